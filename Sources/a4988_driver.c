@@ -0,0 +1,136 @@
+/*
+ * a4988_driver.c
+ *
+ *  Created on: 2026/2/20
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_gpio_driver.h"
+#include "a4988_driver.h"
+#include <stdint.h>
+
+/*
+ * MS1 / MS2 / MS3 levels for each @A4988_Resolution (Bit 0 = MS1, Bit 1 = MS2, Bit 2 = MS3)
+ */
+static const uint8_t A4988_MSTable[5] = {0x0, 0x1, 0x2, 0x3, 0x7};
+
+// Write one control pin, if it is wired at all
+static void A4988_WritePin(const A4988_Pin_t *pPin, uint8_t Value){
+	if (pPin->pGPIOx != 0){
+		GPIO_WriteToOutputPin(pPin->pGPIOx, pPin->PinNumber, Value); // BSRR: atomic, fine in an ISR
+	}
+}
+
+static void A4988_InitPin(const A4988_Pin_t *pPin, uint8_t Value){
+	GPIO_Handle_t gpio;
+
+	if (pPin->pGPIOx == 0){
+		return;
+	}
+
+	// level first, so the pin never glitches through the wrong one when it becomes an output
+	A4988_WritePin(pPin, Value);
+
+	gpio.pGPIOx = pPin->pGPIOx;
+	gpio.GPIO_PinConfig.GPIO_PinNumber = pPin->PinNumber;
+	gpio.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT;
+	gpio.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_MEDIUM; // static levels, no need for fast edges
+	gpio.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP;
+	gpio.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD;
+	gpio.GPIO_PinConfig.GPIO_PinAltFunMode = 0;
+
+	GPIO_PeriClockControl(pPin->pGPIOx, ENABLE);
+	GPIO_Init(&gpio);
+}
+
+// 1/16 steps covered by one pulse at Resolution
+static uint32_t A4988_PhaseStride(uint8_t Resolution){
+	return 16U >> Resolution;
+}
+
+void A4988_Init(A4988_Handle_t *pA4988Handle){
+	A4988_Config_t *pConfig = &pA4988Handle->A4988_Config;
+	uint8_t ms = A4988_MSTable[pConfig->Resolution];
+
+	A4988_InitPin(&pConfig->Dir, GPIO_PIN_RESET);
+	A4988_InitPin(&pConfig->MS1, (ms & 0x1) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	A4988_InitPin(&pConfig->MS2, (ms & 0x2) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	A4988_InitPin(&pConfig->MS3, (ms & 0x4) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	A4988_InitPin(&pConfig->Enable, GPIO_PIN_RESET); // active low: outputs on
+	A4988_InitPin(&pConfig->Sleep, GPIO_PIN_SET);    // active low: awake
+
+	pA4988Handle->Resolution = pConfig->Resolution;
+	pA4988Handle->Direction = A4988_DIR_FORWARD;
+	pA4988Handle->Phase = 0;    // power-up: the translator starts at Home
+	pA4988Handle->Position = 0;
+}
+
+void A4988_Enable(A4988_Handle_t *pA4988Handle, uint8_t EnableOrDisable){
+	A4988_WritePin(&pA4988Handle->A4988_Config.Enable, (EnableOrDisable == ENABLE) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+void A4988_Sleep(A4988_Handle_t *pA4988Handle, uint8_t EnableOrDisable){
+	if (EnableOrDisable == ENABLE){
+		A4988_WritePin(&pA4988Handle->A4988_Config.Sleep, GPIO_PIN_RESET);
+		pA4988Handle->Phase = 0; // RESET follows SLEEP: back to Home on wake-up
+	}
+	else{
+		A4988_WritePin(&pA4988Handle->A4988_Config.Sleep, GPIO_PIN_SET);
+	}
+}
+
+void A4988_SetDirection(A4988_Handle_t *pA4988Handle, uint8_t Direction){
+	A4988_WritePin(&pA4988Handle->A4988_Config.Dir, (Direction == A4988_DIR_REVERSE) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	pA4988Handle->Direction = Direction;
+}
+
+uint8_t A4988_SetResolution(A4988_Handle_t *pA4988Handle, uint8_t Resolution){
+	A4988_Config_t *pConfig = &pA4988Handle->A4988_Config;
+
+	if (Resolution == pA4988Handle->Resolution){
+		return A4988_OK;
+	}
+	if ((Resolution > A4988_RES_SIXTEENTH) || (pConfig->MS1.pGPIOx == 0) ||
+		(A4988_PulsesToAlign(pA4988Handle, Resolution) != 0)){
+		return A4988_ERROR;
+	}
+
+	/*
+	 * Three separate BSRR writes: for a moment the pins show a mix of the old and new
+	 * resolution. Harmless, the translator only looks at MSx on a STEP rising edge.
+	 */
+	uint8_t ms = A4988_MSTable[Resolution];
+	A4988_WritePin(&pConfig->MS1, (ms & 0x1) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	A4988_WritePin(&pConfig->MS2, (ms & 0x2) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	A4988_WritePin(&pConfig->MS3, (ms & 0x4) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+
+	pA4988Handle->Resolution = Resolution;
+	return A4988_OK;
+}
+
+uint32_t A4988_PulsesToAlign(A4988_Handle_t *pA4988Handle, uint8_t Resolution){
+	uint32_t stride = A4988_PhaseStride(pA4988Handle->Resolution);
+	uint32_t target = A4988_PhaseStride(Resolution);
+	uint32_t offset = pA4988Handle->Phase & (target - 1U); // 1/16 steps past the last step of Resolution
+
+	if (offset == 0){
+		return 0;
+	}
+
+	// forward: up to the next step of Resolution, reverse: back to the last one
+	uint32_t distance = (pA4988Handle->Direction == A4988_DIR_FORWARD) ? (target - offset) : offset;
+	return distance / stride; // power of two: a shift
+}
+
+void A4988_Advance(A4988_Handle_t *pA4988Handle, uint32_t Pulses){
+	uint32_t delta = Pulses * A4988_PhaseStride(pA4988Handle->Resolution);
+
+	if (pA4988Handle->Direction == A4988_DIR_FORWARD){
+		pA4988Handle->Position += (int32_t)delta;
+		pA4988Handle->Phase = (uint8_t)((pA4988Handle->Phase + delta) & (A4988_PHASE_STEPS - 1U));
+	}
+	else{
+		pA4988Handle->Position -= (int32_t)delta;
+		pA4988Handle->Phase = (uint8_t)((pA4988Handle->Phase - delta) & (A4988_PHASE_STEPS - 1U));
+	}
+}
@@ -0,0 +1,121 @@
+/*
+ * a4988_driver.h
+ *
+ *  Created on: 2026/2/20
+ *      Author: Yuheng
+ *
+ * Description:
+ * Driver for the A4988 stepper driver's control pins, on top of the GPIO driver.
+ * (The STEP pulses themselves come from TIM2, see stepper_motion.h.)
+ *
+ * [Previously] only STEP (PA0) and DIR (PA1) were wired, MS1-MS3 / ENABLE / SLEEP
+ * were strapped on the breadboard: full steps only, and the driver always on.
+ *
+ * Microstepping (A4988 datasheet, Table 1):
+ *   MS1 MS2 MS3   resolution
+ *    0   0   0    full step
+ *    1   0   0    1/2
+ *    0   1   0    1/4
+ *    1   1   0    1/8
+ *    1   1   1    1/16
+ * Full steps: most torque per pulse and the highest speed for a given STEP rate,
+ * but loud and jerky at low speed. 1/16: smooth and quiet, but 16 pulses per step.
+ *
+ * Switching resolution while the motor turns:
+ * The translator keeps its position in a table of 1/16 steps (64 per electrical cycle)
+ * and simply walks it in bigger strides after a switch. The strides of a coarse resolution
+ * only land on ITS positions (full steps: 45, 135, 225, 315 degrees) if the switch happens
+ * on one of them, otherwise every following "full step" is off by the same fraction
+ * (unequal coil currents, less torque). So the driver tracks the translator position (Phase),
+ * and A4988_SetResolution refuses a switch that is not aligned.
+ * A4988_PulsesToAlign tells how many more pulses at the current resolution get there.
+ *
+ * Position:
+ * Position counts 1/16 steps whatever the resolution, so it is preserved across switches.
+ * The pulses are not seen by this driver: whoever sends them reports them (A4988_Advance).
+ *
+ * Timing: MSx / DIR must be stable 200 ns before a STEP rising edge (the STEP timer's
+ * low phase, MOTION_STEP_EDGE, is much longer), and after SLEEP the charge pump
+ * needs 1 ms before the first STEP.
+ */
+
+#ifndef SOURCES_A4988_DRIVER_H_
+#define SOURCES_A4988_DRIVER_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+#include "stm32f446xx_gpio_driver.h"
+
+/* @A4988_Resolution (= log2 of the pulses per full step) */
+#define A4988_RES_FULL        0
+#define A4988_RES_HALF        1
+#define A4988_RES_QUARTER     2
+#define A4988_RES_EIGHTH      3
+#define A4988_RES_SIXTEENTH   4
+
+#define A4988_PULSES_PER_STEP(Res)  (1U << (Res))
+#define A4988_PHASE_STEPS     64U // 1/16 steps per electrical cycle (4 full steps)
+
+/* @A4988_Direction */
+#define A4988_DIR_FORWARD     0 // DIR low
+#define A4988_DIR_REVERSE     1 // DIR high
+
+/* @A4988_Status */
+#define A4988_OK              0
+#define A4988_ERROR           1 // not aligned / MSx pins not wired
+
+typedef struct{
+	GPIO_RegDef_t *pGPIOx;  // NULL: not wired (strapped on the board)
+	uint8_t PinNumber;
+} A4988_Pin_t;
+
+typedef struct{
+	A4988_Pin_t Dir;
+	A4988_Pin_t MS1;
+	A4988_Pin_t MS2;
+	A4988_Pin_t MS3;
+	A4988_Pin_t Enable;     // active LOW: outputs on
+	A4988_Pin_t Sleep;      // active LOW (RESET is tied to it on the usual carrier boards)
+	uint8_t Resolution;     // @A4988_Resolution at init (or the strapped one)
+} A4988_Config_t;
+
+/*
+ * A4988 Handle
+ * Everything below A4988_Config is owned by the driver.
+ * Shared between main() and the STEP ISRs: A4988_Advance / A4988_SetResolution
+ * are meant for the ISR that ends a move, or main() while no move runs.
+ */
+typedef struct{
+	A4988_Config_t A4988_Config;
+	uint8_t Resolution;          // @A4988_Resolution, current
+	uint8_t Direction;           // @A4988_Direction, current
+	uint8_t Phase;               // translator position, 1/16 steps from its Home (0 - 63)
+	volatile int32_t Position;   // 1/16 steps since A4988_Init, forward positive
+} A4988_Handle_t;
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+// Wired pins -> outputs: outputs on, awake, forward, Resolution from the config, Position 0
+void A4988_Init(A4988_Handle_t *pA4988Handle);
+
+// ENABLE pin: outputs on (holding torque) / off (motor free, no current)
+void A4988_Enable(A4988_Handle_t *pA4988Handle, uint8_t EnableOrDisable);
+
+// SLEEP pin: ENABLE = asleep. Waking up resets the translator to Home (Phase 0), wait 1 ms before stepping
+void A4988_Sleep(A4988_Handle_t *pA4988Handle, uint8_t EnableOrDisable);
+
+void A4988_SetDirection(A4988_Handle_t *pA4988Handle, uint8_t Direction);
+
+// Switch between two pulses: A4988_ERROR (nothing changed) if Phase is not on a step of Resolution
+uint8_t A4988_SetResolution(A4988_Handle_t *pA4988Handle, uint8_t Resolution);
+
+// Pulses at the current resolution and direction until Phase is on a step of Resolution
+uint32_t A4988_PulsesToAlign(A4988_Handle_t *pA4988Handle, uint8_t Resolution);
+
+// Pulses sent at the current resolution and direction: moves Phase / Position along
+void A4988_Advance(A4988_Handle_t *pA4988Handle, uint32_t Pulses);
+
+#endif /* SOURCES_A4988_DRIVER_H_ */
@@ -0,0 +1,94 @@
+/*
+ * clock_governor.c
+ *
+ *  Created on: 2026/2/25
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_rcc_driver.h"
+#include "stm32f446xx_systick_driver.h"
+#include "clock_governor.h"
+#include "timestamp.h"
+#include <stdint.h>
+
+/*
+ * Apply Level and time it. The hooks re-base the timestamps at the new clock,
+ * so Timestamp_Us keeps counting real microseconds across the switch.
+ */
+static uint32_t Governor_Apply(Governor_Handle_t *pGovHandle, uint8_t Level){
+	const RCC_ClockConfig_t *pConfig = (Level == GOVERNOR_LEVEL_FAST) ?
+			&pGovHandle->Governor_Config.Fast : &pGovHandle->Governor_Config.Slow;
+	uint64_t start = Timestamp_Us();
+
+	if (RCC_ClockConfig(pConfig) != RCC_OK){
+		pGovHandle->Failures++; // the hooks still ran: the drivers match whatever clock we ended on
+	}
+
+	uint32_t us = (uint32_t)(Timestamp_Us() - start);
+	pGovHandle->LastSwitchUs = us;
+	pGovHandle->Level = Level;
+	return us;
+}
+
+static void Governor_Switch(Governor_Handle_t *pGovHandle, uint8_t Level){
+	uint32_t us = Governor_Apply(pGovHandle, Level);
+
+	if (Level == GOVERNOR_LEVEL_FAST){
+		pGovHandle->Boosts++;
+		if (us > pGovHandle->MaxBoostUs){
+			pGovHandle->MaxBoostUs = us;
+		}
+	}
+	else{
+		pGovHandle->Drops++;
+		if (us > pGovHandle->MaxDropUs){
+			pGovHandle->MaxDropUs = us;
+		}
+	}
+}
+
+void Governor_Init(Governor_Handle_t *pGovHandle){
+	pGovHandle->Level = GOVERNOR_LEVEL_FAST;
+	pGovHandle->LastBoost = SysTick_GetTick();
+	pGovHandle->Boosts = 0;
+	pGovHandle->Drops = 0;
+	pGovHandle->Resumes = 0;
+	pGovHandle->Failures = 0;
+	pGovHandle->LastSwitchUs = 0;
+	pGovHandle->MaxBoostUs = 0;
+	pGovHandle->MaxDropUs = 0;
+	pGovHandle->MaxResumeUs = 0;
+}
+
+uint8_t Governor_Boost(Governor_Handle_t *pGovHandle){
+	pGovHandle->LastBoost = SysTick_GetTick();
+
+	if (pGovHandle->Level == GOVERNOR_LEVEL_FAST){
+		return RESET;
+	}
+	Governor_Switch(pGovHandle, GOVERNOR_LEVEL_FAST);
+	return SET;
+}
+
+uint8_t Governor_Process(Governor_Handle_t *pGovHandle, uint8_t Busy){
+	if (Busy){
+		pGovHandle->LastBoost = SysTick_GetTick(); // the idle time counts from the end of the work
+		return RESET;
+	}
+	if ((pGovHandle->Level == GOVERNOR_LEVEL_SLOW)
+			|| ((SysTick_GetTick() - pGovHandle->LastBoost) < pGovHandle->Governor_Config.IdleMs)){
+		return RESET;
+	}
+
+	Governor_Switch(pGovHandle, GOVERNOR_LEVEL_SLOW);
+	return SET;
+}
+
+void Governor_Resume(Governor_Handle_t *pGovHandle){
+	uint32_t us = Governor_Apply(pGovHandle, pGovHandle->Level);
+
+	pGovHandle->Resumes++;
+	if (us > pGovHandle->MaxResumeUs){
+		pGovHandle->MaxResumeUs = us;
+	}
+}
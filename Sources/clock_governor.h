@@ -0,0 +1,89 @@
+/*
+ * clock_governor.h
+ *
+ *  Created on: 2026/2/25
+ *      Author: Yuheng
+ *
+ * Description:
+ * Dynamic frequency scaling: full speed while there is work, a slow clock while idle.
+ *
+ * [Previously] 180 MHz all the time (stm32f446xx_rcc_driver.h), but a feeder is idle
+ * more than 99% of the day: waiting for the next command, or the next meal.
+ *
+ * Two levels, both plain RCC_ClockConfig_t:
+ * - FAST: a feed is running / queued, or the PC is talking (any byte received)
+ * - SLOW: nothing of that for Governor_Config.IdleMs
+ * Boost is immediate (main(), before the command is even decoded). The drop only happens
+ * when the caller says nothing is busy (motor, TX line, ...), so no transfer is ever re-clocked.
+ *
+ * The drivers follow on their own: every RCC_ClockConfig runs the clock-change hooks
+ * (RCC_RegisterClockHook): timestamps, SysTick, USART BRR, step timer PSC ...
+ * The IWDG runs from the LSI and does not care.
+ *
+ * Switch latency (Timestamp_Us around RCC_ClockConfig, hooks included) is kept in the handle.
+ * With the same PLL in both levels only the prescalers move: a few us instead of a re-lock.
+ *
+ * main() only (RCC_ClockConfig is), never from an ISR.
+ */
+
+#ifndef SOURCES_CLOCK_GOVERNOR_H_
+#define SOURCES_CLOCK_GOVERNOR_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+#include "stm32f446xx_rcc_driver.h"
+
+/* @Governor_Level */
+#define GOVERNOR_LEVEL_SLOW   0
+#define GOVERNOR_LEVEL_FAST   1
+
+typedef struct{
+	RCC_ClockConfig_t Fast;
+	RCC_ClockConfig_t Slow;
+	uint32_t IdleMs;          // this long without a boost (and not busy) -> SLOW
+} Governor_Config_t;
+
+typedef struct{
+	Governor_Config_t Governor_Config;
+
+	uint8_t Level;            // @Governor_Level
+	uint32_t LastBoost;       // SysTick_GetTick() of the last boost
+
+	/* Statistics */
+	uint32_t Boosts;          // SLOW -> FAST switches
+	uint32_t Drops;           // FAST -> SLOW switches
+	uint32_t Resumes;         // Level re-applied after Stop mode (Governor_Resume)
+	uint32_t Failures;        // RCC_ClockConfig did not return RCC_OK
+	uint32_t LastSwitchUs;    // duration of the last switch, hooks included
+	uint32_t MaxBoostUs;
+	uint32_t MaxDropUs;
+	uint32_t MaxResumeUs;
+} Governor_Handle_t;
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+// Starts at FAST (Governor_Config.Fast is assumed to be applied already, e.g. at boot)
+void Governor_Init(Governor_Handle_t *pGovHandle);
+
+/*
+ * There is work: FAST now (if not already), and the idle time starts over.
+ * Returns SET if the clock was switched (LastSwitchUs is then fresh).
+ */
+uint8_t Governor_Boost(Governor_Handle_t *pGovHandle);
+
+/*
+ * Main loop: SLOW once IdleMs have passed since the last boost and Busy is RESET.
+ * Returns SET if the clock was switched.
+ */
+uint8_t Governor_Process(Governor_Handle_t *pGovHandle, uint8_t Busy);
+
+/*
+ * The clock tree was lost (Stop mode wakes up on HSI, power_manager.h): the current Level again,
+ * with the full PLL start. The level itself does not change, a boost is still up to the caller.
+ */
+void Governor_Resume(Governor_Handle_t *pGovHandle);
+
+#endif /* SOURCES_CLOCK_GOVERNOR_H_ */
@@ -0,0 +1,79 @@
+/*
+ * cobs.c
+ *
+ *  Created on: 2026/2/7
+ *      Author: Yuheng
+ */
+#include "cobs.h"
+#include <stdint.h>
+
+uint16_t COBS_Encode(const uint8_t *pSrc, uint16_t Len, uint8_t *pDest, uint16_t MaxLen){
+	uint16_t write_index = 1; // slot 0 is reserved for the first code byte
+	uint16_t code_index = 0;  // where the current block's code byte goes
+	uint8_t code = 1;         // distance to the next zero (1 = zero right here)
+
+	if (MaxLen == 0){
+		return 0;
+	}
+
+	for (uint16_t i = 0; i < Len; i++){
+		if (write_index >= MaxLen){
+			return 0;
+		}
+
+		if (pSrc[i] == 0){
+			// Close the current block: its code byte points at where this zero was
+			pDest[code_index] = code;
+			code_index = write_index++;
+			code = 1;
+		}
+		else{
+			pDest[write_index++] = pSrc[i];
+			code++;
+
+			// A block can hold at most 254 data bytes (code 0xFF = "254 bytes, NO zero follows")
+			if (code == 0xFF){
+				pDest[code_index] = code;
+				if (write_index >= MaxLen){
+					return 0;
+				}
+				code_index = write_index++;
+				code = 1;
+			}
+		}
+	}
+
+	pDest[code_index] = code;
+	return write_index;
+}
+
+uint16_t COBS_Decode(const uint8_t *pSrc, uint16_t Len, uint8_t *pDest, uint16_t MaxLen){
+	uint16_t read_index = 0;
+	uint16_t write_index = 0;
+
+	while (read_index < Len){
+		uint8_t code = pSrc[read_index++];
+
+		// A 0x00 can never appear inside a COBS frame, and a block cannot run past the end
+		if ((code == 0) || ((read_index + code - 1) > Len)){
+			return 0;
+		}
+
+		for (uint8_t i = 1; i < code; i++){
+			if (write_index >= MaxLen){
+				return 0;
+			}
+			pDest[write_index++] = pSrc[read_index++];
+		}
+
+		// Every block except a "full" one (0xFF) and the last one stands for a 0x00
+		if ((code != 0xFF) && (read_index < Len)){
+			if (write_index >= MaxLen){
+				return 0;
+			}
+			pDest[write_index++] = 0;
+		}
+	}
+
+	return write_index;
+}
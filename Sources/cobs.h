@@ -0,0 +1,45 @@
+/*
+ * cobs.h
+ *
+ *  Created on: 2026/2/7
+ *      Author: Yuheng
+ *
+ * Description:
+ * COBS (Consistent Overhead Byte Stuffing) encoder / decoder.
+ *
+ * Why COBS?
+ * A binary packet can contain ANY byte value, so the receiver needs a way to know
+ * where one packet ends and the next one begins.
+ * COBS rewrites the packet so that it contains NO 0x00 byte at all,
+ * which frees 0x00 to be used as the "end of frame" marker on the wire.
+ *
+ * How:
+ * Every 0x00 is replaced by the distance to the next 0x00 (a "code" byte).
+ * Cost: at most 1 extra byte per 254 bytes of data, always (hence "Consistent Overhead").
+ *
+ * e.g. raw:     11 22 00 33
+ *      encoded: 03 11 22 02 33     (+ 00 delimiter on the wire)
+ */
+
+#ifndef SOURCES_COBS_H_
+#define SOURCES_COBS_H_
+
+#include <stdint.h>
+
+/* Worst case encoded size for Len raw bytes (without the 0x00 delimiter) */
+#define COBS_MAX_ENCODED_LEN(Len)  ((Len) + ((Len) / 254) + 1)
+
+/*
+ * Returns the encoded length (no delimiter is appended),
+ * or 0 if pDest (MaxLen bytes) is too small.
+ */
+uint16_t COBS_Encode(const uint8_t *pSrc, uint16_t Len, uint8_t *pDest, uint16_t MaxLen);
+
+/*
+ * Decodes one frame (WITHOUT its 0x00 delimiter).
+ * Returns the decoded length, or 0 if the frame is malformed / pDest is too small.
+ * pDest may be the same buffer as pSrc (decoding never writes ahead of reading).
+ */
+uint16_t COBS_Decode(const uint8_t *pSrc, uint16_t Len, uint8_t *pDest, uint16_t MaxLen);
+
+#endif /* SOURCES_COBS_H_ */
@@ -0,0 +1,96 @@
+/*
+ * feed_queue.c
+ *
+ *  Created on: 2026/2/15
+ *      Author: Yuheng
+ */
+#include "feed_queue.h"
+#include "stm32f446xx.h"
+#include <stdint.h>
+
+void FeedQueue_Init(Feed_Queue_t *pQueue){
+	pQueue->Count = 0;
+}
+
+uint8_t FeedQueue_Push(Feed_Queue_t *pQueue, const Feed_Job_t *pJob){
+	uint32_t state = Critical_Enter();
+
+	if (pQueue->Count >= FEED_QUEUE_SIZE){
+		Critical_Exit(state);
+		return RESET;
+	}
+
+	/*
+	 * Insert behind every job of the same or higher priority:
+	 * walk back from the end, shifting lower priority jobs one slot down.
+	 */
+	uint8_t pos = pQueue->Count;
+	while ((pos > 0) && (pQueue->Jobs[pos - 1].Priority < pJob->Priority)){
+		pQueue->Jobs[pos] = pQueue->Jobs[pos - 1];
+		pos--;
+	}
+	pQueue->Jobs[pos] = *pJob;
+	pQueue->Count++;
+
+	Critical_Exit(state);
+	return SET;
+}
+
+// Caller holds the critical section
+static void FeedQueue_RemoveAt(Feed_Queue_t *pQueue, uint8_t Index){
+	for (uint8_t i = Index; (i + 1) < pQueue->Count; i++){
+		pQueue->Jobs[i] = pQueue->Jobs[i + 1];
+	}
+	pQueue->Count--;
+}
+
+uint8_t FeedQueue_Pop(Feed_Queue_t *pQueue, Feed_Job_t *pJob){
+	uint32_t state = Critical_Enter();
+
+	if (pQueue->Count == 0){
+		Critical_Exit(state);
+		return RESET;
+	}
+
+	*pJob = pQueue->Jobs[0];
+	FeedQueue_RemoveAt(pQueue, 0);
+
+	Critical_Exit(state);
+	return SET;
+}
+
+uint8_t FeedQueue_Remove(Feed_Queue_t *pQueue, uint8_t Seq){
+	uint32_t state = Critical_Enter();
+
+	for (uint8_t i = 0; i < pQueue->Count; i++){
+		if (pQueue->Jobs[i].Seq == Seq){
+			FeedQueue_RemoveAt(pQueue, i);
+			Critical_Exit(state);
+			return SET;
+		}
+	}
+
+	Critical_Exit(state);
+	return RESET;
+}
+
+uint8_t FeedQueue_Flush(Feed_Queue_t *pQueue){
+	uint32_t state = Critical_Enter();
+	uint8_t removed = pQueue->Count;
+	pQueue->Count = 0;
+	Critical_Exit(state);
+
+	return removed;
+}
+
+uint8_t FeedQueue_Snapshot(Feed_Queue_t *pQueue, Feed_Job_t *pJobs, uint8_t MaxJobs){
+	uint32_t state = Critical_Enter();
+
+	uint8_t count = (pQueue->Count < MaxJobs) ? pQueue->Count : MaxJobs;
+	for (uint8_t i = 0; i < count; i++){
+		pJobs[i] = pQueue->Jobs[i];
+	}
+
+	Critical_Exit(state);
+	return count;
+}
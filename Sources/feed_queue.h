@@ -0,0 +1,60 @@
+/*
+ * feed_queue.h
+ *
+ *  Created on: 2026/2/15
+ *      Author: Yuheng
+ *
+ * Description:
+ * Bounded priority queue of feed jobs.
+ *
+ * [Previously] a FEED arriving while TIM6 was running was simply thrown away
+ * (later: NACK BUSY), so feeding several cats meant the PC had to poll and resend.
+ * Now every FEED becomes a job in this queue, and the feed state machine (main.c) starts the next job
+ * as soon as the TIM3 ISR reports the last step of the current one.
+ *
+ * Order: highest Priority first, first-come first-served among equal priorities.
+ *
+ * [Previously] shared between main() (push / cancel / flush / snapshot) and the TIM3 ISR (pop).
+ * Only main() uses it now, but every function still masks interrupts for its few instructions
+ * (Critical_Enter): a snapshot stays consistent whoever pops.
+ * With at most FEED_QUEUE_SIZE jobs, shifting the array around is cheaper than anything smarter.
+ */
+
+#ifndef SOURCES_FEED_QUEUE_H_
+#define SOURCES_FEED_QUEUE_H_
+
+#include <stdint.h>
+
+#define FEED_QUEUE_SIZE      8U
+
+/* @Feed_Priority */
+#define FEED_PRIORITY_LOW    0
+#define FEED_PRIORITY_NORMAL 1
+#define FEED_PRIORITY_HIGH   2
+#define FEED_PRIORITY_URGENT 3
+
+typedef struct{
+	uint16_t Steps;
+	uint16_t Speed;       // steps per second
+	uint16_t Period;      // ticks per cruise step (MOTION_PERIOD_TICKS of Speed): the ISRs never divide
+	uint16_t DurationMs;  // ramps + cruise (Motion_EstimateMs), computed once when the job is accepted
+	uint8_t Priority;     // @Feed_Priority
+	uint8_t Seq;          // Seq of the FEED command (job ID towards the PC)
+} Feed_Job_t;
+
+typedef struct{
+	Feed_Job_t Jobs[FEED_QUEUE_SIZE]; // Jobs[0] runs next
+	uint8_t Count;
+} Feed_Queue_t;
+
+void FeedQueue_Init(Feed_Queue_t *pQueue);
+
+uint8_t FeedQueue_Push(Feed_Queue_t *pQueue, const Feed_Job_t *pJob);  // RESET: queue full
+uint8_t FeedQueue_Pop(Feed_Queue_t *pQueue, Feed_Job_t *pJob);         // RESET: queue empty
+uint8_t FeedQueue_Remove(Feed_Queue_t *pQueue, uint8_t Seq);           // RESET: no such job
+uint8_t FeedQueue_Flush(Feed_Queue_t *pQueue);                         // number of jobs removed
+
+// Consistent copy of the queue (in execution order), returns the number of jobs copied
+uint8_t FeedQueue_Snapshot(Feed_Queue_t *pQueue, Feed_Job_t *pJobs, uint8_t MaxJobs);
+
+#endif /* SOURCES_FEED_QUEUE_H_ */
@@ -0,0 +1,285 @@
+/*
+ * fsm.c
+ *
+ *  Created on: 2026/2/28
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "fsm.h"
+#include "soft_timer.h"
+#include "spsc_queue.h"
+#include "timestamp.h"
+#include <stdint.h>
+
+// SET if Ancestor is a strict ancestor of State (FSM_NONE: the root above every top-level state)
+static uint8_t FSM_IsAncestor(const FSM_Handle_t *pFSMHandle, uint8_t Ancestor, uint8_t State){
+	if (Ancestor == FSM_NONE){
+		return SET;
+	}
+
+	const FSM_State_t *pStates = pFSMHandle->FSM_Config.pStates;
+	uint8_t s = pStates[State].Parent;
+
+	while (s != FSM_NONE){
+		if (s == Ancestor){
+			return SET;
+		}
+		s = pStates[s].Parent;
+	}
+	return RESET;
+}
+
+static void FSM_Enter(FSM_Handle_t *pFSMHandle, uint8_t State){
+	const FSM_State_t *pState = &pFSMHandle->FSM_Config.pStates[State];
+
+	if (pState->Entry != 0){
+		pState->Entry(pFSMHandle);
+	}
+}
+
+static void FSM_Exit(FSM_Handle_t *pFSMHandle, uint8_t State){
+	const FSM_State_t *pState = &pFSMHandle->FSM_Config.pStates[State];
+
+	if (pState->Exit != 0){
+		pState->Exit(pFSMHandle);
+	}
+}
+
+/*
+ * Current -> Target, external: exit up to the first strict ancestor of Target,
+ * enter down from there to Target, then its initial children down to a leaf.
+ * At most FSM_MAX_DEPTH states on each side.
+ */
+static void FSM_Transition(FSM_Handle_t *pFSMHandle, uint8_t Target){
+	const FSM_State_t *pStates = pFSMHandle->FSM_Config.pStates;
+	uint8_t path[FSM_MAX_DEPTH];
+	uint8_t depth = 0;
+
+	uint8_t s = pFSMHandle->Current;
+	while ((s != FSM_NONE) && !FSM_IsAncestor(pFSMHandle, s, Target)){
+		FSM_Exit(pFSMHandle, s);
+		s = pStates[s].Parent;
+	}
+
+	// s is now the common ancestor (or the root): Target's chain below it, top-down
+	for (uint8_t t = Target; t != s; t = pStates[t].Parent){
+		path[depth++] = t;
+	}
+	while (depth > 0){
+		FSM_Enter(pFSMHandle, path[--depth]);
+	}
+
+	while (pStates[Target].Initial != FSM_NONE){
+		Target = pStates[Target].Initial;
+		FSM_Enter(pFSMHandle, Target);
+	}
+
+	pFSMHandle->Current = Target;
+}
+
+static void FSM_Dispatch(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent){
+	FSM_Config_t *pConfig = &pFSMHandle->FSM_Config;
+
+	if (pEvent->Signal >= pConfig->NumSignals){
+		pFSMHandle->Ignored++;
+		return;
+	}
+
+	uint8_t index = pFSMHandle->Lookup[pFSMHandle->Current][pEvent->Signal];
+	if (index == 0){
+		pFSMHandle->Ignored++;
+		return;
+	}
+
+	const FSM_Transition_t *pTransition = &pConfig->pTransitions[index - 1U];
+	uint8_t target = pTransition->Target;
+	uint8_t chosen = FSM_NONE;
+
+	if (pTransition->Action != 0){
+		chosen = pTransition->Action(pFSMHandle, pEvent);
+	}
+	if (target == FSM_CHOICE){
+		target = chosen;
+	}
+	if (target < pConfig->NumStates){
+		FSM_Transition(pFSMHandle, target);
+	}
+
+	pFSMHandle->Dispatched++;
+}
+
+uint8_t FSM_Init(FSM_Handle_t *pFSMHandle){
+	FSM_Config_t *pConfig = &pFSMHandle->FSM_Config;
+	const FSM_State_t *pStates = pConfig->pStates;
+
+	pFSMHandle->Current = FSM_NONE;
+	pFSMHandle->Dispatched = 0;
+	pFSMHandle->Ignored = 0;
+	pFSMHandle->Dropped = 0;
+	pFSMHandle->MaxDispatchUs = 0;
+	if (SPSC_Init(&pFSMHandle->Events, pFSMHandle->EventStorage, FSM_QUEUE_SIZE) != SET){
+		return FSM_ERROR; // FSM_QUEUE_SIZE is not a power of two
+	}
+
+	if ((pConfig->NumStates > FSM_MAX_STATES) || (pConfig->NumSignals > FSM_MAX_SIGNALS) ||
+		(pConfig->Initial >= pConfig->NumStates)){
+		return FSM_ERROR;
+	}
+
+	/*
+	 * ------------------------------
+	 * 1. States
+	 * ------------------------------
+	 * Parents exist and nest at most FSM_MAX_DEPTH deep (which also rules out a loop),
+	 * an initial child really is a child.
+	 */
+	for (uint8_t s = 0; s < pConfig->NumStates; s++){
+		uint8_t depth = 0;
+		uint8_t p = pStates[s].Parent;
+
+		while (p != FSM_NONE){
+			if ((p >= pConfig->NumStates) || (++depth >= FSM_MAX_DEPTH)){
+				return FSM_ERROR;
+			}
+			p = pStates[p].Parent;
+		}
+		pFSMHandle->Depth[s] = depth;
+
+		uint8_t initial = pStates[s].Initial;
+		if ((initial != FSM_NONE) && ((initial >= pConfig->NumStates) || (pStates[initial].Parent != s))){
+			return FSM_ERROR;
+		}
+	}
+
+	/*
+	 * ------------------------------
+	 * 2. Lookup
+	 * ------------------------------
+	 * For every state and signal: its own transition, else the nearest ancestor's.
+	 * The walk up happens here once, never while dispatching.
+	 */
+	for (uint8_t s = 0; s < pConfig->NumStates; s++){
+		for (uint8_t sig = 0; sig < pConfig->NumSignals; sig++){
+			pFSMHandle->Lookup[s][sig] = 0;
+		}
+	}
+
+	for (uint8_t i = 0; i < pConfig->NumTransitions; i++){
+		const FSM_Transition_t *pTransition = &pConfig->pTransitions[i];
+
+		if ((pTransition->State >= pConfig->NumStates) || (pTransition->Signal >= pConfig->NumSignals) ||
+			((pTransition->Target >= pConfig->NumStates) && (pTransition->Target != FSM_NONE) &&
+			 (pTransition->Target != FSM_CHOICE)) ||
+			((pTransition->Target == FSM_CHOICE) && (pTransition->Action == 0))){
+			return FSM_ERROR;
+		}
+	}
+
+	for (uint8_t s = 0; s < pConfig->NumStates; s++){
+		for (uint8_t sig = 0; sig < pConfig->NumSignals; sig++){
+			uint8_t best = 0;
+			uint8_t best_depth = 0;
+
+			// the deepest state on the path from s up that defines sig (s itself first)
+			for (uint8_t i = 0; i < pConfig->NumTransitions; i++){
+				const FSM_Transition_t *pTransition = &pConfig->pTransitions[i];
+				uint8_t owner = pTransition->State;
+
+				if ((pTransition->Signal != sig) || ((owner != s) && !FSM_IsAncestor(pFSMHandle, owner, s))){
+					continue;
+				}
+				if ((best == 0) || (pFSMHandle->Depth[owner] > best_depth)){
+					best = i + 1U;
+					best_depth = pFSMHandle->Depth[owner];
+				}
+			}
+			pFSMHandle->Lookup[s][sig] = best;
+		}
+	}
+
+	return FSM_OK;
+}
+
+void FSM_Start(FSM_Handle_t *pFSMHandle){
+	FSM_Transition(pFSMHandle, pFSMHandle->FSM_Config.Initial);
+}
+
+uint8_t FSM_Post(FSM_Handle_t *pFSMHandle, uint8_t Signal, uint8_t Arg){
+	uint8_t event[sizeof(FSM_Event_t)] = {Signal, Arg};
+	uint8_t stored = RESET;
+
+	/*
+	 * Several producers (ISRs, timer callbacks, main()): the critical section makes
+	 * each push atomic, so the queue still only ever sees one producer at a time.
+	 * Both bytes or nothing: half an event would shift every following one.
+	 */
+	uint32_t state = Critical_Enter();
+
+	if (SPSC_Free(&pFSMHandle->Events) >= sizeof(event)){
+		SPSC_PushBuffer(&pFSMHandle->Events, event, sizeof(event));
+		stored = SET;
+	}
+	else{
+		pFSMHandle->Dropped++;
+	}
+
+	Critical_Exit(state);
+	return stored;
+}
+
+uint32_t FSM_Process(FSM_Handle_t *pFSMHandle){
+	uint8_t raw[sizeof(FSM_Event_t)];
+	uint32_t count = 0;
+
+	while (SPSC_PopBuffer(&pFSMHandle->Events, raw, sizeof(raw)) == sizeof(raw)){
+		FSM_Event_t event = {raw[0], raw[1]};
+		uint64_t start = Timestamp_Us();
+
+		FSM_Dispatch(pFSMHandle, &event);
+
+		uint32_t elapsed = (uint32_t)(Timestamp_Us() - start);
+		if (elapsed > pFSMHandle->MaxDispatchUs){
+			pFSMHandle->MaxDispatchUs = elapsed;
+		}
+		count++;
+	}
+
+	return count;
+}
+
+uint8_t FSM_IsIn(const FSM_Handle_t *pFSMHandle, uint8_t State){
+	uint8_t s = pFSMHandle->Current;
+
+	while (s != FSM_NONE){
+		if (s == State){
+			return SET;
+		}
+		s = pFSMHandle->FSM_Config.pStates[s].Parent;
+	}
+	return RESET;
+}
+
+// SoftTimer_Process (main()): turn the expiry into an event like any other
+static void FSM_TimerCallback(SoftTimer_t *pTimer){
+	FSM_Timer_t *pFSMTimer = (FSM_Timer_t*)pTimer->pArg;
+
+	(void)FSM_Post(pFSMTimer->pFSMHandle, pFSMTimer->Signal, pFSMTimer->Generation);
+}
+
+void FSM_TimerInit(FSM_Timer_t *pFSMTimer, FSM_Handle_t *pFSMHandle, uint8_t Signal){
+	pFSMTimer->Timer.Callback = FSM_TimerCallback;
+	pFSMTimer->Timer.pArg = pFSMTimer;
+	pFSMTimer->pFSMHandle = pFSMHandle;
+	pFSMTimer->Signal = Signal;
+	pFSMTimer->Generation = 0;
+}
+
+void FSM_TimerStart(FSM_Timer_t *pFSMTimer, uint32_t Ms){
+	pFSMTimer->Generation++;
+	SoftTimer_Start(&pFSMTimer->Timer, Ms / SOFTTIMER_TICK_MS, 0);
+}
+
+void FSM_TimerStop(FSM_Timer_t *pFSMTimer){
+	pFSMTimer->Generation++;
+	SoftTimer_Stop(&pFSMTimer->Timer);
+}
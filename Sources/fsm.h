@@ -0,0 +1,171 @@
+/*
+ * fsm.h
+ *
+ *  Created on: 2026/2/28
+ *      Author: Yuheng
+ *
+ * Description:
+ * Table-driven hierarchical state machine, driven by an event queue.
+ *
+ * [Previously] the feeder was a handful of flags (FeedActive, the timeout's state, the queue count)
+ * read and written by the TIM3 ISR, main() and the timeout callback, each deciding on its own
+ * what "the motor is running" means. Every new behaviour (jam recovery, a fault that stays)
+ * would have been one more flag and one more if/else in each of them.
+ * Now the states, and what each event does in each state, are two constant tables.
+ *
+ * States (FSM_State_t): a Parent (or FSM_NONE), an Entry / Exit action, and for a composite
+ * state the Initial child it drills into when it is the target of a transition.
+ * Transitions (FSM_Transition_t): {State, Signal} -> Target, with an optional Action.
+ * A state inherits every transition of its ancestors it does not define itself,
+ * so "CANCEL while the motor is on" is written once on the parent, not once per child.
+ *
+ * O(1) Dispatch:
+ * FSM_Init resolves the inheritance once, into Lookup[state][signal] (one byte per pair).
+ * Dispatching an event is then a single table read, the action, and (on a transition)
+ * at most FSM_MAX_DEPTH exits and entries: the cost of an event does not depend on
+ * how many states or transitions the machine has.
+ *
+ * Run-To-Completion:
+ * Events are queued (FSM_Post: any context, ISRs included) and dispatched one at a time
+ * in main() (FSM_Process). An action never runs inside an ISR, and never while another one
+ * is running: an action that posts an event sees it handled after itself, never in the middle.
+ * The latency of an event posted by an ISR is one main loop pass (the WFI wakes up on that
+ * very interrupt), plus the events queued ahead of it.
+ *
+ * Transitions are external: the states are left up to (not including) the first common
+ * ancestor of the current state and the target, then entered down to the target.
+ * A transition to the state itself exits and re-enters it.
+ * Target = FSM_NONE: internal, only the action runs. Target = FSM_CHOICE: the action
+ * returns the target (FSM_NONE to stay), for the "if the queue is empty ... else ..." cases.
+ *
+ * Timed Events (FSM_Timer_t):
+ * A software timer (soft_timer.h) that posts a signal when it fires. Restarting or stopping it
+ * makes an event it already posted stale: FSM_TimerIsCurrent tells them apart.
+ */
+
+#ifndef SOURCES_FSM_H_
+#define SOURCES_FSM_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+#include "soft_timer.h"
+#include "spsc_queue.h"
+
+#define FSM_MAX_STATES    8U  // Lookup rows
+#define FSM_MAX_SIGNALS   8U  // Lookup columns
+#define FSM_MAX_DEPTH     4U  // nesting levels, the root included
+#define FSM_QUEUE_SIZE    32U // bytes, MUST be a power of two: 16 events
+
+#define FSM_NONE          0xFFU // no parent / no initial child / no transition (stay)
+#define FSM_CHOICE        0xFEU // Target: the action decides
+
+/* @FSM_Status */
+#define FSM_OK            0
+#define FSM_ERROR         1 // inconsistent tables, or more than the FSM_MAX_xxx above
+
+typedef struct{
+	uint8_t Signal;
+	uint8_t Arg;       // free for the poster (job Seq, timer generation ...)
+} FSM_Event_t;
+
+typedef struct FSM_Handle FSM_Handle_t;
+
+// Entry / Exit of a state
+typedef void (*FSM_StateAction_t)(FSM_Handle_t *pFSMHandle);
+
+// Transition action: returns the target for FSM_CHOICE (ignored otherwise)
+typedef uint8_t (*FSM_Action_t)(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent);
+
+typedef struct{
+	uint8_t Parent;            // FSM_NONE: top level
+	uint8_t Initial;           // composite: child entered with it, FSM_NONE: leaf
+	FSM_StateAction_t Entry;   // may be NULL
+	FSM_StateAction_t Exit;    // may be NULL
+} FSM_State_t;
+
+typedef struct{
+	uint8_t State;             // where it is defined (its children inherit it)
+	uint8_t Signal;
+	uint8_t Target;            // a state, FSM_NONE (internal) or FSM_CHOICE
+	FSM_Action_t Action;       // may be NULL (not with FSM_CHOICE)
+} FSM_Transition_t;
+
+typedef struct{
+	const FSM_State_t *pStates;           // indexed by state number
+	const FSM_Transition_t *pTransitions;
+	uint8_t NumStates;
+	uint8_t NumTransitions;
+	uint8_t NumSignals;
+	uint8_t Initial;                      // state entered by FSM_Start
+} FSM_Config_t;
+
+/*
+ * FSM Handle
+ * Everything below FSM_Config is owned by the module.
+ */
+struct FSM_Handle{
+	FSM_Config_t FSM_Config;
+
+	uint8_t Current;                                // a leaf state
+	uint8_t Depth[FSM_MAX_STATES];                  // 0 = top level
+	uint8_t Lookup[FSM_MAX_STATES][FSM_MAX_SIGNALS]; // transition index + 1, 0 = ignored
+	SPSC_Queue_t Events;
+	uint8_t EventStorage[FSM_QUEUE_SIZE];
+
+	/* Statistics */
+	uint32_t Dispatched;       // events that hit a transition
+	uint32_t Ignored;          // events no state on the path handles
+	uint32_t Dropped;          // events lost: queue full
+	uint32_t MaxDispatchUs;    // longest single dispatch (action + exits + entries)
+};
+
+/*
+ * Timed event: posts Signal (Arg = generation) to pFSMHandle when it fires.
+ * Static or global, like any SoftTimer_t.
+ */
+typedef struct{
+	SoftTimer_t Timer;
+	FSM_Handle_t *pFSMHandle;
+	uint8_t Signal;
+	uint8_t Generation;        // +1 at every start / stop
+} FSM_Timer_t;
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+/*
+ * Checks the tables, resolves the inheritance into Lookup, empties the queue.
+ * No state is entered yet (FSM_Start). Returns @FSM_Status. Before any ISR may post.
+ */
+uint8_t FSM_Init(FSM_Handle_t *pFSMHandle);
+
+// Enters FSM_Config.Initial (and its initial children): main() only, once
+void FSM_Start(FSM_Handle_t *pFSMHandle);
+
+// Queue an event: any context (a short critical section). RESET if the queue was full
+uint8_t FSM_Post(FSM_Handle_t *pFSMHandle, uint8_t Signal, uint8_t Arg);
+
+// Main loop: dispatches every queued event, in order. Returns how many
+uint32_t FSM_Process(FSM_Handle_t *pFSMHandle);
+
+// Events waiting for FSM_Process
+static inline uint32_t FSM_Pending(const FSM_Handle_t *pFSMHandle){
+	return SPSC_Count(&pFSMHandle->Events) / sizeof(FSM_Event_t);
+}
+
+// SET if the current state is State or one of its descendants
+uint8_t FSM_IsIn(const FSM_Handle_t *pFSMHandle, uint8_t State);
+
+/* Timed events (main() only, like the actions that use them) */
+void FSM_TimerInit(FSM_Timer_t *pFSMTimer, FSM_Handle_t *pFSMHandle, uint8_t Signal);
+void FSM_TimerStart(FSM_Timer_t *pFSMTimer, uint32_t Ms);
+void FSM_TimerStop(FSM_Timer_t *pFSMTimer);
+
+// SET if pEvent was posted by pFSMTimer since its last start (and it was not stopped since)
+static inline uint8_t FSM_TimerIsCurrent(const FSM_Timer_t *pFSMTimer, const FSM_Event_t *pEvent){
+	return (pEvent->Arg == pFSMTimer->Generation) ? SET : RESET;
+}
+
+#endif /* SOURCES_FSM_H_ */
@@ -0,0 +1,494 @@
+/*
+ * kernel.c
+ *
+ *  Created on: 2026/3/1
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "kernel.h"
+#include <stdint.h>
+
+/*
+ * S16-S31 only exist for the compiler (and the assembler) when it may use the FPU:
+ * a soft-float build never sets CONTROL.FPCA, so PendSV never sees an extended frame there.
+ */
+#if defined(__ARM_FP)
+#define KERNEL_FPU_CONTEXT  1
+#else
+#define KERNEL_FPU_CONTEXT  0
+#endif
+
+#define KERNEL_PENDSVSET    (1U << 28)  // SCB_ICSR
+#define KERNEL_EXC_RETURN   0xFFFFFFFDU // back to Thread mode, on the PSP, basic frame
+#define KERNEL_XPSR_THUMB   0x01000000U // xPSR Bit 24 T: the Cortex-M4 only runs Thumb code
+
+static Kernel_Task_t *Tasks[KERNEL_PRIORITIES]; // by priority
+static volatile uint32_t ReadyMask;  // Bit n: Tasks[n] is ready
+static volatile uint32_t TimedMask;  // Bit n: Tasks[n] is blocked with a timeout
+static Kernel_Task_t *pCurrent;
+static volatile uint32_t Tick;
+static uint8_t Running;
+
+static Kernel_Stats_t Stats;
+static uint32_t SwitchStart;
+
+static Kernel_Task_t IdleTask;
+static uint32_t IdleStack[KERNEL_IDLE_STACK_WORDS] __attribute__((aligned(8)));
+
+/*
+ * main()'s context, saved by the very first switch and never resumed.
+ * Big enough for one extended frame (hardware 26 words + S16-S31 + R4-R11 / EXC_RETURN).
+ */
+static Kernel_Task_t BootTask;
+static uint32_t BootStack[KERNEL_STACK_MIN_WORDS] __attribute__((aligned(8)));
+
+// Called by PendSV_Handler only (assembly)
+uint32_t *Kernel_SwitchContext(uint32_t *pSP, uint32_t StartCycles) __attribute__((used));
+void Kernel_SwitchDone(uint32_t EndCycles) __attribute__((used));
+
+// Highest set bit: one CLZ (Mask != 0)
+static inline uint8_t Kernel_Highest(uint32_t Mask){
+	return (uint8_t)(31U - (uint32_t)__builtin_clz(Mask));
+}
+
+static inline uint8_t Kernel_InISR(void){
+	uint32_t ipsr;
+	__asm volatile ("MRS %0, IPSR" : "=r" (ipsr));
+	return (ipsr != 0) ? SET : RESET;
+}
+
+// A wait may only block in a task, with interrupts enabled (PRIMASK before Critical_Enter)
+static inline uint8_t Kernel_CanBlock(uint32_t State){
+	return (Running && !Kernel_InISR() && (State == 0)) ? SET : RESET;
+}
+
+// Inside a critical section: switch if a higher task is ready now (or the current one is not)
+static void Kernel_Preempt(void){
+	if (Running && (Kernel_Highest(ReadyMask) != pCurrent->Priority)){
+		SCB_ICSR = KERNEL_PENDSVSET;
+	}
+}
+
+// Inside a critical section: the task leaves its waiters mask / the timeouts, ready again
+static void Kernel_Wake(Kernel_Task_t *pTask, uint8_t Result){
+	uint32_t bit = (1U << pTask->Priority);
+
+	if (pTask->pWaitMask != 0){
+		*pTask->pWaitMask &= ~bit;
+		pTask->pWaitMask = 0;
+	}
+	TimedMask &= ~bit;
+	ReadyMask |= bit;
+	pTask->WaitResult = Result;
+}
+
+/*
+ * Inside a critical section, from a task: it is not ready anymore, the switch is pending.
+ * It happens at Critical_Exit, and the task resumes there once it is woken up.
+ */
+static void Kernel_Block(volatile uint32_t *pWaitMask, uint32_t Timeout){
+	uint32_t bit = (1U << pCurrent->Priority);
+
+	ReadyMask &= ~bit;
+	pCurrent->pWaitMask = pWaitMask;
+	if (pWaitMask != 0){
+		*pWaitMask |= bit;
+	}
+	if (Timeout != KERNEL_WAIT_FOREVER){
+		pCurrent->WakeTick = Tick + Timeout;
+		TimedMask |= bit;
+	}
+	pCurrent->WaitResult = KERNEL_TIMEOUT;
+
+	SCB_ICSR = KERNEL_PENDSVSET;
+}
+
+/*
+ * Inside a critical section (State: what Critical_Enter returned): wait on pWaiters
+ * for what is left of Timeout since Start. Returns with the critical section entered again.
+ */
+static uint8_t Kernel_Wait(volatile uint32_t *pWaiters, uint32_t Timeout, uint32_t Start, uint32_t State){
+	uint32_t left = KERNEL_WAIT_FOREVER;
+
+	if (Timeout == KERNEL_NO_WAIT){
+		return KERNEL_TIMEOUT;
+	}
+	if (!Kernel_CanBlock(State)){
+		return KERNEL_ERROR;
+	}
+	if (Timeout != KERNEL_WAIT_FOREVER){
+		uint32_t elapsed = Tick - Start;
+		if (elapsed >= Timeout){
+			return KERNEL_TIMEOUT;
+		}
+		left = Timeout - elapsed;
+	}
+
+	Kernel_Task_t *pTask = pCurrent;
+	Kernel_Block(pWaiters, left);
+
+	Critical_Exit(State);
+	SYNC_BARRIER(); // PendSV is taken here, before the next instruction
+	(void)Critical_Enter();
+
+	return pTask->WaitResult;
+}
+
+static void Kernel_Copy(uint8_t *pDest, const uint8_t *pSrc, uint16_t Len){
+	for (uint16_t i = 0; i < Len; i++){
+		pDest[i] = pSrc[i];
+	}
+}
+
+// A task function returned: it simply never runs again
+static void Kernel_TaskExit(void){
+	(void)Critical_Enter();
+	Kernel_Block(0, KERNEL_WAIT_FOREVER);
+	Critical_Exit(0);
+
+	while (1){
+	}
+}
+
+static void Kernel_IdleTask(void *pArg){
+	while (1){
+		Kernel_IdleHook();
+	}
+}
+
+__attribute__((weak)) void Kernel_IdleHook(void){
+	__asm volatile ("WFI" : : : "memory");
+}
+
+/*
+ * The stack of a task that was never switched in looks as if it had been switched out
+ * right at its first instruction:
+ *
+ *   top -> xPSR, PC = Entry, LR = Kernel_TaskExit, R12, R3, R2, R1, R0 = pArg  (hardware frame)
+ *          EXC_RETURN, R11 ... R4                                              (PendSV's part)
+ */
+static uint8_t Kernel_SetupTask(Kernel_Task_t *pTask, Kernel_TaskEntry_t Entry, void *pArg,
+		uint32_t *pStack, uint32_t StackWords, uint8_t Priority){
+	if ((pTask == 0) || (Entry == 0) || (pStack == 0) || (StackWords < KERNEL_STACK_MIN_WORDS) ||
+		(((uint32_t)pStack & 0x7U) != 0) || (Priority >= KERNEL_PRIORITIES)){
+		return KERNEL_ERROR;
+	}
+
+	for (uint32_t i = 0; i < StackWords; i++){
+		pStack[i] = KERNEL_STACK_FILL;
+	}
+
+	uint32_t *sp = &pStack[StackWords & ~1U]; // 8-byte aligned top (AAPCS)
+	*--sp = KERNEL_XPSR_THUMB;
+	*--sp = (uint32_t)Entry & ~1U;
+	*--sp = (uint32_t)Kernel_TaskExit;
+	for (uint8_t i = 0; i < 4; i++){
+		*--sp = 0; // R12, R3 - R1
+	}
+	*--sp = (uint32_t)pArg;
+	*--sp = KERNEL_EXC_RETURN;
+	for (uint8_t i = 0; i < 8; i++){
+		*--sp = 0; // R11 - R4
+	}
+
+	pTask->pSP = sp;
+	pTask->pStack = pStack;
+	pTask->StackWords = StackWords;
+	pTask->pWaitMask = 0;
+	pTask->Activations = 0;
+	pTask->Priority = Priority;
+	pTask->WaitResult = KERNEL_OK;
+
+	uint32_t state = Critical_Enter();
+	uint8_t status = KERNEL_ERROR;
+
+	if (Tasks[Priority] == 0){
+		Tasks[Priority] = pTask;
+		ReadyMask |= (1U << Priority);
+		Kernel_Preempt();
+		status = KERNEL_OK;
+	}
+
+	Critical_Exit(state);
+	return status;
+}
+
+void Kernel_Init(void){
+	for (uint8_t i = 0; i < KERNEL_PRIORITIES; i++){
+		Tasks[i] = 0;
+	}
+	ReadyMask = 0;
+	TimedMask = 0;
+	Tick = 0;
+	Running = RESET;
+	Stats.Switches = 0;
+	Stats.LastSwitchCycles = 0;
+	Stats.MaxSwitchCycles = 0;
+
+	(void)Kernel_SetupTask(&IdleTask, Kernel_IdleTask, 0, IdleStack, KERNEL_IDLE_STACK_WORDS, 0);
+}
+
+uint8_t Kernel_CreateTask(Kernel_Task_t *pTask, Kernel_TaskEntry_t Entry, void *pArg,
+		uint32_t *pStack, uint32_t StackWords, uint8_t Priority){
+	if (Priority == 0){
+		return KERNEL_ERROR; // the idle task's
+	}
+	return Kernel_SetupTask(pTask, Entry, pArg, pStack, StackWords, Priority);
+}
+
+void Kernel_Start(void){
+	/*
+	 * SHPR3 Bits 23:16: PendSV at the lowest priority (0xF0: only the upper 4 bits exist),
+	 * below every IRQ: a switch never delays an ISR, and never runs in the middle of one.
+	 */
+	SCB_SHPR3 = (SCB_SHPR3 & ~(0xFFU << 16)) | (0xF0U << 16);
+
+	(void)Critical_Enter();
+	pCurrent = &BootTask;
+	Running = SET;
+	SCB_ICSR = KERNEL_PENDSVSET;
+
+	/*
+	 * CONTROL Bit 1 SPSEL = 1: Thread mode on the PSP (the tasks' stacks), Handler mode stays on
+	 * the MSP (main()'s stack, from here on the ISRs' only). Bit 2 FPCA = 0: main()'s FP context,
+	 * if any, is not needed anymore. ISB: the new stack pointer is used from the next instruction.
+	 * All in one block: the compiler must not touch the stack in between.
+	 * PendSV is taken right at CPSIE and saves this context into BootStack, never to come back.
+	 */
+	__asm volatile (
+		"MSR   PSP, %0       \n"
+		"MOVS  r0, #2        \n"
+		"MSR   CONTROL, r0   \n"
+		"ISB                 \n"
+		"CPSIE i             \n"
+		"1:                  \n"
+		"B     1b            \n"
+		: : "r" (&BootStack[KERNEL_STACK_MIN_WORDS]) : "r0", "memory");
+
+	while (1){
+	}
+}
+
+/*
+ * PendSV: save the current task on its own stack, load the next one.
+ * Naked: no prologue, LR is still EXC_RETURN and the PSP is exactly what the hardware left.
+ * DWT CYCCNT (0xE0001004) is read on entry and once the next context is back.
+ */
+void PendSV_Handler(void) __attribute__((naked));
+void PendSV_Handler(void){
+	__asm volatile (
+		"MOVW     r3, #0x1004         \n"
+		"MOVT     r3, #0xE000         \n"
+		"LDR      r1, [r3]            \n" // start of the switch
+		"MRS      r0, PSP             \n"
+#if KERNEL_FPU_CONTEXT
+		"TST      lr, #0x10           \n" // EXC_RETURN Bit 4 = 0: extended frame, the task uses the FPU
+		"IT       EQ                  \n"
+		"VSTMDBEQ r0!, {s16-s31}      \n"
+#endif
+		"STMDB    r0!, {r4-r11, lr}   \n"
+		"BL       Kernel_SwitchContext\n" // r0: the next task's saved SP
+		"LDMIA    r0!, {r4-r11, lr}   \n"
+#if KERNEL_FPU_CONTEXT
+		"TST      lr, #0x10           \n"
+		"IT       EQ                  \n"
+		"VLDMIAEQ r0!, {s16-s31}      \n"
+#endif
+		"MSR      PSP, r0             \n"
+		"MOVW     r3, #0x1004         \n"
+		"MOVT     r3, #0xE000         \n"
+		"LDR      r0, [r3]            \n" // end of the switch
+		"PUSH     {r4, lr}            \n" // r4: the next task's already, keeps the MSP 8-byte aligned
+		"BL       Kernel_SwitchDone   \n"
+		"POP      {r4, lr}            \n"
+		"BX       lr                  \n"
+	);
+}
+
+uint32_t *Kernel_SwitchContext(uint32_t *pSP, uint32_t StartCycles){
+	// PendSV may be interrupted: an ISR could be readying a task right now
+	uint32_t state = Critical_Enter();
+
+	pCurrent->pSP = pSP;
+	Kernel_Task_t *pNext = Tasks[Kernel_Highest(ReadyMask)];
+	if (pNext != pCurrent){
+		pNext->Activations++;
+		Stats.Switches++;
+	}
+	pCurrent = pNext;
+	SwitchStart = StartCycles;
+
+	Critical_Exit(state);
+	return pCurrent->pSP;
+}
+
+void Kernel_SwitchDone(uint32_t EndCycles){
+	uint32_t cycles = EndCycles - SwitchStart;
+
+	Stats.LastSwitchCycles = cycles;
+	if (cycles > Stats.MaxSwitchCycles){
+		Stats.MaxSwitchCycles = cycles;
+	}
+}
+
+void Kernel_Tick(void){
+	uint32_t state = Critical_Enter();
+
+	Tick++;
+	if (Running){
+		uint32_t timed = TimedMask;
+
+		while (timed != 0){
+			uint8_t priority = Kernel_Highest(timed);
+			Kernel_Task_t *pTask = Tasks[priority];
+
+			timed &= ~(1U << priority);
+			if ((int32_t)(Tick - pTask->WakeTick) >= 0){
+				Kernel_Wake(pTask, KERNEL_TIMEOUT);
+			}
+		}
+		Kernel_Preempt();
+	}
+
+	Critical_Exit(state);
+}
+
+void Kernel_Delay(uint32_t Ms){
+	uint32_t state = Critical_Enter();
+
+	if ((Ms == 0) || !Kernel_CanBlock(state)){
+		Critical_Exit(state);
+		return;
+	}
+
+	Kernel_Block(0, Ms);
+	Critical_Exit(state);
+	SYNC_BARRIER();
+}
+
+Kernel_Task_t *Kernel_CurrentTask(void){
+	return pCurrent;
+}
+
+uint32_t Kernel_StackFreeWords(const Kernel_Task_t *pTask){
+	uint32_t free = 0;
+
+	while ((free < pTask->StackWords) && (pTask->pStack[free] == KERNEL_STACK_FILL)){
+		free++;
+	}
+	return free;
+}
+
+void Kernel_GetStats(Kernel_Stats_t *pStats){
+	uint32_t state = Critical_Enter();
+
+	*pStats = Stats;
+	pStats->Ticks = Tick;
+
+	Critical_Exit(state);
+}
+
+void Kernel_SemInit(Kernel_Sem_t *pSem, uint32_t Initial, uint32_t Max){
+	pSem->Count = (Initial > Max) ? Max : Initial;
+	pSem->Max = Max;
+	pSem->Waiters = 0;
+}
+
+uint8_t Kernel_SemTake(Kernel_Sem_t *pSem, uint32_t Timeout){
+	uint8_t status = KERNEL_OK;
+	uint32_t state = Critical_Enter();
+
+	if (pSem->Count > 0){
+		pSem->Count--;
+	}
+	else{
+		// Kernel_SemGive hands the unit straight to the waiter: OK means it is ours
+		status = Kernel_Wait(&pSem->Waiters, Timeout, Tick, state);
+	}
+
+	Critical_Exit(state);
+	return status;
+}
+
+uint8_t Kernel_SemGive(Kernel_Sem_t *pSem){
+	uint8_t status = KERNEL_OK;
+	uint32_t state = Critical_Enter();
+
+	if (pSem->Waiters != 0){
+		Kernel_Wake(Tasks[Kernel_Highest(pSem->Waiters)], KERNEL_OK);
+		Kernel_Preempt();
+	}
+	else if (pSem->Count < pSem->Max){
+		pSem->Count++;
+	}
+	else{
+		status = KERNEL_ERROR;
+	}
+
+	Critical_Exit(state);
+	return status;
+}
+
+void Kernel_QueueInit(Kernel_Queue_t *pQueue, uint8_t *pBuffer, uint16_t ItemSize, uint16_t Length){
+	pQueue->pBuffer = pBuffer;
+	pQueue->ItemSize = ItemSize;
+	pQueue->Length = Length;
+	pQueue->Head = 0;
+	pQueue->Count = 0;
+	pQueue->SendWaiters = 0;
+	pQueue->RecvWaiters = 0;
+}
+
+/*
+ * A woken task tries again: something of a higher priority may have been faster.
+ * Timeout is for the whole call, not for each try.
+ */
+uint8_t Kernel_QueueSend(Kernel_Queue_t *pQueue, const void *pItem, uint32_t Timeout){
+	uint32_t start = Tick;
+	uint32_t state = Critical_Enter();
+
+	while (pQueue->Count >= pQueue->Length){
+		uint8_t status = Kernel_Wait(&pQueue->SendWaiters, Timeout, start, state);
+		if (status != KERNEL_OK){
+			Critical_Exit(state);
+			return status;
+		}
+	}
+
+	uint16_t slot = (uint16_t)((pQueue->Head + pQueue->Count) % pQueue->Length);
+	Kernel_Copy(&pQueue->pBuffer[slot * pQueue->ItemSize], (const uint8_t*)pItem, pQueue->ItemSize);
+	pQueue->Count++;
+
+	if (pQueue->RecvWaiters != 0){
+		Kernel_Wake(Tasks[Kernel_Highest(pQueue->RecvWaiters)], KERNEL_OK);
+		Kernel_Preempt();
+	}
+
+	Critical_Exit(state);
+	return KERNEL_OK;
+}
+
+uint8_t Kernel_QueueReceive(Kernel_Queue_t *pQueue, void *pItem, uint32_t Timeout){
+	uint32_t start = Tick;
+	uint32_t state = Critical_Enter();
+
+	while (pQueue->Count == 0){
+		uint8_t status = Kernel_Wait(&pQueue->RecvWaiters, Timeout, start, state);
+		if (status != KERNEL_OK){
+			Critical_Exit(state);
+			return status;
+		}
+	}
+
+	Kernel_Copy((uint8_t*)pItem, &pQueue->pBuffer[pQueue->Head * pQueue->ItemSize], pQueue->ItemSize);
+	pQueue->Head = (uint16_t)((pQueue->Head + 1U) % pQueue->Length);
+	pQueue->Count--;
+
+	if (pQueue->SendWaiters != 0){
+		Kernel_Wake(Tasks[Kernel_Highest(pQueue->SendWaiters)], KERNEL_OK);
+		Kernel_Preempt();
+	}
+
+	Critical_Exit(state);
+	return KERNEL_OK;
+}
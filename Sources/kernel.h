@@ -0,0 +1,164 @@
+/*
+ * kernel.h
+ *
+ *  Created on: 2026/3/1
+ *      Author: Yuheng
+ *
+ * Description:
+ * Minimal preemptive kernel: fixed-priority tasks, each on its own stack, switched by PendSV.
+ *
+ * [Previously] everything ran in one loop in main() (or in ISRs): whatever took long in one step
+ * (a batch of log frames waiting for room in the TX ring, a bulk transfer ...) delayed every other
+ * step, commands included, by that long.
+ * Now the work is split into tasks, and a task that becomes ready preempts any less important one
+ * right away, whatever that one is in the middle of.
+ *
+ * Scheduling:
+ * - One task per priority (0 .. KERNEL_PRIORITIES - 1, higher runs first), 0 is the kernel's idle task.
+ *   So "the next task" is the highest bit of ReadyMask: one CLZ instruction, O(1).
+ * - A task runs until it blocks (Kernel_Delay, a semaphore, a queue) or a higher one gets ready:
+ *   no time slicing (no two tasks share a priority).
+ * - Semaphores / queues keep a bitmask of the priorities waiting on them: a give / send wakes
+ *   the highest one, again with one CLZ.
+ * - No priority inheritance: a low task holding a semaphore delays the high one waiting for it
+ *   for as long as it holds it. Keep such sections short (main.c: one frame into the TX ring).
+ *
+ * Context Switch (PendSV_Handler, PM0214 2.3.7):
+ * The hardware stacks R0-R3, R12, LR, PC, xPSR on the task's stack (PSP) when the exception is taken,
+ * PendSV pushes R4-R11 and EXC_RETURN next to them, and pops the next task's.
+ * PendSV has the lowest priority: it only runs once every ISR is over, so an ISR that readies
+ * a task (Kernel_SemGive ...) ends with exactly one switch, tail-chained.
+ *
+ * FPU (lazy stacking, system_stm32f446xx.c):
+ * A task that executed an FP instruction runs with CONTROL.FPCA = 1, and its exception frame is the
+ * extended one: S0-S15 / FPSCR are reserved by the hardware (and written lazily).
+ * EXC_RETURN Bit 4 = 0 tells PendSV that, and only then does it save / restore S16-S31 as well
+ * (VSTMDB / VLDMIA, 16 more words). Integer-only tasks never pay for it.
+ * Only compiled in when the compiler may emit FP instructions (__ARM_FP, FELINEGUARD_HARD_FLOAT).
+ *
+ * Measured: DWT cycles from PendSV entry to the next task's registers being back (Kernel_GetStats).
+ *
+ * Tick: Kernel_Tick from SysTick_Handler (1 ms), wakes the tasks whose timeout ran out.
+ *
+ * Rules:
+ * - Kernel_Delay / Kernel_SemTake / Kernel_QueueReceive ... with a timeout: from a task only,
+ *   never with interrupts masked. From an ISR (or before Kernel_Start): KERNEL_NO_WAIT only.
+ * - Kernel_SemGive / Kernel_QueueSend with KERNEL_NO_WAIT: from anywhere, ISRs included.
+ */
+
+#ifndef SOURCES_KERNEL_H_
+#define SOURCES_KERNEL_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+#define KERNEL_PRIORITIES        8U     // 0 (idle) .. 7
+#define KERNEL_IDLE_STACK_WORDS  256U   // the idle hook runs on it (main.c: Sleep / Stop, logs)
+#define KERNEL_STACK_MIN_WORDS   64U    // frames of one switch (with FP) + a little
+#define KERNEL_STACK_FILL        0xDEADBEEFU // untouched stack words (Kernel_StackFreeWords)
+
+#define KERNEL_NO_WAIT           0U
+#define KERNEL_WAIT_FOREVER      0xFFFFFFFFU
+
+/* @Kernel_Status */
+#define KERNEL_OK                0
+#define KERNEL_TIMEOUT           1 // nothing came in time (or KERNEL_NO_WAIT and nothing there)
+#define KERNEL_ERROR             2 // bad parameter, priority taken, or not allowed in this context
+
+typedef void (*Kernel_TaskEntry_t)(void *pArg);
+
+/*
+ * Task Control Block
+ * Static or global (like its stack), filled by Kernel_CreateTask.
+ */
+typedef struct{
+	uint32_t *pSP;             // saved stack pointer: MUST stay the first member (PendSV_Handler)
+	uint32_t *pStack;          // lowest word of the stack
+	uint32_t StackWords;
+	uint32_t WakeTick;         // blocked with a timeout: the tick it gives up at
+	volatile uint32_t *pWaitMask; // the waiters mask it is in (semaphore / queue), 0: none
+	uint32_t Activations;      // times it was switched in
+	uint8_t Priority;
+	volatile uint8_t WaitResult; // @Kernel_Status of the last wait
+} Kernel_Task_t;
+
+// Counting semaphore (Max = 1: binary, e.g. a lock or a wake-up signal)
+typedef struct{
+	volatile uint32_t Count;
+	uint32_t Max;
+	volatile uint32_t Waiters; // priorities blocked in Kernel_SemTake
+} Kernel_Sem_t;
+
+// Message queue: fixed-size items copied in and out (the sender's buffer may be reused at once)
+typedef struct{
+	uint8_t *pBuffer;          // ItemSize x Length bytes, provided by the owner
+	uint16_t ItemSize;
+	uint16_t Length;
+	volatile uint16_t Head;    // next item to receive
+	volatile uint16_t Count;
+	volatile uint32_t SendWaiters; // priorities blocked in Kernel_QueueSend (queue full)
+	volatile uint32_t RecvWaiters; // priorities blocked in Kernel_QueueReceive (queue empty)
+} Kernel_Queue_t;
+
+typedef struct{
+	uint32_t Switches;
+	uint32_t LastSwitchCycles; // PendSV entry -> next task's context restored
+	uint32_t MaxSwitchCycles;
+	uint32_t Ticks;
+} Kernel_Stats_t;
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+// Empty task table, idle task created. Before anything else of this module
+void Kernel_Init(void);
+
+/*
+ * pStack: StackWords words (at least KERNEL_STACK_MIN_WORDS), 8-byte aligned.
+ * Priority 1 .. KERNEL_PRIORITIES - 1, one task each. Returns @Kernel_Status.
+ * Before Kernel_Start, or from a running task. A task must never return.
+ */
+uint8_t Kernel_CreateTask(Kernel_Task_t *pTask, Kernel_TaskEntry_t Entry, void *pArg,
+		uint32_t *pStack, uint32_t StackWords, uint8_t Priority);
+
+/*
+ * Thread mode moves to the PSP, PendSV gets the lowest priority, the highest task starts.
+ * Never returns: main()'s stack is the ISR stack (MSP) from then on. SysTick must already tick.
+ */
+void Kernel_Start(void) __attribute__((noreturn));
+
+// Call from SysTick_Handler (1 ms): timeouts
+void Kernel_Tick(void);
+
+/*
+ * The calling task sleeps for Ms ticks (1 ms). The first tick may be partial: Ms - 1 .. Ms.
+ * Timeouts below count the same way.
+ */
+void Kernel_Delay(uint32_t Ms);
+
+Kernel_Task_t *Kernel_CurrentTask(void);
+
+// Words at the bottom of the stack never written so far (KERNEL_STACK_FILL still there)
+uint32_t Kernel_StackFreeWords(const Kernel_Task_t *pTask);
+
+void Kernel_GetStats(Kernel_Stats_t *pStats);
+
+/*
+ * Idle task, with interrupts enabled, again and again while no other task is ready.
+ * Weak default: WFI. Must never block.
+ */
+void Kernel_IdleHook(void);
+
+/* Semaphores: Timeout in ms (KERNEL_NO_WAIT / KERNEL_WAIT_FOREVER). Return @Kernel_Status */
+void Kernel_SemInit(Kernel_Sem_t *pSem, uint32_t Initial, uint32_t Max);
+uint8_t Kernel_SemTake(Kernel_Sem_t *pSem, uint32_t Timeout);
+uint8_t Kernel_SemGive(Kernel_Sem_t *pSem); // KERNEL_ERROR: already at Max (a binary one is simply still set)
+
+/* Queues: Timeout as above. Return @Kernel_Status */
+void Kernel_QueueInit(Kernel_Queue_t *pQueue, uint8_t *pBuffer, uint16_t ItemSize, uint16_t Length);
+uint8_t Kernel_QueueSend(Kernel_Queue_t *pQueue, const void *pItem, uint32_t Timeout);
+uint8_t Kernel_QueueReceive(Kernel_Queue_t *pQueue, void *pItem, uint32_t Timeout);
+
+#endif /* SOURCES_KERNEL_H_ */
@@ -0,0 +1,112 @@
+/*
+ * log.c
+ *
+ *  Created on: 2026/2/11
+ *      Author: Yuheng
+ */
+#include "log.h"
+#include "stm32f446xx.h"
+#include <stdint.h>
+
+/*
+ * Ring of 32-bit words, same free-running index idea as spsc_queue.c:
+ * Head/Tail only ever count up, (Head - Tail) = words in use, index & Mask = slot.
+ */
+#define LOG_MASK  (LOG_BUFFER_WORDS - 1U)
+
+static uint32_t LogBuffer[LOG_BUFFER_WORDS];
+static volatile uint32_t LogHead; // written by the producers (inside the critical section)
+static volatile uint32_t LogTail; // written by the consumer (main)
+static volatile uint32_t LogDropped;
+static uint8_t LogSeq;
+
+void Log_Init(void){
+	LogHead = 0;
+	LogTail = 0;
+	LogDropped = 0;
+	LogSeq = 0;
+}
+
+/*
+ * ==========================================
+ * 			Producer Side
+ * ==========================================
+ * Unlike the SPSC queue, there are MANY producers here (main, SysTick ISR, USART ISR ...).
+ * If an ISR logged in the middle of main()'s record, the two records would be mixed up.
+ * So reserving the slots + writing them + publishing Head happens with interrupts masked.
+ * That costs at most ~20 instructions, far less than the old "print a sentence" approach.
+ */
+void Log_Write(uint16_t LogID, uint8_t NumArgs, const uint32_t *pArgs){
+	if (NumArgs > LOG_MAX_ARGS){
+		NumArgs = LOG_MAX_ARGS;
+	}
+
+	uint32_t state = Critical_Enter();
+
+	uint32_t head = LogHead;
+	uint32_t words = 1U + NumArgs;
+
+	if ((LOG_BUFFER_WORDS - (head - LogTail)) < words){
+		LogDropped++;
+		LogSeq++; // the gap in sequence numbers tells the PC something is missing
+		Critical_Exit(state);
+		return;
+	}
+
+	LogBuffer[head & LOG_MASK] = (uint32_t)LogID | ((uint32_t)LogSeq << 16) | ((uint32_t)NumArgs << 24);
+	for (uint8_t i = 0; i < NumArgs; i++){
+		LogBuffer[(head + 1U + i) & LOG_MASK] = pArgs[i];
+	}
+	LogSeq++;
+
+	MEMORY_BARRIER();
+	LogHead = head + words; // publish the whole record at once
+
+	Critical_Exit(state);
+}
+
+/*
+ * ==========================================
+ * 			Consumer Side
+ * ==========================================
+ * Only main() reads, and a record only becomes visible once it is complete (Head published last),
+ * so no critical section is needed here.
+ */
+uint16_t Log_Read(uint8_t *pDest, uint16_t MaxLen){
+	uint32_t tail = LogTail;
+	uint32_t head = LogHead;
+	uint16_t len = 0;
+
+	MEMORY_BARRIER(); // read Head BEFORE the words it covers
+
+	while (tail != head){
+		uint32_t header = LogBuffer[tail & LOG_MASK];
+		uint32_t words = 1U + ((header >> 24) & 0xFF);
+
+		if ((len + (words * 4U)) > MaxLen){
+			break; // keep whole records together
+		}
+
+		for (uint32_t w = 0; w < words; w++){
+			uint32_t value = LogBuffer[(tail + w) & LOG_MASK];
+			pDest[len++] = (uint8_t)(value & 0xFF);
+			pDest[len++] = (uint8_t)((value >> 8) & 0xFF);
+			pDest[len++] = (uint8_t)((value >> 16) & 0xFF);
+			pDest[len++] = (uint8_t)(value >> 24);
+		}
+		tail += words;
+	}
+
+	MEMORY_BARRIER(); // finish reading the slots BEFORE handing them back
+	LogTail = tail;
+
+	return len;
+}
+
+uint8_t Log_IsPending(void){
+	return (LogTail != LogHead) ? SET : RESET;
+}
+
+uint32_t Log_GetDropped(void){
+	return LogDropped;
+}
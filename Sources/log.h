@@ -0,0 +1,103 @@
+/*
+ * log.h
+ *
+ *  Created on: 2026/2/11
+ *      Author: Yuheng
+ *
+ * Description:
+ * Deferred binary logging.
+ *
+ * [Previously] diagnostics were whole English sentences sent right away
+ * (e.g. "\r\n!!! Watchdog starved to death. Reboot!\r\n", 43 bytes).
+ * Far too slow and too big to use inside an ISR.
+ *
+ * Now a log call only stores a 4-byte record header plus its raw arguments in a RAM ring:
+ *
+ *   LOG_INFO("feed #%u done after %u ms", seq, ms);   -> 12 bytes, a few dozen cycles
+ *
+ * - The format string NEVER goes into Flash or onto the wire.
+ *   It is placed in the '.log_strings' section, which the linker script marks (INFO):
+ *   kept in the .elf, but not loaded on the chip.
+ *   The string's address inside that section IS its log ID.
+ * - After the build, objcopy dumps the section into FelineGuard.logdict (the "dictionary").
+ * - main() sends the records in batches (PROTOCOL_EVT_LOG), script.py looks the IDs up
+ *   in the dictionary and does the printf() on the PC.
+ *
+ * Record layout (little-endian 32-bit words):
+ * word 0: Bits 15:0 log ID, Bits 23:16 sequence number, Bits 31:24 number of arguments (0-4)
+ * word 1...: arguments (each one cast to uint32_t, %d is sign-extended back on the PC)
+ * The sequence number lets the PC notice dropped records (ring full).
+ *
+ * Format string rules: only integer conversions (%u %d %x %X %c, with optional width / 'l'),
+ * and at most LOG_MAX_ARGS arguments. No %s, the string would not exist at print time.
+ *
+ * Safe to call from main() AND from any ISR (several producers, see Log_Write).
+ */
+
+#ifndef SOURCES_LOG_H_
+#define SOURCES_LOG_H_
+
+#include <stdint.h>
+
+/*
+ * ==========================================
+ * 1. Sizes
+ * ==========================================
+ */
+#define LOG_BUFFER_WORDS   256U // 1 KB of RAM, MUST be a power of two
+#define LOG_MAX_ARGS       4U
+#define LOG_MAX_RECORD     ((1U + LOG_MAX_ARGS) * 4U) // bytes
+
+/*
+ * ==========================================
+ * 2. Log Macros
+ * ==========================================
+ * The dictionary entry is "<level>|<file>:<line>|<format>", all glued together at compile time.
+ * 'used' keeps the string even though the code only takes its address,
+ * KEEP() in the linker script stops --gc-sections from throwing it away.
+ */
+#define LOG_STRINGIFY_(x)  #x
+#define LOG_STRINGIFY(x)   LOG_STRINGIFY_(x)
+
+#define LOG_ID(level, fmt) ({ \
+		static const char log_fmt_[] __attribute__((section(".log_strings"), used)) = \
+				level "|" __FILE__ ":" LOG_STRINGIFY(__LINE__) "|" fmt; \
+		(uint16_t)(uintptr_t)log_fmt_; \
+	})
+
+// Counts the arguments after the format string: LOG_NARGS() = 0 ... LOG_NARGS(a, b, c, d) = 4
+#define LOG_NARGS_(_0, _1, _2, _3, _4, N, ...)  N
+#define LOG_NARGS(...)     LOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+
+#define LOG_RECORD(level, fmt, ...) do { \
+		const uint32_t log_args_[LOG_MAX_ARGS + 1] = { 0, ##__VA_ARGS__ }; \
+		_Static_assert(LOG_NARGS(__VA_ARGS__) <= LOG_MAX_ARGS, "too many log arguments"); \
+		Log_Write(LOG_ID(level, fmt), LOG_NARGS(__VA_ARGS__), &log_args_[1]); \
+	} while (0)
+
+#define LOG_INFO(fmt, ...)   LOG_RECORD("I", fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...)   LOG_RECORD("W", fmt, ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...)  LOG_RECORD("E", fmt, ##__VA_ARGS__)
+
+/*
+ * ==========================================
+ * 		3. Function Prototypes
+ * ==========================================
+ */
+void Log_Init(void);
+
+// Use the LOG_xxx macros instead, they create the ID
+void Log_Write(uint16_t LogID, uint8_t NumArgs, const uint32_t *pArgs);
+
+/*
+ * Consumer side (main() only).
+ * Copies as many WHOLE records as fit into pDest (MaxLen >= LOG_MAX_RECORD),
+ * returns the number of bytes copied (0: nothing pending).
+ */
+uint16_t Log_Read(uint8_t *pDest, uint16_t MaxLen);
+
+uint8_t Log_IsPending(void);   // SET while records wait for Log_Read (main() only)
+
+uint32_t Log_GetDropped(void); // records lost because the ring was full
+
+#endif /* SOURCES_LOG_H_ */
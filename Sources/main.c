@@ -17,28 +17,781 @@
  */
 
 #include <stdint.h>
-#include <string.h> // for strlen()
 #include "stm32f446xx.h"
+#include "stm32f446xx_crc_driver.h"
+#include "stm32f446xx_dma_driver.h"
 #include "stm32f446xx_gpio_driver.h"
+#include "stm32f446xx_rcc_driver.h"
+#include "stm32f446xx_rtc_driver.h"
+#include "stm32f446xx_systick_driver.h"
 #include "stm32f446xx_timer_driver.h"
 #include "stm32f446xx_uart_driver.h"
 #include "stm32f446xx_watchdog_driver.h"
+#include "a4988_driver.h"
+#include "clock_governor.h"
+#include "feed_queue.h"
+#include "fsm.h"
+#include "kernel.h"
+#include "log.h"
+#include "motion_math.h"
+#include "power_manager.h"
+#include "protocol.h"
+#include "soft_timer.h"
+#include "stepper_motion.h"
+#include "timestamp.h"
 
-#if !defined(__SOFT_FP__) && defined(__ARM_FP)
-  #warning "FPU is not initialized, but the project is compiling for an FPU. Please initialize the FPU before use."
-#endif
+// FPU: enabled by SystemInit (system_stm32f446xx.c) before the C runtime starts, in every build
 
 /* --- Global Variables --- */
-USART_Handle_t USART2_Handle; // declared here to reuse in USART_SendData in main() function
-uint8_t message = 0; // data collected from USART2 data register
-uint8_t FEED_COMPLETE = 0; // "Feed Complete" message flag
+USART_Handle_t USART2_Handle; // declared here to reuse in USART_SendDataIT in main() and in USART2_IRQHandler
+DMA_Handle_t USART2_TxDMA; // DMA1 Stream 6 Channel 4 -> USART2_TX
+DMA_Handle_t USART2_RxDMA; // DMA1 Stream 5 Channel 4 -> USART2_RX
+DMA_Handle_t CRC_DMA;      // DMA2 Stream 0, memory-to-memory -> CRC_DR
+DMA_Handle_t TIM2_UpDMA;   // DMA1 Stream 1 Channel 3 -> TIM2_DMAR (ramp rows)
+Motion_Handle_t StepperMotion; // TIM2 CH1 -> PA0 (STEP), ramps every feed
+A4988_Handle_t StepperDriver;  // DIR / MS1-3 / ENABLE / SLEEP of the A4988
+Governor_Handle_t ClockGovernor; // 180 MHz while there is work, 45 MHz while idle
+Power_Handle_t PowerManager;     // Sleep whenever no task is ready, Stop between feeds
 
-void software_delay(uint32_t count){
-    for(uint32_t i = 0; i < count; i++){
-    	__asm("NOP");
-    }
+/*
+ * RX ring written by the DMA (circular mode).
+ * The ISRs move its content into USART2_Handle.RxQueue at every IDLE / half / full event,
+ * so it only has to cover half a burst: 64 bytes at 115200 baud is ~5.5ms of traffic.
+ */
+#define USART2_RX_DMA_SIZE 64
+static uint8_t USART2_RxDMABuffer[USART2_RX_DMA_SIZE];
+
+/*
+ * ==========================================
+ * 		Firmware Image CRC
+ * ==========================================
+ * Checksum of everything this firmware put in Flash (vector table, code, constants,
+ * initial values of .data), computed once at boot by the DMA + CRC unit in the background.
+ * The PC can read it (PROTOCOL_OP_GET_IMAGE_CRC) to check which build is running / that it is intact.
+ *
+ * Linker script symbols:
+ * _sidata = where the initial values of .data are stored in Flash (last thing in the image)
+ * _sdata / _edata = start / end of .data in RAM -> its size
+ */
+extern uint32_t _sidata, _sdata, _edata;
+#define FLASH_IMAGE_START  0x08000000U
+
+static uint32_t ImageLength;   // bytes
+static uint32_t ImageCRC;
+static uint8_t ImageCRCReady;  // SET once the DMA job is done
+static uint64_t ImageCRCStart; // us, to log how long the background job took
+
+/*
+ * ==========================================
+ * 		Binary Protocol (see protocol.h)
+ * ==========================================
+ * [Previously] a table of text messages ("Feeding started...", "Feed Complete." ...)
+ * sent from Flash by the DMA, and single ASCII bytes as commands.
+ * Now every message is a small COBS frame with an opcode, a sequence number and a CRC.
+ */
+static Protocol_Decoder_t RxDecoder;
+static uint8_t EventSeq; // sequence number of the events WE send (replies echo the PC's)
+
+/*
+ * Motor: NEMA17, 1.8 deg per full step
+ * Steps and speeds (FEED, motion profile) always count FULL steps,
+ * whatever resolution the A4988 runs at underneath (see Feed Segments).
+ */
+#define STEPPER_FULL_STEPS     200U
+#define STEPPER_MICROSTEPS     1U
+#define STEPPER_STEPS_PER_REV  MOTION_STEPS_PER_REV(STEPPER_FULL_STEPS, STEPPER_MICROSTEPS)
+
+/*
+ * Motion Profile (see stepper_motion.h), folded into plain numbers by the compiler (motion_math.h)
+ * - START_SPEED: 60 rpm = 200 steps/s, the NEMA17 starts / stops at this rate without missing a step
+ * - MAX_SPEED / ACCEL: 1200 rpm = 4000 steps/s, top of the ramp table, reached after
+ *   (4000^2 - 200^2) / (2 x 8000) = ~1000 steps (~0.5 s)
+ */
+#define MOTION_START_SPEED    MOTION_STEP_RATE(60U, STEPPER_STEPS_PER_REV)
+#define MOTION_MAX_SPEED      MOTION_STEP_RATE(1200U, STEPPER_STEPS_PER_REV)
+#define MOTION_ACCEL          8000U // steps/s^2
+
+/*
+ * Feed Parameters
+ * Speed is the cruise STEP frequency, reached through the ramp.
+ * [Previously] capped at 1000 steps/s: without a ramp the motor stalled above that.
+ * Limits:
+ * - below 16 steps/s one step (1 us ticks) would not fit in 16 bits
+ * - the whole move (ramps included) is guarded by a timed event (FeedTimer), in ms on 16 bits,
+ *   with some margin: the TIM3 ISR (step counter) ends the job, the timeout only catches a motion that never finishes
+ */
+#define FEED_SPEED_MIN          16U
+#define FEED_SPEED_MAX          MOTION_MAX_SPEED
+#define FEED_TIMEOUT_MARGIN_MS  500U
+#define FEED_DURATION_MAX_MS    (65535U - FEED_TIMEOUT_MARGIN_MS)
+
+/*
+ * Feed Jobs
+ * FeedQueue holds the jobs waiting, CurrentJob the one the motor is running (or retrying).
+ * [Previously] both were changed by the TIM3 ISR (next job) and by main() (first job, cancel, flush,
+ * timeout), with a FeedActive flag SET from the first job until the queue ran dry.
+ * Now only the feed state machine changes them (Feed Controller below, Control task only):
+ * the TIM3 ISR reads CurrentJob while a move runs, and reports the end of the move as an event.
+ */
+static Feed_Queue_t FeedQueue;
+static Feed_Job_t CurrentJob;
+
+/*
+ * Feed Controller (fsm.h)
+ *
+ *   IDLE            nothing to do
+ *   ACTIVE          LED on, a job is in progress: CANCEL / FLUSH are handled here, for both children
+ *    +- DISPENSING  CurrentJob's segments (below), guarded by FeedTimer
+ *    +- JAM         DISPENSING timed out: back off FEED_JAM_BACKOFF_STEPS, then retry what is left
+ *   FAULT           still stuck after FEED_JAM_RETRIES retries: driver off, FEED is NACKed BUSY
+ *                   until a FLUSH clears it
+ *
+ * [Previously] TIM6 itself was the timeout, then a plain software timer.
+ * Now FeedTimer (a timed event of the machine) guards every move of DISPENSING and JAM.
+ */
+/* @Feed_State */
+#define FEED_STATE_IDLE        0
+#define FEED_STATE_ACTIVE      1
+#define FEED_STATE_DISPENSING  2
+#define FEED_STATE_JAM         3
+#define FEED_STATE_FAULT       4
+#define FEED_STATE_COUNT       5
+
+/* @Feed_Signal */
+#define FEED_SIG_KICK          0 // a job was queued (Command_Feed)
+#define FEED_SIG_MOVE_DONE     1 // TIM3 ISR: the last pulse of a move is out, Arg = FeedMove
+#define FEED_SIG_TIMEOUT       2 // FeedTimer, Arg = its generation
+#define FEED_SIG_CANCEL        3 // CANCEL of the running job, Arg = its Seq
+#define FEED_SIG_FLUSH         4 // FLUSH: stop the running job, clear a FAULT
+#define FEED_SIG_REFUSED       5 // the A4988 refused a resolution switch, no move started, Arg = FeedMove
+#define FEED_SIG_COUNT         6
+
+/* @Feed_Result (second byte of EVT_FEED_DONE) */
+#define FEED_RESULT_DONE       0
+#define FEED_RESULT_CANCELLED  1
+#define FEED_RESULT_FAILED     2 // timed out, and the jam recovery did not help
+
+/*
+ * Jam recovery: the auger is turned back 2 electrical cycles (14.4 deg, in 1/16 steps at the
+ * start speed) to loosen what blocks it, then forward again, with the steps backed off added
+ * to what was left of the portion (at most the whole portion).
+ */
+#define FEED_JAM_RETRIES        2U
+#define FEED_JAM_BACKOFF_STEPS  8U // full steps
+
+static FSM_Handle_t FeedFSM;
+static FSM_Timer_t FeedTimer;
+static volatile uint8_t FeedMove;   // +1 per move started: a MOVE_DONE of an older move is stale
+static volatile uint8_t FeedMoving; // SET by the Control task when a move starts, RESET by its end (TIM3 ISR) or Feed_StopMove
+static uint8_t FeedJamRetries;      // of CurrentJob
+
+/*
+ * Feed Segments (microstepping, see a4988_driver.h)
+ * [Previously] every step was a full step: fast, but the motor clattered,
+ * loudest right where it starts and stops, and a portion ended on a coarse 1.8 deg step.
+ * Now a portion is 3 moves, chained in Motion_CompleteCallback without any gap:
+ *
+ *   FINE_START: FEED_FINE_STEPS full steps in 1/16 steps, at the start speed (no ramp)
+ *   COARSE:     the rest in full steps, ramped from the start speed up and back down
+ *   FINE_END:   FEED_FINE_STEPS full steps in 1/16 steps, at the start speed
+ *
+ * The speed is the same on both sides of every switch, and each switch happens
+ * on a full-step position of the translator, so the position is kept exactly.
+ * A portion of at most 2 x FEED_FINE_STEPS is fine all the way (FINE_START only).
+ */
+#define FEED_FINE_RESOLUTION    A4988_RES_SIXTEENTH
+#define FEED_COARSE_RESOLUTION  A4988_RES_FULL
+#define FEED_FINE_STEPS         4U // full steps at each end = one electrical cycle
+#define FEED_FINE_PERIOD        MOTION_PERIOD_TICKS(MOTION_TICK_HZ, MOTION_START_SPEED) // ticks per full step
+
+/* @Feed_Segment */
+#define FEED_SEGMENT_FINE_START 0
+#define FEED_SEGMENT_COARSE     1
+#define FEED_SEGMENT_FINE_END   2
+#define FEED_SEGMENT_BACKOFF    3 // JAM: backwards, not part of the portion
+
+static volatile uint8_t FeedSegment;       // @Feed_Segment in progress
+static volatile uint16_t FeedSegmentSteps; // full steps of the segment in progress
+static volatile uint16_t FeedStepsDone;    // full steps of the finished segments
+
+/*
+ * Feeding Schedule
+ * Stored here for now, set as a whole by PROTOCOL_OP_SET_SCHEDULE
+ * (there is no wall clock on the board yet to run it).
+ */
+#define SCHEDULE_MAX_ENTRIES  8
+
+typedef struct{
+	uint16_t MinuteOfDay; // 0 - 1439
+	uint16_t Steps;
+} Schedule_Entry_t;
+
+static Schedule_Entry_t Schedule[SCHEDULE_MAX_ENTRIES];
+static uint8_t ScheduleCount;
+
+/*
+ * ==========================================
+ * 		Tasks (kernel.h)
+ * ==========================================
+ * [Previously] one loop in main() did everything in turn: a batch of log frames waiting
+ * for room in the TX ring held the next command back for just as long.
+ * Now the loop is split by urgency:
+ *
+ *   Control (2)  watchdog, commands, feed state machine, image CRC, soft timers, governor.
+ *                Woken by the ISRs that bring it work (ControlWake), and at least every tick
+ *   Log     (1)  the feed events handed over by Control (FeedEvents), and the deferred logs
+ *                every LOG_TASK_PERIOD_MS, only while Control has nothing to do
+ *   Idle    (0)  Sleep / Stop (Kernel_IdleHook below)
+ */
+#define CONTROL_TASK_PRIORITY   2U
+#define CONTROL_STACK_WORDS     512U
+#define LOG_TASK_PRIORITY       1U
+#define LOG_STACK_WORDS         256U
+#define LOG_TASK_PERIOD_MS      10U
+#define KERNEL_STATS_PERIOD_MS  60000U // context switch cost and stack use, to the log
+
+static Kernel_Task_t ControlTask;
+static uint32_t ControlStack[CONTROL_STACK_WORDS] __attribute__((aligned(8)));
+static Kernel_Task_t LogTask;
+static uint32_t LogStack[LOG_STACK_WORDS] __attribute__((aligned(8)));
+static Kernel_Sem_t ControlWake; // binary: given by the RX events (USART_ApplicationEventCallback) and TIM3
+static Kernel_Sem_t TxLock;      // binary, 1 = free: see Send_Packet
+static SoftTimer_t KernelStatsTimer;
+
+/*
+ * EVT_FEED_STARTED / EVT_FEED_DONE, from the state machine (Control) to the Log task.
+ * [Previously] Control sent them itself, inside the transition, waiting for TX room with the
+ * next command held back. Now it only copies a few bytes into FeedEvents and moves on.
+ * Room for the worst burst: STARTED + DONE of every queued job, plus the running one's.
+ */
+typedef struct{
+	uint8_t Opcode;
+	uint8_t Len;
+	uint8_t Payload[2];
+} Feed_Event_t;
+
+#define FEED_EVENT_QUEUE_LENGTH (2U * (FEED_QUEUE_SIZE + 1U))
+
+static Kernel_Queue_t FeedEvents;
+static uint8_t FeedEventBuffer[FEED_EVENT_QUEUE_LENGTH * sizeof(Feed_Event_t)];
+
+/*
+ * Encode one packet and queue it into the TX ring buffer (TxLock held).
+ * The frame is built on the stack, so it is COPIED (USART_SendDataIT)
+ * rather than handed to the DMA, which would still be reading it after we return.
+ *
+ * A frame is only useful in one piece (half a frame fails the CRC on the PC),
+ * so if the ring is too full we first wait for just enough of it to drain (~87 us per byte @ 115200).
+ * [Previously] the bound was 200000 polling iterations: its length changed with the clock.
+ * [Previously] the whole ring had to drain (USART_FlushTx), up to ~22 ms with TxLock held,
+ * even when one frame's worth of room was a few ms away.
+ * Still no room after that: the whole frame is dropped (TxDroppedFrames). Queueing the part
+ * that fits would cut off its 0x00 delimiter, and the PC would lose the next frame with it.
+ */
+#define SEND_FLUSH_TIMEOUT_US  25000U // bound only: even a full 256-byte ring @ 115200 drains in ~22 ms
+static uint32_t TxDroppedFrames;
+static void Send_Frame(uint8_t Opcode, uint8_t Seq, const uint8_t *pPayload, uint8_t Len){
+	Protocol_Packet_t packet;
+	uint8_t frame[PROTOCOL_MAX_FRAME];
+
+	packet.Opcode = Opcode;
+	packet.Seq = Seq;
+	packet.Len = Len;
+	for (uint8_t i = 0; i < Len; i++){
+		packet.Payload[i] = pPayload[i];
+	}
+
+	uint16_t frame_len = Protocol_Encode(&packet, frame, sizeof(frame));
+	if (frame_len == 0){
+		return;
+	}
+
+	if (USART_WaitTxFree(&USART2_Handle, frame_len, SEND_FLUSH_TIMEOUT_US) != USART_OK){
+		TxDroppedFrames++;
+		return;
+	}
+	USART_SendDataIT(&USART2_Handle, frame, frame_len);
+}
+
+/*
+ * Control and Log both send: TxLock keeps each frame in one piece in the ring,
+ * and the events in EventSeq order.
+ */
+static void Send_Packet(uint8_t Opcode, uint8_t Seq, const uint8_t *pPayload, uint8_t Len){
+	(void)Kernel_SemTake(&TxLock, KERNEL_WAIT_FOREVER);
+	Send_Frame(Opcode, Seq, pPayload, Len);
+	(void)Kernel_SemGive(&TxLock);
+}
+
+static void Send_Ack(uint8_t Seq, const uint8_t *pPayload, uint8_t Len){
+	Send_Packet(PROTOCOL_OP_ACK, Seq, pPayload, Len);
+}
+
+static void Send_Nack(uint8_t Seq, uint8_t Opcode, uint8_t Error){
+	uint8_t payload[2] = {Opcode, Error};
+	Send_Packet(PROTOCOL_OP_NACK, Seq, payload, sizeof(payload));
+}
+
+static void Send_Event(uint8_t Opcode, const uint8_t *pPayload, uint8_t Len){
+	(void)Kernel_SemTake(&TxLock, KERNEL_WAIT_FOREVER);
+	Send_Frame(Opcode, EventSeq++, pPayload, Len);
+	(void)Kernel_SemGive(&TxLock);
+}
+
+/*
+ * Control task: hand a feed event to the Log task (FeedEvents), in order.
+ * Queue full: Control waits for a free slot rather than sending this one itself, ahead of
+ * older events still queued. Not long: Control runs again as soon as the Log task takes
+ * ONE event out, i.e. within one frame's wait for TX room (SEND_FLUSH_TIMEOUT_US at most).
+ */
+static void Send_FeedEvent(uint8_t Opcode, const uint8_t *pPayload, uint8_t Len){
+	Feed_Event_t event;
+
+	event.Opcode = Opcode;
+	event.Len = Len;
+	for (uint8_t i = 0; i < Len; i++){
+		event.Payload[i] = pPayload[i];
+	}
+
+	(void)Kernel_QueueSend(&FeedEvents, &event, KERNEL_WAIT_FOREVER);
+}
+
+/*
+ * ==========================================
+ * 		Feed Engine
+ * ==========================================
+ * The moves themselves. Started by the feed state machine (Control task, no move running),
+ * chained segment after segment by the TIM3 ISR.
+ */
+// Full steps in 1/16 steps at EACH end of a portion (a short portion: all of it, once)
+static uint16_t Feed_FineSteps(uint16_t Steps){
+	return (Steps > (2U * FEED_FINE_STEPS)) ? FEED_FINE_STEPS : Steps;
+}
+
+// Ticks per 1/16 step: the start speed, or the job's speed if that is even slower
+static uint32_t Feed_FinePeriod(const Feed_Job_t *pJob){
+	uint32_t period = (pJob->Period > FEED_FINE_PERIOD) ? pJob->Period : FEED_FINE_PERIOD;
+	return period >> FEED_FINE_RESOLUTION;
+}
+
+// Ramps, cruise and both fine ends, in ms (Control task: FEED command, jam retry)
+static uint32_t Feed_EstimateMs(const Feed_Job_t *pJob){
+	uint32_t fine_steps = (pJob->Steps > (2U * FEED_FINE_STEPS)) ? (2U * FEED_FINE_STEPS) : pJob->Steps;
+	uint32_t fine_ticks = (fine_steps + 1U) * (Feed_FinePeriod(pJob) << FEED_FINE_RESOLUTION); // + 1: alignment (below)
+
+	return Motion_EstimateMs(&StepperMotion, pJob->Steps - fine_steps, pJob->Period) +
+		((fine_ticks + (MOTION_TICK_HZ / 1000U) - 1U) / (MOTION_TICK_HZ / 1000U));
+}
+
+/*
+ * No move could be started (A4988_SetResolution refused): the state machine fails the job.
+ * Without it the segment would run its pulse count at the wrong resolution
+ * (16x too short or 16x too long).
+ */
+static void Feed_Refused(void){
+	FeedMoving = RESET;
+	(void)FSM_Post(&FeedFSM, FEED_SIG_REFUSED, FeedMove);
+}
+
+/*
+ * Start one segment of CurrentJob (TIM3 ISR, or the Control task while no move runs).
+ * MSx change between two moves: the step timer is frozen with STEP low,
+ * the next rising edge is MOTION_STEP_EDGE (10 us) away.
+ */
+static void Feed_RunSegment(uint8_t Segment){
+	uint16_t fine = Feed_FineSteps(CurrentJob.Steps);
+
+	FeedSegment = Segment;
+
+	if (Segment == FEED_SEGMENT_COARSE){
+		if (A4988_SetResolution(&StepperDriver, FEED_COARSE_RESOLUTION) != A4988_OK){
+			/*
+			 * FINE_START should have ended on a full step. If not, the rest of that step
+			 * goes out first as a FINE_START of 0 steps: its completion comes back here.
+			 */
+			uint32_t align = A4988_PulsesToAlign(&StepperDriver, FEED_COARSE_RESOLUTION);
+			if (align == 0){
+				Feed_Refused(); // aligned, so the MSx pins are not wired
+				return;
+			}
+			FeedSegment = FEED_SEGMENT_FINE_START;
+			FeedSegmentSteps = 0;
+			Motion_MoveConstant(&StepperMotion, align, Feed_FinePeriod(&CurrentJob));
+			return;
+		}
+		FeedSegmentSteps = CurrentJob.Steps - (2U * fine);
+		Motion_Move(&StepperMotion, FeedSegmentSteps, CurrentJob.Period);
+		return;
+	}
+
+	FeedSegmentSteps = fine;
+	if (A4988_SetResolution(&StepperDriver, FEED_FINE_RESOLUTION) != A4988_OK){
+		Feed_Refused(); // 1/16 is always aligned: only unwired MSx pins get here
+		return;
+	}
+	uint32_t pulses = (uint32_t)fine << FEED_FINE_RESOLUTION;
+	if (Segment == FEED_SEGMENT_FINE_START){
+		// a cancelled portion may have stopped between two full steps: finish that one first
+		pulses += A4988_PulsesToAlign(&StepperDriver, FEED_COARSE_RESOLUTION);
+	}
+	Motion_MoveConstant(&StepperMotion, pulses, Feed_FinePeriod(&CurrentJob));
+}
+
+// Full steps of the running portion sent so far
+static uint16_t Feed_StepsDone(void){
+	uint32_t segment = Motion_GetStepsDone(&StepperMotion) >> StepperDriver.Resolution;
+
+	if (segment > FeedSegmentSteps){
+		segment = FeedSegmentSteps; // the alignment pulses of FINE_START
+	}
+	return (uint16_t)(FeedStepsDone + segment);
+}
+
+/*
+ * Stop the move in progress (if any) and keep track of what it did.
+ * Motion_Stop clears a pending TIM3 "last step" interrupt; a MOVE_DONE it already
+ * posted is told apart by FeedMove.
+ */
+static void Feed_StopMove(void){
+	uint32_t state = Critical_Enter();
+
+	if (FeedMoving){
+		Motion_Stop(&StepperMotion);
+		A4988_Advance(&StepperDriver, Motion_GetStepsDone(&StepperMotion)); // keep track of the position
+		FeedStepsDone = Feed_StepsDone();
+		FeedSegmentSteps = 0;
+		FeedMoving = RESET;
+	}
+
+	Critical_Exit(state);
+}
+
+/*
+ * TIM3 ISR (Motion_CounterIRQHandling): the last step of the current segment is out.
+ * Overrides the weak default in stepper_motion.c.
+ */
+void Motion_CompleteCallback(Motion_Handle_t *pMotionHandle){
+	A4988_Advance(&StepperDriver, pMotionHandle->StepsDone);
+
+	if (FeedSegment != FEED_SEGMENT_BACKOFF){
+		FeedStepsDone += FeedSegmentSteps;
+
+		if (FeedStepsDone < CurrentJob.Steps){
+			// next segment of the same portion, right away (same speed on both sides)
+			Feed_RunSegment((FeedSegment == FEED_SEGMENT_FINE_START) ? FEED_SEGMENT_COARSE : FEED_SEGMENT_FINE_END);
+			return;
+		}
+
+		// cheap enough for an ISR: 3 words into the log ring, the text is rendered on the PC
+		LOG_INFO("feed #%u: done, %u steps", CurrentJob.Seq, FeedStepsDone);
+	}
+
+	/*
+	 * [Previously] the next job was started right here, in the same interrupt.
+	 * Now the state machine decides (next job, retry, idle ...) in the Control task: the motor rests
+	 * for one pass of it between two portions (woken by this very interrupt, TIM3_IRQHandler).
+	 */
+	FeedMoving = RESET;
+	(void)FSM_Post(&FeedFSM, FEED_SIG_MOVE_DONE, FeedMove);
+}
+
+/*
+ * ==========================================
+ * 		Feed Controller (state machine)
+ * ==========================================
+ * Entry / exit / transition actions, all in the Control task (FSM_Process).
+ * Every EVT_FEED_STARTED / EVT_FEED_DONE of a job is sent from here.
+ */
+static void Feed_Report(uint8_t Seq, uint8_t Result){
+	uint8_t done[2] = {Seq, Result};
+	Send_FeedEvent(PROTOCOL_EVT_FEED_DONE, done, sizeof(done));
+}
+
+// Next job into CurrentJob: DISPENSING, or Otherwise if the queue is empty
+static uint8_t Feed_Next(uint8_t Otherwise){
+	if (FeedQueue_Pop(&FeedQueue, &CurrentJob) != SET){
+		return Otherwise;
+	}
+
+	FeedJamRetries = 0;
+	Send_FeedEvent(PROTOCOL_EVT_FEED_STARTED, &CurrentJob.Seq, 1);
+	LOG_INFO("feed #%u: %u steps at %u steps/s", CurrentJob.Seq, CurrentJob.Steps, CurrentJob.Speed);
+	return FEED_STATE_DISPENSING;
+}
+
+static void Feed_ActiveEntry(FSM_Handle_t *pFSMHandle){
+	GPIO_WriteToOutputPin(GPIOA, 5, 1); // Turn LED ON
+}
+
+static void Feed_ActiveExit(FSM_Handle_t *pFSMHandle){
+	GPIO_WriteToOutputPin(GPIOA, 5, 0); // LED2 goes Off
+}
+
+static void Feed_DispensingEntry(FSM_Handle_t *pFSMHandle){
+	/*
+	 * Exactly CurrentJob.Steps full steps: fine start, ramp up to its speed and back down, fine end.
+	 * TIM3 counts the pulses of each segment and starts the next one
+	 * (Motion_CompleteCallback) after the last one.
+	 */
+	FeedStepsDone = 0;
+	FeedMove++;
+	FeedMoving = SET;
+	Feed_RunSegment(FEED_SEGMENT_FINE_START);
+
+	// Only a safety net: expected duration + margin
+	FSM_TimerStart(&FeedTimer, (uint32_t)CurrentJob.DurationMs + FEED_TIMEOUT_MARGIN_MS);
 }
 
+static void Feed_DispensingExit(FSM_Handle_t *pFSMHandle){
+	FSM_TimerStop(&FeedTimer);
+	Feed_StopMove();
+}
+
+static void Feed_JamEntry(FSM_Handle_t *pFSMHandle){
+	uint32_t pulses = FEED_JAM_BACKOFF_STEPS << FEED_FINE_RESOLUTION;
+	uint32_t backoff_ms = (FEED_JAM_BACKOFF_STEPS * FEED_FINE_PERIOD) / (MOTION_TICK_HZ / 1000U);
+
+	LOG_WARN("feed #%u: stuck after %u of %u steps, backing off (retry %u)", CurrentJob.Seq, FeedStepsDone,
+			CurrentJob.Steps, FeedJamRetries + 1U);
+
+	// Stopped between two pulses: DIR / MSx are stable long before the next rising edge
+	A4988_SetDirection(&StepperDriver, A4988_DIR_REVERSE);
+	FeedSegment = FEED_SEGMENT_BACKOFF;
+	FeedSegmentSteps = 0;
+	FeedMove++;
+	FeedMoving = SET;
+	if (A4988_SetResolution(&StepperDriver, FEED_FINE_RESOLUTION) != A4988_OK){
+		Feed_Refused();
+		return;
+	}
+	Motion_MoveConstant(&StepperMotion, pulses, FEED_FINE_PERIOD >> FEED_FINE_RESOLUTION);
+
+	FSM_TimerStart(&FeedTimer, backoff_ms + FEED_TIMEOUT_MARGIN_MS);
+}
+
+static void Feed_JamExit(FSM_Handle_t *pFSMHandle){
+	FSM_TimerStop(&FeedTimer);
+	Feed_StopMove();
+	A4988_SetDirection(&StepperDriver, A4988_DIR_FORWARD);
+}
+
+static void Feed_FaultEntry(FSM_Handle_t *pFSMHandle){
+	Feed_Job_t jobs[FEED_QUEUE_SIZE];
+
+	A4988_Enable(&StepperDriver, DISABLE); // no holding current into a blocked auger
+	LOG_ERROR("feed #%u: failed after %u retries, FAULT until FLUSH", CurrentJob.Seq, FeedJamRetries);
+	Feed_Report(CurrentJob.Seq, FEED_RESULT_FAILED);
+
+	// nothing behind it can run either
+	uint32_t state = Critical_Enter();
+	uint8_t count = FeedQueue_Snapshot(&FeedQueue, jobs, FEED_QUEUE_SIZE);
+	FeedQueue_Flush(&FeedQueue);
+	Critical_Exit(state);
+
+	for (uint8_t i = 0; i < count; i++){
+		Feed_Report(jobs[i].Seq, FEED_RESULT_CANCELLED);
+	}
+}
+
+static void Feed_FaultExit(FSM_Handle_t *pFSMHandle){
+	A4988_Enable(&StepperDriver, ENABLE);
+	LOG_INFO("feed: fault cleared");
+}
+
+// IDLE: KICK -> the job just queued (or a higher priority one)
+static uint8_t Feed_OnKick(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent){
+	return Feed_Next(FSM_NONE);
+}
+
+// DISPENSING: the portion is out -> next job or IDLE
+static uint8_t Feed_OnDispensed(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent){
+	if (pEvent->Arg != FeedMove){
+		return FSM_NONE; // a move stopped since (cancelled, timed out)
+	}
+
+	Feed_Report(CurrentJob.Seq, FEED_RESULT_DONE);
+	return Feed_Next(FEED_STATE_IDLE);
+}
+
+/*
+ * DISPENSING: FeedTimer fired. A move that ended meanwhile (MOVE_DONE queued behind this event)
+ * is not stuck: only a move still running is given up.
+ */
+static uint8_t Feed_OnStuck(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent){
+	if ((FSM_TimerIsCurrent(&FeedTimer, pEvent) != SET) || !FeedMoving){
+		return FSM_NONE;
+	}
+
+	Feed_StopMove();
+	LOG_ERROR("feed #%u: timeout after %u of %u steps", CurrentJob.Seq, FeedStepsDone, CurrentJob.Steps);
+	return (FeedJamRetries < FEED_JAM_RETRIES) ? FEED_STATE_JAM : FEED_STATE_FAULT;
+}
+
+// JAM: backed off -> forward again, what was left plus the steps backed off
+static uint8_t Feed_OnBackedOff(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent){
+	if (pEvent->Arg != FeedMove){
+		return FSM_NONE;
+	}
+
+	uint32_t steps = (uint32_t)CurrentJob.Steps - FeedStepsDone + FEED_JAM_BACKOFF_STEPS;
+	if (steps < CurrentJob.Steps){
+		CurrentJob.Steps = (uint16_t)steps; // else the whole portion again: never longer than accepted
+	}
+	CurrentJob.DurationMs = (uint16_t)Feed_EstimateMs(&CurrentJob);
+	FeedJamRetries++;
+
+	return FEED_STATE_DISPENSING;
+}
+
+// JAM: even the back-off did not finish -> the motor cannot turn at all
+static uint8_t Feed_OnBackOffStuck(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent){
+	if ((FSM_TimerIsCurrent(&FeedTimer, pEvent) != SET) || !FeedMoving){
+		return FSM_NONE;
+	}
+	return FEED_STATE_FAULT;
+}
+
+// DISPENSING / JAM: the A4988 refused a resolution switch, no move runs -> nothing to retry
+static uint8_t Feed_OnRefused(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent){
+	if (pEvent->Arg != FeedMove){
+		return FSM_NONE;
+	}
+
+	LOG_ERROR("feed #%u: resolution switch refused after %u of %u steps", CurrentJob.Seq, FeedStepsDone,
+			CurrentJob.Steps);
+	return FEED_STATE_FAULT;
+}
+
+// ACTIVE (DISPENSING or JAM): CANCEL of the running job -> next job or IDLE
+static uint8_t Feed_OnCancel(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent){
+	if (pEvent->Arg != CurrentJob.Seq){
+		return FSM_NONE; // already over by the time the event came through
+	}
+
+	Feed_StopMove();
+	Feed_Report(CurrentJob.Seq, FEED_RESULT_CANCELLED);
+	return Feed_Next(FEED_STATE_IDLE);
+}
+
+// ACTIVE: FLUSH (the queue is empty already, Command_Flush) -> IDLE
+static uint8_t Feed_OnFlush(FSM_Handle_t *pFSMHandle, const FSM_Event_t *pEvent){
+	Feed_StopMove();
+	Feed_Report(CurrentJob.Seq, FEED_RESULT_CANCELLED);
+	return FSM_NONE;
+}
+
+/*
+ * The tables. Lookup (fsm.h) makes DISPENSING and JAM inherit CANCEL / FLUSH from ACTIVE.
+ * Any pair not listed is ignored: e.g. KICK while ACTIVE (the job waits in the queue
+ * and Feed_Next picks it up), MOVE_DONE in IDLE (a stale one).
+ */
+static const FSM_State_t FeedStates[FEED_STATE_COUNT] = {
+	[FEED_STATE_IDLE]       = {FSM_NONE,          FSM_NONE,                0,                    0},
+	[FEED_STATE_ACTIVE]     = {FSM_NONE,          FEED_STATE_DISPENSING,   Feed_ActiveEntry,     Feed_ActiveExit},
+	[FEED_STATE_DISPENSING] = {FEED_STATE_ACTIVE, FSM_NONE,                Feed_DispensingEntry, Feed_DispensingExit},
+	[FEED_STATE_JAM]        = {FEED_STATE_ACTIVE, FSM_NONE,                Feed_JamEntry,        Feed_JamExit},
+	[FEED_STATE_FAULT]      = {FSM_NONE,          FSM_NONE,                Feed_FaultEntry,      Feed_FaultExit},
+};
+
+static const FSM_Transition_t FeedTransitions[] = {
+	{FEED_STATE_IDLE,       FEED_SIG_KICK,      FSM_CHOICE,      Feed_OnKick},
+	{FEED_STATE_ACTIVE,     FEED_SIG_CANCEL,    FSM_CHOICE,      Feed_OnCancel},
+	{FEED_STATE_ACTIVE,     FEED_SIG_FLUSH,     FEED_STATE_IDLE, Feed_OnFlush},
+	{FEED_STATE_DISPENSING, FEED_SIG_MOVE_DONE, FSM_CHOICE,      Feed_OnDispensed},
+	{FEED_STATE_DISPENSING, FEED_SIG_TIMEOUT,   FSM_CHOICE,      Feed_OnStuck},
+	{FEED_STATE_DISPENSING, FEED_SIG_REFUSED,   FSM_CHOICE,      Feed_OnRefused},
+	{FEED_STATE_JAM,        FEED_SIG_MOVE_DONE, FSM_CHOICE,      Feed_OnBackedOff},
+	{FEED_STATE_JAM,        FEED_SIG_TIMEOUT,   FSM_CHOICE,      Feed_OnBackOffStuck},
+	{FEED_STATE_JAM,        FEED_SIG_REFUSED,   FSM_CHOICE,      Feed_OnRefused},
+	{FEED_STATE_FAULT,      FEED_SIG_FLUSH,     FEED_STATE_IDLE, 0},
+};
+
+static void Feed_InitController(void){
+	FeedFSM.FSM_Config.pStates = FeedStates;
+	FeedFSM.FSM_Config.pTransitions = FeedTransitions;
+	FeedFSM.FSM_Config.NumStates = FEED_STATE_COUNT;
+	FeedFSM.FSM_Config.NumTransitions = sizeof(FeedTransitions) / sizeof(FeedTransitions[0]);
+	FeedFSM.FSM_Config.NumSignals = FEED_SIG_COUNT;
+	FeedFSM.FSM_Config.Initial = FEED_STATE_IDLE;
+
+	if (FSM_Init(&FeedFSM) != FSM_OK){
+		LOG_ERROR("feed state machine: bad tables");
+	}
+	FSM_TimerInit(&FeedTimer, &FeedFSM, FEED_SIG_TIMEOUT);
+}
+
+/*
+ * ========================================
+ * 		System Clock: 16 MHz -> 180 MHz
+ * ========================================
+ * [Previously] never touched: the core ran from the 16 MHz HSI it resets to.
+ * [Now] PLL at 180 MHz (stm32f446xx_rcc_driver.h), ~11x the throughput of everything.
+ * HSE (8 MHz from the ST-LINK MCO) first, it is crystal-accurate (baud rates, step timing).
+ * Without it (MCO not connected), the same 180 MHz from HSI / 8.
+ *
+ * Called before any peripheral is set up: they all read their clock from the RCC registers,
+ * so nothing needs to be re-derived afterwards, except the timestamps (hook registered in main()).
+ *
+ * Whichever PLL ends up running is also the governor's FAST level (clock_governor.h).
+ * SLOW keeps that PLL and only divides HCLK by 4 (45 MHz): no re-lock on a boost,
+ * and PCLK1 stays at 45 MHz, so USART2 keeps its BRR across every switch.
+ */
+#define GOVERNOR_IDLE_MS  2000U // this long without a command / feed -> 45 MHz
+
+static void SystemClock_Config(void){
+	RCC_ClockConfig_t *pFast = &ClockGovernor.Governor_Config.Fast;
+	RCC_ClockConfig_t *pSlow = &ClockGovernor.Governor_Config.Slow;
+
+	pFast->Source = RCC_SOURCE_PLL_HSE;
+	pFast->PLLM = 4;     // 8 MHz / 4 = 2 MHz PLL input
+	pFast->PLLN = 180;   // VCO = 360 MHz
+	pFast->PLLP = 2;     // SYSCLK = 180 MHz
+	pFast->AHBDiv = RCC_AHB_DIV1;  // HCLK  = 180 MHz
+	pFast->APB1Div = RCC_APB_DIV4; // PCLK1 = 45 MHz (TIM2/3: 90 MHz)
+	pFast->APB2Div = RCC_APB_DIV2; // PCLK2 = 90 MHz
+
+	uint8_t status = RCC_ClockConfig(pFast);
+	if (status != RCC_OK){
+		pFast->Source = RCC_SOURCE_PLL_HSI;
+		pFast->PLLM = 8; // 16 MHz / 8 = 2 MHz, the rest is the same
+		status = RCC_ClockConfig(pFast);
+	}
+
+	*pSlow = *pFast;
+	pSlow->AHBDiv = RCC_AHB_DIV4;  // HCLK  = 45 MHz
+	pSlow->APB1Div = RCC_APB_DIV1; // PCLK1 = 45 MHz (TIM2/3: 45 MHz, TIM2 PSC redone by its hook)
+	pSlow->APB2Div = RCC_APB_DIV1; // PCLK2 = 45 MHz
+	ClockGovernor.Governor_Config.IdleMs = GOVERNOR_IDLE_MS;
+
+	LOG_INFO("clock: HCLK %u Hz (status %u)", RCC_GetHCLKValue(), status);
+}
+
+/*
+ * Clock-change hooks (RCC_RegisterClockHook), run by every RCC_ClockConfig of the governor.
+ * IWDG (LSI), TIM3 (counts TIM2's pulses) and the DMAs do not depend on HCLK: no hook.
+ */
+static void Clock_SysTickChanged(void){
+	(void)SysTick_Init(); // one reload period is restarted: the tick slips by < 1 ms
+}
+
+static void Clock_USART2Changed(void){
+	USART_ClockChanged(&USART2_Handle);
+}
+
+static void Clock_MotionChanged(void){
+	Motion_ClockChanged(&StepperMotion);
+}
+
+/*
+ * Low Power (see power_manager.h)
+ * POWER_WAKEUP_MS: the IWDG (1 s) is fed at every RTC wakeup in Stop mode
+ * POWER_STOP_MAX_MS: the idle task runs (and reports the accounting) at least this often
+ */
+#define POWER_WAKEUP_MS    500U
+#define POWER_STOP_MAX_MS  60000U
+
+static uint8_t PowerReady; // SET once the RTC runs: Stop mode allowed
+
 void Setup_Peripherals(void){ // void as parameter emphasizes that this function will not take in anything
 	/*
 	 * ========================================
@@ -69,32 +822,79 @@ void Setup_Peripherals(void){ // void as parameter emphasizes that this function
 
 	/*
 	 * ========================================
-	 * 		PA1 (DIR) Configuration
+	 * 		A4988 Control Pins
 	 * ========================================
+	 * PA1 DIR, PB5 MS1, PB4 MS2, PB10 MS3, PA8 ENABLE, PA9 SLEEP
+	 * (Nucleo Arduino header D4 - D8, next to the STEP / DIR wires)
+	 * [Previously] only PA1 (DIR) was configured here, MSx / ENABLE / SLEEP were strapped
+	 * on the breadboard (full steps, always on).
+	 * The driver sets every pin's level before making it an output: no glitch at boot.
 	 */
-	GPIO_Handle_t GPIO_DIR; // PA1
-
-	GPIO_DIR.pGPIOx = GPIOA;
+	StepperDriver.A4988_Config.Dir.pGPIOx = GPIOA;
+	StepperDriver.A4988_Config.Dir.PinNumber = 1;
+	StepperDriver.A4988_Config.MS1.pGPIOx = GPIOB;
+	StepperDriver.A4988_Config.MS1.PinNumber = 5;
+	StepperDriver.A4988_Config.MS2.pGPIOx = GPIOB;
+	StepperDriver.A4988_Config.MS2.PinNumber = 4;
+	StepperDriver.A4988_Config.MS3.pGPIOx = GPIOB;
+	StepperDriver.A4988_Config.MS3.PinNumber = 10;
+	StepperDriver.A4988_Config.Enable.pGPIOx = GPIOA;
+	StepperDriver.A4988_Config.Enable.PinNumber = 8;
+	StepperDriver.A4988_Config.Sleep.pGPIOx = GPIOA;
+	StepperDriver.A4988_Config.Sleep.PinNumber = 9;
+	StepperDriver.A4988_Config.Resolution = FEED_FINE_RESOLUTION; // every portion starts fine
 
-	GPIO_DIR.GPIO_PinConfig.GPIO_PinNumber = 1;
-	GPIO_DIR.GPIO_PinConfig.GPIO_PinMode = GPIO_MODE_OUT; // output mode to send signal
-	GPIO_DIR.GPIO_PinConfig.GPIO_PinSpeed = GPIO_SPEED_MEDIUM; // no need to use high speed, this will save some power
-	GPIO_DIR.GPIO_PinConfig.GPIO_PinOPType = GPIO_OP_TYPE_PP; // default mode (Open Drain will be used for I2C)
-	GPIO_DIR.GPIO_PinConfig.GPIO_PinPuPdControl = GPIO_NO_PUPD; // again, this will be set by purely software, there is no external hardware button, so need for pull-up/down resistors to be enabled
+	A4988_Init(&StepperDriver);
 
-	GPIO_Init(&GPIO_DIR); // forgot to initialize, causing compilation error
 	/*
 	 * ========================================
 	 * 		TIM2 (PWM) Configuration
 	 * ========================================
 	 */
-	TIM_Handle_t TIMER2;
+	static TIM_Handle_t TIMER2; // static: StepperMotion keeps a pointer to it (profile playback)
 	TIMER2.pTIMx = TIM2;
-	TIMER2.TIM_Config.Prescaler = 15; // PSC
-	TIMER2.TIM_Config.Period = 3000; // ARR
+	TIMER2.TIM_Config.Prescaler = MOTION_TIMER_PSC(RCC_GetTimerClock1Value(), MOTION_TICK_HZ); // 1 us ticks
+	TIMER2.TIM_Config.Period = MOTION_TIMER_ARR(MOTION_TICK_HZ, MOTION_START_SPEED); // until the first feed
 
 	TIM_PWM_Init(&TIMER2); // Configure TIM2
 
+	/*
+	 * Acceleration engine on top of the PWM:
+	 * PSC is recomputed from the real clock (1 us ticks), ARR / CCR1 are rewritten
+	 * on every step by the TIM2 update ISR, the ramp table is built here once.
+	 *
+	 * TIM3 counts the STEP pulses in hardware (TIM2 update -> TRGO -> TIM3 ITR1)
+	 * and gates TIM2 off after exactly N of them (TIM3 OC1REF -> TRGO -> TIM2 ITR2).
+	 * [Previously] a portion was "2 seconds of PWM" (TIM6), and the number of steps
+	 * depended on when the ISR got around to stopping the motor.
+	 */
+	TIM3_PCLK_EN();
+
+	StepperMotion.pTIMx = TIM2;
+	StepperMotion.pCounterTIMx = TIM3;
+	StepperMotion.CounterTrigger = TIM_TRIGGER_ITR1; // TIM3 ITR1 = TIM2 TRGO
+	StepperMotion.GateTrigger = TIM_TRIGGER_ITR2;    // TIM2 ITR2 = TIM3 TRGO
+
+	/*
+	 * Ramps streamed by the DMA, one ARR value per TIM2 update (DMAR burst of 1 word):
+	 * no TIM2 interrupt at all, only 2 TIM3 compare interrupts per feed.
+	 * Table 28. DMA1 request mapping: TIM2_UP -> Stream 1 (or 7), Channel 3
+	 */
+	TIM2_UpDMA.pDMAx = DMA1;
+	TIM2_UpDMA.Stream = 1;
+	TIM2_UpDMA.DMA_Config.DMA_Channel = 3;
+	TIM_DMA_BurstInit(&TIMER2, &TIM2_UpDMA, TIM_DMABASE_ARR, 1);
+	StepperMotion.pProfileTIM = &TIMER2;
+	StepperMotion.Motion_Config.Profile = MOTION_PROFILE_SCURVE;
+	StepperMotion.Motion_Config.StartSpeed = MOTION_START_SPEED;
+	StepperMotion.Motion_Config.MaxSpeed = MOTION_MAX_SPEED;
+	StepperMotion.Motion_Config.Accel = MOTION_ACCEL;
+
+	Motion_Init(&StepperMotion);
+
+	TIM_IRQInterruptConfig(TIM2_IRQ, ENABLE);
+	TIM_IRQInterruptConfig(TIM3_IRQ, ENABLE);
+
 	/* ---------- USART2 Configuration ----------*/
 
 	/*
@@ -164,19 +964,56 @@ void Setup_Peripherals(void){ // void as parameter emphasizes that this function
 
 	/*
 	 * ==============================
-	 * USART2 Interrupt Set Up
+	 * USART2 TX DMA Set Up
 	 * ==============================
-	 * Reference: Table 163. USART interrupt requests
+	 * Table 28. DMA1 request mapping: USART2_TX -> Stream 6, Channel 4
+	 * Memory (our Flash strings) -> Peripheral (USART2->DR), one byte at a time,
+	 * memory address increments, the DR address stays fixed.
+	 */
+	USART2_TxDMA.pDMAx = DMA1;
+	USART2_TxDMA.Stream = 6;
+	USART2_TxDMA.DMA_Config.DMA_Channel = 4;
+	USART2_TxDMA.DMA_Config.DMA_Direction = DMA_DIR_MEM_TO_PERIPH;
+	USART2_TxDMA.DMA_Config.DMA_MemInc = ENABLE;
+	USART2_TxDMA.DMA_Config.DMA_PeriphInc = DISABLE;
+	USART2_TxDMA.DMA_Config.DMA_DataSize = DMA_SIZE_BYTE;
+	USART2_TxDMA.DMA_Config.DMA_Mode = DMA_MODE_NORMAL;
+	USART2_TxDMA.DMA_Config.DMA_Priority = DMA_PRIORITY_MEDIUM;
+	USART2_TxDMA.DMA_Config.DMA_Interrupts = DMA_IT_TC | DMA_IT_TE;
+
+	USART_DMA_TxInit(&USART2_Handle, &USART2_TxDMA);
+
+	DMA_IRQInterruptConfig(DMA1_STREAM6_IRQ, ENABLE);
+
+	/*
+	 * ==============================
+	 * USART2 RX DMA Set Up (Circular + IDLE line)
+	 * ==============================
+	 * Table 28. DMA1 request mapping: USART2_RX -> Stream 5, Channel 4
+	 * Peripheral (USART2->DR) -> Memory (USART2_RxDMABuffer), wraps around forever.
 	 *
-	 * In order to use interrupt for USART
-	 * [RXNEIE] must be enabled
+	 * [Previously] RXNEIE (CR1 Bit 5) was enabled here: one interrupt per byte,
+	 * and every byte overwrote the same global 'message' variable.
+	 * Now the DMA collects the bytes and the CPU is only interrupted
+	 * when the line goes IDLE (end of a burst), or at half/full buffer.
 	 *
-	 * Control register 1 (USART_CR1)
-	 * Bit 5 RXNEIE: RXNE interrupt enable
-	 * 0: Interrupt is inhibited
-	 * 1: An USART interrupt is generated whenever ORE=1 or RXNE=1 in the USART_SR register
+	 * NOTE: TXEIE/TCIE (TX side) are NOT enabled here,
+	 * USART_SendDataIT turns them on only while there is something to send.
 	 */
-	SET_BIT(USART2->CR1, 5);
+	USART2_RxDMA.pDMAx = DMA1;
+	USART2_RxDMA.Stream = 5;
+	USART2_RxDMA.DMA_Config.DMA_Channel = 4;
+	USART2_RxDMA.DMA_Config.DMA_Direction = DMA_DIR_PERIPH_TO_MEM;
+	USART2_RxDMA.DMA_Config.DMA_MemInc = ENABLE;
+	USART2_RxDMA.DMA_Config.DMA_PeriphInc = DISABLE;
+	USART2_RxDMA.DMA_Config.DMA_DataSize = DMA_SIZE_BYTE;
+	USART2_RxDMA.DMA_Config.DMA_Mode = DMA_MODE_CIRCULAR;
+	USART2_RxDMA.DMA_Config.DMA_Priority = DMA_PRIORITY_HIGH; // RX cannot wait, TX can
+	USART2_RxDMA.DMA_Config.DMA_Interrupts = DMA_IT_HT | DMA_IT_TC;
+
+	USART_DMA_RxInit(&USART2_Handle, &USART2_RxDMA, USART2_RxDMABuffer, USART2_RX_DMA_SIZE);
+
+	DMA_IRQInterruptConfig(DMA1_STREAM5_IRQ, ENABLE);
 
 	/*
 	 * ==============================
@@ -202,6 +1039,19 @@ void Setup_Peripherals(void){ // void as parameter emphasizes that this function
 
 	GPIO_Init(&PA5_LED);
 
+	/*
+	 * ==============================
+	 * 	  CRC Unit (+ DMA2 feed)
+	 * ==============================
+	 * Used by the protocol (frame CRC) and for the firmware image checksum.
+	 * Only DMA2 can do memory-to-memory, any free stream works (Channel is ignored).
+	 */
+	CRC_PeriClockControl(ENABLE);
+
+	CRC_DMA.pDMAx = DMA2;
+	CRC_DMA.Stream = 0;
+	CRC_DMA_Init(&CRC_DMA);
+
 	/*
 	 * ==============================
 	 * 	  IWDG Configuration
@@ -228,36 +1078,37 @@ void Setup_Peripherals(void){ // void as parameter emphasizes that this function
 
 	/*
 	 * ========================================
-	 * 		    TIM6 Configuration
+	 * 		    SysTick Configuration
 	 * ========================================
-	 * NOTE:
-	 * I chose TIM 6 because it is a "Basic Timer" (Unlike TIM2/3 -> General Purpose Timers)
-	 * It is designed to do simple timing
+	 * [Previously] TIM6 (a "Basic Timer") was the 1 ms tick of the software timers,
+	 * and before that the timeout of a feed.
+	 * [Now] the core's own SysTick is the tick (stm32f446xx_systick_driver.h):
+	 * soft timers, timestamps and SysTick_DelayMs / Us all run on it. TIM6 is free again.
 	 *
-	 * This timer is to replace the software delay I used to control the duration of motor spin
-	 * It offers two major benefits:
-	 * 1) Hardware timer is much more precise than software delay
-	 * 2) With Interrupt, the timer itself will no longer be blocking the CPU
+	 * LOAD comes from the current HCLK: call SysTick_Init() again after any clock change.
 	 */
+	SysTick_Init();
 
-	TIM6_PCLK_EN(); // Enable Clock
-	TIM_Handle_t TIMER6;
-	TIMER6.pTIMx = TIM6;
-
-	// Math:
-	// Timer Clock = 16,000,000 Hz
-	// Timer Target Tick Speed = 1 kHz (1ms)
-	// Timer Prescaler = (16,000,000 / 1,000) - 1 = 15999
-	TIMER6.TIM_Config.Prescaler = 15999;
-
-	// Target Duration = 2000 ms
-	// Period (ARR) = 2000 - 1 = 1999
-	TIMER6.TIM_Config.Period = 1999;
-
-	TIM_Basic_Init(&TIMER6);
+	/*
+	 * ========================================
+	 * 		    Low-Power Configuration
+	 * ========================================
+	 * Stop mode between feeds (power_manager.h), woken by:
+	 * - the RTC every POWER_WAKEUP_MS: half the IWDG timeout above (1 s), both on the LSI
+	 * - PA3 (USART2 RX), EXTI Line 3: the first falling edge of a command
+	 */
+	PowerManager.Power_Config.pWakeGPIOx = GPIOA;
+	PowerManager.Power_Config.WakePinNumber = 3;
+	PowerManager.Power_Config.WakeIRQ = EXTI3_IRQ;
+	PowerManager.Power_Config.WakeupMs = POWER_WAKEUP_MS;
 
-	TIM_IRQInterruptConfig(TIM6_IRQ, ENABLE); // the IRQInterruptConfig logic is universal
-											  // will refractor later to avoid wasteful copying
+	if (Power_Init(&PowerManager) != RTC_OK){
+		LOG_WARN("RTC did not start: no Stop mode, Sleep only");
+		PowerReady = RESET;
+	}
+	else{
+		PowerReady = SET;
+	}
 }
 
 /*
@@ -276,21 +1127,13 @@ void USART2_IRQHandler(void){
 	 * there is no pending register to manually clear
 	 * since USART interrupt does NOT go through EXTI
 	 *
-	 * Also, in SR (Status Register)
-	 * Bit 5 RXNE: Read data register not empty
-	 * It says:
-	 * [This bit is set by hardware when the content of the RDR shift register
-	 * has been transferred to the USART_DR register. An interrupt is generated
-	 * if RXNEIE=1 in the USART_CR1 register.
-	 * It is cleared by a read to the USART_DR register.]
-	 * ->
-	 * this tells us that, the hardware will automatically reset this register
-	 * once the data in Data Register is read, so we do not need to manually reset it
-	 *
-	 * [READ ONLY!]
-	 * Reading DR automatically clears the RXNE flag.
-	*/
-	message = ( (USART2->DR) & 0xFF );
+	 * [Previously] this ISR read DR on every RXNE (one interrupt per byte).
+	 * Now the received bytes are moved by the DMA, so this ISR only sees:
+	 * - RX: IDLE line (end of a burst) and errors (ORE / FE / NF), counted in the handle
+	 * - TX: TXE (load the next byte of the TX ring buffer) / TC (transmission finished)
+	 * All of that logic lives in the driver.
+	 */
+	USART_IRQHandling(&USART2_Handle); // RX burst: ControlWake from USART_ApplicationEventCallback
 
 	/*
 	 * [Commented Out] because:
@@ -302,46 +1145,572 @@ void USART2_IRQHandler(void){
 	// USART2->DR = 0;
 }
 
-void TIM6_DAC_IRQHandler(void){
+/*
+ * ==========================================
+ * 	 DMA1 Stream 5 ISR (USART2 RX DMA)
+ * ==========================================
+ * Half / full buffer, only matters for bursts longer than half the RX buffer.
+ */
+void DMA1_Stream5_IRQHandler(void){
+	USART_DMA_RxIRQHandling(&USART2_Handle);
+}
+
+/*
+ * USART2 ISRs above (overrides the weak default in the driver): bytes for the Control task.
+ * Only for RX events: [Previously] every USART2 interrupt gave ControlWake, so each TXE of a
+ * log batch woke Control for a pass with nothing to do. TX needs no wake-up, Send_Frame polls.
+ * Control preempts whatever runs once the ISR returns.
+ */
+void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle, uint8_t AppEvent){
+	if ((AppEvent == USART_EVENT_RX_FRAME) || (AppEvent == USART_EVENT_RX_DATA) || (AppEvent == USART_EVENT_RX_DMA_ERROR)){
+		(void)Kernel_SemGive(&ControlWake);
+	}
+}
+
+/*
+ * ==========================================
+ * 	 DMA1 Stream 6 ISR (USART2 TX DMA)
+ * ==========================================
+ * Fires once per message (Transfer Complete), not once per byte.
+ */
+void DMA1_Stream6_IRQHandler(void){
+	USART_DMA_TxIRQHandling(&USART2_Handle);
+}
+
+/*
+ * ==========================================
+ * 	 RTC Wakeup / EXTI3 ISRs (Low Power)
+ * ==========================================
+ * In Stop mode both are taken care of by Power_Stop (interrupts masked), these only run
+ * for the RTC wakeups while awake (every POWER_WAKEUP_MS, nothing to do),
+ * and for an EXTI3 edge left over from the last Stop.
+ */
+void RTC_WKUP_IRQHandler(void){
+	RTC_WakeupIRQHandling();
+}
+
+void EXTI3_IRQHandler(void){
+	Power_WakeIRQHandling(&PowerManager);
+}
+
+/*
+ * ==========================================
+ * 	 SysTick ISR (1 ms)
+ * ==========================================
+ * No flag to clear: COUNTFLAG clears itself when CTRL is read, the exception itself is not latched.
+ * It is principal to keep ISR simple and short:
+ * the wheel is turned and the callbacks (e.g. the feed timeout) run in the Control task
+ */
+void SysTick_Handler(void){
+	SysTick_IRQHandling(); // the ms count behind SysTick_GetTick / SysTick_DelayMs
+
+	SoftTimer_Tick(); // one more tick for the software timers
+
+	// Far more often than the DWT cycle counter wraps (>= 24 s): keeps the 64-bit timestamps right
+	Timestamp_Poll();
+
+	Kernel_Tick(); // task timeouts: Control's 1 ms wait, Log's period
+}
+
+/*
+ * ==========================================
+ * 	 TIM2 ISR (one update per STEP)
+ * ==========================================
+ * Loads the period of the next step from the ramp table,
+ * the step count itself (and the end of the job) is up to TIM3.
+ * Idle while the DMA plays the ramps (StepperMotion.pProfileTIM), kept for the ISR mode.
+ */
+void TIM2_IRQHandler(void){
+	Motion_IRQHandling(&StepperMotion);
+}
+
+/*
+ * ==========================================
+ * 	 TIM3 ISR (STEP pulse counter)
+ * ==========================================
+ * Once per feed: the N-th pulse is counted and TIM2 is already frozen by the gate.
+ * Plus (DMA mode) the start of the cruise and of the deceleration.
+ */
+void TIM3_IRQHandler(void){
+	Motion_CounterIRQHandling(&StepperMotion);
+	(void)Kernel_SemGive(&ControlWake); // MOVE_DONE may be waiting in FeedFSM
+}
+
+/*
+ * ==========================================
+ * 		Command Processing
+ * ==========================================
+ * Called once for every complete, CRC-checked packet.
+ * Every command gets exactly one ACK or NACK carrying its Seq,
+ * so the PC can send a whole batch without waiting in between.
+ */
+/*
+ * FEED payload: u16 steps, u16 speed [, u8 priority (default NORMAL)]
+ * ACK payload:  u8 number of jobs ahead of this one (0: starts right now)
+ * NACK FULL if FEED_QUEUE_SIZE jobs are already waiting, BUSY while the feeder is in FAULT.
+ */
+static void Command_Feed(const Protocol_Packet_t *pPacket){
+	if ((pPacket->Len != 4) && (pPacket->Len != 5)){
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_LENGTH);
+		return;
+	}
+
+	if (FSM_IsIn(&FeedFSM, FEED_STATE_FAULT) == SET){
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_BUSY); // FLUSH first
+		return;
+	}
+
+	Feed_Job_t job;
+	job.Steps = Protocol_GetU16(&pPacket->Payload[0]);
+	job.Speed = Protocol_GetU16(&pPacket->Payload[2]);
+	job.Priority = (pPacket->Len == 5) ? pPacket->Payload[4] : FEED_PRIORITY_NORMAL;
+	job.Seq = pPacket->Seq;
+
+	if ((job.Steps == 0) || (job.Speed < FEED_SPEED_MIN) || (job.Speed > FEED_SPEED_MAX) ||
+		(job.Priority > FEED_PRIORITY_URGENT)){
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_RANGE);
+		return;
+	}
+
+	// The one division of a feed, here in the Control task: the ISRs that start the job only get ticks
+	job.Period = (uint16_t)MOTION_PERIOD_TICKS(MOTION_TICK_HZ, job.Speed);
+
+	// duration in ms, acceleration and deceleration included
+	uint32_t duration_ms = Feed_EstimateMs(&job);
+	if ((duration_ms == 0) || (duration_ms > FEED_DURATION_MAX_MS)){
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_RANGE);
+		return;
+	}
+	job.DurationMs = (uint16_t)duration_ms;
+
 	/*
-	 * ==============================
-	 * 1. Check if the Update Interrupt Flag (UIF) is set (Bit 0 in SR)
-	 *  ==============================
-	 * Status Register:
-	 * Bit 0 UIF: Update interrupt flag
-	 * [0: No update occurred.]
-	 *
-	 * [1: Update interrupt pending. This bit is set by hardware when the registers are updated:
-	 * – At overflow or underflow and if UDIS = 0 in the TIMx_CR1 register.
-	 * – When CNT is reinitialized by software using the UG bit in the TIMx_EGR register,
-	 * if URS = 0 and UDIS = 0 in the TIMx_CR1 register.
-	*/
-	if ( READ_BIT(TIM6->SR, 0)){
-		TIM_SetCompare1(TIM2, 0); // CCR1 = 0 -> "Turn Off" the motor
-		GPIO_WriteToOutputPin(GPIOA, 5, 0); // LED2 goes Off
+	 * [Previously] "if TIM6 is running, ignore the command" (later: NACK BUSY).
+	 * Now the job simply waits in the queue: the state machine starts it right away (IDLE)
+	 * or once the jobs ahead of it are over.
+	 */
+	if (FeedQueue_Push(&FeedQueue, &job) != SET){
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_FULL);
+		return;
 	}
 
-	// --- Finishing Up ---
+	uint8_t ahead = FeedQueue.Count - 1U + FSM_IsIn(&FeedFSM, FEED_STATE_ACTIVE); // a snapshot, only informative
+	(void)FSM_Post(&FeedFSM, FEED_SIG_KICK, job.Seq);
 
-	// A. Turn off TIM 6
-	// otherwise it will auto-reload, and interrupt the CPU every 2 seconds
-	CLEAR_BIT(TIM6->CR1, 0);
+	// Tell PC the job is ACCEPTED (EVT_FEED_STARTED / EVT_FEED_DONE follow)
+	Send_Ack(pPacket->Seq, &ahead, 1);
+}
+
+/*
+ * CANCEL payload: u8 Seq of the FEED command to cancel (waiting or running)
+ */
+static void Command_Cancel(const Protocol_Packet_t *pPacket){
+	if (pPacket->Len != 1){
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_LENGTH);
+		return;
+	}
 
-	// B. Reset Flag Bit
-	// If we do not clear the flag,
-	// CPU still thinks this interrupt task is "not done", leading to a deadloop
-	CLEAR_BIT(TIM6->SR, 0); // FIXED BUG
+	uint8_t target = pPacket->Payload[0];
 
-	// C. Serial Print the "Feed Complete" message
-	// However, it is principal to keep ISR simple and short
-	// so I only use a flag here to indicate action
-	FEED_COMPLETE = 1;
+	if (FeedQueue_Remove(&FeedQueue, target) == SET){
+		LOG_INFO("feed #%u cancelled", target);
+		Send_Ack(pPacket->Seq, 0, 0);
+		Feed_Report(target, FEED_RESULT_CANCELLED);
+	}
+	else if (FSM_IsIn(&FeedFSM, FEED_STATE_ACTIVE) && (CurrentJob.Seq == target)){
+		// the state machine stops it (EVT_FEED_DONE) and starts the next job, if any
+		LOG_INFO("feed #%u cancelled", target);
+		Send_Ack(pPacket->Seq, 0, 0);
+		(void)FSM_Post(&FeedFSM, FEED_SIG_CANCEL, target);
+	}
+	else{
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_NOT_FOUND);
+	}
+}
+
+/*
+ * FLUSH: drop every waiting job AND stop the running one (e.g. "stop everything"), clears a FAULT
+ * ACK payload: u8 number of jobs cancelled
+ */
+static void Command_Flush(const Protocol_Packet_t *pPacket){
+	Feed_Job_t jobs[FEED_QUEUE_SIZE];
+	uint32_t state = Critical_Enter();
+
+	uint8_t count = FeedQueue_Snapshot(&FeedQueue, jobs, FEED_QUEUE_SIZE);
+	FeedQueue_Flush(&FeedQueue);
+
+	Critical_Exit(state);
+
+	uint8_t cancelled = count + FSM_IsIn(&FeedFSM, FEED_STATE_ACTIVE); // the running one: stopped by the state machine
+	LOG_INFO("feed queue flushed, %u jobs cancelled", cancelled);
+	Send_Ack(pPacket->Seq, &cancelled, 1);
+
+	for (uint8_t i = 0; i < count; i++){
+		Feed_Report(jobs[i].Seq, FEED_RESULT_CANCELLED);
+	}
+	(void)FSM_Post(&FeedFSM, FEED_SIG_FLUSH, 0); // the queue is empty now -> IDLE
+}
+
+/*
+ * Queue status reply (ACK payload, 5 + 6 x N bytes):
+ * u8  running (1 = a job is being dispensed, or retried after a jam)
+ * u8  Seq of the running job
+ * u16 steps left for the running job (of the current try)
+ * u8  N = number of waiting jobs, then N x {u8 seq, u8 priority, u16 steps, u16 speed}
+ */
+static void Command_QueueStatus(const Protocol_Packet_t *pPacket){
+	Feed_Job_t jobs[FEED_QUEUE_SIZE];
+	uint8_t reply[5 + (6 * FEED_QUEUE_SIZE)];
+	uint16_t remaining = 0;
+
+	uint32_t state = Critical_Enter();
+	uint8_t running = FSM_IsIn(&FeedFSM, FEED_STATE_ACTIVE);
+	uint8_t running_seq = CurrentJob.Seq;
+	if (running){
+		remaining = (uint16_t)(CurrentJob.Steps - Feed_StepsDone());
+	}
+	uint8_t count = FeedQueue_Snapshot(&FeedQueue, jobs, FEED_QUEUE_SIZE);
+	Critical_Exit(state);
+
+	reply[0] = running;
+	reply[1] = running ? running_seq : 0;
+	Protocol_PutU16(&reply[2], remaining);
+	reply[4] = count;
+	for (uint8_t i = 0; i < count; i++){
+		uint8_t *p = &reply[5 + (6 * i)];
+		p[0] = jobs[i].Seq;
+		p[1] = jobs[i].Priority;
+		Protocol_PutU16(&p[2], jobs[i].Steps);
+		Protocol_PutU16(&p[4], jobs[i].Speed);
+	}
+
+	Send_Ack(pPacket->Seq, reply, 5 + (6 * count));
+}
+
+static void Command_SetSchedule(const Protocol_Packet_t *pPacket){
+	uint8_t count = pPacket->Len / 4;
+
+	if (((pPacket->Len % 4) != 0) || (count > SCHEDULE_MAX_ENTRIES)){
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_LENGTH);
+		return;
+	}
+
+	// Validate everything first, so a bad entry leaves the old schedule untouched
+	for (uint8_t i = 0; i < count; i++){
+		if (Protocol_GetU16(&pPacket->Payload[(i * 4)]) >= (24U * 60U)){
+			Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_RANGE);
+			return;
+		}
+	}
+
+	for (uint8_t i = 0; i < count; i++){
+		Schedule[i].MinuteOfDay = Protocol_GetU16(&pPacket->Payload[(i * 4)]);
+		Schedule[i].Steps = Protocol_GetU16(&pPacket->Payload[(i * 4) + 2]);
+	}
+	ScheduleCount = count;
+
+	Send_Ack(pPacket->Seq, 0, 0);
+}
+
+/*
+ * Image CRC reply (ACK payload, 8 bytes): u32 CRC, u32 image length in bytes
+ * NACK BUSY while the boot-time DMA job is still running (a few ms at most).
+ */
+static void Command_GetImageCRC(const Protocol_Packet_t *pPacket){
+	uint8_t reply[8];
+
+	if (!ImageCRCReady){
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_BUSY);
+		return;
+	}
+
+	Protocol_PutU32(&reply[0], ImageCRC);
+	Protocol_PutU32(&reply[4], ImageLength);
+	Send_Ack(pPacket->Seq, reply, sizeof(reply));
+}
+
+/*
+ * Status reply (ACK payload, 8 bytes):
+ * u8  feeder: 0 idle, 1 feeding (or retrying after a jam), 2 FAULT (FLUSH clears it)
+ * u8  number of schedule entries
+ * u16 bad frames received (COBS / length / CRC)
+ * u16 RX bytes dropped (RX queue full)
+ * u16 UART errors (overrun + framing + noise)
+ */
+static void Command_GetStatus(const Protocol_Packet_t *pPacket){
+	uint8_t status[8];
+
+	status[0] = FSM_IsIn(&FeedFSM, FEED_STATE_FAULT) ? 2 : FSM_IsIn(&FeedFSM, FEED_STATE_ACTIVE);
+	status[1] = ScheduleCount;
+	Protocol_PutU16(&status[2], (uint16_t)RxDecoder.BadFrames);
+	Protocol_PutU16(&status[4], (uint16_t)(USART2_Handle.RxDroppedBytes + USART2_Handle.RxLappedBytes));
+	Protocol_PutU16(&status[6], (uint16_t)(USART2_Handle.RxOverrunErrors
+			+ USART2_Handle.RxFramingErrors + USART2_Handle.RxNoiseErrors + USART2_Handle.RxDMAErrors));
+
+	Send_Ack(pPacket->Seq, status, sizeof(status));
+}
+
+static void Process_Command(const Protocol_Packet_t *pPacket){
+	switch (pPacket->Opcode){
+	case PROTOCOL_OP_PING:{
+		// [Previously] 'H' for "Hello" or "Handshake"
+		uint8_t version = PROTOCOL_VERSION;
+		Send_Ack(pPacket->Seq, &version, 1);
+		break;
+	}
+	case PROTOCOL_OP_FEED:
+		Command_Feed(pPacket);
+		break;
+	case PROTOCOL_OP_SET_SCHEDULE:
+		Command_SetSchedule(pPacket);
+		break;
+	case PROTOCOL_OP_GET_STATUS:
+		Command_GetStatus(pPacket);
+		break;
+	case PROTOCOL_OP_GET_IMAGE_CRC:
+		Command_GetImageCRC(pPacket);
+		break;
+	case PROTOCOL_OP_CANCEL:
+		Command_Cancel(pPacket);
+		break;
+	case PROTOCOL_OP_FLUSH:
+		Command_Flush(pPacket);
+		break;
+	case PROTOCOL_OP_QUEUE_STATUS:
+		Command_QueueStatus(pPacket);
+		break;
+	default:
+		Send_Nack(pPacket->Seq, pPacket->Opcode, PROTOCOL_ERR_OPCODE);
+		break;
+	}
+}
+
+/*
+ * ==========================================
+ * 		Control Task
+ * ==========================================
+ * [Previously] the body of the main loop, steps 1 - 8.
+ * Now steps 1 - 7 run here (the logs moved to Log_Task, the low power part to Kernel_IdleHook),
+ * then the task waits for an ISR to bring work, for at most one tick.
+ */
+static void Control_Task(void *pArg){
+	while (1){
+		// ---------------------------------------------------------
+		// 1. Watchdog Feeding
+		// ---------------------------------------------------------
+		// We MUST feed the dog constantly.
+		// If we used a blocking delay (the old software_delay), the CPU would get stuck
+		// and fail to reach this line, causing the IWDG to reset the MCU.
+		// At least once per tick: a task above this one that never blocks starves the dog too.
+		IWDG_FEED();
+
+		// ---------------------------------------------------------
+		// 2. Command Processing
+		// ---------------------------------------------------------
+		// The USART2 ISRs fill RxQueue (IDLE line / half / full DMA buffer),
+		// we simply empty it here, a chunk at a time, and feed the frame decoder.
+		// A frame may be split across chunks (or across passes), the decoder keeps the partial frame.
+		uint8_t rx_chunk[16];
+		uint32_t count;
+		Protocol_Packet_t packet;
+		while ((count = USART_ReadRx(&USART2_Handle, rx_chunk, sizeof(rx_chunk))) > 0){
+			// the PC is talking: full speed before the command is even decoded (a FEED starts right away)
+			if (Governor_Boost(&ClockGovernor) == SET){
+				LOG_INFO("clock: boost to %u Hz in %u us", RCC_GetHCLKValue(), ClockGovernor.LastSwitchUs);
+			}
+			for (uint32_t i = 0; i < count; i++){
+				uint8_t result = Protocol_ProcessByte(&RxDecoder, rx_chunk[i], &packet);
+
+				if (result == PROTOCOL_RESULT_PACKET){
+					Process_Command(&packet);
+				}
+				else if (result == PROTOCOL_RESULT_BAD_CRC){
+					Send_Nack(packet.Seq, packet.Opcode, PROTOCOL_ERR_CRC); // the PC resends it
+				}
+				else if (result == PROTOCOL_RESULT_BAD_FRAME){
+					// nothing trustworthy to reply to, the PC times out
+					LOG_WARN("dropped a bad frame (%u so far)", RxDecoder.BadFrames);
+				}
+			}
+		}
+
+		// ---------------------------------------------------------
+		// 3. Feed State Machine
+		// ---------------------------------------------------------
+		// [Previously] the TIM3 ISR ran the feed controller itself, and only left
+		// {event, Seq} pairs here to be turned into EVT_FEED_xxx frames.
+		// Now the ISR, the commands above and the feed timer only post events:
+		// every decision (next job, jam recovery, fault) is taken here, one event at a time.
+		(void)FSM_Process(&FeedFSM);
+
+		// ---------------------------------------------------------
+		// 4. Background Image CRC
+		// ---------------------------------------------------------
+		// Polled once per tick: the DMA job takes far longer than that
+		if (!ImageCRCReady){
+			uint32_t crc;
+			uint8_t status = CRC_DMA_Poll(&CRC_DMA, &crc);
+
+			if (status == CRC_OK){
+				uint32_t whole = ImageLength & ~3U;
+				ImageCRC = CRC_Software(crc, (const uint8_t*)(FLASH_IMAGE_START + whole), ImageLength - whole);
+				ImageCRCReady = SET;
+				LOG_INFO("firmware image: %u bytes, CRC 0x%08x, %u us", ImageLength, ImageCRC,
+						(uint32_t)(Timestamp_Us() - ImageCRCStart));
+			}
+			else if (status == CRC_ERROR){
+				ImageCRC = CRC_Calculate((const uint8_t*)FLASH_IMAGE_START, ImageLength); // CPU fallback
+				ImageCRCReady = SET;
+				LOG_WARN("image CRC DMA failed, CPU result 0x%08x", ImageCRC);
+			}
+		}
+
+		// ---------------------------------------------------------
+		// 5. Software Timers
+		// ---------------------------------------------------------
+		// The SysTick ISR only counted the ticks, the expired timers' callbacks run here.
+		SoftTimer_Process();
+
+		// ---------------------------------------------------------
+		// 6. Clock Governor
+		// ---------------------------------------------------------
+		// Down to 45 MHz once nothing happened for GOVERNOR_IDLE_MS. Never in the middle of
+		// a feed (the step timing would be re-clocked mid-ramp) nor of a transmission.
+		uint8_t busy = (FSM_IsIn(&FeedFSM, FEED_STATE_ACTIVE) || (FeedQueue.Count > 0) || USART2_Handle.TxBusy) ? SET : RESET;
+		if (Governor_Process(&ClockGovernor, busy) == SET){
+			LOG_INFO("clock: drop to %u Hz in %u us", RCC_GetHCLKValue(), ClockGovernor.LastSwitchUs);
+		}
+
+		// ---------------------------------------------------------
+		// 7. Wait
+		// ---------------------------------------------------------
+		// Straight into the next pass if this one left work behind (an event posted by a timer
+		// callback, bytes that came in meanwhile), else block until an ISR gives ControlWake
+		// or the next tick (soft timers, governor, IWDG feeding). The core sleeps meanwhile
+		// if nothing else is ready (Kernel_IdleHook).
+		if ((USART_RxAvailable(&USART2_Handle) == 0) && (FSM_Pending(&FeedFSM) == 0)){
+			(void)Kernel_SemTake(&ControlWake, 1);
+		}
+
+		/*
+		 * [WARNING]
+		 * There used to an "else" block here to turn off the motor if the user
+		 * inputs "invalid commands".
+		 * BUT, since I added TIM6 ISR in the latest version,
+		 * keep that else block here will force the motor OFF immediately
+		 * whenver no command arrived (which is 99% of the time).
+		 * The job of turning off the motor belongs to the feed state machine (step 3)
+		 */
+	}
+}
+
+/*
+ * ==========================================
+ * 		Log Task
+ * ==========================================
+ * The LOG_xxx() calls (tasks AND ISRs) only filled a RAM ring,
+ * here the records go out in batches, one EVT_LOG frame per batch.
+ * Only while the TX ring has room for a full frame, and below Control:
+ * a reply preempts a batch, and never waits for more than the frame being queued (TxLock).
+ * Blocks on FeedEvents instead of sleeping: a feed event goes out as soon as Control blocks,
+ * the logs at the latest LOG_TASK_PERIOD_MS later.
+ */
+static void Log_Task(void *pArg){
+	uint8_t log_batch[PROTOCOL_MAX_PAYLOAD];
+	Feed_Event_t event;
+
+	while (1){
+		if (Kernel_QueueReceive(&FeedEvents, &event, LOG_TASK_PERIOD_MS) == KERNEL_OK){
+			do{
+				Send_Event(event.Opcode, event.Payload, event.Len);
+			} while (Kernel_QueueReceive(&FeedEvents, &event, KERNEL_NO_WAIT) == KERNEL_OK);
+		}
+
+		while (USART_GetTxFree(&USART2_Handle) >= PROTOCOL_MAX_FRAME){
+			uint16_t log_len = Log_Read(log_batch, sizeof(log_batch));
+			if (log_len == 0){
+				break;
+			}
+			Send_Event(PROTOCOL_EVT_LOG, log_batch, (uint8_t)log_len);
+		}
+	}
+}
+
+/*
+ * ==========================================
+ * 		Idle (Low Power)
+ * ==========================================
+ * Runs whenever neither task is ready.
+ * [Previously] the last step of the main loop.
+ * Checked with interrupts masked: an ISR that fires after the check leaves its IRQ pending,
+ * WFI returns at once and the ISR runs at Critical_Exit (nothing is slept through).
+ * A task it readies preempts the idle task right there.
+ * - Sleep: WFI, at least the 1 ms tick wakes us (Control's wait times out)
+ * - Stop: only once the governor dropped the clock (idle for GOVERNOR_IDLE_MS) and nothing
+ *   at all is in flight: no feed, no TX, no log waiting, no image CRC, no feed timer that would need the tick
+ */
+void Kernel_IdleHook(void){
+	uint32_t state = Critical_Enter();
+	uint8_t work = ((USART_RxAvailable(&USART2_Handle) > 0) || (FSM_Pending(&FeedFSM) > 0)) ? SET : RESET;
+
+	if (!work){
+		if (PowerReady && (ClockGovernor.Level == GOVERNOR_LEVEL_SLOW) && !FSM_IsIn(&FeedFSM, FEED_STATE_ACTIVE)
+				&& (FeedQueue.Count == 0) && (FeedEvents.Count == 0) && !USART2_Handle.TxBusy && !Log_IsPending() && ImageCRCReady
+				&& (SoftTimer_IsActive(&FeedTimer.Timer) != SET)){
+			uint8_t wake = Power_Stop(&PowerManager, POWER_STOP_MAX_MS);
+			// woke on HSI: re-base the timestamp before Governor_Resume times its PLL re-lock with it
+			Timestamp_ClockChanged();
+			Governor_Resume(&ClockGovernor); // still masked: no ISR runs on HSI
+			Critical_Exit(state);
+
+			LOG_INFO("power: wake %u after %u stops, clock back in %u us", wake, PowerManager.Stops,
+					ClockGovernor.LastSwitchUs);
+			LOG_INFO("power: run %u ms, sleep %u ms, stop %u s, ~%u uA average",
+					(uint32_t)(Power_GetRunUs(&PowerManager) / 1000U), (uint32_t)(PowerManager.SleepUs / 1000U),
+					(uint32_t)(PowerManager.StopMs / 1000U), Power_GetAverageUa(&PowerManager));
+			return;
+		}
+		Power_Sleep(&PowerManager);
+	}
+	Critical_Exit(state);
+}
+
+// KernelStatsTimer (Control task): what the context switches cost, how deep the stacks went
+static void Kernel_StatsCallback(SoftTimer_t *pTimer){
+	Kernel_Stats_t stats;
+
+	Kernel_GetStats(&stats);
+	LOG_INFO("kernel: %u switches, last %u / max %u cycles", stats.Switches, stats.LastSwitchCycles,
+			stats.MaxSwitchCycles);
+	LOG_INFO("kernel: free stack words: control %u / %u, log %u / %u", Kernel_StackFreeWords(&ControlTask),
+			CONTROL_STACK_WORDS, Kernel_StackFreeWords(&LogTask), LOG_STACK_WORDS);
+	if (TxDroppedFrames != 0){
+		LOG_WARN("tx: %u frames dropped so far (TX ring full)", TxDroppedFrames);
+	}
 }
 
 int main(void)
 {
+	Log_Init(); // before any ISR: ISRs log too
+	Kernel_Init(); // same: ISRs give ControlWake, SysTick ticks the kernel
+	Kernel_SemInit(&ControlWake, 0, 1);
+	Kernel_SemInit(&TxLock, 1, 1);
+	Kernel_QueueInit(&FeedEvents, FeedEventBuffer, sizeof(Feed_Event_t), FEED_EVENT_QUEUE_LENGTH);
+	Feed_InitController(); // same: the TIM3 ISR posts to it
+	Protocol_DecoderInit(&RxDecoder);
+	FeedQueue_Init(&FeedQueue);
+	Timestamp_Init(); // first: everything after this can be timed (and RCC_ClockConfig's timeouts need it)
+	(void)RCC_RegisterClockHook(Timestamp_ClockChanged); // first hook: the others may use deadlines
+	SystemClock_Config(); // before any peripheral reads its clock
+	SoftTimer_Init(); // before SysTick starts ticking
 	Setup_Peripherals(); // set up hardware
 
+	// only now: a hook must never touch a peripheral that is not configured yet
+	(void)RCC_RegisterClockHook(Clock_SysTickChanged);
+	(void)RCC_RegisterClockHook(Clock_USART2Changed);
+	(void)RCC_RegisterClockHook(Clock_MotionChanged);
+	Governor_Init(&ClockGovernor); // FAST, from now on
+	FSM_Start(&FeedFSM); // IDLE
+
 	GPIO_WriteToOutputPin(GPIOA, 1, DISABLE);
 
 	/*
@@ -362,9 +1731,10 @@ int main(void)
 	 * NOTE: the CPU will need to check this register constantly
 	 * BUT it will NOT block the CPU, because it runs as many times as the Feed function call
 	 */
+	uint8_t reset_flags = 0;
 	if ( READ_BIT( RCC->CSR, 29 )){
-		char IWDG_AutopsyReport[] = "\r\n!!! Watchdog starved to death. Reboot!\r\n";
-		USART_SendData(&USART2_Handle, (uint8_t*)IWDG_AutopsyReport, strlen(IWDG_AutopsyReport));
+		reset_flags |= PROTOCOL_RESET_IWDG; // reported to the PC in EVT_BOOT
+		LOG_ERROR("watchdog starved to death (IWDG reset), RCC_CSR = 0x%08x", RCC->CSR);
 		/*
 		 * ==============================
 		 * Reset flags to prevent false alert after next reset
@@ -383,86 +1753,34 @@ int main(void)
 		SET_BIT( RCC->CSR, 24 );
 	}
 
-	char boot_msg[] = "STM32 System Initialized.\r\n";
-	USART_SendData(&USART2_Handle, (uint8_t*)boot_msg, strlen(boot_msg));
+	Send_Event(PROTOCOL_EVT_BOOT, &reset_flags, 1);
 
-	while (1){
-		// ---------------------------------------------------------
-		// 1. Watchdog Feeding
-		// ---------------------------------------------------------
-		// We MUST feed the dog in the main loop constantly.
-		// If we used "software_delay" (Blocking), the CPU would get stuck
-		// and fail to reach this line, causing the IWDG to reset the MCU.
-		IWDG_FEED();
-
-		// ---------------------------------------------------------
-		// 2. Command Processing
-		// ---------------------------------------------------------
-		if (message == 'F'){
-			/*
-			 * Check if TIM6 is currently running (CR1 Register, Bit 0 CEN).
-			 * Logic:
-			 * READ_BIT returns 1 (True) if the timer is counting (Motor is spinning).
-			 * We use '!' (NOT) to ensure we only start IF the timer is STOPPED.
-			 * * Purpose:
-			 * Prevents the user from spamming 'F' and resetting the timer repeatedly,
-			 * which would cause UART message overflow or glitchy motor behavior.
-			 */
-			if ( ! READ_BIT(TIM6->CR1, 0) ){
-				// A. Turn ON Hardware
-				GPIO_WriteToOutputPin(GPIOA, 5, 1); // Turn LED ON
-				TIM_SetCompare1(TIM2, 2000); // Set PWM to start Motor
-
-				// [REMOVED] software_delay(2000000); // OLD: Blocking delay
-				// [REMOVED] TIM_SetCompare1(TIM2, 0);
-
-				// B. Start TIM6 (Asynchronous / Non-Blocking Delay)
-				// This acts as a "Background Alarm".
-				// The CPU sets it and immediately moves on.
-				TIM6->CNT = 0; // Reset counter to ensure full 2s duration
+	/*
+	 * Firmware image checksum, in the background:
+	 * the DMA feeds the whole words into the CRC unit while main() keeps running,
+	 * the 0-3 leftover bytes are added in software once it is done (Control task, step 4).
+	 * One DMA transfer moves at most 65535 words (256 KB): a bigger image (the F446 has 512 KB)
+	 * is split into several by the driver, chained into the same CRC (CRC_DMA_Poll).
+	 * [Previously] the word count was cast to 16 bits here: above 256 KB only the start of
+	 * the image would have been checked, and reported as the whole image's CRC.
+	 */
+	ImageLength = ((uint32_t)&_sidata - FLASH_IMAGE_START) + ((uint32_t)&_edata - (uint32_t)&_sdata);
+	ImageCRCStart = Timestamp_Us();
+	if (CRC_DMA_Start(&CRC_DMA, (const uint32_t*)FLASH_IMAGE_START, ImageLength / 4U) != CRC_OK){
+		ImageCRC = CRC_Calculate((const uint8_t*)FLASH_IMAGE_START, ImageLength);
+		ImageCRCReady = SET;
+	}
 
-				SET_BIT(TIM6->CR1, 0); // Enable Counter (Start Timer)
+	KernelStatsTimer.Callback = Kernel_StatsCallback;
+	KernelStatsTimer.pArg = 0;
+	SoftTimer_Start(&KernelStatsTimer, KERNEL_STATS_PERIOD_MS / SOFTTIMER_TICK_MS, KERNEL_STATS_PERIOD_MS / SOFTTIMER_TICK_MS);
 
-				// C. Acknowledge Command
-				// Tell PC that the action has STARTED.
-				char start_msg[] = "Feeding started...\r\n";
-				USART_SendData(&USART2_Handle, (uint8_t*)start_msg, strlen(start_msg));
-			}
-			// D. Clear Buffer
-			// Whether we started the motor or ignored the command,
-			// we must clear 'message' to prevent infinite looping.
-			// otherwise the loop will execute this block forever!
-			message = 0;
-		}
-		else if (message == 'H') { // H for "Hello" or "Handshake"{
-			char ready_msg[] = "System Ready!\r\n";
-			USART_SendData(&USART2_Handle, (uint8_t*)ready_msg, strlen(ready_msg));
+	(void)Kernel_CreateTask(&ControlTask, Control_Task, 0, ControlStack, CONTROL_STACK_WORDS, CONTROL_TASK_PRIORITY);
+	(void)Kernel_CreateTask(&LogTask, Log_Task, 0, LogStack, LOG_STACK_WORDS, LOG_TASK_PRIORITY);
 
-			// Reset here too!
-			message = 0;
-		}
-		// ---------------------------------------------------------
-		// 3. Asynchronous Event Handling
-		// ---------------------------------------------------------
-		// FEED_COMPLETE is set to 1 by the TIM6 Interrupt Service Routine (ISR)
-		// when the 2 seconds have passed.
-		// The CPU checks this flag every loop iteration.
-		if (FEED_COMPLETE == 1) {
-		        char done_msg[] = "Feed Complete.\r\n";
-		        USART_SendData(&USART2_Handle, (uint8_t*)done_msg, strlen(done_msg));
-
-		        // Reset flag to wait for the next event
-		        FEED_COMPLETE = 0;
-		}
-
-		/*
-		 * [WARNING]
-		 * There used to an "else" block here to turn off the motor if the user
-		 * inputs "invalid commands".
-		 * BUT, since I added TIM6 ISR in the latest version,
-		 * keep that else block here will force the motor OFF immediately
-		 * whenver 'message' is 0 (which is 99% of the time).
-		 * The job of turning off the motor is fully intergrated to the TIM6 ISR logic
-		 */
-	}
+	/*
+	 * [Previously] the main loop followed here.
+	 * Now main()'s stack becomes the ISRs' stack (MSP), and Control runs first.
+	 */
+	Kernel_Start();
 }
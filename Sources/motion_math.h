@@ -0,0 +1,128 @@
+/*
+ * motion_math.h
+ *
+ *  Created on: 2026/2/19
+ *      Author: Yuheng
+ *
+ * Description:
+ * Fixed-point (Q16.16) helpers for the motor: RPM -> steps/s, clock -> PSC / ARR / CCR.
+ *
+ * [Previously] every timer number in main.c was worked out by hand ("PSC 15, ARR 3000")
+ * from the notes in DEVLOG, and had to be redone for every change of clock or motor.
+ * Now the numbers are written the way they are thought about (rpm, steps/rev, microsteps, Hz).
+ *
+ * Q16.16:
+ * A 32-bit integer that counts 1/65536ths: 0x00010000 = 1.0, 0x00008000 = 0.5.
+ * Add / subtract as plain integers, multiply = one 32x32 -> 64-bit multiply (SMULL) and a shift.
+ * No float anywhere: the FPU may not even be switched on, and a soft-float call in an ISR
+ * would cost hundreds of cycles.
+ *
+ * Compile time vs run time:
+ * Every UPPERCASE conversion below checks its arguments with __builtin_constant_p.
+ * - all constants -> the _CONST macro, folded by the compiler into a plain number
+ *                    (even at -O0): no code at all, the same as the hand-written value
+ * - otherwise      -> the static inline MotionMath_ function: a few instructions
+ *
+ * Division:
+ * Only MOTION_TIMER_PSC / MOTION_PERIOD_TICKS / MOTION_TIMER_ARR divide by a run-time value
+ * (UDIV, 2-12 cycles). They are meant for init and for main() (e.g. once per FEED command);
+ * the ISRs only get finished tick counts. Divisions by a constant (/ 60) are turned
+ * into a multiply by the compiler.
+ */
+
+#ifndef SOURCES_MOTION_MATH_H_
+#define SOURCES_MOTION_MATH_H_
+
+#include <stdint.h>
+
+/*
+ * ==========================================
+ * 1. Q16.16 Fixed-Point
+ * ==========================================
+ */
+typedef int32_t q16_t;
+
+#define Q16_SHIFT            16
+#define Q16_ONE              ((q16_t)1 << Q16_SHIFT)
+
+#define Q16_FROM_INT(x)      ((q16_t)((int32_t)(x) * Q16_ONE))                // |x| < 32768
+#define Q16_TO_INT(x)        ((int32_t)(((x) + (Q16_ONE / 2)) >> Q16_SHIFT))  // rounded
+#define Q16_FROM_RATIO(Num, Den) \
+	((q16_t)((((int64_t)(Num) << Q16_SHIFT) + ((Den) / 2)) / (Den)))            // Num / Den, rounded (constants!)
+#define Q16_PERCENT(p)       Q16_FROM_RATIO((p), 100)
+
+static inline q16_t Q16_Mul(q16_t a, q16_t b){
+	return (q16_t)(((int64_t)a * b) >> Q16_SHIFT);
+}
+
+// Integer x Q16 -> integer, rounded (e.g. ticks x duty)
+static inline uint32_t Q16_MulUint(uint32_t Value, q16_t Factor){
+	return (uint32_t)((((int64_t)Value * Factor) + (Q16_ONE / 2)) >> Q16_SHIFT);
+}
+
+// Smoothstep s = 3x^2 - 2x^3 for 0 <= x <= 1.0 (S-curve ramps)
+static inline q16_t Q16_Smoothstep(q16_t x){
+	q16_t x2 = Q16_Mul(x, x);
+	q16_t x3 = Q16_Mul(x2, x);
+	return (3 * x2) - (2 * x3);
+}
+
+/*
+ * ==========================================
+ * 2. Motor: RPM -> steps/s
+ * ==========================================
+ * steps/rev = full steps/rev (200 for a 1.8 deg NEMA17) x microstep factor (A4988: 1 - 16)
+ * steps/s   = rpm x steps/rev / 60
+ */
+#define MOTION_STEPS_PER_REV(FullSteps, Microsteps)  ((uint32_t)(FullSteps) * (uint32_t)(Microsteps))
+
+static inline q16_t MotionMath_StepRateQ16(uint32_t Rpm, uint32_t StepsPerRev){
+	return (q16_t)((((uint64_t)Rpm * StepsPerRev << Q16_SHIFT) + 30U) / 60U);
+}
+
+#define MOTION_STEP_RATE_Q16_CONST(Rpm, StepsPerRev) \
+	((q16_t)((((uint64_t)(Rpm) * (StepsPerRev) << Q16_SHIFT) + 30U) / 60U))
+
+#define MOTION_STEP_RATE_Q16(Rpm, StepsPerRev) \
+	(__builtin_constant_p((Rpm) + (StepsPerRev)) ? MOTION_STEP_RATE_Q16_CONST(Rpm, StepsPerRev) \
+	                                             : MotionMath_StepRateQ16((Rpm), (StepsPerRev)))
+
+// Whole steps/s, rounded
+#define MOTION_STEP_RATE(Rpm, StepsPerRev)  ((uint32_t)Q16_TO_INT(MOTION_STEP_RATE_Q16(Rpm, StepsPerRev)))
+
+/*
+ * ==========================================
+ * 3. Timer: clock -> PSC / ARR / CCR
+ * ==========================================
+ * tick    = ClockHz / (PSC + 1)        -> PSC = ClockHz / TickHz - 1
+ * period  = TickHz / RateHz ticks      -> ARR = period - 1
+ * CCR     = period x duty              (PWM mode 1: high for CCR ticks)
+ */
+static inline uint32_t MotionMath_TimerPsc(uint32_t ClockHz, uint32_t TickHz){
+	return (ClockHz / TickHz) - 1U;
+}
+
+static inline uint32_t MotionMath_PeriodTicks(uint32_t TickHz, uint32_t RateHz){
+	return (TickHz + (RateHz / 2U)) / RateHz; // rounded to the nearest tick
+}
+
+#define MOTION_TIMER_PSC_CONST(ClockHz, TickHz)      ((uint32_t)((ClockHz) / (TickHz)) - 1U)
+#define MOTION_PERIOD_TICKS_CONST(TickHz, RateHz)    ((uint32_t)(((TickHz) + ((RateHz) / 2U)) / (RateHz)))
+#define MOTION_TIMER_CCR_CONST(Period, Duty)         ((uint32_t)((((int64_t)(Period) * (Duty)) + (Q16_ONE / 2)) >> Q16_SHIFT))
+
+#define MOTION_TIMER_PSC(ClockHz, TickHz) \
+	(__builtin_constant_p((ClockHz) + (TickHz)) ? MOTION_TIMER_PSC_CONST(ClockHz, TickHz) \
+	                                            : MotionMath_TimerPsc((ClockHz), (TickHz)))
+
+#define MOTION_PERIOD_TICKS(TickHz, RateHz) \
+	(__builtin_constant_p((TickHz) + (RateHz)) ? MOTION_PERIOD_TICKS_CONST(TickHz, RateHz) \
+	                                           : MotionMath_PeriodTicks((TickHz), (RateHz)))
+
+#define MOTION_TIMER_ARR(TickHz, RateHz)  (MOTION_PERIOD_TICKS(TickHz, RateHz) - 1U)
+
+// Period in ticks (ARR + 1), Duty in Q16 (e.g. Q16_PERCENT(50)): no division, safe in an ISR
+#define MOTION_TIMER_CCR(Period, Duty) \
+	(__builtin_constant_p((Period) + (Duty)) ? MOTION_TIMER_CCR_CONST(Period, Duty) \
+	                                         : Q16_MulUint((Period), (Duty)))
+
+#endif /* SOURCES_MOTION_MATH_H_ */
@@ -0,0 +1,336 @@
+/*
+ * multi_axis.c
+ *
+ *  Created on: 2026/2/21
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_rcc_driver.h"
+#include "stm32f446xx_timer_driver.h"
+#include "a4988_driver.h"
+#include "motion_math.h"
+#include "multi_axis.h"
+#include <stdint.h>
+
+/*
+ * Flags: what the tick in the preload registers (LOADED) and the tick running now (ACTIVE) are.
+ * Every update event turns LOADED into ACTIVE (MultiAxis_Advance).
+ * - LAST:   the last tick of a move -> when it stops being ACTIVE, the move is done
+ * - IDLE:   an empty tick (no pulse on any axis) -> while it is ACTIVE, DIR may change
+ * - DIR_PENDING: the move being loaded needs new DIR levels first
+ * - STOPPING:    the queue was empty when the empty tick was loaded
+ */
+#define MULTIAXIS_FLAG_LAST_LOADED   (1U << 0)
+#define MULTIAXIS_FLAG_LAST_ACTIVE   (1U << 1)
+#define MULTIAXIS_FLAG_IDLE_LOADED   (1U << 2)
+#define MULTIAXIS_FLAG_IDLE_ACTIVE   (1U << 3)
+#define MULTIAXIS_FLAG_DIR_PENDING   (1U << 4)
+#define MULTIAXIS_FLAG_STOPPING      (1U << 5)
+
+#define MULTIAXIS_SLAVE_ARR          0xFFFEU // below MULTIAXIS_NO_PULSE: a free-running slave never pulses
+
+static uint32_t MultiAxis_Abs(int16_t Steps){
+	return (uint32_t)((Steps < 0) ? -(int32_t)Steps : (int32_t)Steps);
+}
+
+static uint8_t MultiAxis_DirectionOf(int16_t Steps){
+	return (Steps < 0) ? A4988_DIR_REVERSE : A4988_DIR_FORWARD;
+}
+
+// Only the ISR (or main() with the axes idle, inside a critical section) takes moves out
+static uint8_t MultiAxis_Pop(MultiAxis_Handle_t *pMultiAxisHandle, MultiAxis_Move_t *pMove){
+	if (pMultiAxisHandle->QueueCount == 0){
+		return RESET;
+	}
+
+	*pMove = pMultiAxisHandle->Queue[pMultiAxisHandle->QueueHead];
+	pMultiAxisHandle->QueueHead = (pMultiAxisHandle->QueueHead + 1U) & (MULTIAXIS_QUEUE_SIZE - 1U);
+	pMultiAxisHandle->QueueCount--;
+	return SET;
+}
+
+// An empty tick of Period ticks into the preload registers
+static void MultiAxis_LoadIdle(MultiAxis_Handle_t *pMultiAxisHandle, uint32_t Period){
+	for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+		TIM_SetCompare(pMultiAxisHandle->Axis[i].pTIMx, pMultiAxisHandle->Axis[i].Channel, MULTIAXIS_NO_PULSE);
+	}
+	pMultiAxisHandle->Axis[0].pTIMx->ARR = Period - 1U;
+	pMultiAxisHandle->Flags |= MULTIAXIS_FLAG_IDLE_LOADED;
+}
+
+// Current was just taken from the queue: tick count, Bresenham terms, DIR changes
+static void MultiAxis_Begin(MultiAxis_Handle_t *pMultiAxisHandle){
+	MultiAxis_Move_t *pMove = &pMultiAxisHandle->Current;
+	uint32_t ticks = 0;
+
+	for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+		uint32_t steps = MultiAxis_Abs(pMove->Steps[i]);
+		if (steps > ticks){
+			ticks = steps;
+		}
+
+		if ((pMultiAxisHandle->Axis[i].pDriver != 0) && (steps != 0) &&
+			(MultiAxis_DirectionOf(pMove->Steps[i]) != pMultiAxisHandle->Direction[i])){
+			pMultiAxisHandle->Flags |= MULTIAXIS_FLAG_DIR_PENDING;
+		}
+	}
+
+	pMultiAxisHandle->Ticks = ticks;
+	pMultiAxisHandle->Tick = 0;
+	for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+		pMultiAxisHandle->Error[i] = ticks >> 1; // half a tick ahead: steps centered in their slots
+	}
+}
+
+static void MultiAxis_WriteDirections(MultiAxis_Handle_t *pMultiAxisHandle){
+	MultiAxis_Move_t *pMove = &pMultiAxisHandle->Current;
+
+	for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+		if ((pMultiAxisHandle->Axis[i].pDriver != 0) && (pMove->Steps[i] != 0)){
+			uint8_t direction = MultiAxis_DirectionOf(pMove->Steps[i]);
+			A4988_SetDirection(pMultiAxisHandle->Axis[i].pDriver, direction);
+			pMultiAxisHandle->Direction[i] = direction;
+		}
+	}
+}
+
+/*
+ * Write the preload registers for the tick after the one running now:
+ * the next Bresenham tick of Current, the next move, or an empty tick.
+ */
+static void MultiAxis_LoadNext(MultiAxis_Handle_t *pMultiAxisHandle){
+	if (pMultiAxisHandle->Tick >= pMultiAxisHandle->Ticks){
+		if (MultiAxis_Pop(pMultiAxisHandle, &pMultiAxisHandle->Current) != SET){
+			MultiAxis_LoadIdle(pMultiAxisHandle, MULTIAXIS_GAP_PERIOD);
+			pMultiAxisHandle->Flags |= MULTIAXIS_FLAG_STOPPING;
+			return;
+		}
+		MultiAxis_Begin(pMultiAxisHandle);
+	}
+
+	if (pMultiAxisHandle->Flags & MULTIAXIS_FLAG_DIR_PENDING){
+		if (!(pMultiAxisHandle->Flags & MULTIAXIS_FLAG_IDLE_ACTIVE)){
+			// the last pulse of the old direction is running: one empty tick first
+			MultiAxis_LoadIdle(pMultiAxisHandle, MULTIAXIS_GAP_PERIOD);
+			return;
+		}
+		MultiAxis_WriteDirections(pMultiAxisHandle);
+		pMultiAxisHandle->Flags &= ~MULTIAXIS_FLAG_DIR_PENDING;
+	}
+
+	// Bresenham: every axis adds its share, and steps when it passes a whole tick count
+	uint32_t ticks = pMultiAxisHandle->Ticks;
+	for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+		MultiAxis_Axis_t *pAxis = &pMultiAxisHandle->Axis[i];
+
+		pMultiAxisHandle->Error[i] += MultiAxis_Abs(pMultiAxisHandle->Current.Steps[i]);
+		if (pMultiAxisHandle->Error[i] >= ticks){
+			pMultiAxisHandle->Error[i] -= ticks;
+			TIM_SetCompare(pAxis->pTIMx, pAxis->Channel, MULTIAXIS_STEP_EDGE);
+		}
+		else{
+			TIM_SetCompare(pAxis->pTIMx, pAxis->Channel, MULTIAXIS_NO_PULSE);
+		}
+	}
+	pMultiAxisHandle->Axis[0].pTIMx->ARR = pMultiAxisHandle->Current.Period - 1U;
+
+	pMultiAxisHandle->Tick++;
+	if (pMultiAxisHandle->Tick == ticks){
+		pMultiAxisHandle->Finishing = pMultiAxisHandle->Current;
+		pMultiAxisHandle->Flags |= MULTIAXIS_FLAG_LAST_LOADED;
+	}
+}
+
+static void MultiAxis_Halt(MultiAxis_Handle_t *pMultiAxisHandle){
+	TIM_RegDef_t *pMaster = pMultiAxisHandle->Axis[0].pTIMx;
+
+	CLEAR_BIT(pMaster->DIER, 0);
+	CLEAR_BIT(pMaster->CR1, 0);
+	pMultiAxisHandle->State = MULTIAXIS_STATE_IDLE;
+}
+
+/*
+ * One update event: the loaded tick has just become the running one.
+ * Reports the move whose last tick just ended, then loads the following tick.
+ */
+static void MultiAxis_Advance(MultiAxis_Handle_t *pMultiAxisHandle){
+	uint8_t flags = pMultiAxisHandle->Flags;
+
+	if (flags & MULTIAXIS_FLAG_LAST_ACTIVE){
+		MultiAxis_Move_t *pDone = &pMultiAxisHandle->Finishing;
+		for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+			if (pMultiAxisHandle->Axis[i].pDriver != 0){
+				A4988_Advance(pMultiAxisHandle->Axis[i].pDriver, MultiAxis_Abs(pDone->Steps[i]));
+			}
+		}
+		pMultiAxisHandle->MovesDone++;
+		MultiAxis_MoveDoneCallback(pMultiAxisHandle, pDone); // may push the next move
+	}
+
+	flags &= ~(MULTIAXIS_FLAG_LAST_ACTIVE | MULTIAXIS_FLAG_IDLE_ACTIVE);
+	if (flags & MULTIAXIS_FLAG_LAST_LOADED){
+		flags |= MULTIAXIS_FLAG_LAST_ACTIVE;
+	}
+	if (flags & MULTIAXIS_FLAG_IDLE_LOADED){
+		flags |= MULTIAXIS_FLAG_IDLE_ACTIVE;
+	}
+	flags &= ~(MULTIAXIS_FLAG_LAST_LOADED | MULTIAXIS_FLAG_IDLE_LOADED);
+
+	if (flags & MULTIAXIS_FLAG_STOPPING){
+		flags &= ~MULTIAXIS_FLAG_STOPPING;
+		if (pMultiAxisHandle->QueueCount == 0){
+			// the empty tick is running, nothing came in meanwhile: stop here (all outputs low)
+			pMultiAxisHandle->Flags = flags;
+			MultiAxis_Halt(pMultiAxisHandle);
+			return;
+		}
+	}
+
+	pMultiAxisHandle->Flags = flags;
+	MultiAxis_LoadNext(pMultiAxisHandle);
+}
+
+void MultiAxis_Init(MultiAxis_Handle_t *pMultiAxisHandle){
+	TIM_RegDef_t *pMaster = pMultiAxisHandle->Axis[0].pTIMx;
+
+	for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+		MultiAxis_Axis_t *pAxis = &pMultiAxisHandle->Axis[i];
+		TIM_RegDef_t *pTIMx = pAxis->pTIMx;
+		uint8_t first = SET;
+
+		for (uint8_t j = 0; j < i; j++){
+			if (pMultiAxisHandle->Axis[j].pTIMx == pTIMx){
+				first = RESET; // a timer shared by several axes is set up once
+			}
+		}
+
+		if (first == SET){
+			// 1 us ticks from each timer's own clock (TIM1 sits on APB2)
+			uint32_t clock = ((uint32_t)pTIMx >= APB2_BASEADDR) ? RCC_GetTimerClock2Value() : RCC_GetTimerClock1Value();
+			pTIMx->PSC = MOTION_TIMER_PSC(clock, MULTIAXIS_TICK_HZ);
+			SET_BIT(pTIMx->CR1, 7); // ARPE: a new Period waits for the end of the tick
+			SET_BIT(pTIMx->CR1, 2); // URS: UG does not count as a tick
+
+			if (pTIMx == pMaster){
+				pTIMx->ARR = MULTIAXIS_GAP_PERIOD - 1U;
+				TIM_MasterConfig(pTIMx, TIM_TRGO_UPDATE);
+			}
+			else{
+				// never overflows by itself while the master runs (Period <= 0xFFFF ticks)
+				pTIMx->ARR = MULTIAXIS_SLAVE_ARR;
+				TIM_SlaveConfig(pTIMx, pAxis->Trigger, TIM_SLAVE_RESET);
+			}
+		}
+
+		TIM_PWM_ChannelInit(pTIMx, pAxis->Channel, TIM_OCMODE_PWM2, MULTIAXIS_NO_PULSE);
+		pMultiAxisHandle->Direction[i] = (pAxis->pDriver != 0) ? pAxis->pDriver->Direction : A4988_DIR_FORWARD;
+	}
+
+	// load the prescalers, slaves counting (and reset by every master update), master stopped
+	for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+		TIM_RegDef_t *pTIMx = pMultiAxisHandle->Axis[i].pTIMx;
+		SET_BIT(pTIMx->EGR, 0);
+		if (pTIMx != pMaster){
+			SET_BIT(pTIMx->CR1, 0);
+		}
+	}
+	CLEAR_BIT(pMaster->CR1, 0);
+
+	pMultiAxisHandle->QueueHead = 0;
+	pMultiAxisHandle->QueueCount = 0;
+	pMultiAxisHandle->Ticks = 0;
+	pMultiAxisHandle->Tick = 0;
+	pMultiAxisHandle->Flags = 0;
+	pMultiAxisHandle->MovesDone = 0;
+	pMultiAxisHandle->State = MULTIAXIS_STATE_IDLE;
+}
+
+uint8_t MultiAxis_Push(MultiAxis_Handle_t *pMultiAxisHandle, const MultiAxis_Move_t *pMove){
+	TIM_RegDef_t *pMaster = pMultiAxisHandle->Axis[0].pTIMx;
+	uint8_t any = RESET;
+
+	for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+		if (pMove->Steps[i] != 0){
+			any = SET;
+		}
+	}
+	if ((any != SET) || (pMove->Period <= (2U * MULTIAXIS_STEP_EDGE))){
+		return MULTIAXIS_ERROR;
+	}
+
+	uint32_t state = Critical_Enter();
+
+	if (pMultiAxisHandle->QueueCount >= MULTIAXIS_QUEUE_SIZE){
+		Critical_Exit(state);
+		return MULTIAXIS_ERROR;
+	}
+	uint8_t tail = (pMultiAxisHandle->QueueHead + pMultiAxisHandle->QueueCount) & (MULTIAXIS_QUEUE_SIZE - 1U);
+	pMultiAxisHandle->Queue[tail] = *pMove;
+	pMultiAxisHandle->QueueCount++;
+
+	if (pMultiAxisHandle->State == MULTIAXIS_STATE_IDLE){
+		/*
+		 * Start from rest: the axes count as sitting in an empty tick (DIR may change now).
+		 * 1st Advance: tick 0 into the preload registers, UG makes it the running tick
+		 * (its TRGO resets the slaves, which load theirs), 2nd Advance: tick 1 into the preload.
+		 */
+		pMultiAxisHandle->Flags = MULTIAXIS_FLAG_IDLE_LOADED;
+		pMultiAxisHandle->State = MULTIAXIS_STATE_RUNNING;
+
+		MultiAxis_Advance(pMultiAxisHandle);
+		SET_BIT(pMaster->EGR, 0);
+		MultiAxis_Advance(pMultiAxisHandle);
+
+		CLEAR_BIT(pMaster->SR, 0);
+		SET_BIT(pMaster->DIER, 0);
+		SET_BIT(pMaster->CR1, 0);
+	}
+
+	Critical_Exit(state);
+	return MULTIAXIS_OK;
+}
+
+void MultiAxis_Stop(MultiAxis_Handle_t *pMultiAxisHandle){
+	TIM_RegDef_t *pMaster = pMultiAxisHandle->Axis[0].pTIMx;
+	uint32_t state = Critical_Enter();
+
+	MultiAxis_Halt(pMultiAxisHandle);
+
+	// outputs low right now: NO_PULSE everywhere, made active by a UG (+ TRGO for the slaves)
+	for (uint8_t i = 0; i < pMultiAxisHandle->AxisCount; i++){
+		TIM_SetCompare(pMultiAxisHandle->Axis[i].pTIMx, pMultiAxisHandle->Axis[i].Channel, MULTIAXIS_NO_PULSE);
+	}
+	SET_BIT(pMaster->EGR, 0);
+	CLEAR_BIT(pMaster->SR, 0);
+
+	// the pulses already sent are not known per axis: the A4988 positions are left as they were
+	pMultiAxisHandle->QueueCount = 0;
+	pMultiAxisHandle->Ticks = 0;
+	pMultiAxisHandle->Tick = 0;
+	pMultiAxisHandle->Flags = 0;
+
+	Critical_Exit(state);
+}
+
+void MultiAxis_IRQHandling(MultiAxis_Handle_t *pMultiAxisHandle){
+	TIM_RegDef_t *pMaster = pMultiAxisHandle->Axis[0].pTIMx;
+
+	if (!READ_BIT(pMaster->SR, 0)){
+		return;
+	}
+	CLEAR_BIT(pMaster->SR, 0);
+
+	if (pMultiAxisHandle->State != MULTIAXIS_STATE_RUNNING){
+		return;
+	}
+
+	MultiAxis_Advance(pMultiAxisHandle);
+}
+
+/*
+ * Weak default: does nothing (same pattern as Motion_CompleteCallback).
+ */
+__attribute__((weak)) void MultiAxis_MoveDoneCallback(MultiAxis_Handle_t *pMultiAxisHandle, const MultiAxis_Move_t *pMove){
+	(void)pMultiAxisHandle;
+	(void)pMove;
+}
@@ -0,0 +1,133 @@
+/*
+ * multi_axis.h
+ *
+ *  Created on: 2026/2/21
+ *      Author: Yuheng
+ *
+ * Description:
+ * Coordinated STEP generation for up to 4 steppers (e.g. 2 hopper augers + 1 agitator),
+ * on any mix of timer channels (TIM1 / TIM8 ...).
+ *
+ * [Previously] stepper_motion.h drives ONE motor: one STEP pin, one timer, its own pulse counter.
+ * Several of those side by side would each run on their own clock, and a "move these
+ * 3 motors by 800 / 200 / 50 steps" would end at 3 different moments.
+ *
+ * Bresenham:
+ * A move lasts N = max |Steps| ticks, the longest axis steps on every tick.
+ * Every other axis adds its |Steps| to an error term each tick and steps whenever
+ * the term passes N (then subtracts N): its steps are spread evenly over the same N ticks,
+ * and all axes finish within the same last tick. Only adds and compares, no division.
+ *
+ * One time base for every axis (RM0390 17.3.19 Timer synchronization):
+ *
+ *   master = timer of Axis[0] --TRGO = update--> every other axis timer (slave RESET mode)
+ *
+ * A tick = one master period (ARR = Period - 1). The master's update resets the slaves
+ * (CNT = 0 + update event), so all channels start the tick together and all preloaded CCRx
+ * take effect together. Every channel runs PWM mode 2 (same waveform as stepper_motion.h):
+ * CCRx = MULTIAXIS_STEP_EDGE -> one pulse in this tick, CCRx = MULTIAXIS_NO_PULSE -> none.
+ * The master's update ISR writes the pattern of the NEXT tick into the preload registers.
+ *
+ * Motion Queue:
+ * Moves are queued (MultiAxis_Push) and played back to back: the first tick of a move
+ * directly follows the last tick of the previous one. Only a change of direction
+ * inserts one empty tick (DIR must not change under the last pulse of the old direction).
+ * A move is a constant tick rate: ramps are a series of moves with shorter and shorter Periods.
+ *
+ * Example, next to the feeder (RM0390 Table 72 for the TIM8 ITRs):
+ *   Axis[0] TIM1 CH1 (hopper 1, master)
+ *   Axis[1] TIM1 CH2 (hopper 2)          same timer: no trigger needed
+ *   Axis[2] TIM8 CH1 (agitator)          Trigger = TIM_TRIGGER_ITR0 (TIM1 TRGO)
+ *   Axis[3] TIM8 CH2 (spare)             Trigger = TIM_TRIGGER_ITR0 (TIM1 TRGO)
+ *   MultiAxis_IRQHandling from TIM1_UP_TIM10_IRQHandler (the master's update)
+ * TIM2 / TIM3 are taken by stepper_motion.h (STEP timer / its pulse counter and gate):
+ * every timer listed here is owned by this module, none of them can be one of those.
+ * TIM8 still needs its TIMx definition in stm32f446xx.h (and MOE, like TIM1 in TIM_PWM_ChannelInit).
+ *
+ * Library only for now: main.c does not create a handle, the board has one motor (the feeder).
+ */
+
+#ifndef SOURCES_MULTI_AXIS_H_
+#define SOURCES_MULTI_AXIS_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+#include "stm32f446xx_timer_driver.h"
+#include "a4988_driver.h"
+
+#define MULTIAXIS_MAX_AXES    4U
+#define MULTIAXIS_QUEUE_SIZE  8U          // power of two (ring index wraps with a mask)
+#define MULTIAXIS_TICK_HZ     1000000U    // same 1 us ticks as stepper_motion.h
+#define MULTIAXIS_STEP_EDGE   10U         // ticks LOW at the start of a tick, then HIGH until its end
+#define MULTIAXIS_NO_PULSE    0xFFFFU     // CCRx above any ARR (slaves: 0xFFFE, master: Period - 1): no pulse in this tick
+#define MULTIAXIS_GAP_PERIOD  100U        // ticks of the empty tick before a direction change
+
+/* @MultiAxis_State */
+#define MULTIAXIS_STATE_IDLE     0
+#define MULTIAXIS_STATE_RUNNING  1
+
+/* @MultiAxis_Status */
+#define MULTIAXIS_OK          0
+#define MULTIAXIS_ERROR       1 // queue full / Period too short / no steps at all
+
+typedef struct{
+	TIM_RegDef_t *pTIMx;        // timer of the STEP pin, its clock already enabled
+	uint8_t Channel;            // @TIM_Channel
+	uint8_t Trigger;            // @TIM_Trigger: ITRx of pTIMx wired to the master's TRGO (ignored on the master's timer)
+	A4988_Handle_t *pDriver;    // DIR + position of this axis (or NULL: one direction only)
+} MultiAxis_Axis_t;
+
+typedef struct{
+	int16_t Steps[MULTIAXIS_MAX_AXES]; // per axis, the sign is the direction (A4988_DIR_REVERSE if < 0)
+	uint16_t Period;                   // ticks per tick = per step of the longest axis, > 2 x MULTIAXIS_STEP_EDGE
+} MultiAxis_Move_t;
+
+/*
+ * Multi-Axis Handle
+ * Axis[0].pTIMx is the master, the GPIO pins must already be in their timer's alternate function.
+ * Everything below AxisCount is owned by the driver.
+ */
+typedef struct{
+	MultiAxis_Axis_t Axis[MULTIAXIS_MAX_AXES];
+	uint8_t AxisCount;
+
+	// shared motion queue: main() pushes, the master's update ISR pops
+	MultiAxis_Move_t Queue[MULTIAXIS_QUEUE_SIZE];
+	uint8_t QueueHead;
+	volatile uint8_t QueueCount;
+
+	// the move whose ticks are being loaded
+	MultiAxis_Move_t Current;
+	uint32_t Ticks;                    // N = max |Steps|
+	uint32_t Tick;                     // next tick to load
+	uint32_t Error[MULTIAXIS_MAX_AXES]; // Bresenham terms
+	uint8_t Direction[MULTIAXIS_MAX_AXES]; // @A4988_Direction on the DIR pins right now
+
+	MultiAxis_Move_t Finishing;        // the move whose last tick is loaded / running
+	uint8_t Flags;                     // what the loaded / running tick is (see multi_axis.c)
+
+	volatile uint32_t MovesDone;
+	volatile uint8_t State;            // @MultiAxis_State
+} MultiAxis_Handle_t;
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+// Prescalers (MULTIAXIS_TICK_HZ), channels in PWM mode 2, master TRGO, slaves in reset mode
+void MultiAxis_Init(MultiAxis_Handle_t *pMultiAxisHandle);
+
+// Queue a move (main()), starts right away if the axes are idle
+uint8_t MultiAxis_Push(MultiAxis_Handle_t *pMultiAxisHandle, const MultiAxis_Move_t *pMove);
+
+// Stop now (pulses in progress are cut short), drop the queue, no callback
+void MultiAxis_Stop(MultiAxis_Handle_t *pMultiAxisHandle);
+
+// Master timer update interrupt: call it from the master timer's ISR
+void MultiAxis_IRQHandling(MultiAxis_Handle_t *pMultiAxisHandle);
+
+// Called from the ISR when the last pulse of a move is out (weak, override it)
+void MultiAxis_MoveDoneCallback(MultiAxis_Handle_t *pMultiAxisHandle, const MultiAxis_Move_t *pMove);
+
+#endif /* SOURCES_MULTI_AXIS_H_ */
@@ -0,0 +1,147 @@
+/*
+ * power_manager.c
+ *
+ *  Created on: 2026/2/26
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_gpio_driver.h"
+#include "stm32f446xx_rtc_driver.h"
+#include "stm32f446xx_watchdog_driver.h"
+#include "power_manager.h"
+#include "timestamp.h"
+#include <stdint.h>
+
+// Takes an IRQ out of the pending state (its flag in the peripheral must be cleared first)
+static void Power_ClearPendingIRQ(uint8_t IRQNumber){
+	NVIC_ICPR[IRQNumber / 32] = (1U << (IRQNumber % 32));
+}
+
+uint8_t Power_Init(Power_Handle_t *pPowerHandle){
+	pPowerHandle->SleepUs = 0;
+	pPowerHandle->StopMs = 0;
+	pPowerHandle->Sleeps = 0;
+	pPowerHandle->Stops = 0;
+	pPowerHandle->StopWakeups = 0;
+
+	uint8_t status = RTC_Init();
+	if (status == RTC_OK){
+		status = RTC_SetWakeup(pPowerHandle->Power_Config.WakeupMs);
+	}
+
+	/*
+	 * Wake-up pin: EXTI line = pin number, port chosen in SYSCFG_EXTICR, falling edge (start bit).
+	 * The pin keeps its alternate function: the EXTI sees the input stage whatever the mode.
+	 * IMR stays masked outside Stop mode, otherwise every falling edge on RX would be an interrupt.
+	 */
+	uint8_t pin = pPowerHandle->Power_Config.WakePinNumber;
+
+	GPIO_SYSCFG_Config(pPowerHandle->Power_Config.pWakeGPIOx, pin);
+	CLEAR_BIT(EXTI->IMR, pin);
+	CLEAR_BIT(EXTI->RTSR, pin);
+	SET_BIT(EXTI->FTSR, pin);
+	NVIC_ISER_Config(pPowerHandle->Power_Config.WakeIRQ);
+
+	return status;
+}
+
+void Power_Sleep(Power_Handle_t *pPowerHandle){
+	// DWT / SysTick keep counting in Sleep (only the core clock is gated): plain timestamps
+	uint64_t start = Timestamp_Us();
+
+	__asm volatile ("WFI" : : : "memory");
+
+	pPowerHandle->SleepUs += Timestamp_Us() - start;
+	pPowerHandle->Sleeps++;
+}
+
+uint8_t Power_Stop(Power_Handle_t *pPowerHandle, uint32_t MaxMs){
+	uint8_t pin = pPowerHandle->Power_Config.WakePinNumber;
+	uint8_t reason;
+	uint32_t start = RTC_GetMs();
+	uint32_t elapsed;
+
+	EXTI->PR = (1U << pin); // an old edge (plain RX traffic) must not end it at once
+	Power_ClearPendingIRQ(pPowerHandle->Power_Config.WakeIRQ);
+	SET_BIT(EXTI->IMR, pin);
+
+	/*
+	 * PWR_CR:
+	 * Bit 0 LPDS: low-power regulator in Stop
+	 * Bit 1 PDDS: 0 = Stop (1 would be Standby: RAM lost, wake-up through reset)
+	 * Bit 9 FPDS: flash in deep power-down in Stop (a few us more to wake up)
+	 * SCB_SCR Bit 2 SLEEPDEEP: WFI now means Stop
+	 */
+	PWR->CR = (PWR->CR & ~(1U << 1)) | (1U << 0) | (1U << 9);
+	SET_BIT(SCB_SCR, 2);
+
+	while (1){
+		IWDG_FEED();
+		__asm volatile ("WFI" : : : "memory");
+		IWDG_FEED();
+
+		/*
+		 * Interrupts are masked: no ISR ran. Clear what woke us (flag, then NVIC pending bit),
+		 * otherwise the next WFI would return at once.
+		 */
+		uint8_t by_pin = READ_BIT(EXTI->PR, pin) ? SET : RESET;
+		uint8_t by_rtc = RTC_ClearWakeup();
+		EXTI->PR = (1U << pin);
+		Power_ClearPendingIRQ(pPowerHandle->Power_Config.WakeIRQ);
+		Power_ClearPendingIRQ(RTC_WKUP_IRQ);
+
+		elapsed = RTC_ElapsedMs(start, RTC_GetMs());
+		if (by_pin){
+			reason = POWER_WAKE_PIN;
+			break;
+		}
+		if (!by_rtc){
+			reason = POWER_WAKE_OTHER; // left pending: its ISR runs at Critical_Exit
+			break;
+		}
+		pPowerHandle->StopWakeups++;
+		if (elapsed >= MaxMs){
+			reason = POWER_WAKE_TIMEOUT;
+			break;
+		}
+	}
+
+	CLEAR_BIT(SCB_SCR, 2);
+	CLEAR_BIT(EXTI->IMR, pin);
+
+	/*
+	 * Whatever Stop mode did to the over-drive, SYSCLK is HSI now: its enable bits may be
+	 * cleared, and the next RCC_ClockConfig ramps it up from scratch.
+	 * PWR_CR Bit 17 ODSWEN, then Bit 16 ODEN.
+	 */
+	CLEAR_BIT(PWR->CR, 17);
+	CLEAR_BIT(PWR->CR, 16);
+
+	pPowerHandle->StopMs += elapsed;
+	pPowerHandle->Stops++;
+
+	return reason;
+}
+
+void Power_WakeIRQHandling(Power_Handle_t *pPowerHandle){
+	EXTI->PR = (1U << pPowerHandle->Power_Config.WakePinNumber);
+}
+
+uint64_t Power_GetRunUs(Power_Handle_t *pPowerHandle){
+	// Timestamp_Us stands still in Stop: it is exactly Run + Sleep
+	return Timestamp_Us() - pPowerHandle->SleepUs;
+}
+
+uint32_t Power_GetAverageUa(Power_Handle_t *pPowerHandle){
+	uint64_t run_us = Power_GetRunUs(pPowerHandle);
+	uint64_t stop_us = pPowerHandle->StopMs * 1000U;
+	uint64_t total_us = run_us + pPowerHandle->SleepUs + stop_us;
+
+	if (total_us == 0){
+		return 0;
+	}
+
+	// uA x us: 30000 uA x 10 years of us still fits in 64 bits
+	uint64_t charge = (run_us * POWER_RUN_UA) + (pPowerHandle->SleepUs * POWER_SLEEP_UA) + (stop_us * POWER_STOP_UA);
+	return (uint32_t)(charge / total_us);
+}
@@ -0,0 +1,113 @@
+/*
+ * power_manager.h
+ *
+ *  Created on: 2026/2/26
+ *      Author: Yuheng
+ *
+ * Description:
+ * Low-power idle: the core sleeps whenever main() has nothing to do.
+ *
+ * [Previously] the main loop spun at full power, polling its queues millions of times a second
+ * for a command that comes a few times a day.
+ *
+ * Two levels (RM0390 5.3 Low-power modes):
+ * - Sleep (Power_Sleep): WFI, only the core clock stops. Any interrupt ends it (SysTick every ms,
+ *   USART2, DMA ...), the peripherals keep running: fine between two bytes, or during a feed.
+ * - Stop (Power_Stop): WFI with SLEEPDEEP, every clock of the 1.2 V domain off, regulator in
+ *   low-power mode, flash powered down. Only the EXTI lines can end it:
+ *     - Line 22: the RTC wakeup timer, every Power_Config.WakeupMs (stm32f446xx_rtc_driver.h)
+ *     - the USART2 RX pin: the falling edge of the first start bit
+ *   Only when NOTHING is running (no feed, no transfer, no soft timer waiting).
+ *
+ * Why not SLEEPONEXIT? It sleeps straight out of the last ISR and never comes back to main().
+ * Here the work itself (decoding, events, logs) runs in main(), so main() decides when to sleep.
+ *
+ * Both are called with interrupts MASKED (Critical_Enter), right after checking there is no work:
+ * an interrupt that comes in between is not lost, it stays pending and WFI returns at once
+ * (PM0214 3.12.11: WFI wakes on a pending interrupt even with PRIMASK set).
+ * It is serviced at Critical_Exit.
+ *
+ * Stop mode, the details:
+ * - IWDG: it keeps counting (LSI) and cannot be frozen on the F446. The RTC wakes the core up
+ *   every WakeupMs, the dog is fed, and the core goes straight back to Stop, still on HSI,
+ *   without returning. WakeupMs must stay well below the IWDG timeout (both count on the LSI).
+ * - Clock: the core wakes up on HSI 16 MHz, the PLL is off. The caller restores it
+ *   (Governor_Resume) BEFORE Critical_Exit, so no ISR ever runs at the wrong clock.
+ * - The byte that wakes the core is lost (it arrives before the clock is back):
+ *   the PC sends 0x00, waits 2 ms, then 0x00 again (frame delimiters) before its frames (script.py).
+ * - SysTick and the DWT counter stand still: SysTick_GetTick / Timestamp_Us do not
+ *   count the time spent in Stop. The RTC does (StopMs below).
+ *
+ * Accounting:
+ * Time in each state, and from it an estimated average current with POWER_xxx_UA.
+ * Those are typical values (datasheet DS10693, 5.3.6 Supply current characteristics),
+ * good enough to see the savings: replace them by what an ammeter says on the real board.
+ */
+
+#ifndef SOURCES_POWER_MANAGER_H_
+#define SOURCES_POWER_MANAGER_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+/*
+ * Typical supply current of each state (uA)
+ * Run: between 45 and 180 MHz (clock_governor.h), peripherals on
+ * Sleep: the same, core clock gated
+ * Stop: low-power regulator, flash in deep power-down
+ */
+#define POWER_RUN_UA     30000U
+#define POWER_SLEEP_UA   10000U
+#define POWER_STOP_UA    200U
+
+/* @Power_Wake */
+#define POWER_WAKE_PIN       0 // the wake-up pin (a byte on USART2 RX)
+#define POWER_WAKE_TIMEOUT   1 // MaxMs spent in Stop
+#define POWER_WAKE_OTHER     2 // some other interrupt (it is serviced at Critical_Exit)
+
+typedef struct{
+	GPIO_RegDef_t *pWakeGPIOx; // wake-up pin (falling edge), e.g. the USART2 RX pin
+	uint8_t WakePinNumber;
+	uint8_t WakeIRQ;           // EXTIx_IRQ of that pin
+	uint32_t WakeupMs;         // RTC wakeup period: < IWDG timeout, with margin
+} Power_Config_t;
+
+typedef struct{
+	Power_Config_t Power_Config;
+
+	/* Accounting */
+	uint64_t SleepUs;          // time in Sleep (Timestamp_Us)
+	uint64_t StopMs;           // time in Stop (RTC)
+	uint32_t Sleeps;
+	uint32_t Stops;
+	uint32_t StopWakeups;      // RTC wakeups inside Stop (one IWDG refresh each)
+} Power_Handle_t;
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+/*
+ * RTC + wakeup timer, wake-up pin on its EXTI line (masked until Stop), counters at 0.
+ * Returns @RTC_Status. After Timestamp_Init (RTC_Init uses deadlines).
+ */
+uint8_t Power_Init(Power_Handle_t *pPowerHandle);
+
+// Interrupts masked: WFI until the next interrupt (which stays pending)
+void Power_Sleep(Power_Handle_t *pPowerHandle);
+
+/*
+ * Interrupts masked: Stop mode until the wake-up pin, another interrupt, or MaxMs.
+ * Returns @Power_Wake. SYSCLK is HSI 16 MHz afterwards: restore the clock before Critical_Exit.
+ */
+uint8_t Power_Stop(Power_Handle_t *pPowerHandle, uint32_t MaxMs);
+
+// Call from the wake-up pin's EXTIx_IRQHandler (the edge only matters in Stop mode)
+void Power_WakeIRQHandling(Power_Handle_t *pPowerHandle);
+
+// Run = since boot minus Sleep (Timestamp_Us), then the weighted average of the three (uA)
+uint64_t Power_GetRunUs(Power_Handle_t *pPowerHandle);
+uint32_t Power_GetAverageUa(Power_Handle_t *pPowerHandle);
+
+#endif /* SOURCES_POWER_MANAGER_H_ */
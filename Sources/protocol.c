@@ -0,0 +1,146 @@
+/*
+ * protocol.c
+ *
+ *  Created on: 2026/2/7
+ *      Author: Yuheng
+ */
+#include "protocol.h"
+#include "cobs.h"
+#include "stm32f446xx.h"
+#include "stm32f446xx_crc_driver.h"
+#include <stdint.h>
+
+/*
+ * [Previously] a bit-by-bit software loop here.
+ * The CRC unit gives the same result (see stm32f446xx_crc_driver.h) for a fraction of the cycles,
+ * and the driver falls back to its own software copy whenever the unit is busy.
+ *
+ * The unit holds ONE running CRC, and two tasks use it: the Log task encodes frames, the Control
+ * task (higher priority) decodes them. Control preempting a frame half fed into CRC_DR would
+ * reset it under the Log task's feet (a frame sent with a wrong CRC).
+ * Interrupts are off for the whole frame instead: at most PROTOCOL_MAX_FRAME bytes, a few
+ * hundred cycles. (The image CRC needs no guard: only Control runs it, nothing above it uses the unit.)
+ */
+uint32_t Protocol_CRC32(const uint8_t *pData, uint32_t Len){
+	uint32_t state = Critical_Enter();
+	uint32_t crc = CRC_Calculate(pData, Len);
+	Critical_Exit(state);
+	return crc;
+}
+
+void Protocol_DecoderInit(Protocol_Decoder_t *pDecoder){
+	pDecoder->Len = 0;
+	pDecoder->Overflow = RESET;
+	pDecoder->BadFrames = 0;
+}
+
+uint8_t Protocol_ProcessByte(Protocol_Decoder_t *pDecoder, uint8_t Byte, Protocol_Packet_t *pPacket){
+	/*
+	 * ==========================================
+	 * 	1. Not the delimiter: just collect it
+	 * ==========================================
+	 */
+	if (Byte != 0x00){
+		if (pDecoder->Len < sizeof(pDecoder->Buffer)){
+			pDecoder->Buffer[pDecoder->Len++] = Byte;
+		}
+		else{
+			pDecoder->Overflow = SET; // too long for any valid packet
+		}
+		return PROTOCOL_RESULT_NONE;
+	}
+
+	/*
+	 * ==========================================
+	 * 	2. Delimiter: one frame is complete
+	 * ==========================================
+	 */
+	uint16_t frame_len = pDecoder->Len;
+	uint8_t overflow = pDecoder->Overflow;
+
+	// Whatever happens below, the next byte starts a new frame
+	pDecoder->Len = 0;
+	pDecoder->Overflow = RESET;
+
+	if (frame_len == 0){
+		return PROTOCOL_RESULT_NONE; // back-to-back delimiters (e.g. the PC flushing the line)
+	}
+
+	uint8_t raw[PROTOCOL_MAX_PACKET];
+	uint16_t raw_len = overflow ? 0 : COBS_Decode(pDecoder->Buffer, frame_len, raw, sizeof(raw));
+
+	// Shortest valid packet: header + CRC, no payload
+	if (raw_len < (PROTOCOL_HEADER_LEN + PROTOCOL_CRC_LEN)){
+		pDecoder->BadFrames++;
+		return PROTOCOL_RESULT_BAD_FRAME;
+	}
+
+	uint8_t payload_len = raw[2];
+	if ((payload_len > PROTOCOL_MAX_PAYLOAD) ||
+		(raw_len != (PROTOCOL_HEADER_LEN + payload_len + PROTOCOL_CRC_LEN))){
+		pDecoder->BadFrames++;
+		return PROTOCOL_RESULT_BAD_FRAME;
+	}
+
+	pPacket->Opcode = raw[0];
+	pPacket->Seq = raw[1];
+	pPacket->Len = payload_len;
+
+	/*
+	 * ==========================================
+	 * 	3. CRC check
+	 * ==========================================
+	 * Opcode/Seq are still handed back on a CRC failure so the caller can NACK it:
+	 * they might be the corrupted bytes, but the PC only uses the NACK to resend sooner,
+	 * its own timeout still covers the case where they were wrong.
+	 */
+	uint16_t crc_pos = PROTOCOL_HEADER_LEN + payload_len;
+	uint32_t received_crc = (uint32_t)raw[crc_pos]
+			| ((uint32_t)raw[crc_pos + 1] << 8)
+			| ((uint32_t)raw[crc_pos + 2] << 16)
+			| ((uint32_t)raw[crc_pos + 3] << 24);
+
+	if (Protocol_CRC32(raw, crc_pos) != received_crc){
+		pDecoder->BadFrames++;
+		pPacket->Len = 0;
+		return PROTOCOL_RESULT_BAD_CRC;
+	}
+
+	for (uint8_t i = 0; i < payload_len; i++){
+		pPacket->Payload[i] = raw[PROTOCOL_HEADER_LEN + i];
+	}
+
+	return PROTOCOL_RESULT_PACKET;
+}
+
+uint16_t Protocol_Encode(const Protocol_Packet_t *pPacket, uint8_t *pFrame, uint16_t MaxLen){
+	uint8_t raw[PROTOCOL_MAX_PACKET];
+
+	if (pPacket->Len > PROTOCOL_MAX_PAYLOAD){
+		return 0;
+	}
+
+	// 1. Header + payload
+	raw[0] = pPacket->Opcode;
+	raw[1] = pPacket->Seq;
+	raw[2] = pPacket->Len;
+	for (uint8_t i = 0; i < pPacket->Len; i++){
+		raw[PROTOCOL_HEADER_LEN + i] = pPacket->Payload[i];
+	}
+
+	// 2. CRC over everything before it
+	uint16_t crc_pos = PROTOCOL_HEADER_LEN + pPacket->Len;
+	Protocol_PutU32(&raw[crc_pos], Protocol_CRC32(raw, crc_pos));
+
+	// 3. COBS, leaving one byte for the delimiter
+	if (MaxLen < 2){
+		return 0;
+	}
+	uint16_t frame_len = COBS_Encode(raw, crc_pos + PROTOCOL_CRC_LEN, pFrame, MaxLen - 1);
+	if (frame_len == 0){
+		return 0;
+	}
+
+	pFrame[frame_len++] = 0x00;
+	return frame_len;
+}
@@ -0,0 +1,171 @@
+/*
+ * protocol.h
+ *
+ *  Created on: 2026/2/7
+ *      Author: Yuheng
+ *
+ * Description:
+ * Binary command protocol between the PC (script.py) and the feeder.
+ *
+ * [Previously] one ASCII byte per command ('F', 'H') and free-text replies,
+ * so the PC had to wait for "Complete" in a text line before it could send anything else,
+ * and a feed could not carry any parameter (portion, speed...).
+ *
+ * ==========================================
+ * 		Packet Layout (before framing)
+ * ==========================================
+ * | Opcode | Seq | Len | Payload (Len bytes) | CRC-32 (4 bytes, little-endian) |
+ *
+ * - Opcode: what to do (@Protocol_Opcodes)
+ * - Seq:    chosen by the sender, echoed back in the ACK / NACK.
+ *           This is what allows pipelining: the PC can fire many commands in a row
+ *           and match every reply to its command afterwards.
+ * - Len:    payload length, 0 - PROTOCOL_MAX_PAYLOAD
+ * - CRC:    covers Opcode ... last Payload byte
+ *
+ * ==========================================
+ * 		Framing (on the wire)
+ * ==========================================
+ * COBS(packet) + 0x00
+ * COBS removes every 0x00 from the packet, so 0x00 can only mean "end of frame".
+ * A receiver that starts listening in the middle of a frame (or loses a byte)
+ * re-synchronizes at the next 0x00 by itself.
+ *
+ * ==========================================
+ * 		CRC-32
+ * ==========================================
+ * Polynomial 0x04C11DB7, initial value 0xFFFFFFFF, no reflection, no final XOR.
+ * Same algorithm as the CRC calculation unit of the STM32F446 (RM0390 Chapter 12):
+ * whole 32-bit (little-endian) words first, MSB first, then the 0-3 leftover bytes one by one.
+ * Computed by the CRC unit (stm32f446xx_crc_driver), so protocol.c is only usable from main().
+ *
+ * All multi-byte fields are little-endian (native Cortex-M4 byte order).
+ */
+
+#ifndef SOURCES_PROTOCOL_H_
+#define SOURCES_PROTOCOL_H_
+
+#include <stdint.h>
+#include "cobs.h"
+
+/*
+ * ==========================================
+ * 1. Sizes
+ * ==========================================
+ */
+#define PROTOCOL_MAX_PAYLOAD      64U
+#define PROTOCOL_HEADER_LEN       3U   // Opcode + Seq + Len
+#define PROTOCOL_CRC_LEN          4U
+#define PROTOCOL_MAX_PACKET       (PROTOCOL_HEADER_LEN + PROTOCOL_MAX_PAYLOAD + PROTOCOL_CRC_LEN)
+#define PROTOCOL_MAX_FRAME        (COBS_MAX_ENCODED_LEN(PROTOCOL_MAX_PACKET) + 1U) // + 0x00 delimiter
+
+/*
+ * ==========================================
+ * 2. Opcodes
+ * ==========================================
+ * @Protocol_Opcodes
+ * 0x01 - 0x7F: PC -> feeder (commands)
+ * 0x80 - 0xBF: feeder -> PC (replies, Seq = Seq of the command)
+ * 0xC0 - 0xFF: feeder -> PC (events,  Seq = feeder's own counter)
+ */
+#define PROTOCOL_OP_PING          0x01 // payload: none                -> ACK {version}
+#define PROTOCOL_OP_FEED          0x02 // payload: u16 steps, u16 speed (steps/s) [, u8 priority] -> ACK {u8 jobs ahead} / NACK FULL
+#define PROTOCOL_OP_SET_SCHEDULE  0x03 // payload: N x {u16 minute_of_day, u16 steps} -> ACK
+#define PROTOCOL_OP_GET_STATUS    0x04 // payload: none                -> ACK {status}
+#define PROTOCOL_OP_GET_IMAGE_CRC 0x05 // payload: none                -> ACK {u32 crc, u32 length} / NACK BUSY
+#define PROTOCOL_OP_CANCEL        0x06 // payload: u8 Seq of a FEED      -> ACK / NACK NOT_FOUND
+#define PROTOCOL_OP_FLUSH         0x07 // payload: none                -> ACK {u8 jobs cancelled}
+#define PROTOCOL_OP_QUEUE_STATUS  0x08 // payload: none                -> ACK {queue, see main.c}
+
+#define PROTOCOL_OP_ACK           0x80 // payload: command specific reply data (may be empty)
+#define PROTOCOL_OP_NACK          0x81 // payload: u8 opcode of the command, u8 @Protocol_Errors
+
+#define PROTOCOL_EVT_BOOT         0xC0 // payload: u8 @Protocol_ResetFlags
+#define PROTOCOL_EVT_FEED_DONE    0xC1 // payload: u8 Seq of the FEED command, u8 (0: done, 1: cancelled, 2: stuck, feeder in FAULT)
+#define PROTOCOL_EVT_LOG          0xC2 // payload: whole log records (see log.h), decoded by script.py
+#define PROTOCOL_EVT_FEED_STARTED 0xC3 // payload: u8 Seq of the FEED command now dispensing
+
+/*
+ * Reported by PING. Bumped whenever a message changes meaning, so a host script can refuse
+ * a firmware it does not understand:
+ * 1: first binary protocol
+ * 2: EVT_FEED_DONE result 2 = stuck, feeder in FAULT; GET_STATUS byte 0 = 2 in FAULT
+ */
+#define PROTOCOL_VERSION          2
+
+/* @Protocol_Errors (NACK reason) */
+#define PROTOCOL_ERR_CRC          1 // frame arrived, but corrupted
+#define PROTOCOL_ERR_OPCODE       2 // unknown opcode
+#define PROTOCOL_ERR_LENGTH       3 // payload length does not fit the opcode
+#define PROTOCOL_ERR_RANGE        4 // a parameter is out of range
+#define PROTOCOL_ERR_BUSY         5 // resource not ready yet (e.g. image CRC still running)
+#define PROTOCOL_ERR_FULL         6 // feed queue full
+#define PROTOCOL_ERR_NOT_FOUND    7 // CANCEL: no such job
+
+/* @Protocol_ResetFlags (EVT_BOOT payload) */
+#define PROTOCOL_RESET_IWDG       (1U << 0)
+
+/*
+ * ==========================================
+ * 3. Structures
+ * ==========================================
+ */
+typedef struct{
+	uint8_t Opcode;
+	uint8_t Seq;
+	uint8_t Len;
+	uint8_t Payload[PROTOCOL_MAX_PAYLOAD];
+} Protocol_Packet_t;
+
+/*
+ * Stream decoder: collects bytes until a 0x00 delimiter, then decodes the frame.
+ * One per input stream (only accessed from main(), never from an ISR).
+ */
+typedef struct{
+	uint8_t Buffer[COBS_MAX_ENCODED_LEN(PROTOCOL_MAX_PACKET)];
+	uint16_t Len;
+	uint8_t Overflow;         // SET: current frame is too long, drop everything until the next 0x00
+	uint32_t BadFrames;       // statistics: COBS / length / CRC failures
+} Protocol_Decoder_t;
+
+/* @Protocol_Result (Protocol_ProcessByte) */
+#define PROTOCOL_RESULT_NONE      0 // frame not complete yet
+#define PROTOCOL_RESULT_PACKET    1 // *pPacket holds a valid packet
+#define PROTOCOL_RESULT_BAD_CRC   2 // *pPacket holds Opcode/Seq of a packet that failed the CRC
+#define PROTOCOL_RESULT_BAD_FRAME 3 // garbage / truncated frame, nothing to reply to
+
+/*
+ * ==========================================
+ * 		4. Function Prototypes
+ * ==========================================
+ */
+void Protocol_DecoderInit(Protocol_Decoder_t *pDecoder);
+uint8_t Protocol_ProcessByte(Protocol_Decoder_t *pDecoder, uint8_t Byte, Protocol_Packet_t *pPacket);
+
+/*
+ * Packet -> wire frame (COBS + 0x00 delimiter) in pFrame.
+ * Returns the frame length, 0 if the packet is invalid or pFrame is too small.
+ * PROTOCOL_MAX_FRAME bytes are always enough.
+ */
+uint16_t Protocol_Encode(const Protocol_Packet_t *pPacket, uint8_t *pFrame, uint16_t MaxLen);
+
+uint32_t Protocol_CRC32(const uint8_t *pData, uint32_t Len);
+
+/* Little-endian field helpers */
+static inline uint16_t Protocol_GetU16(const uint8_t *p){
+	return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static inline void Protocol_PutU16(uint8_t *p, uint16_t Value){
+	p[0] = (uint8_t)(Value & 0xFF);
+	p[1] = (uint8_t)(Value >> 8);
+}
+
+static inline void Protocol_PutU32(uint8_t *p, uint32_t Value){
+	p[0] = (uint8_t)(Value & 0xFF);
+	p[1] = (uint8_t)((Value >> 8) & 0xFF);
+	p[2] = (uint8_t)((Value >> 16) & 0xFF);
+	p[3] = (uint8_t)(Value >> 24);
+}
+
+#endif /* SOURCES_PROTOCOL_H_ */
@@ -1,22 +1,273 @@
+import os     # library to locate the log dictionary next to the build output
+import re     # library for regular expressions (C format string -> Python)
 import serial # library for serial communication (UART)
+import struct # library to pack / unpack binary fields (little-endian u16 ...)
 import time   # library for delays and timing
 
+# ==========================================
+# 0. Binary Protocol (must match protocol.h)
+# ==========================================
+# [Previously] single ASCII bytes ('F', 'H') and free-text replies ("Complete" in response).
+# Now every message is a packet:
+#   | opcode | seq | len | payload | crc32 (little-endian) |
+# framed with COBS + a 0x00 delimiter on the wire.
+# Every command gets exactly one ACK / NACK carrying its seq,
+# so we can send a whole batch in ONE write and match the replies afterwards (pipelining).
+
+OP_PING         = 0x01
+OP_FEED         = 0x02 # payload: u16 steps, u16 speed (steps/s) [, u8 priority] -> ACK {u8 jobs ahead}
+OP_SET_SCHEDULE = 0x03 # payload: N x {u16 minute_of_day, u16 steps}
+OP_GET_STATUS   = 0x04
+OP_GET_IMAGE_CRC = 0x05 # reply: u32 crc, u32 length of the firmware in Flash
+OP_CANCEL       = 0x06 # payload: u8 seq of a FEED (waiting or running)
+OP_FLUSH        = 0x07 # cancel everything, reply: u8 jobs cancelled
+OP_QUEUE_STATUS = 0x08 # reply: u8 running, u8 seq, u16 steps left, u8 n, n x {u8 seq, u8 prio, u16 steps, u16 speed}
+
+OP_ACK          = 0x80
+OP_NACK         = 0x81 # payload: u8 opcode, u8 error
+
+EVT_BOOT        = 0xC0 # payload: u8 reset flags
+EVT_FEED_DONE   = 0xC1 # payload: u8 seq of the FEED command, u8 (0: done, 1: cancelled, 2: stuck, feeder in FAULT)
+EVT_LOG         = 0xC2 # payload: deferred log records (see log.h)
+EVT_FEED_STARTED = 0xC3 # payload: u8 seq of the FEED command
+
+PROTOCOL_VERSION = 2 # PING reply, must match protocol.h
+
+ERRORS = {1: "bad CRC", 2: "unknown opcode", 3: "bad length", 4: "out of range", 5: "busy",
+          6: "feed queue full", 7: "no such job"}
+PRIORITIES = {'LOW': 0, 'NORMAL': 1, 'HIGH': 2, 'URGENT': 3}
+
+DEFAULT_STEPS = 666 # same portion as the old 'F' command (2 seconds at 333 steps/s)
+DEFAULT_SPEED = 1200 # cruise steps per second, the firmware ramps up / down (old fixed PWM: 333, no ramp)
+
+
+# ==========================================
+# 0.1 Deferred Log Decoder (must match log.h)
+# ==========================================
+# The firmware only sends a log ID + raw arguments, the format strings stay on the PC:
+# the build dumps them (objcopy) into FelineGuard.logdict, and a log ID is simply
+# the offset of its string in that file. Each entry reads "<level>|<file>:<line>|<format>".
+LOG_DICTIONARY = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Debug', 'FelineGuard.logdict')
+LOG_LEVELS = {'I': 'INFO', 'W': 'WARN', 'E': 'ERROR'}
+LOG_CONVERSION = re.compile(r'%([-+ #0]*\d*)(?:hh|h|ll|l)?([diuxXc%])')
+
+
+def load_log_dictionary(path):
+    try:
+        with open(path, 'rb') as f:
+            return f.read()
+    except OSError:
+        print(f"[Warning] No log dictionary at {path}, logs will be shown as raw IDs")
+        return None
+
+
+def render_log(dictionary, log_id, args):
+    if dictionary is None or log_id >= len(dictionary):
+        return f"[LOG 0x{log_id:04X}] {' '.join(f'0x{a:08X}' for a in args)}"
+
+    entry = dictionary[log_id:dictionary.index(b'\0', log_id)].decode('utf-8', errors='replace')
+    level, location, fmt = entry.split('|', 2)
+    remaining = list(args)
+
+    def convert(match):
+        # C -> Python: drop the length modifier, give %d / %i their sign back (args are raw u32)
+        flags, conversion = match.group(1), match.group(2)
+        if conversion == '%':
+            return '%'
+        value = remaining.pop(0) if remaining else 0
+        if conversion in 'di':
+            value = value - (1 << 32) if value & 0x80000000 else value
+            conversion = 'd'
+        return ('%' + flags + conversion) % value
+
+    return f"[{LOG_LEVELS.get(level, level)}] {LOG_CONVERSION.sub(convert, fmt)}  ({location})"
+
+
+def decode_log_records(payload):
+    # Yields (log_id, seq, args) for every record of an EVT_LOG payload
+    offset = 0
+    while offset + 4 <= len(payload):
+        header = struct.unpack_from('<I', payload, offset)[0]
+        nargs = header >> 24
+        args = struct.unpack_from(f'<{nargs}I', payload, offset + 4)
+        yield header & 0xFFFF, (header >> 16) & 0xFF, args
+        offset += 4 + 4 * nargs
+
+
+log_dictionary = load_log_dictionary(LOG_DICTIONARY)
+last_log_seq = None
+
+# FEED jobs accepted by the STM32 and not finished yet: seq -> (steps, speed)
+pending_jobs = {}
+
+
+def crc32_stm32(data):
+    # Polynomial 0x04C11DB7, init 0xFFFFFFFF, no reflection, no final XOR.
+    # Same as the STM32 CRC unit: whole little-endian words first, then the leftover bytes.
+    crc = 0xFFFFFFFF
+    whole = len(data) - (len(data) % 4)
+    for i in range(0, whole, 4):
+        crc ^= struct.unpack_from('<I', data, i)[0]
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7) if (crc & 0x80000000) else (crc << 1)
+            crc &= 0xFFFFFFFF
+    for byte in data[whole:]:
+        crc ^= byte << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x04C11DB7) if (crc & 0x80000000) else (crc << 1)
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray([0]) # placeholder for the first code byte
+    code_index = 0
+    code = 1
+    for byte in data:
+        if byte == 0:
+            out[code_index] = code
+            code_index = len(out)
+            out.append(0)
+            code = 1
+        else:
+            out.append(byte)
+            code += 1
+            if code == 0xFF: # block full (254 data bytes, no zero follows)
+                out[code_index] = code
+                code_index = len(out)
+                out.append(0)
+                code = 1
+    out[code_index] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None # malformed frame
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def build_frame(opcode, seq, payload=b''):
+    packet = bytes([opcode, seq & 0xFF, len(payload)]) + payload
+    packet += struct.pack('<I', crc32_stm32(packet))
+    return cobs_encode(packet) + b'\x00'
+
+
+class Link:
+    # Keeps the seq counter and the bytes of a frame that arrived only partially
+    def __init__(self, ser):
+        self.ser = ser
+        self.seq = 0
+        self.rx = bytearray()
+
+    def send(self, commands):
+        # commands: list of (opcode, payload) -> sent in ONE write, returns their seq numbers
+        frames = b''
+        seqs = []
+        for opcode, payload in commands:
+            self.seq = (self.seq + 1) & 0xFF
+            seqs.append(self.seq)
+            frames += build_frame(opcode, self.seq, payload)
+        # The STM32 may be in Stop mode between feeds: a first 0x00 wakes it up and is lost
+        # (or garbled) while its clock comes back (< 1 ms), a second one clears its decoder
+        self.ser.write(b'\x00')
+        time.sleep(0.002)
+        self.ser.write(b'\x00' + frames)
+        return seqs
+
+    def read_packet(self, timeout):
+        # Returns (opcode, seq, payload), or None on timeout
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            chunk = self.ser.read(self.ser.in_waiting or 1)
+            self.rx += chunk
+            while b'\x00' in self.rx:
+                frame, _, rest = self.rx.partition(b'\x00')
+                self.rx = bytearray(rest)
+                packet = cobs_decode(bytes(frame)) if frame else None
+                if packet is None or len(packet) < 7 or len(packet) != 7 + packet[2]:
+                    continue # garbage between frames (e.g. noise at power-up)
+                body, crc = packet[:-4], struct.unpack('<I', packet[-4:])[0]
+                if crc32_stm32(body) != crc:
+                    print("[Warning] Dropped a frame with a bad CRC")
+                    continue
+                return body[0], body[1], body[3:]
+        return None
+
+    def wait_replies(self, seqs, timeout = 1):
+        # Collects the ACK / NACK for every seq in seqs, events are printed on the way
+        replies = {}
+        deadline = time.time() + timeout
+        while len(replies) < len(seqs) and time.time() < deadline:
+            packet = self.read_packet(deadline - time.time())
+            if packet is None:
+                break
+            opcode, seq, payload = packet
+            if opcode in (OP_ACK, OP_NACK) and seq in seqs:
+                replies[seq] = (opcode, payload)
+            else:
+                print_event(opcode, payload)
+        return replies
+
+
+def print_event(opcode, payload):
+    global last_log_seq
+    if opcode == EVT_LOG:
+        for log_id, seq, args in decode_log_records(payload):
+            if last_log_seq is not None and seq != (last_log_seq + 1) & 0xFF:
+                print(f"[Warning] {(seq - last_log_seq - 1) & 0xFF} log records lost (STM32 log ring was full)")
+            last_log_seq = seq
+            print(f"[STM32] {render_log(log_dictionary, log_id, args)}")
+    elif opcode == EVT_BOOT:
+        last_log_seq = None # the log sequence restarts with the firmware
+        print("[STM32]: Boot" + (" (recovered from a WATCHDOG reset!)" if payload and payload[0] & 1 else ""))
+    elif opcode == EVT_FEED_STARTED:
+        print(f"[STM32]: Feeding started (command #{payload[0]})")
+    elif opcode == EVT_FEED_DONE:
+        pending_jobs.pop(payload[0], None)
+        if len(payload) > 1 and payload[1] == 1:
+            print(f"[STM32]: Feed cancelled (command #{payload[0]})")
+        elif len(payload) > 1 and payload[1] == 2:
+            print(f"[STM32]: Feed FAILED (command #{payload[0]}), the motor stayed stuck: FAULT, send K (flush) to clear it")
+        else:
+            print(f"[STM32]: Feed Complete (command #{payload[0]})")
+    else:
+        print(f"[STM32]: Unexpected packet 0x{opcode:02X} {payload.hex()}")
+
+
+def describe(reply):
+    if reply is None:
+        return "no reply (timeout)"
+    opcode, payload = reply
+    if opcode == OP_ACK:
+        return "ACK"
+    return f"NACK ({ERRORS.get(payload[1], payload[1])})"
+
 # ==========================================
 # 1. Configuration & Connection
 # ==========================================
-try: 
+try:
     # Initialize the Serial Connection
     # 'COM3': the physical port my STM32 is connected to (can check in device manager)
     # 115200: Baud rate (Speed). Must match the STM32 code exactly
-    # timeout = 1: Safety Feature. If we try to read and nothing comes,
-    #              give up after 1 second. Prevents the program from freezing forever
-    ser = serial.Serial('COM3', 115200, timeout = 1)
+    # timeout = 0.05: reads return quickly, the protocol functions handle their own deadlines
+    ser = serial.Serial('COM3', 115200, timeout = 0.05)
     print(f"Successfully connected to {ser.portstr}")
 except Exception as e:
     # if the cable is unplugged or COM port is busy, print the error and stop.
     print(f"Error connecting to serial port: {e}")
     exit()
 
+link = Link(ser)
+
 # ==========================================
 # 2. Automated Handshake (Startup Check)
 # ==========================================
@@ -27,21 +278,23 @@ system_online = False
 # [Critical Step] -> "clear the mailbox"
 # when hardware powers up, it might send garbage bytes due to hardware reasons.
 # we flush the buffer to ensure we are listening to fresh data.
+# (a lone 0x00 also resets the STM32's frame decoder, in case it holds half a frame)
 ser.reset_input_buffer() # serial library function to clear the buffer
+ser.write(b'\x00')
 
 # [Retry] mechanism: try 3 times in case the first message gets lost.
 for i in range(3):
-    ser.write(b'H') # send 'H' (Handshake request) to STM32
+    seqs = link.send([(OP_PING, b'')])
     print(f"Ping attemp {i + 1}...")
 
-    # Read the response
-    # .decode(): Convert computer bytes to human text
-    # .strip(): Remove invisible newline characters (\r\n)
-    response = ser.readline().decode('utf-8', errors='ignore').strip()
-
-    # If STM32 replies with the keyword "Ready"
-    if "Ready" in response: # STM32 says it is ready
-        print(f"[STM32]: {response}")
+    reply = link.wait_replies(seqs).get(seqs[0])
+    if reply is not None and reply[0] == OP_ACK: # STM32 says it is ready
+        print(f"[STM32]: Ready (protocol version {reply[1][0]})")
+        if reply[1][0] != PROTOCOL_VERSION:
+            # the same bytes would mean something else: better stop than misread them
+            print(f"Error: this script speaks protocol version {PROTOCOL_VERSION}. Flash the matching firmware.")
+            ser.close()
+            exit()
         system_online = True
         break # Handshake is successful, break out of the re-try loop
 
@@ -56,60 +309,148 @@ print("Connection Verified! Entering Control Loop.")
 # ==========================================
 # 3. Main Control Loop
 # ==========================================
+HELP = """Commands:
+  F [steps] [speed] [prio]   feed (default 666 steps at 1200 steps/s, prio LOW/NORMAL/HIGH/URGENT)
+  M n [steps] [speed]        n portions in ONE write (several cats), dispensed back-to-back
+  W                          wait until every queued feed is done
+  J                          feed queue status
+  X seq                      cancel a feed (waiting or running)
+  K                          cancel everything (flush the queue, stop the motor)
+  H                          ping
+  S                          status
+  V                          firmware image CRC (which build is running?)
+  C hh:mm=steps ...          set the feeding schedule (e.g. C 07:30=666 18:00=800)
+  P n                        send n pings in ONE write (pipelining test)
+  Q                          quit"""
+
 try:
+    print(HELP)
     while True:
         # Prompt user for input.
         # .upper() handles 'f' and 'F' automatically.
-        user_input = input("Enter command (F to feed cat, H to ping, Q to quit): ").upper()
-
-        # Reset Buffer before using ser.write(b...) to send any command to STM32
-        # this clears any culmulated "garbage messages" or "history messages"
-        ser.reset_input_buffer()
+        words = input("Enter command: ").upper().split()
+        if not words:
+            continue
+        command = words[0]
 
         # --- QUIT LOGIC ---
-        if user_input == 'Q':
+        if command == 'Q':
             print("Exiting program...")
-            break # use break instead of exit() so it will execute ser.close() below to release resources 
-        
-        # --- FEED LOGIC (Blocking) ---
-        elif user_input == 'F':
-            ser.write(b'F') # send byte 'F'
-            print(f"[PC] Sent: F (Feeding...)")
+            break # use break instead of exit() so it will execute ser.close() below to release resources
+
+        # --- FEED LOGIC ---
+        elif command in ('F', 'M'):
+            count = 1
+            if command == 'M':
+                count = int(words[1]) if len(words) > 1 else 2
+                words = words[1:]
+            steps = int(words[1]) if len(words) > 1 else DEFAULT_STEPS
+            speed = int(words[2]) if len(words) > 2 else DEFAULT_SPEED
+            payload = struct.pack('<HH', steps, speed)
+            if len(words) > 3:
+                payload += bytes([PRIORITIES.get(words[3], 1)])
+
+            # Every portion is its own job, all sent in ONE write: no waiting between them
+            seqs = link.send([(OP_FEED, payload)] * count)
+            replies = link.wait_replies(seqs)
+            for seq in seqs:
+                reply = replies.get(seq)
+                if reply is not None and reply[0] == OP_ACK:
+                    pending_jobs[seq] = (steps, speed)
+                    print(f"[PC] Feed #{seq}: {steps} steps at {speed} steps/s -> queued, {reply[1][0]} job(s) ahead")
+                else:
+                    print(f"[PC] Feed #{seq} -> {describe(reply)}")
+
+        # --- WAIT FOR THE QUEUE ---
+        elif command == 'W':
+            # Some margin over the total dispense time of everything still pending
+            deadline = time.time() + sum(st / sp for st, sp in pending_jobs.values()) + 2
+            while pending_jobs and time.time() < deadline:
+                packet = link.read_packet(deadline - time.time())
+                if packet is not None:
+                    print_event(packet[0], packet[2])
+            if pending_jobs:
+                # this executes only if the time ran out (Timeout)
+                print(f"[Warning] Still waiting for feed(s) {sorted(pending_jobs)} (Timeout)")
+            else:
+                print("[PC] All feeds done.")
+
+        # --- QUEUE STATUS ---
+        elif command == 'J':
+            seqs = link.send([(OP_QUEUE_STATUS, b'')])
+            reply = link.wait_replies(seqs).get(seqs[0])
+            if reply is not None and reply[0] == OP_ACK:
+                running, seq, remaining, waiting = struct.unpack_from('<BBHB', reply[1])
+                print(f"[STM32]: " + (f"Dispensing #{seq}, {remaining} steps left" if running else "Idle")
+                      + f", {waiting} job(s) waiting")
+                for i in range(waiting):
+                    seq, prio, steps, speed = struct.unpack_from('<BBHH', reply[1], 5 + 6 * i)
+                    print(f"           #{seq}: {steps} steps at {speed} steps/s, priority {prio}")
+            else:
+                print(f"[PC] Queue status -> {describe(reply)}")
 
-            print("Waiting here for confirmation from STM32...")
+        # --- CANCEL / FLUSH ---
+        elif command == 'X' and len(words) > 1:
+            seqs = link.send([(OP_CANCEL, bytes([int(words[1]) & 0xFF]))])
+            print(f"[PC] Cancel #{words[1]} -> {describe(link.wait_replies(seqs).get(seqs[0]))}")
 
-            # Start a timer to prevent deadlocks
+        elif command == 'K':
+            seqs = link.send([(OP_FLUSH, b'')])
+            reply = link.wait_replies(seqs).get(seqs[0])
+            if reply is not None and reply[0] == OP_ACK:
+                print(f"[PC] Flush -> {reply[1][0]} job(s) cancelled")
+            else:
+                print(f"[PC] Flush -> {describe(reply)}")
+
+        # --- PING LOGIC ---
+        elif command == 'H':
             start_time = time.time()
+            seqs = link.send([(OP_PING, b'')])
+            reply = link.wait_replies(seqs).get(seqs[0])
+            print(f"[PC] Ping -> {describe(reply)} in {(time.time() - start_time) * 1000:.1f} ms")
 
-            # Keep checking for response for up to 5 seconds
-            while (time.time() -  start_time) < 5: 
-                response = ser.readline().decode('utf-8', errors='ignore').strip()
-                if response:
-                    print(f"[STM32]: {response}")
-                    if "Complete" in response:
-                        break
+        # --- STATUS LOGIC ---
+        elif command == 'S':
+            seqs = link.send([(OP_GET_STATUS, b'')])
+            reply = link.wait_replies(seqs).get(seqs[0])
+            if reply is not None and reply[0] == OP_ACK and len(reply[1]) == 8:
+                feeding, entries, bad_frames, dropped, uart_errors = struct.unpack('<BBHHH', reply[1])
+                print(f"[STM32]: {('Idle', 'Feeding', 'FAULT')[min(feeding, 2)]}, {entries} schedule entries, "
+                      f"{bad_frames} bad frames, {dropped} RX bytes dropped, {uart_errors} UART errors")
             else:
-                # this executes only if the 5 seconds ran out (Timeout)
-                print("[Warning] No response received from STM32 (Timeout)")
-
-        # --- PING LOGIC (Non-Blocking / Fast Check) ---
-        elif user_input == 'H':
-            print("[PC] Sent: H (Ping)")
-            ser.write(b'H') # handshake
-
-            # [FIXED BUG HERE]
-            # Give the electrical signal time to travel and STM32 to process.
-            # Without this sleep, Python checks too fast and sees an empty buffer
-            time.sleep(0.1)
-
-            if ser.in_waiting: # Check: Is there data in the buffer?
-                response = ser.readline().decode('utf-8', errors='ignore').strip()
-                print(f"[STM32]: {response}")
+                print(f"[PC] Status -> {describe(reply)}")
+
+        # --- FIRMWARE IMAGE CRC ---
+        elif command == 'V':
+            seqs = link.send([(OP_GET_IMAGE_CRC, b'')])
+            reply = link.wait_replies(seqs).get(seqs[0])
+            if reply is not None and reply[0] == OP_ACK and len(reply[1]) == 8:
+                crc, length = struct.unpack('<II', reply[1])
+                print(f"[STM32]: Firmware image {length} bytes, CRC 0x{crc:08X}")
             else:
-                print("[Warning] No response. Connection might be lost.")
+                print(f"[PC] Image CRC -> {describe(reply)}")
+
+        # --- SCHEDULE LOGIC ---
+        elif command == 'C':
+            payload = b''
+            for entry in words[1:]:
+                hhmm, steps = entry.split('=')
+                hours, minutes = hhmm.split(':')
+                payload += struct.pack('<HH', int(hours) * 60 + int(minutes), int(steps))
+            seqs = link.send([(OP_SET_SCHEDULE, payload)])
+            print(f"[PC] Schedule ({len(words) - 1} entries) -> {describe(link.wait_replies(seqs).get(seqs[0]))}")
+
+        # --- PIPELINING TEST ---
+        elif command == 'P':
+            count = int(words[1]) if len(words) > 1 else 10
+            start_time = time.time()
+            seqs = link.send([(OP_PING, b'')] * count)
+            replies = link.wait_replies(seqs, timeout = 2)
+            print(f"[PC] {len(replies)}/{count} pings answered in {(time.time() - start_time) * 1000:.1f} ms")
+
         # --- INVALID INPUT ---
         else:
-            print("Invalid Command. Please enter 'F', 'H', or 'Q'.")
+            print(HELP)
 
 # ==========================================
 # 4. Safe Shutdown
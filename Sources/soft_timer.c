@@ -0,0 +1,174 @@
+/*
+ * soft_timer.c
+ *
+ *  Created on: 2026/2/22
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "soft_timer.h"
+#include <stdint.h>
+
+#define SOFTTIMER_SLOTS  (1U << SOFTTIMER_LEVEL_BITS)
+#define SOFTTIMER_MASK   (SOFTTIMER_SLOTS - 1U)
+
+// slot of Expiry at Level: its 6 bits of that level
+#define SOFTTIMER_SLOT(Expiry, Level)  (((Expiry) >> ((Level) * SOFTTIMER_LEVEL_BITS)) & SOFTTIMER_MASK)
+
+static SoftTimer_t *Wheel[SOFTTIMER_LEVELS][SOFTTIMER_SLOTS];
+static volatile uint32_t Clock;  // ticks counted by the ISR
+static uint32_t WheelTime;       // last tick the wheel was turned to (main only)
+
+static void SoftTimer_Unlink(SoftTimer_t *pTimer){
+	*pTimer->ppPrev = pTimer->pNext;
+	if (pTimer->pNext != 0){
+		pTimer->pNext->ppPrev = pTimer->ppPrev;
+	}
+	pTimer->pNext = 0;
+	pTimer->ppPrev = 0;
+}
+
+/*
+ * Into the slot that is turned (level 0) or cascaded (above) at the latest tick not after Expiry.
+ * Relative to the next tick the wheel will run: a timer already due goes into that slot.
+ * Called inside a critical section.
+ */
+static void SoftTimer_Insert(SoftTimer_t *pTimer){
+	uint32_t base = WheelTime + 1U;
+	uint32_t delta = pTimer->Expiry - base;
+	uint8_t level = 0;
+
+	if ((int32_t)delta < 0){
+		pTimer->Expiry = base; // late (main() behind the ISR clock): right away
+		delta = 0;
+	}
+	else if (delta > SOFTTIMER_MAX_DELAY){
+		pTimer->Expiry = base + SOFTTIMER_MAX_DELAY;
+		delta = SOFTTIMER_MAX_DELAY;
+	}
+
+	// level n holds the delays below 64^(n + 1)
+	while ((level < (SOFTTIMER_LEVELS - 1U)) && (delta >= (1UL << ((level + 1U) * SOFTTIMER_LEVEL_BITS)))){
+		level++;
+	}
+
+	SoftTimer_t **ppHead = &Wheel[level][SOFTTIMER_SLOT(pTimer->Expiry, level)];
+	pTimer->pNext = *ppHead;
+	pTimer->ppPrev = ppHead;
+	if (*ppHead != 0){
+		(*ppHead)->ppPrev = &pTimer->pNext;
+	}
+	*ppHead = pTimer;
+}
+
+/*
+ * Re-insert every timer of one slot of Level: they all expire within the next 64^Level ticks,
+ * so each one drops at least one level. Returns the slot index (0: the level above is due too).
+ */
+static uint32_t SoftTimer_Cascade(uint8_t Level, uint32_t Time){
+	uint32_t index = SOFTTIMER_SLOT(Time, Level);
+	uint32_t state = Critical_Enter();
+
+	SoftTimer_t *pTimer = Wheel[Level][index];
+	Wheel[Level][index] = 0;
+	while (pTimer != 0){
+		SoftTimer_t *pNext = pTimer->pNext;
+		SoftTimer_Insert(pTimer);
+		pTimer = pNext;
+	}
+
+	Critical_Exit(state);
+	return index;
+}
+
+// One tick: cascade if a level boundary is crossed, then fire the level 0 slot
+static void SoftTimer_RunTick(uint32_t Time){
+	if (SOFTTIMER_SLOT(Time, 0) == 0){
+		for (uint8_t level = 1; level < SOFTTIMER_LEVELS; level++){
+			if (SoftTimer_Cascade(level, Time) != 0){
+				break;
+			}
+		}
+	}
+
+	SoftTimer_t **ppHead = &Wheel[0][SOFTTIMER_SLOT(Time, 0)];
+	while (1){
+		/*
+		 * One timer at a time: a callback (or an ISR) may stop / start any timer,
+		 * including the next ones of this slot. Each one is taken out BEFORE its callback,
+		 * so a callback that restarts its own timer simply puts it back in.
+		 */
+		uint32_t state = Critical_Enter();
+		SoftTimer_t *pTimer = *ppHead;
+		if (pTimer == 0){
+			Critical_Exit(state);
+			break;
+		}
+
+		SoftTimer_Unlink(pTimer);
+		if (pTimer->Period != 0){
+			pTimer->Expiry += pTimer->Period;
+			SoftTimer_Insert(pTimer);
+		}
+		else{
+			pTimer->State = SOFTTIMER_STATE_IDLE;
+		}
+		Critical_Exit(state);
+
+		pTimer->Callback(pTimer);
+	}
+}
+
+void SoftTimer_Init(void){
+	for (uint8_t level = 0; level < SOFTTIMER_LEVELS; level++){
+		for (uint8_t slot = 0; slot < SOFTTIMER_SLOTS; slot++){
+			Wheel[level][slot] = 0;
+		}
+	}
+	Clock = 0;
+	WheelTime = 0;
+}
+
+void SoftTimer_Start(SoftTimer_t *pTimer, uint32_t Delay, uint32_t Period){
+	uint32_t state = Critical_Enter();
+
+	if (pTimer->State == SOFTTIMER_STATE_ACTIVE){
+		SoftTimer_Unlink(pTimer);
+	}
+
+	pTimer->Expiry = Clock + ((Delay != 0) ? Delay : 1U);
+	pTimer->Period = (Period <= SOFTTIMER_MAX_DELAY) ? Period : SOFTTIMER_MAX_DELAY;
+	pTimer->State = SOFTTIMER_STATE_ACTIVE;
+	SoftTimer_Insert(pTimer);
+
+	Critical_Exit(state);
+}
+
+void SoftTimer_Stop(SoftTimer_t *pTimer){
+	uint32_t state = Critical_Enter();
+
+	if (pTimer->State == SOFTTIMER_STATE_ACTIVE){
+		SoftTimer_Unlink(pTimer);
+		pTimer->State = SOFTTIMER_STATE_IDLE;
+	}
+
+	Critical_Exit(state);
+}
+
+uint8_t SoftTimer_IsActive(SoftTimer_t *pTimer){
+	return (pTimer->State == SOFTTIMER_STATE_ACTIVE) ? SET : RESET;
+}
+
+uint32_t SoftTimer_Now(void){
+	return Clock;
+}
+
+void SoftTimer_Tick(void){
+	Clock++; // the only thing the ISR does: single writer, one aligned word
+}
+
+void SoftTimer_Process(void){
+	while (WheelTime != Clock){
+		SoftTimer_RunTick(WheelTime + 1U);
+		WheelTime++;
+	}
+}
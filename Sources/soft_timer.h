@@ -0,0 +1,104 @@
+/*
+ * soft_timer.h
+ *
+ *  Created on: 2026/2/22
+ *      Author: Yuheng
+ *
+ * Description:
+ * Software timers: any number of one-shot / periodic timers on ONE hardware time base.
+ *
+ * [Previously] TIM6 was the feed timeout and nothing else: every new "in X ms, do Y"
+ * (retries, LED patterns, schedules ...) would have needed a hardware timer of its own.
+ * Now the SysTick ISR only ticks every SOFTTIMER_TICK_MS, and the timers below are plain structs in RAM.
+ *
+ * Hierarchical Timer Wheel:
+ * A sorted list would cost O(n) per insert. Instead, 5 wheels of 64 slots each,
+ * every slot a linked list of the timers expiring in it:
+ *
+ *   level 0: 64 slots of 1 tick        -> the next 64 ticks
+ *   level 1: 64 slots of 64 ticks      -> up to 4096 ticks (4 s)
+ *   level 2: 64 slots of 4096 ticks    -> up to ~4.5 min
+ *   level 3: 64 slots of 2^18 ticks    -> up to ~4.7 h
+ *   level 4: 64 slots of 2^24 ticks    -> up to ~12 days (SOFTTIMER_MAX_DELAY)
+ *
+ * - Start: pick the level from the delay, the slot from the expiry bits -> O(1)
+ * - Stop:  unlink from a doubly linked list -> O(1)
+ * - Tick:  run the level 0 slot of this tick. Every 64 ticks, the next level 1 slot is
+ *          "cascaded": its timers are re-inserted, now all less than 64 ticks away
+ *          (every 4096 ticks one level 2 slot, ...). Each timer is moved at most once per level,
+ *          so the cost per tick does not grow with the number of timers waiting.
+ *
+ * Deferred Context:
+ * The tick ISR only counts (SoftTimer_Tick, a single increment). The wheel is turned and the
+ * callbacks run in main() (SoftTimer_Process, every loop pass): a callback may take its time,
+ * log, send frames, start / stop timers, without ever delaying an interrupt.
+ * A callback is late by at most one main loop pass; ticks missed meanwhile are caught up.
+ *
+ * SoftTimer_Start / SoftTimer_Stop may also be called from an ISR (short critical sections).
+ */
+
+#ifndef SOURCES_SOFT_TIMER_H_
+#define SOURCES_SOFT_TIMER_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+#define SOFTTIMER_TICK_MS      1U   // period of the hardware tick (SoftTimer_Tick)
+#define SOFTTIMER_LEVELS       5U
+#define SOFTTIMER_LEVEL_BITS   6U   // 64 slots per level
+#define SOFTTIMER_MAX_DELAY    ((1UL << (SOFTTIMER_LEVELS * SOFTTIMER_LEVEL_BITS)) - 1U) // ticks, longer delays are clamped
+
+/* @SoftTimer_State */
+#define SOFTTIMER_STATE_IDLE     0 // never started, stopped, or a one-shot that fired
+#define SOFTTIMER_STATE_ACTIVE   1 // waiting in the wheel
+
+typedef struct SoftTimer SoftTimer_t;
+
+typedef void (*SoftTimer_Callback_t)(SoftTimer_t *pTimer);
+
+/*
+ * Software Timer
+ * Callback / pArg are set by the caller (before SoftTimer_Start), the rest is owned by the module.
+ * The struct must stay valid while the timer is active (static or global, not on the stack).
+ */
+struct SoftTimer{
+	SoftTimer_Callback_t Callback; // runs in main() (SoftTimer_Process)
+	void *pArg;                    // free for the callback
+
+	SoftTimer_t *pNext;            // slot list
+	SoftTimer_t **ppPrev;          // the pointer that points at this timer (slot head or previous pNext)
+	uint32_t Expiry;               // tick it fires at
+	uint32_t Period;               // ticks, 0 = one-shot
+	volatile uint8_t State;        // @SoftTimer_State
+};
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+// Empty wheel, clock at 0: before the tick interrupt is enabled
+void SoftTimer_Init(void);
+
+/*
+ * (Re)start: fires Delay ticks from now (at least 1), then every Period ticks (0 = once).
+ * Periodic timers do not drift: each expiry is the previous one + Period.
+ * A timer that is already active is simply moved.
+ */
+void SoftTimer_Start(SoftTimer_t *pTimer, uint32_t Delay, uint32_t Period);
+
+// No callback any more (unless it is running right now). Harmless on an idle timer
+void SoftTimer_Stop(SoftTimer_t *pTimer);
+
+uint8_t SoftTimer_IsActive(SoftTimer_t *pTimer);
+
+// Ticks since SoftTimer_Init (wraps after 49 days at 1 ms: compare with a subtraction)
+uint32_t SoftTimer_Now(void);
+
+// Call from the hardware tick ISR, every SOFTTIMER_TICK_MS
+void SoftTimer_Tick(void);
+
+// Call from the main loop: turns the wheel up to now and runs the callbacks due
+void SoftTimer_Process(void);
+
+#endif /* SOURCES_SOFT_TIMER_H_ */
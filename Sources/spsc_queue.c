@@ -0,0 +1,132 @@
+/*
+ * spsc_queue.c
+ *
+ *  Created on: 2026/2/5
+ *      Author: Yuheng
+ */
+#include "spsc_queue.h"
+#include <stdint.h>
+
+uint8_t SPSC_Init(SPSC_Queue_t *pQueue, uint8_t *pBuffer, uint32_t Size){
+	pQueue->pBuffer = pBuffer;
+	pQueue->Head = 0;
+	pQueue->Tail = 0;
+	pQueue->HighWater = 0;
+	pQueue->Dropped = 0;
+
+	// A power of two has exactly one bit set -> (Size & (Size - 1)) == 0
+	if ((Size == 0) || ((Size & (Size - 1)) != 0)){
+		pQueue->Mask = 0;
+		pQueue->pBuffer = 0;
+		return RESET;
+	}
+	pQueue->Mask = Size - 1;
+	return SET;
+}
+
+/*
+ * A queue whose SPSC_Init failed has no storage (pBuffer = 0): every push is dropped (and counted),
+ * every pop finds it empty. Unusable, but never a write through a NULL pointer.
+ */
+
+/*
+ * ==========================================
+ * 			Producer Side
+ * ==========================================
+ * Order matters:
+ * 1. write the byte into the slot
+ * 2. BARRIER
+ * 3. publish the new Head
+ * If 3 could happen before 1, the consumer might read the slot before the byte is in it.
+ */
+static void SPSC_UpdateHighWater(SPSC_Queue_t *pQueue, uint32_t count){
+	if (count > pQueue->HighWater){
+		pQueue->HighWater = count;
+	}
+}
+
+uint8_t SPSC_Push(SPSC_Queue_t *pQueue, uint8_t Data){
+	uint32_t head = pQueue->Head; // our own index, nobody else changes it
+	uint32_t tail = pQueue->Tail; // snapshot of the consumer's index
+
+	if ((pQueue->pBuffer == 0) || ((head - tail) > pQueue->Mask)){ // count == Size -> full
+		pQueue->Dropped++;
+		return RESET;
+	}
+
+	pQueue->pBuffer[head & pQueue->Mask] = Data;
+	MEMORY_BARRIER();
+	pQueue->Head = head + 1;
+
+	SPSC_UpdateHighWater(pQueue, head + 1 - tail);
+	return SET;
+}
+
+uint32_t SPSC_PushBuffer(SPSC_Queue_t *pQueue, const uint8_t *pData, uint32_t Len){
+	uint32_t head = pQueue->Head;
+	uint32_t tail = pQueue->Tail;
+	uint32_t free_space = (pQueue->pBuffer == 0) ? 0 : ((pQueue->Mask + 1) - (head - tail));
+
+	// Whatever does not fit is dropped (and counted), the producer never waits
+	if (Len > free_space){
+		pQueue->Dropped += (Len - free_space);
+		Len = free_space;
+	}
+
+	for (uint32_t i = 0; i < Len; i++){
+		pQueue->pBuffer[(head + i) & pQueue->Mask] = pData[i];
+	}
+	MEMORY_BARRIER();
+	pQueue->Head = head + Len; // publish all bytes at once
+
+	SPSC_UpdateHighWater(pQueue, head + Len - tail);
+	return Len;
+}
+
+/*
+ * ==========================================
+ * 			Consumer Side
+ * ==========================================
+ * Mirror image of the producer:
+ * 1. read Head (how far the producer got)
+ * 2. BARRIER -> the slot contents are read only AFTER we know they are valid
+ * 3. read the byte(s)
+ * 4. BARRIER -> finish reading BEFORE handing the slot back
+ * 5. publish the new Tail
+ */
+uint8_t SPSC_Pop(SPSC_Queue_t *pQueue, uint8_t *pData){
+	uint32_t tail = pQueue->Tail;
+	uint32_t head = pQueue->Head;
+
+	if ((head == tail) || (pQueue->pBuffer == 0)){ // empty
+		return RESET;
+	}
+
+	MEMORY_BARRIER();
+	*pData = pQueue->pBuffer[tail & pQueue->Mask];
+	MEMORY_BARRIER();
+	pQueue->Tail = tail + 1;
+
+	return SET;
+}
+
+uint32_t SPSC_PopBuffer(SPSC_Queue_t *pQueue, uint8_t *pDest, uint32_t MaxLen){
+	uint32_t tail = pQueue->Tail;
+	uint32_t count = pQueue->Head - tail;
+
+	if (count > MaxLen){
+		count = MaxLen;
+	}
+	if ((count == 0) || (pQueue->pBuffer == 0)){
+		return 0;
+	}
+
+	MEMORY_BARRIER();
+	for (uint32_t i = 0; i < count; i++){
+		pDest[i] = pQueue->pBuffer[(tail + i) & pQueue->Mask];
+	}
+	MEMORY_BARRIER();
+	pQueue->Tail = tail + count;
+
+	return count;
+}
@@ -0,0 +1,73 @@
+/*
+ * spsc_queue.h
+ *
+ *  Created on: 2026/2/5
+ *      Author: Yuheng
+ *
+ * Description:
+ * Lock-free Single-Producer / Single-Consumer (SPSC) byte queue.
+ *
+ * The "mailbox" between an ISR and main() (or the other way around):
+ * - exactly ONE context writes (Push), e.g. the USART2 ISR
+ * - exactly ONE context reads (Pop), e.g. the main loop
+ *
+ * Why no interrupt disabling is needed:
+ * Head is ONLY written by the producer, Tail is ONLY written by the consumer.
+ * Each side just reads the other side's index, and a 32-bit aligned read/write
+ * is a single (atomic) LDR/STR on the Cortex-M4. So neither side can ever see
+ * a "half-updated" index, and there is nothing to lock.
+ *
+ * Why the size must be a power of two:
+ * Head/Tail are free-running counters (they are never wrapped back to 0).
+ * - slot  = index & (Size - 1)  -> one AND instead of a division
+ * - count = Head - Tail         -> correct even after the 32-bit counters overflow
+ * Both tricks only work when Size is a power of two.
+ *
+ * NOT safe for two producers (e.g. two ISRs with different priorities pushing into
+ * the same queue), give each producer its own queue instead.
+ */
+
+#ifndef SOURCES_SPSC_QUEUE_H_
+#define SOURCES_SPSC_QUEUE_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+typedef struct{
+	uint8_t *pBuffer;            // storage, provided by the owner (Size bytes)
+	uint32_t Mask;               // Size - 1
+	volatile uint32_t Head;      // total bytes ever pushed (written by producer only)
+	volatile uint32_t Tail;      // total bytes ever popped (written by consumer only)
+
+	/* Statistics (written by the producer only) */
+	volatile uint32_t HighWater; // largest fill level ever seen -> tells us if Size is big enough
+	volatile uint32_t Dropped;   // bytes rejected because the queue was full
+} SPSC_Queue_t;
+
+/*
+ * Returns SET on success, RESET if Size is not a power of two: the queue is then left
+ * permanently full (every push dropped, SPSC_Free 0) and empty (every pop fails).
+ */
+uint8_t SPSC_Init(SPSC_Queue_t *pQueue, uint8_t *pBuffer, uint32_t Size);
+
+/* Producer side */
+uint8_t SPSC_Push(SPSC_Queue_t *pQueue, uint8_t Data);                        // SET if stored
+uint32_t SPSC_PushBuffer(SPSC_Queue_t *pQueue, const uint8_t *pData, uint32_t Len); // bytes stored
+
+/* Consumer side */
+uint8_t SPSC_Pop(SPSC_Queue_t *pQueue, uint8_t *pData);                       // SET if a byte was read
+uint32_t SPSC_PopBuffer(SPSC_Queue_t *pQueue, uint8_t *pDest, uint32_t MaxLen); // bytes read
+
+/* Either side (the answer may already be stale by the time it is used, but never invalid) */
+static inline uint32_t SPSC_Count(const SPSC_Queue_t *pQueue){
+	return (pQueue->Head - pQueue->Tail);
+}
+
+static inline uint32_t SPSC_Free(const SPSC_Queue_t *pQueue){
+	if (pQueue->pBuffer == 0){
+		return 0; // SPSC_Init failed
+	}
+	return ((pQueue->Mask + 1) - SPSC_Count(pQueue));
+}
+
+#endif /* SOURCES_SPSC_QUEUE_H_ */
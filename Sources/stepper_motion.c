@@ -0,0 +1,599 @@
+/*
+ * stepper_motion.c
+ *
+ *  Created on: 2026/2/17
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_rcc_driver.h"
+#include "stm32f446xx_timer_driver.h"
+#include "stepper_motion.h"
+#include "motion_math.h"
+#include <stdint.h>
+
+/*
+ * Integer square root (bit by bit, no division).
+ * Only used by Motion_Init, so speed does not matter much.
+ */
+static uint32_t Motion_Sqrt(uint64_t Value){
+	uint64_t result = 0;
+	uint64_t bit = (uint64_t)1 << 62; // highest power of 4 that fits
+
+	while (bit > Value){
+		bit >>= 2;
+	}
+
+	while (bit != 0){
+		if (Value >= result + bit){
+			Value -= result + bit;
+			result = (result >> 1) + bit;
+		}
+		else{
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint32_t)result;
+}
+
+/*
+ * ==========================================
+ * 			Ramp Table
+ * ==========================================
+ * Speeds are handled in Q8 (steps/s x 256): at 4000 steps/s one unit is 0.004 steps/s,
+ * so the rounding of the table is far below the 1 us tick of the timer.
+ *
+ * Ramp length K = number of steps to go from v0 to vmax at constant acceleration:
+ * vmax^2 = v0^2 + 2 * a * K  ->  K = (vmax^2 - v0^2) / (2 * a)
+ *
+ * Entries are stored as ARR values (period - 1): the DMA can copy them straight into ARR.
+ *
+ * The S-curve is defined over TIME (ramp time T = (vmax - v0) / a), so the table is built
+ * by walking it one step at a time: the speed of the next step is taken at the moment
+ * the previous step ends. It covers the same K steps (same average speed over the same T).
+ */
+static uint32_t Motion_PeriodFromSpeed(uint64_t SpeedQ8){
+	// period = 1 / v, in ticks, rounded to the nearest tick
+	return (uint32_t)((((uint64_t)MOTION_TICK_HZ << 8) + (SpeedQ8 / 2U)) / SpeedQ8);
+}
+
+static void Motion_BuildRampTable(Motion_Handle_t *pMotionHandle){
+	Motion_Config_t *pConfig = &pMotionHandle->Motion_Config;
+	uint32_t *pTable = pMotionHandle->RampTable;
+	uint64_t v0 = pConfig->StartSpeed;
+	uint64_t vmax = pConfig->MaxSpeed;
+	uint64_t a = pConfig->Accel;
+	uint32_t length = 0;
+
+	if ((vmax <= v0) || (a == 0)){
+		pMotionHandle->RampLength = 0; // no ramp: every move runs at (at most) MaxSpeed from the start
+		return;
+	}
+
+	if (pConfig->Profile == MOTION_PROFILE_SCURVE){
+		uint64_t ramp_ticks = ((vmax - v0) * MOTION_TICK_HZ) / a;
+		uint64_t t = 0;
+		uint64_t speed_q8 = v0 << 8;
+
+		while ((length < MOTION_RAMP_MAX) && (t < ramp_ticks)){
+			uint32_t period = Motion_PeriodFromSpeed(speed_q8);
+			pTable[length] = period - 1U;
+			t += period;
+			length++;
+
+			// x = t / T, s = 3x^2 - 2x^3 (Q16)
+			q16_t x = (t >= ramp_ticks) ? Q16_ONE : (q16_t)((t << Q16_SHIFT) / ramp_ticks);
+			uint64_t s = (uint64_t)Q16_Smoothstep(x);
+			speed_q8 = (v0 << 8) + (((vmax - v0) * s) >> 8);
+		}
+	}
+	else{
+		uint64_t ramp = ((vmax * vmax) - (v0 * v0) + (2U * a) - 1U) / (2U * a); // rounded up
+		length = (ramp > MOTION_RAMP_MAX) ? MOTION_RAMP_MAX : (uint32_t)ramp;
+
+		for (uint32_t k = 0; k < length; k++){
+			// v^2 = v0^2 + 2ak, shifted by 16 so that the root comes out in Q8
+			pTable[k] = Motion_PeriodFromSpeed(Motion_Sqrt(((v0 * v0) + (2U * a * k)) << 16)) - 1U;
+		}
+	}
+
+	// The same ramp backwards, for the DMA (it can only walk memory upwards)
+	for (uint32_t k = 0; k < length; k++){
+		pMotionHandle->DecelTable[k] = pTable[length - 1U - k];
+	}
+
+	pMotionHandle->RampLength = (uint16_t)length;
+}
+
+/*
+ * Split a move into ramp and cruise.
+ * The table only gets shorter periods as k grows, so the ramp of a move is
+ * "every entry still slower than the cruise" (found by bisection),
+ * and at most half of the move (a short move turns into a triangle: up, then straight down).
+ * No division: it also runs in the ISR that chains the next move (Motion_CompleteCallback).
+ */
+static void Motion_Plan(Motion_Handle_t *pMotionHandle, uint32_t Steps, uint32_t Period,
+		uint32_t *pAccelSteps, uint32_t *pCruisePeriod){
+	const uint32_t *pTable = pMotionHandle->RampTable;
+	uint32_t length = pMotionHandle->RampLength;
+	uint32_t cruise = Period;
+
+	if (cruise < pMotionHandle->MinPeriod){
+		cruise = pMotionHandle->MinPeriod; // never faster than the top of the ramp
+	}
+
+	uint32_t low = 0;
+	uint32_t high = length;
+	while (low < high){
+		uint32_t mid = (low + high) / 2U;
+		if ((pTable[mid] + 1U) > cruise){
+			low = mid + 1U;
+		}
+		else{
+			high = mid;
+		}
+	}
+
+	*pAccelSteps = (low > (Steps / 2U)) ? (Steps / 2U) : low;
+	*pCruisePeriod = cruise;
+}
+
+// Period of step number 'Step' (0 = first) of the current move
+static uint32_t Motion_Period(Motion_Handle_t *pMotionHandle, uint32_t Step){
+	uint32_t left = pMotionHandle->StepsTotal - 1U - Step; // steps after this one
+
+	if (Step < pMotionHandle->AccelSteps){
+		return pMotionHandle->RampTable[Step] + 1U;
+	}
+	if (left < pMotionHandle->AccelSteps){
+		return pMotionHandle->RampTable[left] + 1U; // deceleration = the ramp backwards
+	}
+	return pMotionHandle->CruisePeriod;
+}
+
+/*
+ * Write the preload register for step 'Step'.
+ * It is copied into the active ARR at the next update event, i.e. when the period in progress ends.
+ * CCR1 stays at MOTION_STEP_EDGE for every step: only ARR changes (one word, what the DMA streams).
+ * Past the last step: MOTION_NO_PULSE -> the output stays low (no extra pulse).
+ */
+static void Motion_LoadStep(Motion_Handle_t *pMotionHandle, uint32_t Step){
+	TIM_RegDef_t *pTIMx = pMotionHandle->pTIMx;
+
+	if (Step < pMotionHandle->StepsTotal){
+		pTIMx->ARR = Motion_Period(pMotionHandle, Step) - 1U;
+	}
+	else{
+		pTIMx->CCR1 = MOTION_NO_PULSE;
+	}
+}
+
+/*
+ * DMA mode: the counter counts that the CPU has to step in (CC2 interrupt),
+ * i.e. where the next step does not come from a table row the DMA is already playing:
+ * - at AccelSteps - 1:          the first cruise step (or the first deceleration step)
+ * - at StepsTotal - Accel - 1:  the first deceleration step, + start the deceleration rows
+ * Step 1 is loaded by Motion_Move itself, so count 0 is never an event.
+ * Returns the first such count after 'After', 0 if none is left.
+ */
+static uint32_t Motion_NextEvent(Motion_Handle_t *pMotionHandle, uint32_t After){
+	uint32_t accel = pMotionHandle->AccelSteps;
+	uint32_t events[2];
+
+	if (accel == 0){
+		return 0; // constant speed, no ramp
+	}
+
+	events[0] = accel - 1U;
+	events[1] = pMotionHandle->StepsTotal - accel - 1U;
+
+	for (uint8_t i = 0; i < 2; i++){
+		if ((events[i] > After) && (events[i] != 0)){
+			return events[i];
+		}
+	}
+	return 0;
+}
+
+/*
+ * DMA mode: step 'Step' - 1 is running (its ARR is active),
+ * load 'Step' by hand, and let the DMA play what follows from the tables.
+ */
+static void Motion_LoadStepDMA(Motion_Handle_t *pMotionHandle, uint32_t Step){
+	uint32_t accel = pMotionHandle->AccelSteps;
+	uint32_t length = pMotionHandle->RampLength;
+
+	Motion_LoadStep(pMotionHandle, Step);
+
+	if ((Step == 1U) && (accel >= 3U)){
+		// steps 2 .. accel - 1: RampTable[2 ...]
+		TIM_PlayProfile(pMotionHandle->pProfileTIM, &pMotionHandle->RampTable[2], (uint16_t)(accel - 2U));
+	}
+	else if ((Step == (pMotionHandle->StepsTotal - accel)) && (accel >= 2U)){
+		// steps StepsTotal - accel + 1 .. StepsTotal - 1: the last accel - 1 rows of DecelTable
+		TIM_PlayProfile(pMotionHandle->pProfileTIM, &pMotionHandle->DecelTable[length - accel + 1U], (uint16_t)(accel - 1U));
+	}
+}
+
+/*
+ * Tick = 1 us, from the REAL timer clock (x2 when the APB prescaler is not 1)
+ * TIM1 / TIM8-11 hang on APB2, the others on APB1.
+ */
+static void Motion_SetTick(TIM_RegDef_t *pTIMx){
+	uint32_t clock = ((uint32_t)pTIMx >= APB2_BASEADDR) ? RCC_GetTimerClock2Value() : RCC_GetTimerClock1Value();
+	pTIMx->PSC = MOTION_TIMER_PSC(clock, MOTION_TICK_HZ);
+}
+
+void Motion_Init(Motion_Handle_t *pMotionHandle){
+	TIM_RegDef_t *pTIMx = pMotionHandle->pTIMx;
+
+	// 1. Tick = 1 us
+	Motion_SetTick(pTIMx);
+
+	/*
+	 * 2. CR1
+	 * Bit 7 ARPE: Auto-reload preload enable
+	 * With ARPE = 1 a new ARR waits in the "shadow" register until the next update event,
+	 * like CCR1 already does (OC1PE). Needed to change the step rate on every step
+	 * without ever cutting a step period short.
+	 *
+	 * Bit 2 URS: Update request source
+	 * 1: only a counter overflow sets UIF. Motion_Move forces an update (UG) to load the
+	 * first step right away, and that one must not count as a finished step.
+	 */
+	SET_BIT(pTIMx->CR1, 7);
+	SET_BIT(pTIMx->CR1, 2);
+
+	/*
+	 * 3. CCMR1 Bits 6:4 OC1M = 111: PWM mode 2
+	 * Channel 1 is INACTIVE while CNT < CCR1: each step period is "low, then high",
+	 * and the falling edge of a pulse is the update event that starts the next period.
+	 */
+	pTIMx->CCMR1 &= ~(7U << 4);
+	pTIMx->CCMR1 |= (7U << 4);
+
+	// 4. Output low, and load the prescaler now (PSC is preloaded too)
+	pTIMx->CCR1 = MOTION_NO_PULSE;
+	SET_BIT(pTIMx->EGR, 0);
+
+	// 5. Hardware pulse counter (see stepper_motion.h)
+	TIM_RegDef_t *pCounter = pMotionHandle->pCounterTIMx;
+	if (pCounter != 0){
+		// a) step timer: one TRGO pulse per update = per finished STEP pulse
+		TIM_MasterConfig(pTIMx, TIM_TRGO_UPDATE);
+
+		// b) counter: clocked by those TRGO pulses, counts 0 -> 65535, no prescaler
+		pCounter->PSC = 0;
+		pCounter->ARR = MOTION_COUNTER_MAX;
+		TIM_SlaveConfig(pCounter, pMotionHandle->CounterTrigger, TIM_SLAVE_EXTCLK);
+
+		/*
+		 * c) counter channel 1: PWM mode 1, NOT preloaded (OC1PE = 0, CCR1 takes effect at once)
+		 * OC1REF = (CNT < CCR1): high while pulses are still owed, sent out as the counter's TRGO.
+		 * No pin involved (CC1E stays 0), OC1REF exists anyway.
+		 */
+		pCounter->CCMR1 &= ~(7U << 4);
+		pCounter->CCMR1 |= (6U << 4);
+		CLEAR_BIT(pCounter->CCMR1, 3);
+		pCounter->CCR1 = 0; // gate closed
+		TIM_MasterConfig(pCounter, TIM_TRGO_OC1REF);
+
+		SET_BIT(pCounter->EGR, 0); // load PSC
+		pCounter->CNT = 0;
+		SET_BIT(pCounter->CR1, 0);
+
+		/*
+		 * d) step timer gated by the counter: runs only while OC1REF is high.
+		 * RM0390: in gated mode CEN must be set by software (TIM_PWM_Init did),
+		 * the gate then starts and stops the counter by itself.
+		 */
+		TIM_SlaveConfig(pTIMx, pMotionHandle->GateTrigger, TIM_SLAVE_GATED);
+	}
+
+	else{
+		pMotionHandle->pProfileTIM = 0; // DMA mode needs the counter's events
+	}
+
+	Motion_BuildRampTable(pMotionHandle);
+	if (pMotionHandle->RampLength > 0){
+		pMotionHandle->MinPeriod = pMotionHandle->RampTable[pMotionHandle->RampLength - 1U] + 1U;
+	}
+	else{
+		pMotionHandle->MinPeriod = MOTION_PERIOD_TICKS(MOTION_TICK_HZ, pMotionHandle->Motion_Config.MaxSpeed);
+	}
+
+	pMotionHandle->StepsTotal = 0;
+	pMotionHandle->StepsDone = 0;
+	pMotionHandle->State = MOTION_STATE_IDLE;
+}
+
+/*
+ * Both kinds of move: Ramp = SET -> Motion_Plan splits it into ramp and cruise,
+ * RESET -> every step at Period (AccelSteps = 0: no table, no DMA rows, no CC2 events).
+ */
+static uint8_t Motion_Start(Motion_Handle_t *pMotionHandle, uint32_t Steps, uint32_t Period, uint8_t Ramp){
+	TIM_RegDef_t *pTIMx = pMotionHandle->pTIMx;
+	TIM_RegDef_t *pCounter = pMotionHandle->pCounterTIMx;
+
+	if ((Steps == 0) || (Period == 0) || ((pCounter != 0) && (Steps > MOTION_COUNTER_MAX))){
+		return MOTION_ERROR;
+	}
+
+	// Freeze the timer: the old move (if any) must not interrupt in the middle of this
+	CLEAR_BIT(pTIMx->DIER, 0); // UIE
+	if (pCounter != 0){
+		CLEAR_BIT(pCounter->DIER, 1); // CC1IE
+		CLEAR_BIT(pCounter->DIER, 2); // CC2IE
+		pCounter->CCR1 = 0;           // gate closed (CEN must stay set in gated mode)
+	}
+	if (pMotionHandle->pProfileTIM != 0){
+		TIM_StopProfile(pMotionHandle->pProfileTIM);
+	}
+
+	/*
+	 * Counted mode: the closed gate already froze it, and CEN must stay set (gated mode,
+	 * nothing below sets it again). Only the ISR mode stops the timer itself.
+	 * [Previously] tied to "no DMA profile": counted mode without DMA lost CEN for good,
+	 * and every move then hung until the feed timeout.
+	 */
+	if (pCounter == 0){
+		CLEAR_BIT(pTIMx->CR1, 0);     // CEN
+	}
+
+	if (Ramp == SET){
+		Motion_Plan(pMotionHandle, Steps, Period, &pMotionHandle->AccelSteps, &pMotionHandle->CruisePeriod);
+	}
+	else{
+		pMotionHandle->AccelSteps = 0;
+		pMotionHandle->CruisePeriod = (Period > (2U * MOTION_STEP_EDGE)) ? Period : (2U * MOTION_STEP_EDGE);
+	}
+	pMotionHandle->StepsTotal = Steps;
+	pMotionHandle->StepsDone = 0;
+
+	/*
+	 * Step 0 goes straight into the active registers:
+	 * EGR Bit 0 UG: Update generation -> ARR / CCR1 / PSC copied from the preload registers, CNT = 0
+	 * then step 1 waits in the preload registers for the end of step 0.
+	 */
+	pTIMx->CCR1 = MOTION_STEP_EDGE;
+	Motion_LoadStep(pMotionHandle, 0);
+	SET_BIT(pTIMx->EGR, 0);
+
+	CLEAR_BIT(pTIMx->SR, 0); // UIF
+	pMotionHandle->State = MOTION_STATE_RUNNING;
+
+	if (pMotionHandle->pProfileTIM != 0){
+		/*
+		 * DMA mode: no update interrupt at all.
+		 * The DMA plays the ramp rows, the counter's CC2 interrupt covers the few steps in between.
+		 */
+		Motion_LoadStepDMA(pMotionHandle, 1);
+
+		uint32_t event = Motion_NextEvent(pMotionHandle, 0);
+		if (event != 0){
+			pCounter->CCR2 = event;
+			CLEAR_BIT(pCounter->SR, 2);
+			SET_BIT(pCounter->DIER, 2);
+		}
+	}
+	else{
+		Motion_LoadStep(pMotionHandle, 1);
+		SET_BIT(pTIMx->DIER, 0);
+	}
+
+	if (pCounter != 0){
+		/*
+		 * The UG above was an update too, and went out on TRGO:
+		 * only reset the count AFTER it. Then opening the gate (CCR1 = N) starts the move.
+		 * SR Bit 1 CC1IF / DIER Bit 1 CC1IE: CNT reached CCR1 = the N-th pulse is out.
+		 */
+		pCounter->CNT = 0;
+		CLEAR_BIT(pCounter->SR, 1);
+		SET_BIT(pCounter->DIER, 1);
+		pCounter->CCR1 = Steps;
+	}
+	else{
+		SET_BIT(pTIMx->CR1, 0);
+	}
+
+	return MOTION_OK;
+}
+
+uint8_t Motion_Move(Motion_Handle_t *pMotionHandle, uint32_t Steps, uint32_t Period){
+	return Motion_Start(pMotionHandle, Steps, Period, SET);
+}
+
+uint8_t Motion_MoveConstant(Motion_Handle_t *pMotionHandle, uint32_t Steps, uint32_t Period){
+	return Motion_Start(pMotionHandle, Steps, Period, RESET);
+}
+
+void Motion_Stop(Motion_Handle_t *pMotionHandle){
+	TIM_RegDef_t *pTIMx = pMotionHandle->pTIMx;
+	TIM_RegDef_t *pCounter = pMotionHandle->pCounterTIMx;
+
+	CLEAR_BIT(pTIMx->DIER, 0);
+	if (pMotionHandle->pProfileTIM != 0){
+		TIM_StopProfile(pMotionHandle->pProfileTIM);
+	}
+
+	if (pCounter != 0){
+		CLEAR_BIT(pCounter->DIER, 1);
+		CLEAR_BIT(pCounter->DIER, 2);
+		pCounter->CCR1 = 0;              // gate closed: the step timer freezes right now
+
+		/*
+		 * Both timers are frozen now. The counter only counts a pulse at its END (update -> TRGO),
+		 * but the A4988 steps on its RISING edge (CNT = MOTION_STEP_EDGE, PWM mode 2):
+		 * frozen in the high half, that step was taken and not counted yet.
+		 * [Previously] it was left out, and the position the A4988 driver keeps drifted
+		 * one microstep behind the translator at every such stop.
+		 */
+		uint32_t done = pCounter->CNT;
+		if ((pMotionHandle->State == MOTION_STATE_RUNNING) && (done < pMotionHandle->StepsTotal) &&
+			(pTIMx->CNT >= MOTION_STEP_EDGE)){
+			done++;
+		}
+		pMotionHandle->StepsDone = done;
+
+		// frozen maybe in the high half of a pulse: restart it at CNT = 0 (low)
+		pTIMx->CCR1 = MOTION_NO_PULSE;
+		SET_BIT(pTIMx->EGR, 0);          // (its TRGO still counts one, StepsDone is already saved)
+		CLEAR_BIT(pCounter->SR, 1);
+		CLEAR_BIT(pCounter->SR, 2);
+	}
+	else if (pMotionHandle->State == MOTION_STATE_RUNNING){
+		pTIMx->CCR1 = MOTION_NO_PULSE;   // preloaded: the pulse in progress still ends normally
+
+		/*
+		 * The update ISR is off, so it no longer counts what still goes out:
+		 * - a period that just ended, its update still pending (SR Bit 0 UIF)
+		 * - the period in progress: its active CCR1 is still MOTION_STEP_EDGE, its pulse goes high
+		 */
+		uint32_t done = pMotionHandle->StepsDone;
+		if (READ_BIT(pTIMx->SR, 0) && (done < pMotionHandle->StepsTotal)){
+			done++;
+		}
+		if (done < pMotionHandle->StepsTotal){
+			done++;
+		}
+		pMotionHandle->StepsDone = done;
+	}
+
+	CLEAR_BIT(pTIMx->SR, 0);  // a pending update ISR becomes a no-op
+	pMotionHandle->State = MOTION_STATE_IDLE;
+}
+
+void Motion_ClockChanged(Motion_Handle_t *pMotionHandle){
+	/*
+	 * PSC is preloaded: the new value only counts from the next update event, i.e. the next step
+	 * of a running move (or the UG of the next Motion_Move). Every table and ARR is in ticks,
+	 * so nothing else changes.
+	 */
+	Motion_SetTick(pMotionHandle->pTIMx);
+}
+
+uint32_t Motion_GetStepsDone(Motion_Handle_t *pMotionHandle){
+	if ((pMotionHandle->pCounterTIMx != 0) && (pMotionHandle->State == MOTION_STATE_RUNNING)){
+		return pMotionHandle->pCounterTIMx->CNT;
+	}
+	return pMotionHandle->StepsDone;
+}
+
+uint32_t Motion_EstimateMs(Motion_Handle_t *pMotionHandle, uint32_t Steps, uint32_t Period){
+	uint32_t accel;
+	uint32_t cruise;
+	uint64_t ticks;
+
+	if ((Steps == 0) || (Period == 0)){
+		return 0;
+	}
+
+	Motion_Plan(pMotionHandle, Steps, Period, &accel, &cruise);
+
+	ticks = (uint64_t)(Steps - (2U * accel)) * cruise;
+	for (uint32_t k = 0; k < accel; k++){
+		ticks += 2U * ((uint64_t)pMotionHandle->RampTable[k] + 1U);
+	}
+
+	return (uint32_t)((ticks + (MOTION_TICK_HZ / 1000U) - 1U) / (MOTION_TICK_HZ / 1000U));
+}
+
+/*
+ * ==========================================
+ * 		Update Interrupt (once per step)
+ * ==========================================
+ * The update event = the end of one step period = the start of the next one.
+ * Step 'done' has just been loaded into the active registers (by the hardware),
+ * so we write step 'done + 1' into the preload registers.
+ */
+void Motion_IRQHandling(Motion_Handle_t *pMotionHandle){
+	TIM_RegDef_t *pTIMx = pMotionHandle->pTIMx;
+	TIM_RegDef_t *pCounter = pMotionHandle->pCounterTIMx;
+
+	if (!READ_BIT(pTIMx->SR, 0)){
+		return;
+	}
+	CLEAR_BIT(pTIMx->SR, 0);
+
+	if (pMotionHandle->State != MOTION_STATE_RUNNING){
+		return;
+	}
+
+	if (pCounter != 0){
+		// the hardware count, not ours: right even if an update interrupt was missed
+		uint32_t done = pCounter->CNT;
+		if (done < pMotionHandle->StepsTotal){
+			pMotionHandle->StepsDone = done;
+			Motion_LoadStep(pMotionHandle, done + 1U);
+		}
+		return; // the end of the move is reported by Motion_CounterIRQHandling
+	}
+
+	uint32_t done = pMotionHandle->StepsDone + 1U;
+	pMotionHandle->StepsDone = done;
+
+	if (done >= pMotionHandle->StepsTotal){
+		// the period starting now has CCR1 = MOTION_NO_PULSE: the last pulse is out
+		CLEAR_BIT(pTIMx->DIER, 0);
+		pMotionHandle->State = MOTION_STATE_IDLE;
+		Motion_CompleteCallback(pMotionHandle); // may start the next move right away
+		return;
+	}
+
+	Motion_LoadStep(pMotionHandle, done + 1U);
+}
+
+/*
+ * ==========================================
+ * 		Counter Interrupt (a few per move)
+ * ==========================================
+ * CC2 (DMA mode only): the counter reached an event of Motion_NextEvent,
+ *      load the next step and start the deceleration rows if it is time.
+ *      Plenty of time: the whole step in progress (>= 250 us at 4000 steps/s).
+ * CC1: CNT reached CCR1 = StepsTotal, the gate is already closed by the hardware,
+ *      this only reports it.
+ */
+void Motion_CounterIRQHandling(Motion_Handle_t *pMotionHandle){
+	TIM_RegDef_t *pCounter = pMotionHandle->pCounterTIMx;
+
+	if (READ_BIT(pCounter->SR, 2) && READ_BIT(pCounter->DIER, 2)){
+		CLEAR_BIT(pCounter->SR, 2);
+
+		uint32_t count = pCounter->CCR2; // the event, even if this interrupt is late
+		Motion_LoadStepDMA(pMotionHandle, count + 1U);
+
+		uint32_t event = Motion_NextEvent(pMotionHandle, count);
+		if (event != 0){
+			pCounter->CCR2 = event;
+		}
+		else{
+			CLEAR_BIT(pCounter->DIER, 2);
+		}
+	}
+
+	if (!READ_BIT(pCounter->SR, 1)){
+		return;
+	}
+	CLEAR_BIT(pCounter->SR, 1);
+
+	if (pMotionHandle->State != MOTION_STATE_RUNNING){
+		return;
+	}
+
+	CLEAR_BIT(pCounter->DIER, 1);
+	CLEAR_BIT(pCounter->DIER, 2);
+	CLEAR_BIT(pMotionHandle->pTIMx->DIER, 0);
+	if (pMotionHandle->pProfileTIM != 0){
+		TIM_StopProfile(pMotionHandle->pProfileTIM);
+	}
+	pMotionHandle->StepsDone = pMotionHandle->StepsTotal;
+	pMotionHandle->State = MOTION_STATE_IDLE;
+	Motion_CompleteCallback(pMotionHandle); // may start the next move right away
+}
+
+/*
+ * Weak default: does nothing (same pattern as USART_ApplicationEventCallback).
+ */
+__attribute__((weak)) void Motion_CompleteCallback(Motion_Handle_t *pMotionHandle){
+	(void)pMotionHandle;
+}
@@ -0,0 +1,181 @@
+/*
+ * stepper_motion.h
+ *
+ *  Created on: 2026/2/17
+ *      Author: Yuheng
+ *
+ * Description:
+ * Acceleration engine for the NEMA17 STEP signal (TIM2 CH1 -> PA0).
+ *
+ * [Previously] Feed_StartJob wrote one ARR value and the motor jumped straight to the
+ * target step rate. A rotor at rest cannot follow a fast step train, so above ~1000 steps/s
+ * it stalled (and silently missed steps), which kept every portion slow.
+ * Now every move ramps up, cruises, and ramps back down:
+ *
+ *   speed
+ *     ^        __________
+ *     |       /          \
+ *     |      /            \
+ *     |_____/              \_____
+ *     +-----------------------------> steps
+ *         accel   cruise   decel
+ *
+ * Ramp Table:
+ * "How long is the k-th step of a ramp" only depends on the profile, not on the move,
+ * so it is computed ONCE by Motion_Init (integer / fixed-point math, no float)
+ * in timer ticks of 1 us. Decelerating walks the same table backwards,
+ * and a move slower than MaxSpeed simply stops climbing the table earlier.
+ * Per step, the TIM2 update ISR costs one table lookup and one register write (ARR),
+ * or nothing at all in DMA mode (below).
+ *
+ * Profiles:
+ * - TRAPEZOID: constant acceleration, v(k) = sqrt(v0^2 + 2 * a * k) after k steps
+ * - SCURVE:    v(t) = v0 + (vmax - v0) * (3x^2 - 2x^3), x = t / T (smoothstep over the ramp time T)
+ *              the acceleration fades in and out (no jerk entering or leaving the cruise),
+ *              at the cost of a peak 1.5x higher than the trapezoid's in the middle of the ramp.
+ *
+ * No glitches:
+ * ARR and CCR1 are both preloaded (ARPE / OC1PE). The ISR runs at the START of a step period
+ * and writes the values for the NEXT one, so a period is never cut short or stretched.
+ *
+ * Exact step count (pCounterTIMx):
+ * Counting pulses in the update ISR is only exact as long as no update interrupt is ever late,
+ * and stopping after the last one is up to software. With a counter timer,
+ * the hardware does both (RM0390 17.3.19 Timer synchronization):
+ *
+ *   step timer (TIM2) --TRGO = update (1 per pulse)--> counter (TIM3, external clock mode 1)
+ *   step timer (TIM2) <--gate = OC1REF (CNT < N)------ counter (TIM3, CCR1 = N)
+ *
+ * The counter counts every finished pulse, and its OC1REF drops the moment it reaches N,
+ * which freezes the step timer (gated mode) right at the start of period N+1: exactly N pulses,
+ * whatever the CPU is doing. Its CC1 interrupt then reports the end of the move.
+ * The update ISR still drives the ramp, but reads the step number from the counter,
+ * so a late interrupt costs at most a slightly off ramp, never a step.
+ *
+ * Waveform: PWM mode 2 (low while CNT < CCR1, high until the update),
+ * so the timer is always frozen at CNT = 0 with the output LOW, never in the middle of a pulse.
+ * CCR1 is the same for every step (MOTION_STEP_EDGE), only ARR changes.
+ *
+ * DMA mode (pProfileTIM, needs the counter):
+ * Even a short ISR per step caps the step rate and jitters when the UART is busy.
+ * The ramp tables already hold ARR values, so the timer's update DMA request
+ * (TIM_PlayProfile) copies them into ARR by itself, one per step:
+ * RampTable forwards for the acceleration, DecelTable (the same ramp stored backwards,
+ * the DMA only walks upwards) for the deceleration. During the cruise ARR simply stays.
+ * Left for the CPU: the first cruise step and the start of the deceleration,
+ * two compare interrupts of the counter (CC2) per move instead of one per step.
+ */
+
+#ifndef SOURCES_STEPPER_MOTION_H_
+#define SOURCES_STEPPER_MOTION_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+#include "stm32f446xx_timer_driver.h"
+
+#define MOTION_TICK_HZ      1000000U // timer ticks per second (the prescaler is set from the real clock)
+#define MOTION_RAMP_MAX     1024U    // ramp table entries (2 tables x 4 KB), longer ramps stop at the last entry
+#define MOTION_STEP_EDGE    10U      // ticks LOW at the start of each period, then HIGH until its end (A4988: >= 1 us each)
+#define MOTION_NO_PULSE     0xFFFFFFFFU // CCR1 above any ARR: PWM mode 2 never goes high
+#define MOTION_COUNTER_MAX  0xFFFFU  // 16-bit counter timer: longest move in counted mode
+
+/* @Motion_Profile */
+#define MOTION_PROFILE_TRAPEZOID  0
+#define MOTION_PROFILE_SCURVE     1
+
+/* @Motion_State */
+#define MOTION_STATE_IDLE         0
+#define MOTION_STATE_RUNNING      1
+
+/* @Motion_Status */
+#define MOTION_OK                 0
+#define MOTION_ERROR              1 // 0 steps / 0 period / more than MOTION_COUNTER_MAX steps
+
+typedef struct{
+	uint8_t Profile;      // @Motion_Profile
+	uint16_t StartSpeed;  // steps/s the motor can start and stop at without a ramp (pull-in rate)
+	uint16_t MaxSpeed;    // steps/s at the top of the ramp table
+	uint32_t Accel;       // steps/s^2 (average over the ramp for SCURVE)
+} Motion_Config_t;
+
+/*
+ * Motion Handle
+ * pTIMx must already run PWM on channel 1 (TIM_PWM_Init), Motion_Init switches it to mode 2.
+ * pCounterTIMx: NULL -> pulses counted by the update ISR,
+ * otherwise its clock must be enabled, the rest is set up by Motion_Init.
+ * pProfileTIM: NULL -> ramp loaded by the update ISR, otherwise the handle of the SAME timer
+ * as pTIMx, already set up by TIM_DMA_BurstInit(TIM_DMABASE_ARR, 1 word).
+ * Everything below Motion_Config is owned by the driver.
+ */
+typedef struct{
+	TIM_RegDef_t *pTIMx;          // step timer, channel 1 = STEP pin
+	TIM_RegDef_t *pCounterTIMx;   // pulse counter (or NULL)
+	uint8_t CounterTrigger;       // @TIM_Trigger: ITRx of the counter wired to pTIMx's TRGO
+	uint8_t GateTrigger;          // @TIM_Trigger: ITRx of pTIMx wired to the counter's TRGO
+	TIM_Handle_t *pProfileTIM;    // DMA mode (or NULL)
+	Motion_Config_t Motion_Config;
+
+	uint32_t RampTable[MOTION_RAMP_MAX]; // ARR (period in ticks - 1), RampTable[0] = first step
+	uint32_t DecelTable[MOTION_RAMP_MAX]; // the same, last entry first
+	uint16_t RampLength;                 // entries actually used
+	uint32_t MinPeriod;                  // ticks, fastest step allowed (top of the ramp, or MaxSpeed)
+
+	// current move: written by Motion_Move, then only by the update ISR
+	uint32_t StepsTotal;
+	uint32_t AccelSteps;                 // ramp steps used on the way up (= on the way down)
+	uint32_t CruisePeriod;               // ticks
+	volatile uint32_t StepsDone;         // pulses fully sent (see Motion_GetStepsDone)
+	volatile uint8_t State;              // @Motion_State
+} Motion_Handle_t;
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+// Sets the prescaler (MOTION_TICK_HZ), PWM mode 2, ARPE and URS, links the counter, builds the ramp table
+void Motion_Init(Motion_Handle_t *pMotionHandle);
+
+/*
+ * Start a move of Steps pulses, cruising at one step per Period ticks (clamped to the table top).
+ * Period = MOTION_PERIOD_TICKS(MOTION_TICK_HZ, steps/s) (motion_math.h), worked out
+ * once in main(): this may run in an ISR, and has no division of its own.
+ * Restarts right away if a move is running: call Motion_Stop first, or chain it
+ * from Motion_CompleteCallback (the next move then starts without any idle gap).
+ */
+uint8_t Motion_Move(Motion_Handle_t *pMotionHandle, uint32_t Steps, uint32_t Period);
+
+/*
+ * The same without any ramp: every step at Period ticks (not limited by the ramp table).
+ * Meant for the slow ends of a move (e.g. microsteps at the start / stop rate) and for jogging.
+ */
+uint8_t Motion_MoveConstant(Motion_Handle_t *pMotionHandle, uint32_t Steps, uint32_t Period);
+
+/*
+ * Stop now (no ramp down), no completion callback.
+ * Counted mode: the step timer freezes at once (a pulse in progress is cut),
+ * otherwise it stops after the pulse in progress.
+ * Either way StepsDone then counts every rising edge the driver saw, the cut pulse
+ * or the one still finishing included: A4988_Advance(Motion_GetStepsDone()) stays exact.
+ */
+void Motion_Stop(Motion_Handle_t *pMotionHandle);
+
+// Clock-change hook: the prescaler again, so a tick stays 1 us (a running move keeps its speed)
+void Motion_ClockChanged(Motion_Handle_t *pMotionHandle);
+
+// Pulses sent so far by the current (or last) move, read from the counter while it runs
+uint32_t Motion_GetStepsDone(Motion_Handle_t *pMotionHandle);
+
+// How long Motion_Move(Steps, Period) takes, ramps included, in ms (rounded up)
+uint32_t Motion_EstimateMs(Motion_Handle_t *pMotionHandle, uint32_t Steps, uint32_t Period);
+
+// Step timer update interrupt: call it from the step timer's ISR
+void Motion_IRQHandling(Motion_Handle_t *pMotionHandle);
+
+// Counter CC1 (last pulse counted) / CC2 (DMA mode events) interrupt: call it from the counter timer's ISR
+void Motion_CounterIRQHandling(Motion_Handle_t *pMotionHandle);
+
+// Called from the ISR that sees the last pulse of a move go out (weak, override it)
+void Motion_CompleteCallback(Motion_Handle_t *pMotionHandle);
+
+#endif /* SOURCES_STEPPER_MOTION_H_ */
@@ -68,12 +68,30 @@
 #define GPIOG_BASEADDR      (AHB1_BASEADDR + 0x1800U)
 #define GPIOH_BASEADDR      (AHB1_BASEADDR + 0x1C00U)
 
+/*
+ * DMA Controllers (AHB1)
+ * DMA1: 0x4002 6000, DMA2: 0x4002 6400
+ */
+#define DMA1_BASEADDR       (AHB1_BASEADDR + 0x6000U)
+#define DMA2_BASEADDR       (AHB1_BASEADDR + 0x6400U)
+
+/*
+ * CRC calculation unit (AHB1): 0x4002 3000
+ */
+#define CRC_BASEADDR        (AHB1_BASEADDR + 0x3000U)
+
 /* RCC (Reset and Clock Control) Base Address.
  * We need this address to enable the clock for the GPIO peripherals.
  * Without enabling the clock in the RCC registers, GPIOs remain dead (powered down).
  */
 #define RCC_BASEADDR        (AHB1_BASEADDR + 0x3800U) //0x40023800
 
+/*
+ * Flash interface registers (AHB1): 0x4002 3C00
+ * wait states + ART accelerator, must follow every change of HCLK
+ */
+#define FLASH_BASEADDR      (AHB1_BASEADDR + 0x3C00U)
+
 /*
  * APB1 Peripherals (where TIM2 lives!)
  */
@@ -88,6 +106,10 @@
 
 #define TIM6_BASEADDR       (APB1_BASEADDR + 0x1000U) // TIM6: 0x4000 1000
 
+#define PWR_BASEADDR        (APB1_BASEADDR + 0x7000U) // PWR: 0x4000 7000 (voltage scaling, over-drive)
+
+#define RTC_BASEADDR        (APB1_BASEADDR + 0x2800U) // RTC: 0x4000 2800 (backup domain, runs in Stop mode)
+
 /*
  * APB2 Peripherals
  */
@@ -168,6 +190,53 @@ typedef struct{
 
 } RCC_RegDef_t;
 
+/*
+ * ==========================================
+ * 			FLASH Interface Register Map
+ * ==========================================
+ * RM0390 Section 3.8 Flash interface registers (only ACR is used here)
+ */
+typedef struct{
+	volatile uint32_t ACR;     // Access control register (latency, prefetch, caches), Offset: 0x00
+	volatile uint32_t KEYR;    // Key register,                                      Offset: 0x04
+	volatile uint32_t OPTKEYR; // Option key register,                               Offset: 0x08
+	volatile uint32_t SR;      // Status register,                                   Offset: 0x0C
+	volatile uint32_t CR;      // Control register,                                  Offset: 0x10
+	volatile uint32_t OPTCR;   // Option control register,                           Offset: 0x14
+} FLASH_RegDef_t;
+
+/*
+ * ==========================================
+ * 			PWR Register Map
+ * ==========================================
+ * RM0390 Section 5.5 PWR registers
+ */
+typedef struct{
+	volatile uint32_t CR;      // Power control register,        Offset: 0x00
+	volatile uint32_t CSR;     // Power control/status register, Offset: 0x04
+} PWR_RegDef_t;
+
+/*
+ * ==========================================
+ * 			RTC Register Map
+ * ==========================================
+ * RM0390 Section 22.6.21 RTC register map (up to the sub-second register, the rest is unused)
+ * Write-protected: WPR must be unlocked (0xCA, 0x53) before any other register is written.
+ */
+typedef struct{
+	volatile uint32_t TR;      // Time register (BCD),                 Offset: 0x00
+	volatile uint32_t DR;      // Date register (BCD),                 Offset: 0x04
+	volatile uint32_t CR;      // Control register,                    Offset: 0x08
+	volatile uint32_t ISR;     // Initialization and status register,  Offset: 0x0C
+	volatile uint32_t PRER;    // Prescaler register,                  Offset: 0x10
+	volatile uint32_t WUTR;    // Wakeup timer register,               Offset: 0x14
+	volatile uint32_t CALIBR;  // Calibration register,                Offset: 0x18
+	volatile uint32_t ALRMAR;  // Alarm A register,                    Offset: 0x1C
+	volatile uint32_t ALRMBR;  // Alarm B register,                    Offset: 0x20
+	volatile uint32_t WPR;     // Write protection register,           Offset: 0x24
+	volatile uint32_t SSR;     // Sub second register,                 Offset: 0x28
+} RTC_RegDef_t;
+
 /*
  * ==========================================
  * EXTI Register Definition Structure
@@ -216,12 +285,12 @@ typedef struct {
     volatile uint32_t CNT;      // Counter,                         Offset: 0x24
     volatile uint32_t PSC;      // Prescaler,                       Offset: 0x28
     volatile uint32_t ARR;      // Auto-reload register,            Offset: 0x2C
-    volatile uint32_t Reserved1;//                                  Offset: 0x30
+    volatile uint32_t RCR;      // Repetition counter (TIM1/8 only), Offset: 0x30
     volatile uint32_t CCR1;     // Capture/compare register 1,      Offset: 0x34
     volatile uint32_t CCR2;     // Capture/compare register 2,      Offset: 0x38
     volatile uint32_t CCR3;     // Capture/compare register 3,      Offset: 0x3C
     volatile uint32_t CCR4;     // Capture/compare register 4,      Offset: 0x40
-    volatile uint32_t Reserved2;//                                  Offset: 0x44
+    volatile uint32_t BDTR;     // Break and dead-time (TIM1/8 only), Offset: 0x44
     volatile uint32_t DCR;      // DMA control register,            Offset: 0x48
     volatile uint32_t DMAR;     // DMA address for full transfer,   Offset: 0x4C
 } TIM_RegDef_t;
@@ -252,6 +321,71 @@ typedef struct{
 // 0xE000E100 - 0xE000E11F -> NVIC_ISER0 - NVIC_ISER7
 #define NVIC_ISER_BASE_ADDR 0xE000E100U // according to pm0214 manual
 
+/*
+ * ==========================================
+ * DWT (Data Watchpoint and Trace) Register Structure Definition
+ * ==========================================
+ * Cortex-M4 debug unit (ARMv7-M Architecture Reference Manual C1.8), only the first 2 words used:
+ * CYCCNT counts every core clock cycle (HCLK) once CTRL Bit 0 CYCCNTENA is set,
+ * and it runs without a debugger attached, as long as DEMCR Bit 24 TRCENA is set.
+ */
+typedef struct{
+	volatile uint32_t CTRL;    // Control register,      Offset: 0x00
+	volatile uint32_t CYCCNT;  // Cycle count register,  Offset: 0x04
+} DWT_RegDef_t;
+
+#define DWT_BASE_ADDR       0xE0001000U
+#define DEMCR_ADDR          0xE000EDFCU // Debug Exception and Monitor Control Register (CoreDebug)
+
+/*
+ * ==========================================
+ * SysTick Register Structure Definition
+ * ==========================================
+ * Cortex-M4 24-bit down counter (PM0214 Section 4.5), its exception is SysTick_Handler.
+ */
+typedef struct{
+	volatile uint32_t CTRL;    // Control and status register, Offset: 0x00
+	volatile uint32_t LOAD;    // Reload value register,       Offset: 0x04
+	volatile uint32_t VAL;     // Current value register,      Offset: 0x08
+	volatile uint32_t CALIB;   // Calibration value register,  Offset: 0x0C
+} SysTick_RegDef_t;
+
+#define SYSTICK_BASE_ADDR   0xE000E010U
+
+/*
+ * NVIC ICPR (Interrupt Clear-Pending Registers, PM0214 Section 4.3.5)
+ * Same layout as ISER: writing 1 to a bit removes that IRQ from the pending state.
+ */
+#define NVIC_ICPR_BASE_ADDR 0xE000E280U
+
+/*
+ * System Control Register (PM0214 Section 4.4.6)
+ * Bit 1 SLEEPONEXIT: back to sleep after the last ISR returns, main() never resumes
+ * Bit 2 SLEEPDEEP: WFI enters the chip's deep sleep (Stop / Standby, see PWR_CR) instead of Sleep
+ */
+#define SCB_SCR_ADDR        0xE000ED10U
+
+/*
+ * Interrupt Control and State Register (PM0214 Section 4.4.3)
+ * Bit 28 PENDSVSET: makes PendSV pending (the context switch of kernel.h)
+ */
+#define SCB_ICSR_ADDR       0xE000ED04U
+
+/*
+ * System Handler Priority Register 3 (PM0214 Section 4.4.8)
+ * Bits 23:16 PendSV priority, Bits 31:24 SysTick priority (only the upper 4 bits of each exist)
+ */
+#define SCB_SHPR3_ADDR      0xE000ED20U
+
+/*
+ * Floating Point Unit (PM0214 Section 4.6)
+ * CPACR Bits 23:20 CP10 / CP11: coprocessor access, 11 = full access (both must match)
+ * FPCCR Bit 31 ASPEN: an exception saves the FP context automatically (CONTROL.FPCA)
+ *       Bit 30 LSPEN: lazily, only if the handler itself executes an FP instruction
+ */
+#define SCB_CPACR_ADDR      0xE000ED88U
+#define FPU_FPCCR_ADDR      0xE000EF34U
+
 /*
  * ==========================================
  * 			USART Register Map
@@ -282,6 +416,46 @@ typedef struct{
 	volatile uint32_t SR;   // Status register,    Offset: 0x0C
 } IWDG_RegDef_t;
 
+/*
+ * ==========================================
+ * 			CRC Register Map
+ * ==========================================
+ * RM0390 Section 12.4.4 CRC register map
+ */
+typedef struct{
+	volatile uint32_t DR;   // Data register (write: feed a word, read: result), Offset: 0x00
+	volatile uint32_t IDR;  // Independent data register (8 bits of scratch),    Offset: 0x04
+	volatile uint32_t CR;   // Control register (Bit 0 RESET),                   Offset: 0x08
+} CRC_RegDef_t;
+
+/*
+ * ==========================================
+ * 			DMA Register Map
+ * ==========================================
+ * RM0390 Section 9.5.11 DMA register map
+ *
+ * Each DMA controller has 4 shared flag registers followed by 8 identical "Streams".
+ * Every stream is a block of 6 registers (0x18 bytes), starting at offset 0x10:
+ * Stream x register address = 0x10 + 0x18 * x
+ * So an array of 8 stream structs lines up with the hardware automatically.
+ */
+typedef struct{
+	volatile uint32_t CR;   // Stream x configuration register,       Offset: 0x10 + 0x18 * x
+	volatile uint32_t NDTR; // Stream x number of data register,      Offset: 0x14 + 0x18 * x
+	volatile uint32_t PAR;  // Stream x peripheral address register,  Offset: 0x18 + 0x18 * x
+	volatile uint32_t M0AR; // Stream x memory 0 address register,    Offset: 0x1C + 0x18 * x
+	volatile uint32_t M1AR; // Stream x memory 1 address register,    Offset: 0x20 + 0x18 * x
+	volatile uint32_t FCR;  // Stream x FIFO control register,        Offset: 0x24 + 0x18 * x
+} DMA_Stream_RegDef_t;
+
+typedef struct{
+	volatile uint32_t LISR;  // Low interrupt status register (Stream 0-3),   Offset: 0x00
+	volatile uint32_t HISR;  // High interrupt status register (Stream 4-7),  Offset: 0x04
+	volatile uint32_t LIFCR; // Low interrupt flag clear register,            Offset: 0x08
+	volatile uint32_t HIFCR; // High interrupt flag clear register,           Offset: 0x0C
+	DMA_Stream_RegDef_t STREAM[8]; // Stream 0-7,                           Offset: 0x10 - 0xCC
+} DMA_RegDef_t;
+
 /*
  * ==========================================
  * 4. Peripheral Definitions (Typecasting)
@@ -311,9 +485,21 @@ typedef struct{
  * raw address value (0x40013C00) before casting, causing a compile error.
  */
 #define RCC     ( (RCC_RegDef_t*)RCC_BASEADDR )
+#define FLASH   ( (FLASH_RegDef_t*)FLASH_BASEADDR )
+#define PWR     ( (PWR_RegDef_t*)PWR_BASEADDR )
+#define RTC     ( (RTC_RegDef_t*)RTC_BASEADDR )
 #define EXTI    ( (EXTI_RegDef_t*)EXTI_BASEADDR )
 #define SYSCFG  ( (SYSCFG_RegDef_t*)SYSCFG_BASEADDR )
 #define NVIC_ISER ((NVIC_ISER_RegDef_t*)NVIC_ISER_BASE_ADDR )
+#define DWT     ( (DWT_RegDef_t*)DWT_BASE_ADDR )
+#define SYSTICK ( (SysTick_RegDef_t*)SYSTICK_BASE_ADDR )
+#define DEMCR   ( *(volatile uint32_t*)DEMCR_ADDR )
+#define SCB_SCR ( *(volatile uint32_t*)SCB_SCR_ADDR )
+#define SCB_ICSR ( *(volatile uint32_t*)SCB_ICSR_ADDR )
+#define SCB_SHPR3 ( *(volatile uint32_t*)SCB_SHPR3_ADDR )
+#define SCB_CPACR ( *(volatile uint32_t*)SCB_CPACR_ADDR )
+#define FPU_FPCCR ( *(volatile uint32_t*)FPU_FPCCR_ADDR )
+#define NVIC_ICPR ( (volatile uint32_t*)NVIC_ICPR_BASE_ADDR ) // NVIC_ICPR[IRQ / 32], bit IRQ % 32
 
 // Project 2: Timer definition
 #define TIM2    ( (TIM_RegDef_t*)TIM2_BASEADDR )
@@ -327,6 +513,21 @@ typedef struct{
  */
 #define USART2  ( (USART_RegDef_t*)USART2_BASEADDR )
 
+/*
+ * ==========================================
+ * 			DMA1 / DMA2
+ * ==========================================
+ */
+#define DMA1   ( (DMA_RegDef_t*)DMA1_BASEADDR )
+#define DMA2   ( (DMA_RegDef_t*)DMA2_BASEADDR )
+
+/*
+ * ==========================================
+ * 			CRC
+ * ==========================================
+ */
+#define CRC    ( (CRC_RegDef_t*)CRC_BASEADDR )
+
 /*
  * ==========================================
  * 			IWDG (System Recovery)
@@ -339,6 +540,7 @@ typedef struct{
  * 		 TIM6 (Replace Software Deay)
  * ==========================================
  */
+#define TIM1   ( (TIM_RegDef_t*)TIM1_BASEADDR ) // advanced timer: RCR / BDTR on top of the TIM2-5 registers
 #define TIM3   ( (TIM_RegDef_t*)TIM3_BASEADDR )
 
 #define TIM6   ( (TIM_RegDef_t*)TIM6_BASEADDR )
@@ -353,10 +555,61 @@ typedef struct{
  */
 #define EXTI15_10_IRQ (40)
 
+#define EXTI3_IRQ     (9)  // EXTI Line 3: PA3 (USART2_RX) as a Stop mode wake-up source
+
+#define RTC_WKUP_IRQ  (3)  // RTC wakeup timer through EXTI Line 22
+
 #define USART2_IRQ    (38)
 
+#define TIM2_IRQ      (28) // STEP pulse train (one update per step)
+
 #define TIM3_IRQ      (29)
 
 #define TIM6_IRQ      (54) // TIM6 global interrupt, DAC1 and DAC2 underrun error interrupts
 
+#define DMA1_STREAM5_IRQ (16) // USART2_RX lives on DMA1 Stream 5 (Channel 4)
+#define DMA1_STREAM6_IRQ (17) // USART2_TX lives on DMA1 Stream 6 (Channel 4)
+
+/*
+ * ==========================================
+ * 6. Cortex-M4 Core Helpers
+ * ==========================================
+ * Critical Section (PM0214 Section 2.3.7 / 3.12.2 MRS, MSR, CPS)
+ * PRIMASK = 1 blocks every maskable interrupt.
+ * We SAVE the previous PRIMASK instead of blindly re-enabling interrupts,
+ * so these calls can be nested, or used from inside an ISR, safely.
+ *
+ * Usage:
+ * uint32_t state = Critical_Enter();
+ * ... a few instructions that must not be interrupted ...
+ * Critical_Exit(state);
+ *
+ * The "memory" clobber stops the compiler from moving memory accesses across these lines.
+ */
+static inline uint32_t Critical_Enter(void){
+	uint32_t primask;
+	__asm volatile ("MRS %0, PRIMASK\n\tCPSID i" : "=r" (primask) : : "memory");
+	return primask;
+}
+
+static inline void Critical_Exit(uint32_t primask){
+	__asm volatile ("MSR PRIMASK, %0" : : "r" (primask) : "memory");
+}
+
+/*
+ * Data Memory Barrier (PM0214 Section 3.10.4 DMB)
+ * "Ensures that all explicit memory accesses that appear in program order before the DMB
+ * are observed before any explicit memory accesses that appear after the DMB."
+ * The "memory" clobber is the compiler half of the barrier: without it, the optimizer
+ * could still move a plain buffer write AFTER the index write that publishes it.
+ */
+#define MEMORY_BARRIER()  __asm volatile ("DMB" : : : "memory")
+
+/*
+ * Data / Instruction Synchronization Barriers (PM0214 Section 3.10.5 DSB, 3.10.6 ISB)
+ * After a write that changes how the core itself executes (e.g. CPACR): the write completes,
+ * then the pipeline is refetched, so the very next instruction sees the new setting.
+ */
+#define SYNC_BARRIER()    __asm volatile ("DSB\n\tISB" : : : "memory")
+
 #endif /* SOURCES_STM32F446XX_H_ */
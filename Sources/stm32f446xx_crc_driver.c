@@ -0,0 +1,198 @@
+/*
+ * stm32f446xx_crc_driver.c
+ *
+ *  Created on: 2026/2/13
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_crc_driver.h"
+#include "stm32f446xx_dma_driver.h"
+#include <stdint.h>
+
+// SET while a DMA job is feeding CRC_DR: any CPU write in between would corrupt its result
+static volatile uint8_t CRC_DMABusy = RESET;
+static const uint32_t *CRC_DMANext; // next chunk of a DMA job
+static uint32_t CRC_DMALeft;        // words not handed to the DMA yet
+
+void CRC_PeriClockControl(uint8_t EnableOrDisable){
+	if (EnableOrDisable == ENABLE){
+		CRC_PCLK_EN();
+	}
+	else{
+		CLEAR_BIT(RCC->AHB1ENR, 12);
+	}
+}
+
+/*
+ * ==========================================
+ * 			Software Reference
+ * ==========================================
+ */
+static uint32_t CRC_SoftwareStep(uint32_t Crc, uint8_t Bits){
+	for (uint8_t bit = 0; bit < Bits; bit++){
+		if (Crc & 0x80000000U){
+			Crc = (Crc << 1) ^ CRC_POLYNOMIAL;
+		}
+		else{
+			Crc = (Crc << 1);
+		}
+	}
+	return Crc;
+}
+
+// Little-endian word from any address (no alignment needed)
+static uint32_t CRC_LoadWord(const uint8_t *p){
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Leftover bytes: the same MSB-first shifting, 8 bits at a time
+static uint32_t CRC_SoftwareTail(uint32_t Crc, const uint8_t *pData, uint32_t Len){
+	while (Len > 0){
+		Crc ^= ((uint32_t)(*pData++) << 24);
+		Crc = CRC_SoftwareStep(Crc, 8);
+		Len--;
+	}
+	return Crc;
+}
+
+uint32_t CRC_Software(uint32_t Crc, const uint8_t *pData, uint32_t Len){
+	// whole words, exactly what one write to CRC_DR does
+	while (Len >= 4){
+		Crc ^= CRC_LoadWord(pData);
+		Crc = CRC_SoftwareStep(Crc, 32);
+		pData += 4;
+		Len -= 4;
+	}
+	return CRC_SoftwareTail(Crc, pData, Len);
+}
+
+/*
+ * ==========================================
+ * 			Hardware (CPU fed)
+ * ==========================================
+ */
+void CRC_Reset(void){
+	/*
+	 * CRC_CR Bit 0 RESET:
+	 * "Resets the CRC calculation unit and sets the data register to 0xFFFF FFFF.
+	 * This bit can only be set, it is automatically cleared by hardware."
+	 */
+	SET_BIT(CRC->CR, 0);
+}
+
+uint32_t CRC_Accumulate(const uint32_t *pWords, uint32_t NumWords){
+	for (uint32_t i = 0; i < NumWords; i++){
+		CRC->DR = pWords[i]; // the AHB simply stalls the next access until the 4 cycles are over
+	}
+	return CRC->DR;
+}
+
+uint32_t CRC_Calculate(const uint8_t *pData, uint32_t Len){
+#ifdef CRC_USE_SOFTWARE
+	return CRC_Software(CRC_INIT_VALUE, pData, Len);
+#else
+	if (CRC_DMABusy){
+		return CRC_Software(CRC_INIT_VALUE, pData, Len); // slower, but identical
+	}
+
+	CRC_Reset();
+
+	// Word aligned (Flash images, most buffers): one LDR per word instead of four byte loads
+	if (((uint32_t)pData & 0x3U) == 0){
+		(void)CRC_Accumulate((const uint32_t*)pData, Len / 4U);
+		pData += Len & ~3U;
+		Len &= 3U;
+	}
+	while (Len >= 4){
+		CRC->DR = CRC_LoadWord(pData);
+		pData += 4;
+		Len -= 4;
+	}
+
+	return CRC_SoftwareTail(CRC->DR, pData, Len);
+#endif
+}
+
+/*
+ * ==========================================
+ * 			Hardware (DMA fed)
+ * ==========================================
+ */
+void CRC_DMA_Init(DMA_Handle_t *pDMAHandle){
+	pDMAHandle->DMA_Config.DMA_Channel = 0;                    // unused for memory-to-memory
+	pDMAHandle->DMA_Config.DMA_Direction = DMA_DIR_MEM_TO_MEM;
+	pDMAHandle->DMA_Config.DMA_MemInc = DISABLE;               // destination: CRC_DR, always the same address
+	pDMAHandle->DMA_Config.DMA_PeriphInc = ENABLE;             // source: walks through the buffer
+	pDMAHandle->DMA_Config.DMA_DataSize = DMA_SIZE_WORD;
+	pDMAHandle->DMA_Config.DMA_Mode = DMA_MODE_NORMAL;         // circular is not allowed for M2M
+	pDMAHandle->DMA_Config.DMA_Priority = DMA_PRIORITY_LOW;    // background job, never delay the UART
+	pDMAHandle->DMA_Config.DMA_Interrupts = 0;                 // polled with CRC_DMA_Poll
+
+	DMA_PeriClockControl(pDMAHandle->pDMAx, ENABLE);
+	DMA_Init(pDMAHandle);
+}
+
+/*
+ * One DMA transfer of at most CRC_DMA_MAX_WORDS (NDTR is 16 bits), the rest waits in
+ * CRC_DMANext / CRC_DMALeft. The CRC unit is NOT reset in between: the chunks chain
+ * into one CRC, exactly as a single transfer would.
+ */
+static uint8_t CRC_DMA_StartChunk(DMA_Handle_t *pDMAHandle){
+	uint32_t words = (CRC_DMALeft > CRC_DMA_MAX_WORDS) ? CRC_DMA_MAX_WORDS : CRC_DMALeft;
+
+	/*
+	 * Memory-to-memory: PAR = source, M0AR = destination (RM0390 9.3.6)
+	 * NOTE: 'Peripheral' and 'Memory' are just the names of the two DMA ports here.
+	 * For M2M, enabling the stream IS the request: the DMA starts right away.
+	 */
+	if (DMA_StartTransfer(pDMAHandle, (uint32_t)CRC_DMANext, (uint32_t)&CRC->DR, (uint16_t)words) != DMA_OK){
+		CRC_DMABusy = RESET;
+		return CRC_ERROR; // the caller falls back to the CPU
+	}
+
+	CRC_DMANext += words;
+	CRC_DMALeft -= words;
+	return CRC_OK;
+}
+
+uint8_t CRC_DMA_Start(DMA_Handle_t *pDMAHandle, const uint32_t *pWords, uint32_t NumWords){
+	if (CRC_DMABusy || (NumWords == 0)){
+		return CRC_BUSY;
+	}
+
+	CRC_DMABusy = SET;
+	CRC_DMANext = pWords;
+	CRC_DMALeft = NumWords;
+	CRC_Reset();
+
+	return CRC_DMA_StartChunk(pDMAHandle);
+}
+
+uint8_t CRC_DMA_Poll(DMA_Handle_t *pDMAHandle, uint32_t *pResult){
+	if (!CRC_DMABusy){
+		return CRC_ERROR; // nothing was started
+	}
+
+	uint8_t flags = DMA_GetFlags(pDMAHandle);
+
+	if (flags & DMA_FLAG_TE){
+		DMA_StopTransfer(pDMAHandle);
+		CRC_DMABusy = RESET;
+		return CRC_ERROR;
+	}
+
+	if ( !(flags & DMA_FLAG_TC) ){
+		return CRC_BUSY;
+	}
+
+	DMA_ClearFlags(pDMAHandle, DMA_FLAG_ALL);
+
+	// More than one transfer's worth: next chunk, same running CRC
+	if (CRC_DMALeft != 0){
+		return (CRC_DMA_StartChunk(pDMAHandle) == CRC_OK) ? CRC_BUSY : CRC_ERROR;
+	}
+
+	*pResult = CRC->DR;
+	CRC_DMABusy = RESET;
+	return CRC_OK;
+}
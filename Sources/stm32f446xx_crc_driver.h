@@ -0,0 +1,108 @@
+/*
+ * stm32f446xx_crc_driver.h
+ *
+ *  Created on: 2026/2/13
+ *      Author: Yuheng
+ *
+ * Description:
+ * Header file for the CRC (Cyclic Redundancy Check) calculation unit Driver.
+ *
+ * Why?
+ * A bit-by-bit software CRC-32 costs ~8 shifts/XORs per bit, i.e. hundreds of cycles per word.
+ * The CRC unit does one whole 32-bit word in 4 AHB cycles: we write the word into CRC_DR,
+ * and CRC_DR already holds the updated CRC when we read it back.
+ *
+ * The algorithm is FIXED in hardware on the F446 (RM0390 Chapter 12):
+ * - Polynomial 0x04C11DB7 (CRC-32 / Ethernet polynomial)
+ * - Initial value 0xFFFFFFFF (after CR RESET)
+ * - 32-bit words only, processed MSB first, no bit reflection, no final XOR
+ * (= "CRC-32/MPEG-2" when the bytes of each word are taken most significant first)
+ *
+ * Words vs bytes:
+ * The unit only takes words. A byte buffer is fed as little-endian words (how the CPU loads it),
+ * and the 0-3 leftover bytes are finished in software, one 8-bit step each.
+ * CRC_Software gives bit-identical results without touching the hardware,
+ * for host-side testing (build with CRC_USE_SOFTWARE) and while the unit is busy with a DMA job.
+ */
+
+#ifndef SOURCES_STM32F446XX_CRC_DRIVER_H_
+#define SOURCES_STM32F446XX_CRC_DRIVER_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+#include "stm32f446xx_dma_driver.h"
+
+/*
+ * ==========================================
+ * 1. Clock Enable Macro
+ * ==========================================
+ * RCC AHB1 peripheral clock enable register (RCC_AHB1ENR)
+ * Bit 12 CRCEN: CRC clock enable
+ */
+#define CRC_PCLK_EN()  ( SET_BIT(RCC->AHB1ENR, 12) )
+
+/*
+ * ==========================================
+ * 2. Constants
+ * ==========================================
+ */
+#define CRC_POLYNOMIAL   0x04C11DB7U
+#define CRC_INIT_VALUE   0xFFFFFFFFU
+
+/* @CRC_Status */
+#define CRC_OK           0
+#define CRC_BUSY         1 // a DMA job owns the unit
+#define CRC_ERROR        2 // DMA transfer error
+
+/*
+ * ==========================================
+ * 		3. Function Prototypes
+ * ==========================================
+ */
+void CRC_PeriClockControl(uint8_t EnableOrDisable);
+
+/*
+ * Direct register access (main() only, and only when no DMA job is running)
+ * CRC_Reset:      CR Bit 0 RESET -> DR back to 0xFFFFFFFF
+ * CRC_Accumulate: feed NumWords words, returns the running CRC (CRC_Calculate, aligned buffers)
+ */
+void CRC_Reset(void);
+uint32_t CRC_Accumulate(const uint32_t *pWords, uint32_t NumWords);
+
+/*
+ * One-shot CRC of a byte buffer (any length, any alignment).
+ * Uses the hardware, or CRC_Software if the unit is busy (or CRC_USE_SOFTWARE is defined).
+ * Not reentrant: call it from main() only, never from an ISR.
+ */
+uint32_t CRC_Calculate(const uint8_t *pData, uint32_t Len);
+
+/*
+ * Software reference, continues from Crc (start with CRC_INIT_VALUE).
+ * Safe anywhere (ISR, host PC), same results as the hardware.
+ */
+uint32_t CRC_Software(uint32_t Crc, const uint8_t *pData, uint32_t Len);
+
+/*
+ * ==========================================
+ * 	4. DMA Feed (bulk checksums, CPU free)
+ * ==========================================
+ * Memory-to-memory transfer on DMA2 (DMA1 cannot do memory-to-memory):
+ * source = the buffer (the "peripheral" side for M2M, address incrementing),
+ * destination = CRC_DR (fixed address), one word per item.
+ *
+ * CRC_DMA_Init: fills pDMAHandle->DMA_Config (pDMAx = DMA2 and Stream must be set by the caller)
+ * CRC_DMA_Start: resets the CRC and starts feeding pWords (word aligned, any number of words > 0)
+ * CRC_DMA_Poll: CRC_BUSY while running, then CRC_OK (*pResult = CRC) or CRC_ERROR,
+ *               and the unit is free again
+ *
+ * One transfer moves at most CRC_DMA_MAX_WORDS (256 KB): a longer job is split,
+ * CRC_DMA_Poll starts the next chunk when one completes (poll it regularly).
+ * [Previously] NumWords was a uint16_t: a caller with more words silently truncated it.
+ */
+#define CRC_DMA_MAX_WORDS  65535U // NDTR is 16 bits
+
+void CRC_DMA_Init(DMA_Handle_t *pDMAHandle);
+uint8_t CRC_DMA_Start(DMA_Handle_t *pDMAHandle, const uint32_t *pWords, uint32_t NumWords);
+uint8_t CRC_DMA_Poll(DMA_Handle_t *pDMAHandle, uint32_t *pResult);
+
+#endif /* SOURCES_STM32F446XX_CRC_DRIVER_H_ */
@@ -0,0 +1,190 @@
+/*
+ * stm32f446xx_dma_driver.c
+ *
+ *  Created on: 2026/2/3
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_dma_driver.h"
+#include "timestamp.h"
+#include <stdint.h>
+
+/*
+ * Bit position of a stream's 6 flags inside LISR/HISR (and LIFCR/HIFCR)
+ * Stream:  0/4  1/5  2/6  3/7
+ * Offset:  0    6    16   22
+ */
+static const uint8_t DMA_FlagOffset[4] = {0, 6, 16, 22};
+
+/*
+ * EN = 0, then wait for it to read back 0: the stream finishes the item in flight first.
+ * [Previously] an endless wait. A stuck bus (or a stream that was never clocked) hung the caller,
+ * possibly an ISR. Now it gives up after DMA_DISABLE_TIMEOUT_US.
+ */
+static uint8_t DMA_DisableStream(DMA_Stream_RegDef_t *pStream){
+	uint32_t deadline = Timestamp_Deadline(DMA_DISABLE_TIMEOUT_US);
+
+	CLEAR_BIT(pStream->CR, 0);
+	while ( READ_BIT(pStream->CR, 0) ){
+		if (Timestamp_Expired(deadline)){
+			return DMA_TIMEOUT;
+		}
+	}
+	return DMA_OK;
+}
+
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnableOrDisable){
+	if (EnableOrDisable == ENABLE){
+		if (pDMAx == DMA1){
+			DMA1_PCLK_EN();
+		}
+		else if (pDMAx == DMA2){
+			DMA2_PCLK_EN();
+		}
+	}
+	else{
+		if (pDMAx == DMA1){
+			CLEAR_BIT(RCC->AHB1ENR, 21);
+		}
+		else if (pDMAx == DMA2){
+			CLEAR_BIT(RCC->AHB1ENR, 22);
+		}
+	}
+}
+
+uint8_t DMA_Init(DMA_Handle_t *pDMAHandle){
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->STREAM[pDMAHandle->Stream];
+	DMA_Config_t DMA_Config = pDMAHandle->DMA_Config;
+
+	/*
+	 * ==========================================
+	 * 	1. Make sure the stream is OFF
+	 * ==========================================
+	 * RM0390 9.3.18 Stream configuration procedure:
+	 * "If the stream is enabled, disable it by resetting the EN bit in the DMA_SxCR register,
+	 * then read this bit in order to confirm that there is no ongoing stream operation."
+	 * Writing the configuration while EN = 1 is simply ignored by the hardware.
+	 */
+	if (DMA_DisableStream(pStream) != DMA_OK){
+		return DMA_TIMEOUT;
+	}
+
+	// Clear any leftover flags from a previous transfer
+	DMA_ClearFlags(pDMAHandle, DMA_FLAG_ALL);
+
+	/*
+	 * ==========================================
+	 * 	2. Build the CR value in one go
+	 * ==========================================
+	 * Bits 27:25 CHSEL: Channel selection
+	 * Bits 17:16 PL:    Priority level
+	 * Bits 14:13 MSIZE: Memory data size
+	 * Bits 12:11 PSIZE: Peripheral data size
+	 * Bit 10 MINC:      Memory increment mode
+	 * Bit 9 PINC:       Peripheral increment mode
+	 * Bit 8 CIRC:       Circular mode
+	 * Bits 7:6 DIR:     Data transfer direction
+	 * Bits 4:2:         TCIE / HTIE / TEIE
+	 */
+	uint32_t cr = 0;
+	cr |= ((uint32_t)(DMA_Config.DMA_Channel & 0x7) << 25);
+	cr |= ((uint32_t)(DMA_Config.DMA_Priority & 0x3) << 16);
+	cr |= ((uint32_t)(DMA_Config.DMA_DataSize & 0x3) << 13);
+	cr |= ((uint32_t)(DMA_Config.DMA_DataSize & 0x3) << 11);
+	if (DMA_Config.DMA_MemInc == ENABLE){
+		cr |= (1U << 10);
+	}
+	if (DMA_Config.DMA_PeriphInc == ENABLE){
+		cr |= (1U << 9);
+	}
+	if (DMA_Config.DMA_Mode == DMA_MODE_CIRCULAR){
+		cr |= (1U << 8);
+	}
+	cr |= ((uint32_t)(DMA_Config.DMA_Direction & 0x3) << 6);
+	cr |= (DMA_Config.DMA_Interrupts & (DMA_IT_TE | DMA_IT_HT | DMA_IT_TC));
+
+	pStream->CR = cr;
+
+	/*
+	 * ==========================================
+	 * 	3. FIFO: Direct mode
+	 * ==========================================
+	 * FCR Bit 2 DMDIS = 0 -> Direct mode (FIFO bypassed).
+	 * Each request moves exactly one item, which is what a USART wants.
+	 * (Memory-to-memory forces FIFO mode by hardware anyway.)
+	 */
+	CLEAR_BIT(pStream->FCR, 2);
+	return DMA_OK;
+}
+
+uint8_t DMA_StartTransfer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t MemAddr, uint16_t Len){
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->STREAM[pDMAHandle->Stream];
+
+	// Same rule as DMA_Init: the address/length registers are locked while EN = 1
+	if (DMA_DisableStream(pStream) != DMA_OK){
+		return DMA_TIMEOUT;
+	}
+
+	// A stale TC flag would make the ISR think this new transfer is already done
+	DMA_ClearFlags(pDMAHandle, DMA_FLAG_ALL);
+
+	pStream->PAR = PeriphAddr;
+	pStream->M0AR = MemAddr;
+	pStream->NDTR = Len;
+
+	// Bit 0 EN: Stream enable -> the hardware takes over from here
+	SET_BIT(pStream->CR, 0);
+	return DMA_OK;
+}
+
+uint8_t DMA_StopTransfer(DMA_Handle_t *pDMAHandle){
+	DMA_Stream_RegDef_t *pStream = &pDMAHandle->pDMAx->STREAM[pDMAHandle->Stream];
+
+	// the current item is finished before EN reads back 0
+	uint8_t status = DMA_DisableStream(pStream);
+
+	DMA_ClearFlags(pDMAHandle, DMA_FLAG_ALL);
+	return status;
+}
+
+uint16_t DMA_GetRemaining(DMA_Handle_t *pDMAHandle){
+	// NDTR counts DOWN: number of items still left to move
+	return (uint16_t)(pDMAHandle->pDMAx->STREAM[pDMAHandle->Stream].NDTR & 0xFFFF);
+}
+
+uint8_t DMA_IsEnabled(DMA_Handle_t *pDMAHandle){
+	return READ_BIT(pDMAHandle->pDMAx->STREAM[pDMAHandle->Stream].CR, 0) ? SET : RESET;
+}
+
+uint8_t DMA_GetFlags(DMA_Handle_t *pDMAHandle){
+	uint8_t stream = pDMAHandle->Stream;
+	uint32_t isr = (stream < 4) ? pDMAHandle->pDMAx->LISR : pDMAHandle->pDMAx->HISR;
+
+	return (uint8_t)((isr >> DMA_FlagOffset[stream & 0x3]) & DMA_FLAG_ALL);
+}
+
+void DMA_ClearFlags(DMA_Handle_t *pDMAHandle, uint8_t Flags){
+	uint8_t stream = pDMAHandle->Stream;
+	uint32_t mask = ((uint32_t)(Flags & DMA_FLAG_ALL) << DMA_FlagOffset[stream & 0x3]);
+
+	/*
+	 * LIFCR/HIFCR are "write 1 to clear" registers, writing 0 has no effect.
+	 * So a plain '=' (not '|=') is correct and does not touch the other streams.
+	 */
+	if (stream < 4){
+		pDMAHandle->pDMAx->LIFCR = mask;
+	}
+	else{
+		pDMAHandle->pDMAx->HIFCR = mask;
+	}
+}
+
+void DMA_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnableOrDisable){
+	// Same NVIC_ISER logic as USART_IRQInterruptConfig / TIM_IRQInterruptConfig
+	uint8_t register_num = IRQNumber / 32;
+	uint8_t target_bit = IRQNumber % 32;
+
+	if (EnableOrDisable == ENABLE){
+		SET_BIT(NVIC_ISER->ISER[register_num], target_bit);
+	}
+}
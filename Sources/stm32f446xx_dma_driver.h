@@ -0,0 +1,141 @@
+/*
+ * stm32f446xx_dma_driver.h
+ *
+ *  Created on: 2026/2/3
+ *      Author: Yuheng
+ *
+ * Description:
+ * Header file for DMA (Direct Memory Access) Driver.
+ *
+ * Why DMA?
+ * Even with interrupts, the CPU still has to move every single byte into USART_DR itself.
+ * A DMA stream is a tiny "copy engine" that moves data between memory and a peripheral
+ * on its own, and only interrupts the CPU once the whole block is done.
+ *
+ * Streams & Channels (RM0390 Table 28. DMA1 request mapping):
+ * Each DMA controller has 8 Streams, and each Stream can be connected to
+ * one of 8 Channels (= which peripheral request it listens to).
+ * e.g. USART2_TX -> DMA1 Stream 6 Channel 4
+ *      USART2_RX -> DMA1 Stream 5 Channel 4
+ */
+
+#ifndef SOURCES_STM32F446XX_DMA_DRIVER_H_
+#define SOURCES_STM32F446XX_DMA_DRIVER_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+/*
+ * ==========================================
+ * 1. Clock Enable Macros
+ * ==========================================
+ * RCC AHB1 peripheral clock enable register (RCC_AHB1ENR)
+ * Bit 21 DMA1EN: DMA1 clock enable
+ * Bit 22 DMA2EN: DMA2 clock enable
+ */
+#define DMA1_PCLK_EN()  ( SET_BIT(RCC->AHB1ENR, 21) )
+#define DMA2_PCLK_EN()  ( SET_BIT(RCC->AHB1ENR, 22) )
+
+/*
+ * ==========================================
+ * 2. Configuration Structures
+ * ==========================================
+ */
+typedef struct{
+	uint8_t DMA_Channel;       // 0-7, which peripheral request this stream serves
+	uint8_t DMA_Direction;     // @DMA_Direction
+	uint8_t DMA_MemInc;        // ENABLE: memory address moves forward after each item
+	uint8_t DMA_PeriphInc;     // ENABLE: peripheral address moves forward (only for memory-to-memory)
+	uint8_t DMA_DataSize;      // @DMA_DataSize (same size used on both sides)
+	uint8_t DMA_Mode;          // @DMA_Mode
+	uint8_t DMA_Priority;      // @DMA_Priority
+	uint8_t DMA_Interrupts;    // @DMA_Interrupts (OR them together)
+} DMA_Config_t;
+
+/*
+ * DMA Handle Structure
+ * Concept: "Job Order" (same as the other drivers)
+ * - "Where" to do the job: pDMAx + Stream number
+ * - "How" to do the job:   DMA_Config
+ */
+typedef struct{
+	DMA_RegDef_t *pDMAx;     // DMA1 or DMA2
+	uint8_t Stream;          // 0-7
+	DMA_Config_t DMA_Config;
+} DMA_Handle_t;
+
+/*
+ * ==========================================
+ * 3. Configuration Macros (DMA Specific)
+ * ==========================================
+ */
+/* @DMA_Direction (CR Bits 7:6 DIR) */
+#define DMA_DIR_PERIPH_TO_MEM  0
+#define DMA_DIR_MEM_TO_PERIPH  1
+#define DMA_DIR_MEM_TO_MEM     2 // DMA2 only
+
+/* @DMA_DataSize (CR Bits 14:13 MSIZE / 12:11 PSIZE) */
+#define DMA_SIZE_BYTE          0
+#define DMA_SIZE_HALFWORD      1
+#define DMA_SIZE_WORD          2
+
+/* @DMA_Mode */
+#define DMA_MODE_NORMAL        0 // stop after NDTR items
+#define DMA_MODE_CIRCULAR      1 // reload NDTR and start over forever (CR Bit 8 CIRC)
+
+/* @DMA_Priority (CR Bits 17:16 PL) */
+#define DMA_PRIORITY_LOW       0
+#define DMA_PRIORITY_MEDIUM    1
+#define DMA_PRIORITY_HIGH      2
+#define DMA_PRIORITY_VERY_HIGH 3
+
+/* @DMA_Interrupts (positions match the CR register: TEIE Bit 2, HTIE Bit 3, TCIE Bit 4) */
+#define DMA_IT_TE              (1U << 2) // Transfer Error
+#define DMA_IT_HT              (1U << 3) // Half Transfer
+#define DMA_IT_TC              (1U << 4) // Transfer Complete
+
+/*
+ * @DMA_Flags
+ * Every stream owns 6 bits in LISR/HISR, but at 4 different positions
+ * (Stream 0/4 -> Bit 0, 1/5 -> Bit 6, 2/6 -> Bit 16, 3/7 -> Bit 22).
+ * DMA_GetFlags shifts them back down, so callers always see the Stream 0 layout below.
+ */
+#define DMA_FLAG_FE            (1U << 0) // FIFO error
+#define DMA_FLAG_DME           (1U << 2) // Direct mode error
+#define DMA_FLAG_TE            (1U << 3) // Transfer error
+#define DMA_FLAG_HT            (1U << 4) // Half transfer
+#define DMA_FLAG_TC            (1U << 5) // Transfer complete
+#define DMA_FLAG_ALL           (DMA_FLAG_FE | DMA_FLAG_DME | DMA_FLAG_TE | DMA_FLAG_HT | DMA_FLAG_TC)
+
+/* @DMA_Status */
+#define DMA_OK                 0
+#define DMA_TIMEOUT            1 // the stream did not turn off (EN stuck at 1): nothing was changed
+
+#define DMA_DISABLE_TIMEOUT_US 100U // a stream only finishes the item in flight, far below this
+
+/*
+ * ==========================================
+ * 		4. Function Prototypes
+ * ==========================================
+ */
+void DMA_PeriClockControl(DMA_RegDef_t *pDMAx, uint8_t EnableOrDisable);
+uint8_t DMA_Init(DMA_Handle_t *pDMAHandle); // @DMA_Status
+
+/*
+ * Start / Stop
+ * PeriphAddr: address of the peripheral register (e.g. &USART2->DR)
+ *             for memory-to-memory this is the SOURCE address
+ * MemAddr:    address of the memory buffer (destination for memory-to-memory)
+ * Len:        number of items (of DMA_DataSize), 1 - 65535
+ */
+uint8_t DMA_StartTransfer(DMA_Handle_t *pDMAHandle, uint32_t PeriphAddr, uint32_t MemAddr, uint16_t Len); // @DMA_Status
+uint8_t DMA_StopTransfer(DMA_Handle_t *pDMAHandle); // @DMA_Status
+uint16_t DMA_GetRemaining(DMA_Handle_t *pDMAHandle);
+uint8_t DMA_IsEnabled(DMA_Handle_t *pDMAHandle);
+
+uint8_t DMA_GetFlags(DMA_Handle_t *pDMAHandle);
+void DMA_ClearFlags(DMA_Handle_t *pDMAHandle, uint8_t Flags);
+
+void DMA_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnableOrDisable);
+
+#endif /* SOURCES_STM32F446XX_DMA_DRIVER_H_ */
@@ -0,0 +1,441 @@
+/*
+ * stm32f446xx_rcc_driver.c
+ *
+ *  Created on: 2026/2/9
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_rcc_driver.h"
+#include "timestamp.h"
+#include <stdint.h>
+
+/*
+ * CFGR Bits 7:4 HPRE (AHB prescaler)
+ * 0xxx: not divided, 1000: /2, 1001: /4 ... 1111: /512 (note: /32 does not exist)
+ */
+static const uint16_t AHB_Prescaler[8] = {2, 4, 8, 16, 64, 128, 256, 512};
+
+/*
+ * CFGR Bits 12:10 PPRE1 / Bits 15:13 PPRE2 (APB prescalers)
+ * 0xx: not divided, 100: /2, 101: /4, 110: /8, 111: /16
+ */
+static const uint8_t APB_Prescaler[4] = {2, 4, 8, 16};
+
+// Clk through an HPRE / PPRE code (the same decoding as the registers)
+static uint32_t RCC_ApplyAHB(uint32_t Clk, uint8_t Hpre){
+	return (Hpre < 8) ? Clk : (Clk / AHB_Prescaler[Hpre - 8]);
+}
+
+static uint32_t RCC_ApplyAPB(uint32_t Clk, uint8_t Ppre){
+	return (Ppre < 4) ? Clk : (Clk / APB_Prescaler[Ppre - 4]);
+}
+
+/*
+ * PLL output frequency
+ * f_VCO = f_PLL_input x (PLLN / PLLM)
+ * f_PLL_P = f_VCO / PLLP   (PLLP = 2, 4, 6, 8)
+ * f_PLL_R = f_VCO / PLLR   (PLLR = 2 - 7)
+ *
+ * RCC_PLLCFGR:
+ * Bits 5:0   PLLM
+ * Bits 14:6  PLLN
+ * Bits 17:16 PLLP (00: 2, 01: 4, 10: 6, 11: 8)
+ * Bit 22     PLLSRC (0: HSI, 1: HSE)
+ * Bits 30:28 PLLR
+ */
+static uint32_t RCC_GetPLLOutput(uint8_t UseR){
+	uint32_t pllcfgr = RCC->PLLCFGR;
+	uint32_t pllm = pllcfgr & 0x3F;
+	uint32_t plln = (pllcfgr >> 6) & 0x1FF;
+	uint32_t input = READ_BIT(pllcfgr, 22) ? RCC_HSE_VALUE : RCC_HSI_VALUE;
+
+	if (pllm == 0){
+		return 0; // PLLM = 0/1 are "wrong configuration" values, no valid output
+	}
+
+	// f_in / M first (1 - 2 MHz), so N x that stays well inside 32 bits
+	uint32_t vco = (input / pllm) * plln;
+
+	if (UseR){
+		uint32_t pllr = (pllcfgr >> 28) & 0x7;
+		return (pllr >= 2) ? (vco / pllr) : 0;
+	}
+
+	uint32_t pllp = (((pllcfgr >> 16) & 0x3) + 1) * 2;
+	return vco / pllp;
+}
+
+uint32_t RCC_GetSYSCLKValue(void){
+	/*
+	 * CFGR Bits 3:2 SWS: System clock switch status (set by hardware)
+	 * 00: HSI, 01: HSE, 10: PLL_P, 11: PLL_R
+	 * SWS (not SW) is what is ACTUALLY running, a requested switch may still be pending.
+	 */
+	uint8_t sws = (RCC->CFGR >> 2) & 0x3;
+
+	switch (sws){
+	case 0:  return RCC_HSI_VALUE;
+	case 1:  return RCC_HSE_VALUE;
+	case 2:  return RCC_GetPLLOutput(RESET);
+	default: return RCC_GetPLLOutput(SET);
+	}
+}
+
+uint32_t RCC_GetHCLKValue(void){
+	return RCC_ApplyAHB(RCC_GetSYSCLKValue(), (RCC->CFGR >> 4) & 0xF);
+}
+
+uint32_t RCC_GetPCLK1Value(void){
+	return RCC_ApplyAPB(RCC_GetHCLKValue(), (RCC->CFGR >> 10) & 0x7);
+}
+
+uint32_t RCC_GetPCLK2Value(void){
+	return RCC_ApplyAPB(RCC_GetHCLKValue(), (RCC->CFGR >> 13) & 0x7);
+}
+
+/*
+ * RM0390 6.2 (and DCKCFGR Bit 24 TIMPRE):
+ * TIMPRE = 0: timer clock = HCLK if APB prescaler is 1, otherwise 2 x PCLK
+ * TIMPRE = 1: timer clock = HCLK if APB prescaler is 1, 2 or 4, otherwise 4 x PCLK
+ */
+static uint32_t RCC_GetTimerClock(uint8_t Ppre, uint32_t Pclk){
+	if (Ppre < 4){
+		return Pclk;
+	}
+	if (READ_BIT(RCC->DCKCFGR, 24)){
+		return (Ppre <= 5) ? RCC_GetHCLKValue() : (Pclk * 4);
+	}
+	return Pclk * 2;
+}
+
+uint32_t RCC_GetTimerClock1Value(void){
+	return RCC_GetTimerClock((RCC->CFGR >> 10) & 0x7, RCC_GetPCLK1Value());
+}
+
+uint32_t RCC_GetTimerClock2Value(void){
+	return RCC_GetTimerClock((RCC->CFGR >> 13) & 0x7, RCC_GetPCLK2Value());
+}
+
+uint32_t RCC_GetPeripheralClock(uint32_t PeriphBaseAddr){
+	if ((PeriphBaseAddr >= APB2_BASEADDR) && (PeriphBaseAddr < AHB1_BASEADDR)){
+		return RCC_GetPCLK2Value();
+	}
+	return RCC_GetPCLK1Value();
+}
+
+/*
+ * ==========================================
+ * 		System Clock Configuration
+ * ==========================================
+ */
+#define RCC_PLLCFGR_MASK  ((0x3FU << 0) | (0x1FFU << 6) | (0x3U << 16) | (1U << 22)) // PLLM, PLLN, PLLP, PLLSRC
+
+static RCC_ClockHook_t ClockHooks[RCC_MAX_CLOCK_HOOKS];
+static uint8_t ClockHookCount;
+
+uint8_t RCC_RegisterClockHook(RCC_ClockHook_t Hook){
+	if (ClockHookCount >= RCC_MAX_CLOCK_HOOKS){
+		return RCC_ERROR;
+	}
+	ClockHooks[ClockHookCount++] = Hook;
+	return RCC_OK;
+}
+
+// Wait for Bit of *pReg to read State, at most RCC_READY_TIMEOUT_US
+static uint8_t RCC_WaitBit(volatile uint32_t *pReg, uint8_t Bit, uint8_t State){
+	uint32_t deadline = Timestamp_Deadline(RCC_READY_TIMEOUT_US);
+
+	while ((READ_BIT(*pReg, Bit) ? SET : RESET) != State){
+		if (Timestamp_Expired(deadline)){
+			return RCC_TIMEOUT;
+		}
+	}
+	return RCC_OK;
+}
+
+/*
+ * CFGR Bits 1:0 SW: System clock switch (00: HSI, 01: HSE, 10: PLL_P)
+ * then wait for Bits 3:2 SWS to show it: the switch only happens once the new source is ready.
+ */
+static uint8_t RCC_SwitchSysClk(uint8_t Sw){
+	uint32_t deadline = Timestamp_Deadline(RCC_READY_TIMEOUT_US);
+
+	RCC->CFGR = (RCC->CFGR & ~0x3U) | Sw;
+	while (((RCC->CFGR >> 2) & 0x3) != Sw){
+		if (Timestamp_Expired(deadline)){
+			return RCC_TIMEOUT;
+		}
+	}
+	return RCC_OK;
+}
+
+/*
+ * FLASH_ACR Bits 3:0 LATENCY: wait states (RM0390 3.4.1: the new value must be READ BACK
+ * before the clock goes up, otherwise the CPU fetches faster than the flash can answer)
+ */
+static uint8_t RCC_SetFlashLatency(uint8_t WaitStates){
+	FLASH->ACR = (FLASH->ACR & ~0xFU) | WaitStates;
+	return ((FLASH->ACR & 0xFU) == WaitStates) ? RCC_OK : RCC_ERROR;
+}
+
+// SYSCLK that pConfig would give, 0 if it is out of range
+static uint32_t RCC_ConfigSysClk(const RCC_ClockConfig_t *pConfig){
+	if ((pConfig->Source == RCC_SOURCE_HSI) || (pConfig->Source == RCC_SOURCE_HSE)){
+		return (pConfig->Source == RCC_SOURCE_HSI) ? RCC_HSI_VALUE : RCC_HSE_VALUE;
+	}
+	if (pConfig->Source > RCC_SOURCE_PLL_HSE){
+		return 0;
+	}
+
+	uint32_t input = (pConfig->Source == RCC_SOURCE_PLL_HSI) ? RCC_HSI_VALUE : RCC_HSE_VALUE;
+	if ((pConfig->PLLM < 2) || (pConfig->PLLM > 63) || (pConfig->PLLN < 50) || (pConfig->PLLN > 432)
+			|| (pConfig->PLLP < 2) || (pConfig->PLLP > 8) || (pConfig->PLLP & 1)){
+		return 0;
+	}
+
+	input /= pConfig->PLLM;
+	uint32_t vco = input * pConfig->PLLN;
+	if ((input < 1000000U) || (input > 2000000U) || (vco < 100000000U) || (vco > 432000000U)){
+		return 0;
+	}
+	return vco / pConfig->PLLP;
+}
+
+/*
+ * ART accelerator
+ * FLASH_ACR:
+ * Bit 8 PRFTEN: prefetch
+ * Bit 9 ICEN / Bit 10 DCEN: instruction (64 x 128 bits) / data (8 x 128 bits) caches
+ * Bit 11 ICRST / Bit 12 DCRST: flush a cache, only while it is disabled
+ * With 5 wait states, a cache hit is what keeps a loop at 0 wait states.
+ */
+static void RCC_EnableART(void){
+	if (!READ_BIT(FLASH->ACR, 9)){
+		SET_BIT(FLASH->ACR, 11);
+		CLEAR_BIT(FLASH->ACR, 11);
+	}
+	if (!READ_BIT(FLASH->ACR, 10)){
+		SET_BIT(FLASH->ACR, 12);
+		CLEAR_BIT(FLASH->ACR, 12);
+	}
+	FLASH->ACR |= (1U << 8) | (1U << 9) | (1U << 10);
+}
+
+/*
+ * Full switch: oscillator, PLL, over-drive, flash, prescalers (pConfig already checked).
+ * PLL re-lock and over-drive ramp: a few hundred us.
+ */
+static uint8_t RCC_SwitchClockTree(const RCC_ClockConfig_t *pConfig, uint32_t Hclk, uint32_t PllBits, uint8_t WaitStates){
+	uint8_t use_pll = (pConfig->Source >= RCC_SOURCE_PLL_HSI) ? SET : RESET;
+	uint8_t use_hse = ((pConfig->Source == RCC_SOURCE_HSE) || (pConfig->Source == RCC_SOURCE_PLL_HSE)) ? SET : RESET;
+	uint8_t need_od = (Hclk > RCC_HCLK_NO_OD_MAX) ? SET : RESET;
+
+	/*
+	 * ------------------------------
+	 * 3. Oscillators
+	 * ------------------------------
+	 * RCC_CR:
+	 * Bit 0 HSION / Bit 1 HSIRDY: HSI stays on, it is the fallback of every step below
+	 * Bit 16 HSEON / Bit 17 HSERDY
+	 * Bit 18 HSEBYP: an external clock on OSC_IN instead of a crystal (only writable while HSEON = 0)
+	 */
+	SET_BIT(RCC->CR, 0);
+	if (RCC_WaitBit(&RCC->CR, 1, SET) != RCC_OK){
+		return RCC_TIMEOUT;
+	}
+
+	if (use_hse && !READ_BIT(RCC->CR, 17)){
+		CLEAR_BIT(RCC->CR, 16);
+		SET_BIT(RCC->CR, 18);
+		SET_BIT(RCC->CR, 16);
+		if (RCC_WaitBit(&RCC->CR, 17, SET) != RCC_OK){
+			CLEAR_BIT(RCC->CR, 16); // no MCO (solder bridge SB50 open?): the caller can retry on HSI
+			return RCC_TIMEOUT;
+		}
+	}
+
+	/*
+	 * From here until the final switch, SYSCLK is HSI (or the HSE we are about to use):
+	 * the PLL, the regulator and the flash can be changed under a clock that is not affected.
+	 * Flash latency and APB prescalers are left as they were, which is valid for any slower clock.
+	 */
+	if (((RCC->CFGR >> 2) & 0x3) >= 2){
+		if (RCC_SwitchSysClk(0) != RCC_OK){
+			return RCC_TIMEOUT;
+		}
+	}
+
+	/*
+	 * PWR_CR:
+	 * Bit 16 ODEN / Bit 17 ODSWEN: over-drive on, then switch the 1.2 V domain to it
+	 * PWR_CSR Bit 16 ODRDY / Bit 17 ODSWRDY
+	 * Changed only while SYSCLK is not the PLL (RM0390 5.1.4).
+	 */
+	if (!need_od && READ_BIT(PWR->CR, 16)){
+		CLEAR_BIT(PWR->CR, 17);
+		CLEAR_BIT(PWR->CR, 16);
+	}
+
+	/*
+	 * ------------------------------
+	 * 4. PLL
+	 * ------------------------------
+	 * RCC_CR Bit 24 PLLON / Bit 25 PLLRDY. PLLCFGR is locked while the PLL runs: off first.
+	 * PLLQ / PLLR (USB, SAI, I2S ...) are left alone.
+	 */
+	CLEAR_BIT(RCC->CR, 24);
+	if (RCC_WaitBit(&RCC->CR, 25, RESET) != RCC_OK){
+		return RCC_TIMEOUT;
+	}
+
+	if (use_pll){
+		/*
+		 * PWR_CR Bits 15:14 VOS: 11 = Scale 1 (up to 168 MHz, 180 MHz with over-drive).
+		 * Only written to the regulator when the PLL turns on, so it goes in now.
+		 */
+		PWR->CR |= (0x3U << 14);
+
+		RCC->PLLCFGR = (RCC->PLLCFGR & ~RCC_PLLCFGR_MASK) | PllBits;
+
+		SET_BIT(RCC->CR, 24);
+		if (RCC_WaitBit(&RCC->CR, 25, SET) != RCC_OK){
+			return RCC_TIMEOUT;
+		}
+
+		if (need_od){
+			SET_BIT(PWR->CR, 16);
+			if (RCC_WaitBit(&PWR->CSR, 16, SET) != RCC_OK){
+				return RCC_TIMEOUT;
+			}
+			SET_BIT(PWR->CR, 17);
+			if (RCC_WaitBit(&PWR->CSR, 17, SET) != RCC_OK){
+				return RCC_TIMEOUT;
+			}
+		}
+	}
+
+	/*
+	 * ------------------------------
+	 * 5. The switch itself
+	 * ------------------------------
+	 * Going up: more wait states BEFORE the clock rises. Going down: fewer AFTER it fell.
+	 * APB prescalers at /16 across the switch, so no bus is over its limit for even a moment.
+	 * (The deadline of the SWS wait is counted at the old clock: shorter, never longer, in time.)
+	 */
+	if (WaitStates > (FLASH->ACR & 0xFU)){
+		if (RCC_SetFlashLatency(WaitStates) != RCC_OK){
+			return RCC_TIMEOUT;
+		}
+	}
+
+	uint32_t cfgr = RCC->CFGR & ~((0xFU << 4) | (0x7U << 10) | (0x7U << 13));
+	RCC->CFGR = cfgr | (RCC_APB_DIV16 << 10) | (RCC_APB_DIV16 << 13) | ((uint32_t)pConfig->AHBDiv << 4);
+
+	uint8_t sw = use_pll ? 2 : (use_hse ? 1 : 0);
+	if (RCC_SwitchSysClk(sw) != RCC_OK){
+		return RCC_TIMEOUT;
+	}
+
+	cfgr = RCC->CFGR & ~((0x7U << 10) | (0x7U << 13));
+	RCC->CFGR = cfgr | ((uint32_t)pConfig->APB1Div << 10) | ((uint32_t)pConfig->APB2Div << 13);
+
+	if (WaitStates < (FLASH->ACR & 0xFU)){
+		(void)RCC_SetFlashLatency(WaitStates); // more wait states than needed is only slower
+	}
+
+	RCC_EnableART();
+
+	// Sources no longer in use: off (HSI stays on, see above)
+	if (!use_hse){
+		CLEAR_BIT(RCC->CR, 16);
+	}
+
+	return RCC_OK;
+}
+
+/*
+ * Prescalers only (the PLL keeps running the core): HPRE and the PPREs in two writes, ordered so
+ * no PCLK ever goes above the larger of its old and new values (RM0390 6.3.3: each new ratio takes
+ * effect within 16 AHB cycles of its write):
+ * - HCLK going up:   PPRE first (a lower PCLK for a moment), then HPRE
+ * - HCLK going down: HPRE first (PCLKx fall), then PPRE
+ * e.g. 45 MHz (AHB /4, APB1 /1) -> 180 MHz (AHB /1, APB1 /4): PCLK1 45 -> 11.25 -> 45 MHz,
+ * never 180. A UART on PCLK1 sees a short slow stretch, never an over-clocked one.
+ */
+static uint8_t RCC_ChangePrescalers(const RCC_ClockConfig_t *pConfig, uint32_t Hclk, uint8_t WaitStates){
+	uint32_t hpre = (uint32_t)pConfig->AHBDiv << 4;
+	uint32_t ppre = ((uint32_t)pConfig->APB1Div << 10) | ((uint32_t)pConfig->APB2Div << 13);
+
+	if (WaitStates > (FLASH->ACR & 0xFU)){
+		if (RCC_SetFlashLatency(WaitStates) != RCC_OK){
+			return RCC_TIMEOUT;
+		}
+	}
+
+	if (Hclk > RCC_GetHCLKValue()){
+		RCC->CFGR = (RCC->CFGR & ~((0x7U << 10) | (0x7U << 13))) | ppre;
+		RCC->CFGR = (RCC->CFGR & ~(0xFU << 4)) | hpre;
+	}
+	else{
+		RCC->CFGR = (RCC->CFGR & ~(0xFU << 4)) | hpre;
+		RCC->CFGR = (RCC->CFGR & ~((0x7U << 10) | (0x7U << 13))) | ppre;
+	}
+
+	if (WaitStates < (FLASH->ACR & 0xFU)){
+		(void)RCC_SetFlashLatency(WaitStates);
+	}
+
+	RCC_EnableART();
+	return RCC_OK;
+}
+
+uint8_t RCC_ClockConfig(const RCC_ClockConfig_t *pConfig){
+	/*
+	 * ------------------------------
+	 * 1. Check everything first
+	 * ------------------------------
+	 * A half-applied clock tree is worse than none: out of range -> nothing is touched.
+	 */
+	uint32_t sysclk = RCC_ConfigSysClk(pConfig);
+	if ((sysclk == 0) || ((pConfig->AHBDiv > 0) && (pConfig->AHBDiv < 8)) || (pConfig->AHBDiv > 15)
+			|| ((pConfig->APB1Div > 0) && (pConfig->APB1Div < 4)) || (pConfig->APB1Div > 7)
+			|| ((pConfig->APB2Div > 0) && (pConfig->APB2Div < 4)) || (pConfig->APB2Div > 7)){
+		return RCC_ERROR;
+	}
+
+	uint32_t hclk = RCC_ApplyAHB(sysclk, pConfig->AHBDiv);
+	if ((hclk > RCC_HCLK_MAX) || (RCC_ApplyAPB(hclk, pConfig->APB1Div) > RCC_PCLK1_MAX)
+			|| (RCC_ApplyAPB(hclk, pConfig->APB2Div) > RCC_PCLK2_MAX)){
+		return RCC_ERROR;
+	}
+
+	uint8_t wait_states = (uint8_t)((hclk - 1U) / RCC_FLASH_WS_HZ);
+	uint32_t pll_bits = ((uint32_t)pConfig->PLLM << 0) | ((uint32_t)pConfig->PLLN << 6)
+			| ((uint32_t)((pConfig->PLLP / 2U) - 1U) << 16) | ((pConfig->Source == RCC_SOURCE_PLL_HSE) ? (1U << 22) : 0U);
+
+	PWR_PCLK_EN();
+
+	/*
+	 * ------------------------------
+	 * 2. Same PLL already running?
+	 * ------------------------------
+	 * Then only HPRE / PPRE and the wait states change: no HSI detour, no re-lock (the governor's
+	 * 180 <-> 45 MHz steps). The PLL, and over-drive if it was on, keep running.
+	 */
+	uint8_t status;
+	if ((pConfig->Source >= RCC_SOURCE_PLL_HSI) && (((RCC->CFGR >> 2) & 0x3) == 2) && READ_BIT(RCC->CR, 25)
+			&& ((RCC->PLLCFGR & RCC_PLLCFGR_MASK) == pll_bits)
+			&& ((hclk <= RCC_HCLK_NO_OD_MAX) || READ_BIT(PWR->CSR, 17))){
+		status = RCC_ChangePrescalers(pConfig, hclk, wait_states);
+	}
+	else{
+		status = RCC_SwitchClockTree(pConfig, hclk, pll_bits, wait_states);
+	}
+
+	// whatever happened, HCLK may have changed: everyone who derived something from it is told
+	for (uint8_t i = 0; i < ClockHookCount; i++){
+		ClockHooks[i]();
+	}
+
+	return status;
+}
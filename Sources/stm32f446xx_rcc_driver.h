@@ -0,0 +1,157 @@
+/*
+ * stm32f446xx_rcc_driver.h
+ *
+ *  Created on: 2026/2/9
+ *      Author: Yuheng
+ *
+ * Description:
+ * Header file for RCC (Reset and Clock Control) Driver.
+ *
+ * Why?
+ * Every driver used to assume "the clock is 16 MHz" (e.g. PCLK = 16000000 in USART_SetBaudRate).
+ * That is only true as long as nobody touches the clock tree.
+ * These functions READ the RCC registers and work out the real frequencies instead:
+ *
+ *   [HSI 16 MHz / HSE / PLL] -> SYSCLK -> AHB prescaler -> HCLK (CPU, DMA, GPIO)
+ *                                            |-> APB1 prescaler -> PCLK1 (USART2, TIM2-7, IWDG...)
+ *                                            |-> APB2 prescaler -> PCLK2 (USART1/6, TIM1/8, SYSCFG...)
+ *
+ * [Previously] read-only: the board stayed on the 16 MHz HSI it boots from.
+ * RCC_ClockConfig (section 3) now WRITES the clock tree as well, e.g. the PLL at 180 MHz:
+ *
+ *   HSE 8 MHz / M 4 = 2 MHz x N 180 = VCO 360 MHz / P 2 = SYSCLK 180 MHz (x11.25)
+ *   AHB /1 = HCLK 180 MHz, APB1 /4 = PCLK1 45 MHz (TIM2-7: 90 MHz), APB2 /2 = PCLK2 90 MHz
+ *
+ * Reference: RM0390 6.2 Clocks, 6.3.2 RCC_PLLCFGR, 6.3.3 RCC_CFGR,
+ *            3.4.1 Relation between CPU clock frequency and Flash memory read time,
+ *            5.1.4 Entering Over-drive mode
+ */
+
+#ifndef SOURCES_STM32F446XX_RCC_DRIVER_H_
+#define SOURCES_STM32F446XX_RCC_DRIVER_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+/*
+ * ==========================================
+ * 1. Oscillator Frequencies
+ * ==========================================
+ * HSI: internal RC oscillator, datasheet Table 41. HSI oscillator characteristics
+ * HSE: Nucleo-F446RE has no crystal fitted (X3), the ST-LINK feeds 8 MHz through MCO (bypass mode)
+ */
+#define RCC_HSI_VALUE   16000000U
+#define RCC_HSE_VALUE   8000000U
+
+/*
+ * ==========================================
+ * 		2. Function Prototypes
+ * ==========================================
+ * All of them return Hz and only read registers, so they are safe to call any time.
+ */
+uint32_t RCC_GetSYSCLKValue(void);
+uint32_t RCC_GetHCLKValue(void);
+uint32_t RCC_GetPCLK1Value(void);
+uint32_t RCC_GetPCLK2Value(void);
+
+/*
+ * Timers run at PCLK x1 if their APB prescaler is 1, otherwise at PCLK x2
+ * (x4 with TIMPRE, RM0390 6.2 "the timer clock frequencies are automatically set...").
+ */
+uint32_t RCC_GetTimerClock1Value(void); // TIM2-7, TIM12-14
+uint32_t RCC_GetTimerClock2Value(void); // TIM1, TIM8-11
+
+/*
+ * Clock of the bus a peripheral sits on, picked from its base address
+ * (APB2 starts at 0x4001 0000, everything below is APB1).
+ */
+uint32_t RCC_GetPeripheralClock(uint32_t PeriphBaseAddr);
+
+/*
+ * ==========================================
+ * 		3. System Clock Configuration
+ * ==========================================
+ */
+
+/* @RCC_ClockSource */
+#define RCC_SOURCE_HSI       0
+#define RCC_SOURCE_HSE       1 // bypass mode: the 8 MHz of the ST-LINK MCO
+#define RCC_SOURCE_PLL_HSI   2
+#define RCC_SOURCE_PLL_HSE   3
+
+/* @RCC_AHB_Div: CFGR HPRE codes */
+#define RCC_AHB_DIV1         0
+#define RCC_AHB_DIV2         8
+#define RCC_AHB_DIV4         9
+#define RCC_AHB_DIV8         10
+#define RCC_AHB_DIV16        11
+#define RCC_AHB_DIV64        12
+#define RCC_AHB_DIV128       13
+#define RCC_AHB_DIV256       14
+#define RCC_AHB_DIV512       15
+
+/* @RCC_APB_Div: CFGR PPRE1 / PPRE2 codes */
+#define RCC_APB_DIV1         0
+#define RCC_APB_DIV2         4
+#define RCC_APB_DIV4         5
+#define RCC_APB_DIV8         6
+#define RCC_APB_DIV16        7
+
+/*
+ * Limits (datasheet Table 17. General operating conditions, VOS scale 1)
+ * Above RCC_HCLK_NO_OD_MAX the regulator needs over-drive (done by RCC_ClockConfig).
+ */
+#define RCC_HCLK_MAX         180000000U
+#define RCC_HCLK_NO_OD_MAX   168000000U
+#define RCC_PCLK1_MAX        45000000U
+#define RCC_PCLK2_MAX        90000000U
+
+// RM0390 Table 5 (2.7 V - 3.6 V): one more flash wait state for every 30 MHz of HCLK
+#define RCC_FLASH_WS_HZ      30000000U
+
+#define PWR_PCLK_EN()        (SET_BIT(RCC->APB1ENR, 28)) // Bit 28 PWREN: voltage scaling / over-drive live in PWR
+
+#define RCC_READY_TIMEOUT_US 5000U // oscillator / PLL lock / over-drive / switch (each)
+
+/* @RCC_Status */
+#define RCC_OK               0
+#define RCC_ERROR            1 // out of range: nothing was changed
+#define RCC_TIMEOUT          2 // something did not get ready: still running, from HSI at worst
+
+typedef struct{
+	uint8_t  Source;   // @RCC_ClockSource
+	uint8_t  PLLM;     // 2 - 63: PLL input = f_osc / M, must be 1 - 2 MHz (2 MHz: least jitter)
+	uint16_t PLLN;     // 50 - 432: VCO = input x N, must be 100 - 432 MHz
+	uint8_t  PLLP;     // 2, 4, 6 or 8: SYSCLK = VCO / P
+	uint8_t  AHBDiv;   // @RCC_AHB_Div
+	uint8_t  APB1Div;  // @RCC_APB_Div
+	uint8_t  APB2Div;  // @RCC_APB_Div
+} RCC_ClockConfig_t;
+
+/*
+ * Switch the whole clock tree: oscillator, PLL, regulator over-drive, flash wait states,
+ * prescalers, then ART accelerator (prefetch + instruction / data caches) on.
+ * PLLx fields are ignored for RCC_SOURCE_HSI / HSE. Returns @RCC_Status.
+ *
+ * Same PLL settings as the one already running the core: only the prescalers and wait states
+ * change (a few us, no re-lock). Otherwise the full switch, via HSI (a few hundred us).
+ *
+ * Uses Timestamp_Deadline: call it after Timestamp_Init (main(), not SystemInit, where .bss is not zeroed yet).
+ * Everything derived from a clock must be redone afterwards: Timestamp_ClockChanged, SysTick_Init,
+ * baud rates, timer prescalers. Either switch first and configure the peripherals afterwards (boot),
+ * or register a hook for each of them (at run time, see clock_governor.h).
+ */
+uint8_t RCC_ClockConfig(const RCC_ClockConfig_t *pConfig);
+
+/*
+ * Clock-change hooks: called in registration order at the end of every RCC_ClockConfig
+ * (also after an RCC_TIMEOUT: the clock may have moved anyway). main() only, like RCC_ClockConfig.
+ * Register Timestamp_ClockChanged first, the other hooks may use deadlines.
+ */
+#define RCC_MAX_CLOCK_HOOKS  8U
+
+typedef void (*RCC_ClockHook_t)(void);
+
+uint8_t RCC_RegisterClockHook(RCC_ClockHook_t Hook); // @RCC_Status (RCC_ERROR: table full)
+
+#endif /* SOURCES_STM32F446XX_RCC_DRIVER_H_ */
@@ -0,0 +1,185 @@
+/*
+ * stm32f446xx_rtc_driver.c
+ *
+ *  Created on: 2026/2/26
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_rcc_driver.h"
+#include "stm32f446xx_rtc_driver.h"
+#include "timestamp.h"
+#include <stdint.h>
+
+// Wait for Bit of *pReg to read State, at most RTC_READY_TIMEOUT_US
+static uint8_t RTC_WaitBit(volatile uint32_t *pReg, uint8_t Bit, uint8_t State){
+	uint32_t deadline = Timestamp_Deadline(RTC_READY_TIMEOUT_US);
+
+	while ((READ_BIT(*pReg, Bit) ? SET : RESET) != State){
+		if (Timestamp_Expired(deadline)){
+			return RTC_TIMEOUT;
+		}
+	}
+	return RTC_OK;
+}
+
+/*
+ * RTC_WPR: every RTC register (but ISR flags / WPR itself) is write-protected after reset.
+ * 0xCA then 0x53 unlocks, any other value locks again.
+ */
+static void RTC_Unlock(void){
+	RTC->WPR = 0xCAU;
+	RTC->WPR = 0x53U;
+}
+
+static void RTC_Lock(void){
+	RTC->WPR = 0xFFU;
+}
+
+// 2 BCD digits -> binary (Tens in the upper nibble)
+static uint32_t RTC_FromBCD(uint32_t Bcd){
+	return ((Bcd >> 4) * 10U) + (Bcd & 0xFU);
+}
+
+uint8_t RTC_Init(void){
+	/*
+	 * ------------------------------
+	 * 1. LSI
+	 * ------------------------------
+	 * RCC_CSR Bit 0 LSION / Bit 1 LSIRDY (already on if the IWDG runs)
+	 */
+	SET_BIT(RCC->CSR, 0);
+	if (RTC_WaitBit(&RCC->CSR, 1, SET) != RTC_OK){
+		return RTC_TIMEOUT;
+	}
+
+	/*
+	 * ------------------------------
+	 * 2. Backup domain
+	 * ------------------------------
+	 * PWR_CR Bit 8 DBP: the backup domain (RCC_BDCR, RTC) is write-protected after reset.
+	 * RCC_BDCR:
+	 * Bits 9:8 RTCSEL: 10 = LSI, only writable once after a backup domain reset (Bit 16 BDRST)
+	 * Bit 15 RTCEN
+	 * Already running from LSI (e.g. after an IWDG reset) -> keep it, and the calendar with it.
+	 */
+	PWR_PCLK_EN();
+	SET_BIT(PWR->CR, 8);
+
+	if (((RCC->BDCR >> 8) & 0x3U) != 0x2U){
+		SET_BIT(RCC->BDCR, 16);
+		CLEAR_BIT(RCC->BDCR, 16);
+		RCC->BDCR = (RCC->BDCR & ~(0x3U << 8)) | (0x2U << 8);
+	}
+	SET_BIT(RCC->BDCR, 15);
+
+	RTC_Unlock();
+
+	/*
+	 * RTC_CR Bit 5 BYPSHAD: TR / DR / SSR are read from the counters themselves, not from the
+	 * shadow registers, which are only refreshed every 2 RTCCLK and are stale right after Stop mode.
+	 * (RTC_GetMs reads twice instead, to catch a carry in between)
+	 */
+	SET_BIT(RTC->CR, 5);
+
+	/*
+	 * ------------------------------
+	 * 3. Calendar
+	 * ------------------------------
+	 * RTC_ISR Bit 4 INITS: the calendar was initialized (survives a system reset) -> done.
+	 * Otherwise: Bit 7 INIT = 1 stops the counters, Bit 6 INITF says they can be written.
+	 * PRER: PREDIV_S first, then PREDIV_A (two separate writes, RM0390 22.3.5).
+	 */
+	if (!READ_BIT(RTC->ISR, 4)){
+		SET_BIT(RTC->ISR, 7);
+		if (RTC_WaitBit(&RTC->ISR, 6, SET) != RTC_OK){
+			RTC_Lock();
+			return RTC_TIMEOUT;
+		}
+
+		RTC->PRER = RTC_PREDIV_S;
+		RTC->PRER = (RTC_PREDIV_A << 16) | RTC_PREDIV_S;
+		RTC->TR = 0;               // 00:00:00, 24-hour format (CR Bit 6 FMT = 0)
+		CLEAR_BIT(RTC->CR, 6);
+
+		CLEAR_BIT(RTC->ISR, 7);    // counters run again
+	}
+
+	RTC_Lock();
+	return RTC_OK;
+}
+
+uint8_t RTC_SetWakeup(uint32_t Ms){
+	if ((Ms == 0) || (Ms > RTC_WAKEUP_MAX_MS)){
+		return RTC_ERROR;
+	}
+
+	/*
+	 * RTC_CR:
+	 * Bits 2:0 WUCKSEL: 000 = RTCCLK / 16
+	 * Bit 10 WUTE: wakeup timer on. WUTR is only writable while WUTE = 0 and ISR Bit 2 WUTWF = 1.
+	 * Bit 14 WUTIE: wakeup interrupt
+	 * The counter reloads from WUTR by itself: one wakeup every (WUTR + 1) ticks.
+	 */
+	RTC_Unlock();
+
+	CLEAR_BIT(RTC->CR, 10);
+	if (RTC_WaitBit(&RTC->ISR, 2, SET) != RTC_OK){
+		RTC_Lock();
+		return RTC_TIMEOUT;
+	}
+
+	RTC->WUTR = ((Ms * RTC_WAKEUP_HZ) / 1000U) - 1U;
+	RTC->CR &= ~(0x7U << 0);
+	(void)RTC_ClearWakeup();
+	RTC->CR |= (1U << 14) | (1U << 10);
+
+	RTC_Lock();
+
+	/*
+	 * EXTI Line 22 = RTC wakeup, rising edge. Unmasked: it is the interrupt that ends a WFI,
+	 * in Stop mode too (the EXTI runs without a clock).
+	 */
+	SET_BIT(EXTI->RTSR, 22);
+	SET_BIT(EXTI->IMR, 22);
+	SET_BIT(NVIC_ISER->ISER[RTC_WKUP_IRQ / 32], RTC_WKUP_IRQ % 32);
+
+	return RTC_OK;
+}
+
+uint32_t RTC_GetMs(void){
+	/*
+	 * RTC_SSR counts DOWN from PREDIV_S within each second.
+	 * RTC_TR: Bits 21:16 hours, 14:8 minutes, 6:0 seconds (BCD)
+	 * Without shadow registers, SSR and TR can straddle a second: read until two passes agree.
+	 */
+	uint32_t ssr;
+	uint32_t tr;
+	do{
+		ssr = RTC->SSR;
+		tr = RTC->TR;
+	} while ((ssr != RTC->SSR) || (tr != RTC->TR));
+
+	uint32_t seconds = (RTC_FromBCD((tr >> 16) & 0x3FU) * 3600U) + (RTC_FromBCD((tr >> 8) & 0x7FU) * 60U)
+			+ RTC_FromBCD(tr & 0x7FU);
+	uint32_t sub_ms = ((RTC_PREDIV_S - (ssr & 0xFFFFU)) * 1000U) / (RTC_PREDIV_S + 1U);
+
+	return (seconds * 1000U) + sub_ms;
+}
+
+uint8_t RTC_ClearWakeup(void){
+	/*
+	 * RTC_ISR Bit 10 WUTF: rc_w0 (write 0 to clear, writing 1 changes nothing).
+	 * Bit 7 INIT is a plain read/write bit in the same register: written back as it is.
+	 * EXTI_PR Bit 22: write 1 to clear.
+	 */
+	uint8_t was_set = READ_BIT(RTC->ISR, 10) ? SET : RESET;
+
+	RTC->ISR = (~((1U << 10) | (1U << 7)) & 0xFFFFU) | (RTC->ISR & (1U << 7));
+	EXTI->PR = (1U << 22);
+
+	return was_set;
+}
+
+void RTC_WakeupIRQHandling(void){
+	(void)RTC_ClearWakeup();
+}
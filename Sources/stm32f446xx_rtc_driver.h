@@ -0,0 +1,85 @@
+/*
+ * stm32f446xx_rtc_driver.h
+ *
+ *  Created on: 2026/2/26
+ *      Author: Yuheng
+ *
+ * Description:
+ * Header file for the RTC Driver: a clock that keeps running in Stop mode, and its wakeup timer.
+ *
+ * Why?
+ * In Stop mode every clock of the core domain is off: HSI / HSE / PLL, SysTick, the DWT counter.
+ * Only the backup domain (RTC) and the LSI (IWDG) keep going. So the RTC is the only thing that can:
+ * - wake the core up on time (the periodic wakeup timer -> EXTI Line 22 -> RTC_WKUP_IRQ)
+ * - tell how long it was asleep (the calendar, read before and after)
+ *
+ * Clock: LSI, the same 32 kHz RC as the IWDG (Nucleo-F446RE: no need for the LSE crystal).
+ * The LSI is only accurate to ~+-15%, but the IWDG counts on the same oscillator:
+ * a wakeup period set to half the watchdog timeout stays half of it, whatever the LSI really does.
+ *
+ *   LSI 32 kHz / (PREDIV_A 127 + 1) = 250 Hz / (PREDIV_S 249 + 1) = 1 Hz calendar (4 ms sub-seconds)
+ *   LSI 32 kHz / 16 = 2 kHz wakeup counter (0.5 ms steps, up to 32 s)
+ *
+ * The RTC sits in the backup domain: a system reset (IWDG included) does not stop it,
+ * RTC_Init leaves a calendar that is already running alone.
+ *
+ * Reference: RM0390 22 Real-time clock (RTC), 5.1.2 Battery backup domain, 6.3.20 RCC_BDCR
+ */
+
+#ifndef SOURCES_STM32F446XX_RTC_DRIVER_H_
+#define SOURCES_STM32F446XX_RTC_DRIVER_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+#define RTC_LSI_VALUE        32000U
+#define RTC_PREDIV_A         127U
+#define RTC_PREDIV_S         249U
+#define RTC_WAKEUP_HZ        (RTC_LSI_VALUE / 16U) // WUCKSEL = 000: RTCCLK / 16
+
+#define RTC_WAKEUP_MAX_MS    ((65536U * 1000U) / RTC_WAKEUP_HZ)
+#define RTC_MS_PER_DAY       86400000U
+
+#define RTC_READY_TIMEOUT_US 5000U // LSI start, init mode, wakeup timer write access (each)
+
+/* @RTC_Status */
+#define RTC_OK               0
+#define RTC_ERROR            1 // out of range: nothing was changed
+#define RTC_TIMEOUT          2 // the LSI / RTC did not answer
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+/*
+ * LSI on, backup domain write access, RTC clocked from LSI, calendar running (from 00:00:00),
+ * shadow registers bypassed (valid right after Stop mode). Returns @RTC_Status.
+ * Uses Timestamp_Deadline: after Timestamp_Init.
+ */
+uint8_t RTC_Init(void);
+
+/*
+ * Periodic wakeup interrupt every Ms (1 .. RTC_WAKEUP_MAX_MS), through EXTI Line 22 (rising edge).
+ * Runs in every mode: RTC_WKUP_IRQHandler must exist (RTC_WakeupIRQHandling). Returns @RTC_Status.
+ */
+uint8_t RTC_SetWakeup(uint32_t Ms);
+
+// Time of day from the calendar, in ms (0 .. RTC_MS_PER_DAY - 1, 4 ms steps)
+uint32_t RTC_GetMs(void);
+
+// Start -> End (RTC_GetMs values), across midnight too: at most one day
+static inline uint32_t RTC_ElapsedMs(uint32_t Start, uint32_t End){
+	return (End >= Start) ? (End - Start) : (End + RTC_MS_PER_DAY - Start);
+}
+
+/*
+ * Clears the wakeup flag (RTC WUTF and EXTI Line 22), returns SET if it was set.
+ * Usable with interrupts masked (Stop mode loop), or from RTC_WKUP_IRQHandler.
+ */
+uint8_t RTC_ClearWakeup(void);
+
+// Call from RTC_WKUP_IRQHandler
+void RTC_WakeupIRQHandling(void);
+
+#endif /* SOURCES_STM32F446XX_RTC_DRIVER_H_ */
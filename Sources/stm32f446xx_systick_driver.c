@@ -0,0 +1,106 @@
+/*
+ * stm32f446xx_systick_driver.c
+ *
+ *  Created on: 2026/2/24
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_rcc_driver.h"
+#include "stm32f446xx_systick_driver.h"
+#include "timestamp.h"
+#include <stdint.h>
+
+static volatile uint32_t SysTickCount;
+
+/*
+ * Can the tick interrupt run right now?
+ * PRIMASK Bit 0: interrupts masked (Critical_Enter)
+ * IPSR Bits 8:0: number of the exception being handled, 0 in Thread mode (main)
+ * (all interrupts share one priority here, so no ISR is ever preempted by the tick)
+ */
+static uint8_t SysTick_IsTicking(void){
+	uint32_t primask;
+	uint32_t ipsr;
+
+	__asm volatile ("MRS %0, PRIMASK" : "=r" (primask));
+	__asm volatile ("MRS %0, IPSR" : "=r" (ipsr));
+
+	return (((primask & 0x1) == 0) && ((ipsr & 0x1FF) == 0) && READ_BIT(SYSTICK->CTRL, 1)) ? SET : RESET;
+}
+
+// Ms x 1 ms on the cycle counter (one deadline per ms: no limit on Ms)
+static void SysTick_SpinMs(uint32_t Ms){
+	while (Ms > 0){
+		uint32_t deadline = Timestamp_Deadline(1000U);
+		while (Timestamp_Expired(deadline) != SET);
+		Ms--;
+	}
+}
+
+uint8_t SysTick_Init(void){
+	uint32_t reload = (RCC_GetHCLKValue() / SYSTICK_TICK_HZ) - 1U;
+
+	if (reload > 0xFFFFFFU){
+		return SYSTICK_ERROR;
+	}
+
+	/*
+	 * CTRL:
+	 * Bit 2 CLKSOURCE: 1 = processor clock (HCLK), 0 = HCLK / 8
+	 * Bit 1 TICKINT:   1 = SysTick_Handler at every reload
+	 * Bit 0 ENABLE
+	 * Writing VAL (any value) clears it: the first period is a full one.
+	 */
+	CLEAR_BIT(SYSTICK->CTRL, 0);
+	SYSTICK->LOAD = reload;
+	SYSTICK->VAL = 0;
+	SYSTICK->CTRL = (1U << 2) | (1U << 1) | (1U << 0);
+
+	return SYSTICK_OK;
+}
+
+uint32_t SysTick_GetTick(void){
+	return SysTickCount;
+}
+
+void SysTick_DelayMs(uint32_t Ms){
+	if (Ms == 0){
+		return;
+	}
+	if (SysTick_IsTicking() != SET){
+		SysTick_SpinMs(Ms);
+		return;
+	}
+
+	/*
+	 * The next tick may come a moment after 'start' was read:
+	 * Ms + 1 ticks make sure at least Ms whole milliseconds pass.
+	 */
+	uint32_t start = SysTickCount;
+	while ((SysTickCount - start) <= Ms){
+		__asm volatile ("WFI");
+	}
+}
+
+void SysTick_DelayUs(uint32_t Us){
+	uint32_t whole_ms = Us / 1000U;
+
+	while (whole_ms > (TIMESTAMP_MAX_DEADLINE_US / 1000U)){
+		// longer than one deadline can cover: sleep off the excess first
+		SysTick_DelayMs(TIMESTAMP_MAX_DEADLINE_US / 1000U);
+		Us -= TIMESTAMP_MAX_DEADLINE_US;
+		whole_ms = Us / 1000U;
+	}
+
+	uint32_t deadline = Timestamp_Deadline(Us);
+
+	// DelayMs(n) may take up to n + 1 ms: sleep 2 ms less, spin the rest to the exact deadline
+	if (whole_ms >= 2U){
+		SysTick_DelayMs(whole_ms - 2U);
+	}
+	while (Timestamp_Expired(deadline) != SET);
+}
+
+void SysTick_IRQHandling(void){
+	SysTickCount++;
+}
@@ -0,0 +1,58 @@
+/*
+ * stm32f446xx_systick_driver.h
+ *
+ *  Created on: 2026/2/24
+ *      Author: Yuheng
+ *
+ * Description:
+ * Header file for the SysTick Driver: the millisecond tick, and delays that sleep.
+ *
+ * [Previously] software_delay(count) in main.c: a loop of NOPs, "calibrated" by guessing.
+ * It kept the CPU at 100% doing nothing, and its length changed with the clock,
+ * the optimization level and every interrupt that happened to come in.
+ *
+ * SysTick (PM0214 Section 4.5) is the 24-bit down counter built into the Cortex-M4 core:
+ * clocked by HCLK, it reloads from LOAD and raises SysTick_Handler every LOAD + 1 cycles.
+ * It is the firmware's only periodic tick (1 ms): soft timers, timestamps and the delays below.
+ *
+ * Delays:
+ * - SysTick_DelayMs: WFI (PM0214 3.12.11) between ticks, the core is clock-gated until
+ *   the next interrupt (the tick itself, or anything else), then checks the time again.
+ * - SysTick_DelayUs: whole milliseconds asleep, the rest (< 2 ms) on the DWT cycle counter
+ *   (timestamp.h): exact to a few cycles.
+ * Inside an ISR or with interrupts masked the tick stands still (and WFI would never see it),
+ * so both spin on the cycle counter there instead: still bounded, just not asleep.
+ *
+ * Timeouts for driver busy-waits: Timestamp_Deadline / Timestamp_Expired (timestamp.h).
+ */
+
+#ifndef SOURCES_STM32F446XX_SYSTICK_DRIVER_H_
+#define SOURCES_STM32F446XX_SYSTICK_DRIVER_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+#define SYSTICK_TICK_HZ     1000U // 1 ms
+
+/* @SysTick_Status */
+#define SYSTICK_OK          0
+#define SYSTICK_ERROR       1 // HCLK / SYSTICK_TICK_HZ does not fit in the 24-bit LOAD
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+// LOAD from the current HCLK, tick interrupt on, counter running. Call it again after every clock change
+uint8_t SysTick_Init(void);
+
+uint32_t SysTick_GetTick(void); // ms since boot (wraps after 49 days: compare with a subtraction)
+
+// At least Ms / Us (never shorter), the core asleep whenever it can be
+void SysTick_DelayMs(uint32_t Ms);
+void SysTick_DelayUs(uint32_t Us);
+
+// Call from SysTick_Handler
+void SysTick_IRQHandling(void);
+
+#endif /* SOURCES_STM32F446XX_SYSTICK_DRIVER_H_ */
@@ -6,6 +6,8 @@
  */
 #include "stm32f446xx.h"
 #include "stm32f446xx_timer_driver.h"
+#include "stm32f446xx_dma_driver.h"
+#include "stm32f446xx_rcc_driver.h"
 #include <stdint.h>
 #include <stdio.h>
 
@@ -19,6 +21,16 @@ void TIM_PWM_Init(TIM_Handle_t *pTIMHandle){
 	// 2. Set ARR (Period/Duration)
 	pTIMx->ARR = TIM_Config.Period;
 
+	/*
+	 * 2b. CR1 Bit 7 ARPE: Auto-reload preload enable
+	 * [Previously] only CCR1 was preloaded: a new ARR took effect at once, and if CNT was
+	 * already past it the counter ran on up to the top of its range (a missing pulse),
+	 * or a new short ARR next to an old long CCR1 gave a runt pulse.
+	 * With ARPE = 1, ARR and CCRx both wait for the update event: one period is always
+	 * entirely old or entirely new (see TIM_PWM_SetPeriod).
+	 */
+	SET_BIT(pTIMx->CR1, 7);
+
 	/*
 	 * ==========================================
 	 * 3. set CCMR1 to PWM mode 1
@@ -56,6 +68,17 @@ void TIM_PWM_Init(TIM_Handle_t *pTIMHandle){
 	 */
 	SET_BIT(pTIMx->CCER, 0);
 
+	/*
+	 * 5b. PSC and ARR are preloaded: load them now with an update (EGR Bit 0 UG),
+	 * otherwise the first period still runs on the reset values (PSC 0).
+	 * UG also sets UIF: clear it, nobody is waiting for this one.
+	 */
+	SET_BIT(pTIMx->EGR, 0);
+	CLEAR_BIT(pTIMx->SR, 0);
+
+	// 5c. no channel has a duty for TIM_PWM_SetPeriod to keep yet (TIM_PWM_SetDuty)
+	pTIMHandle->DutyChannels = 0;
+
 	/*
 	 * ==========================================
 	 * 6. Enable Counter (in CR1 - Control Register 1)
@@ -70,9 +93,146 @@ void TIM_PWM_Init(TIM_Handle_t *pTIMHandle){
 	SET_BIT(pTIMx->CR1, 0);
 }
 
-void TIM_SetCompare1(TIM_RegDef_t *pTIMx, uint32_t CaptureValue){
-	// Writing to CCR1 changes the duty cycle (brightness)
-	pTIMx->CCR1 = CaptureValue;
+/*
+ * [Previously] TIM_SetCompare1 only: one STEP pin per timer.
+ * CCR1 - CCR4 are 4 consecutive words (0x34 - 0x40), so channel n is simply (&CCR1)[n - 1].
+ */
+void TIM_SetCompare(TIM_RegDef_t *pTIMx, uint8_t Channel, uint32_t CaptureValue){
+	// Writing to CCRx changes the duty cycle (brightness)
+	(&pTIMx->CCR1)[(Channel - 1U) & 0x3] = CaptureValue;
+}
+
+void TIM_PWM_ChannelInit(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t Mode, uint32_t CaptureValue){
+	uint8_t index = (Channel - 1U) & 0x3;
+	volatile uint32_t *pCCMR = (index < 2) ? &pTIMx->CCMR1 : &pTIMx->CCMR2;
+	uint8_t shift = (index & 0x1) * 8U; // channel 2 / 4: upper byte
+
+	// same steps as TIM_PWM_Init for channel 1: OCxM, OCxPE (Bit 3 of the channel's byte), CCxE
+	*pCCMR &= ~(7U << (shift + 4U));
+	*pCCMR |= ((uint32_t)(Mode & 0x7) << (shift + 4U));
+	*pCCMR |= (1U << (shift + 3U));
+
+	TIM_SetCompare(pTIMx, Channel, CaptureValue);
+	SET_BIT(pTIMx->CCER, index * 4U);
+
+	/*
+	 * Advanced timers: BDTR Bit 15 MOE: Main output enable
+	 * Outputs stay OFF until it is set (it is the "break" switch), whatever CCxE says.
+	 */
+	if (pTIMx == TIM1){
+		SET_BIT(pTIMx->BDTR, 15);
+	}
+}
+
+/*
+ * ==========================================
+ * 		Runtime Retune (PWM frequency / duty)
+ * ==========================================
+ */
+// TIM2 counts on 32 bits, the others on 16 (TIM5 is 32-bit too, but has no TIMx definition here yet)
+static uint32_t TIM_MaxPeriod(TIM_RegDef_t *pTIMx){
+	return (pTIMx == TIM2) ? 0xFFFFFFFFU : 0x10000U;
+}
+
+// CCRx for Duty (TIM_DUTY_FULL = 100%) of a Period ticks long, rounded
+static uint32_t TIM_DutyToCompare(uint32_t Period, uint32_t Duty){
+	return (uint32_t)((((uint64_t)Period * Duty) + (TIM_DUTY_FULL / 2U)) >> 16);
+}
+
+uint8_t TIM_PWM_SetPeriod(TIM_Handle_t *pTIMHandle, uint32_t Period){
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+
+	if ((Period < 2U) || (Period > TIM_MaxPeriod(pTIMx))){
+		return TIM_ERROR;
+	}
+
+	/*
+	 * CR1 Bit 1 UDIS: Update disable
+	 * ARR and CCRx are written one after the other. Should the period end between the two
+	 * writes, its update event would load a new ARR next to an old CCRx (a runt / stretched
+	 * pulse). With UDIS = 1 an overflow still wraps the counter, but copies nothing:
+	 * the period in progress and the one after it keep the old values, and the next
+	 * update after UDIS = 0 loads ARR and every CCRx together.
+	 * Interrupts are off for these few writes: an overflow inside the window gives no UIF
+	 * (the old period just runs once more), so the window must stay short.
+	 * UDIS also holds back TRGO (MMS = 010, update): not for the stepper's TIM2, whose
+	 * every update is a step counted by TIM3. A step in the window would go uncounted.
+	 */
+	uint32_t state = Critical_Enter();
+	SET_BIT(pTIMx->CR1, 1);
+
+	pTIMx->ARR = Period - 1U;
+	for (uint8_t i = 0; i < 4U; i++){
+		if (pTIMHandle->DutyChannels & (1U << i)){
+			(&pTIMx->CCR1)[i] = TIM_DutyToCompare(Period, pTIMHandle->Duty[i]); // same duty, new period
+		}
+	}
+
+	CLEAR_BIT(pTIMx->CR1, 1);
+	Critical_Exit(state);
+
+	pTIMHandle->TIM_Config.Period = Period - 1U;
+	return TIM_OK;
+}
+
+uint8_t TIM_PWM_SetFrequency(TIM_Handle_t *pTIMHandle, uint32_t FrequencyHz){
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+
+	if (FrequencyHz == 0){
+		return TIM_ERROR;
+	}
+
+	// tick = timer clock / (PSC + 1), TIM1 / TIM8-11 on APB2
+	uint32_t clock = ((uint32_t)pTIMx >= APB2_BASEADDR) ? RCC_GetTimerClock2Value() : RCC_GetTimerClock1Value();
+	uint32_t tick = clock / (pTIMx->PSC + 1U);
+
+	return TIM_PWM_SetPeriod(pTIMHandle, (tick + (FrequencyHz / 2U)) / FrequencyHz); // rounded
+}
+
+void TIM_PWM_SetDuty(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint32_t Duty){
+	uint8_t index = (Channel - 1U) & 0x3;
+
+	if (Duty > TIM_DUTY_FULL){
+		Duty = TIM_DUTY_FULL;
+	}
+	pTIMHandle->Duty[index] = Duty;
+	pTIMHandle->DutyChannels |= (1U << index);
+
+	// ARR reads back its preload value: the period this CCRx will be paired with
+	TIM_SetCompare(pTIMHandle->pTIMx, Channel, TIM_DutyToCompare(pTIMHandle->pTIMx->ARR + 1U, Duty));
+}
+
+/*
+ * ==========================================
+ * 		Update Interrupt
+ * ==========================================
+ * DIER Bit 0 UIE: Update interrupt enable
+ * SR   Bit 0 UIF: Update interrupt flag (rc_w0: write 0 to clear)
+ */
+void TIM_UpdateITConfig(TIM_Handle_t *pTIMHandle, uint8_t EnableOrDisable){
+	if (EnableOrDisable == ENABLE){
+		CLEAR_BIT(pTIMHandle->pTIMx->SR, 0); // a stale flag would fire at once
+		SET_BIT(pTIMHandle->pTIMx->DIER, 0);
+	}
+	else{
+		CLEAR_BIT(pTIMHandle->pTIMx->DIER, 0);
+	}
+}
+
+void TIM_IRQHandling(TIM_Handle_t *pTIMHandle){
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+
+	if (READ_BIT(pTIMx->SR, 0) && READ_BIT(pTIMx->DIER, 0)){
+		CLEAR_BIT(pTIMx->SR, 0);
+		TIM_UpdateEventCallback(pTIMHandle);
+	}
+}
+
+/*
+ * Weak default: does nothing (same pattern as Motion_CompleteCallback).
+ */
+__attribute__((weak)) void TIM_UpdateEventCallback(TIM_Handle_t *pTIMHandle){
+	(void)pTIMHandle;
 }
 
 /*
@@ -148,3 +308,96 @@ void TIM_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnableOrDisable){
 	 */
 	SET_BIT(NVIC_ISER->ISER[register_num], target_bit);
 }
+
+/*
+ * ==========================================
+ * 		Master / Slave Mode
+ * ==========================================
+ * CR2 Bits 6:4 MMS: Master mode selection -> what goes out on TRGO
+ */
+void TIM_MasterConfig(TIM_RegDef_t *pTIMx, uint8_t MasterMode){
+	pTIMx->CR2 &= ~(7U << 4);
+	pTIMx->CR2 |= ((uint32_t)(MasterMode & 0x7) << 4);
+}
+
+/*
+ * SMCR Bits 6:4 TS:  Trigger selection (which ITRx / input feeds the slave logic)
+ * SMCR Bits 2:0 SMS: Slave mode selection
+ * RM0390: "The TS bits must only be changed when they are not used (SMS = 000)
+ * to avoid wrong edge detections at the transition"
+ * -> slave mode off, trigger, then the new slave mode.
+ */
+void TIM_SlaveConfig(TIM_RegDef_t *pTIMx, uint8_t Trigger, uint8_t SlaveMode){
+	pTIMx->SMCR &= ~(7U << 0);
+
+	pTIMx->SMCR &= ~(7U << 4);
+	pTIMx->SMCR |= ((uint32_t)(Trigger & 0x7) << 4);
+
+	pTIMx->SMCR |= ((uint32_t)(SlaveMode & 0x7) << 0);
+}
+
+/*
+ * ==========================================
+ * 		DMA Burst / Profile Playback
+ * ==========================================
+ */
+void TIM_DMA_BurstInit(TIM_Handle_t *pTIMHandle, DMA_Handle_t *pDMAHandle, uint8_t BaseRegister, uint8_t BurstLength){
+	TIM_RegDef_t *pTIMx = pTIMHandle->pTIMx;
+
+	pDMAHandle->DMA_Config.DMA_Direction = DMA_DIR_MEM_TO_PERIPH;
+	pDMAHandle->DMA_Config.DMA_MemInc = ENABLE;               // walks through the profile
+	pDMAHandle->DMA_Config.DMA_PeriphInc = DISABLE;           // always DMAR, the timer does the spreading
+	pDMAHandle->DMA_Config.DMA_DataSize = DMA_SIZE_WORD;
+	pDMAHandle->DMA_Config.DMA_Mode = DMA_MODE_NORMAL;
+	pDMAHandle->DMA_Config.DMA_Priority = DMA_PRIORITY_VERY_HIGH; // a late row = a wrong period
+	pDMAHandle->DMA_Config.DMA_Interrupts = 0;                // TIM_GetProfileRemaining tells when it is done
+
+	DMA_PeriClockControl(pDMAHandle->pDMAx, ENABLE);
+	DMA_Init(pDMAHandle);
+
+	pTIMHandle->pUpdateDMA = pDMAHandle;
+	pTIMHandle->BurstLength = BurstLength;
+
+	/*
+	 * DCR (DMA control register)
+	 * Bits 12:8 DBL: DMA burst length, 0 = 1 transfer ... 17 = 18 transfers
+	 * Bits 4:0  DBA: DMA base address, first register written (offset from CR1, in words)
+	 */
+	pTIMx->DCR = ((uint32_t)((BurstLength - 1U) & 0x1F) << 8) | (BaseRegister & 0x1F);
+}
+
+uint8_t TIM_PlayProfile(TIM_Handle_t *pTIMHandle, const uint32_t *pProfile, uint16_t Updates){
+	uint32_t items = (uint32_t)Updates * pTIMHandle->BurstLength;
+
+	if ((pTIMHandle->pUpdateDMA == 0) || (items == 0) || (items > 0xFFFFU)){
+		return TIM_ERROR;
+	}
+
+	if (DMA_StartTransfer(pTIMHandle->pUpdateDMA, (uint32_t)&pTIMHandle->pTIMx->DMAR, (uint32_t)pProfile, (uint16_t)items) != DMA_OK){
+		return TIM_ERROR;
+	}
+
+	/*
+	 * DIER Bit 8 UDE: Update DMA request enable
+	 * From now on every update event pulls one row. (A UG from software only does it
+	 * if URS = 0: keep URS = 1 to play rows on real overflows only.)
+	 */
+	SET_BIT(pTIMHandle->pTIMx->DIER, 8);
+	return TIM_OK;
+}
+
+void TIM_StopProfile(TIM_Handle_t *pTIMHandle){
+	if (pTIMHandle->pUpdateDMA == 0){
+		return;
+	}
+
+	CLEAR_BIT(pTIMHandle->pTIMx->DIER, 8);
+	DMA_StopTransfer(pTIMHandle->pUpdateDMA);
+}
+
+uint16_t TIM_GetProfileRemaining(TIM_Handle_t *pTIMHandle){
+	if ((pTIMHandle->pUpdateDMA == 0) || !DMA_IsEnabled(pTIMHandle->pUpdateDMA)){
+		return 0;
+	}
+	return DMA_GetRemaining(pTIMHandle->pUpdateDMA) / pTIMHandle->BurstLength;
+}
@@ -16,6 +16,10 @@
 #ifndef SOURCES_STM32F446XX_TIMER_DRIVER_H_
 #define SOURCES_STM32F446XX_TIMER_DRIVER_H_
 
+#include <stdint.h>
+#include "stm32f446xx.h"
+#include "stm32f446xx_dma_driver.h"
+
 /*
  * ==========================================
  * 1. Peripheral Clock Setup
@@ -34,6 +38,8 @@
 
 #define TIM6_PCLK_EN()  (SET_BIT(RCC->APB1ENR, 4)) // Bit 4 TIM6EN: TIM6 clock enable
 
+#define TIM1_PCLK_EN()  (SET_BIT(RCC->APB2ENR, 0)) // TIM1 hangs on APB2: Bit 0 TIM1EN
+
 
 /*
  * ==========================================
@@ -81,12 +87,141 @@ typedef struct{
 typedef struct{
     TIM_RegDef_t *pTIMx;       // Pointer to the Timer's Register Base Address
     TIM_Config_t TIM_Config;   // Configuration settings
+    DMA_Handle_t *pUpdateDMA;  // stream serving this timer's update request (TIM_DMA_BurstInit), or NULL
+    uint8_t BurstLength;       // registers written per update event (set by TIM_DMA_BurstInit)
+    uint32_t Duty[4];          // per channel, TIM_DUTY_FULL = 100% (set by TIM_PWM_SetDuty)
+    uint8_t DutyChannels;      // Bit n: channel n + 1 has a Duty, TIM_PWM_SetPeriod rescales its CCRx
 } TIM_Handle_t;
 
+/*
+ * ==========================================
+ * 3. Master / Slave Mode (RM0390 17.3.19 Timer synchronization)
+ * ==========================================
+ * A timer can publish an internal signal (TRGO) that another timer uses as its input:
+ * - as its CLOCK (external clock mode 1): the slave counts the master's events
+ * - as a GATE: the slave only counts while the signal is high
+ *
+ * Which master lands on which ITRx input depends on the slave
+ * (RM0390 Table 93. TIMx internal trigger connection), e.g.
+ * TIM3: ITR1 = TIM2 TRGO
+ * TIM2: ITR2 = TIM3 TRGO
+ * TIM1: ITR1 = TIM2 TRGO, ITR2 = TIM3 TRGO
+ */
+/* @TIM_MasterMode (CR2 Bits 6:4 MMS) */
+#define TIM_TRGO_RESET      0 // UG bit
+#define TIM_TRGO_ENABLE     1 // CEN
+#define TIM_TRGO_UPDATE     2 // every update event (overflow)
+#define TIM_TRGO_OC1REF     4 // channel 1 output compare reference (before polarity / CC1E)
+
+/* @TIM_SlaveMode (SMCR Bits 2:0 SMS) */
+#define TIM_SLAVE_DISABLE   0 // internal clock (CK_INT), the default
+#define TIM_SLAVE_RESET     4 // trigger rising edge: CNT = 0 + update event (preloads copied), like a UG
+#define TIM_SLAVE_GATED     5 // counts only while the trigger is high
+#define TIM_SLAVE_TRIGGER   6 // counter starts on the trigger rising edge
+#define TIM_SLAVE_EXTCLK    7 // external clock mode 1: counts the trigger rising edges
+
+/* @TIM_Trigger (SMCR Bits 6:4 TS) */
+#define TIM_TRIGGER_ITR0    0
+#define TIM_TRIGGER_ITR1    1
+#define TIM_TRIGGER_ITR2    2
+#define TIM_TRIGGER_ITR3    3
+
+/*
+ * ==========================================
+ * 4. DMA Burst (RM0390 17.3.20 DMA burst mode)
+ * ==========================================
+ * On every update event the timer asks the DMA for BurstLength words and writes them,
+ * through the single DMAR register, into BurstLength consecutive registers starting at DBA.
+ * A whole table of (ARR, ..., CCR1) values is then "played" one row per period
+ * without the CPU: the values land in the preload registers and take effect one period later.
+ *
+ * Update request mapping (RM0390 Table 28), e.g. TIM2_UP -> DMA1 Stream 1 Channel 3
+ */
+/* @TIM_DMABase (DCR Bits 4:0 DBA = register offset / 4) */
+#define TIM_DMABASE_ARR     11 // 0x2C
+#define TIM_DMABASE_CCR1    13 // 0x34 (TIM1/8: RCR sits in between at 0x30)
+
+/* @TIM_Status */
+#define TIM_OK              0
+#define TIM_ERROR           1 // no DMA handle / profile too long (NDTR is 16 bits)
+
+/*
+ * ==========================================
+ * 5. Output Channels
+ * ==========================================
+ * 4 channels per timer (TIM2-5, TIM1/8), each with its own CCRx and output pin.
+ * CCMR1 holds channels 1 / 2, CCMR2 channels 3 / 4 (8 bits each),
+ * CCER has 4 bits per channel (CCxE = Bit 4 x (Channel - 1)).
+ */
+/* @TIM_Channel */
+#define TIM_CHANNEL_1       1
+#define TIM_CHANNEL_2       2
+#define TIM_CHANNEL_3       3
+#define TIM_CHANNEL_4       4
+
+/* @TIM_OCMode (CCMRx OCxM) */
+#define TIM_OCMODE_PWM1     6 // active while CNT < CCRx
+#define TIM_OCMODE_PWM2     7 // inactive while CNT < CCRx
+
+/*
+ * ==========================================
+ * 6. Runtime Retune (RM0390 17.3.2 Time-base unit, 17.3.10 PWM mode)
+ * ==========================================
+ * Change the PWM frequency / duty while the timer runs, without a runt or missing pulse:
+ * ARR (ARPE) and CCRx (OCxPE) are preloaded, so new values only take effect at the next
+ * update event, and TIM_PWM_SetPeriod holds back that update (UDIS) until ARR and all CCRx
+ * are written, so they switch together. The period in progress always finishes as it started.
+ *
+ * Duty is a fraction of the period in 1/65536ths (the same Q16 scale as Q16_PERCENT in
+ * motion_math.h), kept per channel: a new period keeps every channel's duty.
+ * Channels written with TIM_SetCompare are left alone (a fixed CCRx in ticks, e.g. a STEP edge).
+ */
+#define TIM_DUTY_FULL       65536U // 100%
+
 /* Function Prototypes */
-void TIM_PWM_Init(TIM_Handle_t *pTIMHandle);
-void TIM_SetCompare1(TIM_RegDef_t *pTIMx, uint32_t CaptureValue);
+void TIM_PWM_Init(TIM_Handle_t *pTIMHandle); // channel 1, PWM mode 1, ARR / CCR1 preloaded, counter on
+
+// Any channel: PWM mode, CCRx preloaded (OCxPE), output on (CCxE, + MOE on TIM1/8), CCRx = CaptureValue
+void TIM_PWM_ChannelInit(TIM_RegDef_t *pTIMx, uint8_t Channel, uint8_t Mode, uint32_t CaptureValue);
+void TIM_SetCompare(TIM_RegDef_t *pTIMx, uint8_t Channel, uint32_t CaptureValue); // @TIM_Channel
+
+/*
+ * Runtime retune (main() or an ISR, the counter keeps running)
+ * TIM_PWM_SetPeriod:    Period in ticks (ARR + 1, >= 2), TIM_ERROR if the counter is too short for it
+ * TIM_PWM_SetFrequency: the same from Hz, at the current prescaler (one division: not for tight ISRs)
+ * TIM_PWM_SetDuty:      Duty in 1/65536ths of the period (TIM_DUTY_FULL = always active)
+ * Not for a timer whose update is a TRGO someone counts (the stepper's TIM2): see UDIS in SetPeriod.
+ */
+uint8_t TIM_PWM_SetPeriod(TIM_Handle_t *pTIMHandle, uint32_t Period);
+uint8_t TIM_PWM_SetFrequency(TIM_Handle_t *pTIMHandle, uint32_t FrequencyHz);
+void TIM_PWM_SetDuty(TIM_Handle_t *pTIMHandle, uint8_t Channel, uint32_t Duty); // @TIM_Channel
+
+/*
+ * Update interrupt: the moment the values set above take effect
+ * TIM_IRQHandling: call it from the timer's ISR, it clears UIF and calls TIM_UpdateEventCallback
+ * (weak, override it), e.g. to write the next frequency of a sweep, one per period.
+ * The NVIC side is still TIM_IRQInterruptConfig.
+ */
+void TIM_UpdateITConfig(TIM_Handle_t *pTIMHandle, uint8_t EnableOrDisable);
+void TIM_IRQHandling(TIM_Handle_t *pTIMHandle);
+void TIM_UpdateEventCallback(TIM_Handle_t *pTIMHandle);
 
 void TIM_Basic_Init(TIM_Handle_t *pTIMHandle); // Basic Timer (not targeted at PWM)
 void TIM_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnableOrDisable);
+
+void TIM_MasterConfig(TIM_RegDef_t *pTIMx, uint8_t MasterMode);                  // @TIM_MasterMode
+void TIM_SlaveConfig(TIM_RegDef_t *pTIMx, uint8_t Trigger, uint8_t SlaveMode);   // @TIM_Trigger, @TIM_SlaveMode
+
+/*
+ * DMA burst / profile playback
+ * TIM_DMA_BurstInit: pDMAHandle->pDMAx, Stream and DMA_Channel must be set by the caller,
+ *                    the rest of DMA_Config is filled here (memory -> DMAR, words)
+ * TIM_PlayProfile:   Updates rows of BurstLength words each, one row per update event
+ *                    (the first one at the NEXT update), the array must stay valid until it is done
+ * TIM_GetProfileRemaining: rows not played yet (0: done)
+ */
+void TIM_DMA_BurstInit(TIM_Handle_t *pTIMHandle, DMA_Handle_t *pDMAHandle, uint8_t BaseRegister, uint8_t BurstLength);
+uint8_t TIM_PlayProfile(TIM_Handle_t *pTIMHandle, const uint32_t *pProfile, uint16_t Updates);
+void TIM_StopProfile(TIM_Handle_t *pTIMHandle);
+uint16_t TIM_GetProfileRemaining(TIM_Handle_t *pTIMHandle);
 #endif /* SOURCES_STM32F446XX_TIMER_DRIVER_H_ */
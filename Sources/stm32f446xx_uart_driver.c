@@ -5,9 +5,26 @@
  *      Author: Yuheng
  */
 #include "stm32f446xx.h"
+#include "stm32f446xx_rcc_driver.h"
 #include "stm32f446xx_uart_driver.h"
+#include "timestamp.h"
 #include <stdint.h>
 
+// BRR from the current PCLK, keeping what it actually achieved (USART_Init / USART_ClockChanged)
+static void USART_ApplyBaudRate(USART_Handle_t *pUSARTHandle){
+	uint32_t BaudRate = pUSARTHandle->USART_Config.USART_Baud;
+
+	pUSARTHandle->BaudClock = RCC_GetPeripheralClock((uint32_t)pUSARTHandle->pUSARTx);
+	pUSARTHandle->ActualBaud = USART_SetBaudRate(pUSARTHandle->pUSARTx, BaudRate);
+	if (pUSARTHandle->ActualBaud != 0){
+		int64_t diff = (int64_t)pUSARTHandle->ActualBaud - (int64_t)BaudRate;
+		pUSARTHandle->BaudErrorPpm = (int32_t)((diff * 1000000) / (int64_t)BaudRate);
+	}
+	else{
+		pUSARTHandle->BaudErrorPpm = 0;
+	}
+}
+
 void USART_Init(USART_Handle_t *pUSARTHandle){
 	// unpacking handle
 	USART_RegDef_t *USARTx = pUSARTHandle->pUSARTx;
@@ -15,7 +32,17 @@ void USART_Init(USART_Handle_t *pUSARTHandle){
 	uint8_t WordLen = pUSARTHandle->USART_Config.USART_WordLength;
 	uint8_t Parity = pUSARTHandle->USART_Config.USART_ParityControl;
 	uint8_t StopBits = pUSARTHandle->USART_Config.USART_StopBits;
-	uint32_t BaudRate = pUSARTHandle->USART_Config.USART_Baud;
+
+	/*
+	 * ==========================================
+	 * 			0. Software Queues
+	 * ==========================================
+	 * Both storage arrays live inside the handle and have power-of-two sizes,
+	 * so SPSC_Init cannot fail here.
+	 */
+	SPSC_Init(&pUSARTHandle->TxQueue, pUSARTHandle->TxStorage, USART_TX_BUFFER_SIZE);
+	SPSC_Init(&pUSARTHandle->RxQueue, pUSARTHandle->RxStorage, USART_RX_BUFFER_SIZE);
+	pUSARTHandle->TxBusy = RESET;
 
 	/*
 	 * ==========================================
@@ -109,9 +136,14 @@ void USART_Init(USART_Handle_t *pUSARTHandle){
 	 * ==========================================
 	 * 			5. Set Baud Rate
 	 * ==========================================
-	 * calling Helper Function USART_SetBaudRate
+	 * calling Helper Function USART_SetBaudRate,
+	 * and keeping what it actually achieved.
+	 * Error in ppm (parts per million) = (actual - requested) / requested x 10^6
+	 * e.g. 115200 @ 16 MHz -> BRR = 138.9 -> 139 -> 115108 baud -> -798 ppm (-0.08%)
+	 * A UART link tolerates a few % of total mismatch between both ends, so anything
+	 * beyond +-20000 ppm (2%) is worth a look.
 	 */
-	USART_SetBaudRate(USARTx, BaudRate);
+	USART_ApplyBaudRate(pUSARTHandle);
 
 	/*
 	 * ==========================================
@@ -127,81 +159,144 @@ void USART_Init(USART_Handle_t *pUSARTHandle){
 	SET_BIT(USARTx->CR1, 13);
 }
 
-void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate){
+/*
+ * Baud rate a BRR value really produces: the reverse of USART_ComputeBRR, straight from the
+ * register layout, so whatever the encoding gets wrong shows up here instead of being repeated.
+ * OVER8 = 0: 16 x USARTDIV = BRR[15:0]                     (mantissa x 16 + 4-bit fraction)
+ * OVER8 = 1:  8 x USARTDIV = BRR[15:4] x 8 + BRR[2:0]      (mantissa x 8 + 3-bit fraction)
+ * baud = f_ck / (that), rounded
+ */
+static uint32_t USART_DecodeBRR(uint32_t PCLK, uint32_t BRR, uint8_t Over8){
+	uint32_t div = Over8 ? (((BRR >> 4) << 3) | (BRR & 0x7U)) : (BRR & 0xFFFFU);
+
+	if (div == 0){
+		return 0;
+	}
+	return (PCLK + (div / 2U)) / div;
+}
+
+/*
+ * Candidate BRR for one oversampling mode.
+ * Returns the BRR value (0 if the baud rate cannot be reached), *pActual = resulting baud.
+ */
+static uint32_t USART_ComputeBRR(uint32_t PCLK, uint32_t BaudRate, uint8_t Over8, uint32_t *pActual){
+	/*
+	 * Tx/Rx baud = f_ck / (8 x (2 - OVER8) x USARTDIV)
+	 *
+	 * OVER8 = 0: 16 x USARTDIV = f_ck / baud
+	 *            -> Mantissa = BRR[15:4], Fraction = BRR[3:0] (4 bits, 1/16 steps)
+	 * OVER8 = 1:  8 x USARTDIV = f_ck / baud as well
+	 *            -> Mantissa = BRR[15:4], Fraction = BRR[2:0] (3 bits, 1/8 steps), BRR[3] must stay 0
+	 *
+	 * So in both cases "USARTDIV in fraction steps" is the same integer division f_ck / baud,
+	 * rounded to the nearest step: (A + B/2) / B. Only how it is split into BRR differs.
+	 * [Previously] 2 x f_ck for OVER8: twice the divider, the line ran at half the rate.
+	 *
+	 * Worked example, PCLK1 = 45 MHz (clock_governor.h, both levels), 115200 baud:
+	 *   45000000 / 115200 = 390.6 -> 391
+	 *   OVER8 = 0: BRR = 391 = 0x187 (mantissa 24, fraction 7)  -> 45000000 / 391 = 115090 (-954 ppm)
+	 *   OVER8 = 1: BRR = (391 >> 3) << 4 | (391 & 7) = 0x307     -> 45000000 / (48 x 8 + 7) = 115090
+	 *   Same error: oversampling by 16 is kept.
+	 */
+	uint32_t div = (PCLK + (BaudRate / 2U)) / BaudRate;
+	uint8_t fraction_bits = Over8 ? 3 : 4;
+
+	// USARTDIV must be >= 1 (mantissa != 0), and the mantissa only has 12 bits
+	if ((div < (1U << fraction_bits)) || ((div >> fraction_bits) > 0xFFF)){
+		*pActual = 0;
+		return 0;
+	}
+
+	uint32_t mantissa = div >> fraction_bits;
+	uint32_t fraction = div & ((1U << fraction_bits) - 1U);
+	uint32_t brr = (mantissa << 4) | fraction;
+
+	*pActual = USART_DecodeBRR(PCLK, brr, Over8);
+	return brr;
+}
+
+void USART_ClockChanged(USART_Handle_t *pUSARTHandle){
+	/*
+	 * Same PCLK as when BRR was computed -> nothing to do. USART_SetBaudRate disables the USART
+	 * for a moment (UE = 0), which would cut a byte on the line: only when the divider really changes.
+	 */
+	if (RCC_GetPeripheralClock((uint32_t)pUSARTHandle->pUSARTx) == pUSARTHandle->BaudClock){
+		return;
+	}
+	USART_ApplyBaudRate(pUSARTHandle);
+}
+
+uint32_t USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate){
 	/*
 	 * ==========================================
-	 * 		Oversampling by 16 (default)
+	 * 		1. Real Peripheral Clock
+	 * ==========================================
+	 * [Previously] PCLK = 16000000 (HSI, datasheet Table 41),
+	 * which silently broke the baud rate as soon as the clock tree changed.
+	 * Now it is read back from RCC (USART2 sits on APB1 -> PCLK1).
+	 */
+	uint32_t PCLK = RCC_GetPeripheralClock((uint32_t)pUSARTx);
+
+	if (BaudRate == 0){
+		return 0;
+	}
+
+	/*
+	 * ==========================================
+	 * 	2. Oversampling by 16 or by 8
 	 * ==========================================
-	 * Benefits:
-	 * 1. Noise Immunity
-	 * 2. Clock Tolerance
-	 * NOTE:
-	 * I chose Oversampling by 16 (default) over 8 because:
-	 * a. 16 is more "reliable", because it checks the received data 16 times
-	 * b. It requires higher clock frequency, so maximum baud rate is limited,
-	 * but I only need 115200, which is standard baud rate for Serial Printing
-	 * c. Oversampling by 8 sacrifices reliability to gain higher baud rate,
-	 * but again, I only need 115200, so I do not need it
-	 *
 	 * Control Register 1:
 	 * Bit 15 OVER8: Oversampling mode
-	 * 0: oversampling by 16
-	 * 1: oversampling by 8
+	 * 0: oversampling by 16 -> more samples per bit, better noise / clock tolerance, max baud = f_ck / 16
+	 * 1: oversampling by 8  -> max baud = f_ck / 8 (e.g. 2 Mbaud @ 16 MHz, 5.6 Mbaud @ 45 MHz)
+	 *
+	 * [Previously] always 16, since I only needed 115200.
+	 * Now both are computed and the one with the smaller error wins,
+	 * on a tie 16 is kept for its better noise immunity.
 	 */
-	CLEAR_BIT(pUSARTx->CR1, 15);
+	uint32_t actual16, actual8;
+	uint32_t brr16 = USART_ComputeBRR(PCLK, BaudRate, 0, &actual16);
+	uint32_t brr8 = USART_ComputeBRR(PCLK, BaudRate, 1, &actual8);
+
+	uint32_t error16 = (actual16 > BaudRate) ? (actual16 - BaudRate) : (BaudRate - actual16);
+	uint32_t error8 = (actual8 > BaudRate) ? (actual8 - BaudRate) : (BaudRate - actual8);
+
+	uint8_t use_over8 = (brr16 == 0) || ((brr8 != 0) && (error8 < error16));
+	uint32_t brr = use_over8 ? brr8 : brr16;
+
+	if (brr == 0){
+		return 0; // too fast even for OVER8 (or too slow for a 12-bit mantissa): leave BRR alone
+	}
 
 	/*
 	 * ==========================================
-	 * 		Standard Equation 1 (OVER8 = 0)
+	 * 		3. Write CR1 / BRR
 	 * ==========================================
-	 * Tx/Rx baud = f_ck / (8 x (2 - OVER8) x USARTDIV
-	 *
-	 * thus,
-	 * usartdiv = f_ck / (8 * 2 * baud)
+	 * OVER8 and BRR are only changed with the USART disabled (UE = 0),
+	 * so the caller must make sure nothing is being sent/received (e.g. USART_FlushTx first).
 	 */
+	uint8_t was_enabled = READ_BIT(pUSARTx->CR1, 13) ? SET : RESET;
+	CLEAR_BIT(pUSARTx->CR1, 13);
 
-	// 1. set correct Peripheral Clock Frequency
-	// according to datasheet (page 105), 6.3.10 Internal clock source characteristics
-	// Table 41. HSI oscillator characteristics
-	// frequency -> f_HSI = 16MHz
-	uint32_t PCLK = 16000000;
-
-	// 2. Baud rate register (BRR)
-	// Bits 15:4 DIV_Mantissa[11:0]: mantissa of USARTDIV
-	// These 12 bits define the mantissa of the USART Divider (USARTDIV)
-
-	// Bits 3:0 DIV_Fraction[3:0]: fraction of USARTDIV
-	// It uses a fixed-point algorithm
-	uint32_t usartdiv_mantissa = 0;
-	uint32_t usartdiv_fraction = 0;
-
-	// 3. Calculation
-	// usartdiv = f_ck / (8 * 2 * baud)
-	// NOTE:
-	// when using MCUs such as this STM32F4 board,
-	// it is best to avoid using floating point numbers,
-	// thus, I will multiply DIV by
-	uint32_t divider = 8 * 2 * BaudRate;
-	usartdiv_mantissa = PCLK / divider; // integer part
-
-	uint32_t remainder = PCLK % divider; // source of fractional part
-
-	// to get (A / B) and round
-	// do:
-	// (A + B/2) / B
-	usartdiv_fraction = (remainder * 16 + (divider / 2)) / divider;
-
-	// 4. Overwrite Bits
-	uint32_t mask = (1u << 12) - 1; // creates a mask of 12 1s
-	uint8_t shift_amount = 4; // Mantissa starts at bit 4
-	pUSARTx->BRR &= (~mask << shift_amount); // clear bits first
-	pUSARTx->BRR |= (usartdiv_mantissa << shift_amount);
-
-	pUSARTx->BRR &= (~0xF); // clear Bits 3:0
-	pUSARTx->BRR |= (usartdiv_fraction);
+	if (use_over8){
+		SET_BIT(pUSARTx->CR1, 15);
+	}
+	else{
+		CLEAR_BIT(pUSARTx->CR1, 15);
+	}
+
+	// Bits 15:4 DIV_Mantissa[11:0], Bits 3:0 DIV_Fraction[3:0] -> one write, no half-updated divider
+	pUSARTx->BRR = brr;
+
+	if (was_enabled){
+		SET_BIT(pUSARTx->CR1, 13);
+	}
+
+	// What the registers now hold, decoded back: this is what ActualBaud / BaudErrorPpm report
+	return USART_DecodeBRR(PCLK, pUSARTx->BRR, READ_BIT(pUSARTx->CR1, 15) ? 1 : 0);
 }
 
-void USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t Len){
+uint8_t USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t Len){
     /*
      * Although C has strlen() to calculate string length using the null-terminator,
      * it is best practice to let the caller pass the explicit length of the array.
@@ -241,6 +336,11 @@ void USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t L
      * Note: This is a "Blocking" implementation.
      * The CPU is stuck in a loop asking "Is TXE empty yet?" millions of times.
      * Later, I will optimize this using Interrupts so the CPU can do other things while waiting.
+     * -> Done: see USART_SendDataIT (TX ring buffer + TXE interrupt) below.
+     *
+     * [Previously] the wait had no end: with the transmitter off (TE = 0) or the clock
+     * switched away, TXE never comes back and the caller hung right here.
+     * Now each byte gets USART_BYTE_TIMEOUT_US, then USART_TIMEOUT.
      */
 
     // Use a pointer to access the hardware registers directly.
@@ -254,7 +354,12 @@ void USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t L
         // We check Bit 7 (TXE) of the Status Register (SR).
         // If it is 0 (NOT empty), we wait here.
         // If it is 1 (Empty), the loop condition becomes false, and we proceed.
-        while( READ_BIT(pUSARTx->SR, 7) == 0 ); // do nothing when it is not ready to "load" again
+        uint32_t deadline = Timestamp_Deadline(USART_BYTE_TIMEOUT_US);
+        while( READ_BIT(pUSARTx->SR, 7) == 0 ){ // do nothing when it is not ready to "load" again
+            if (Timestamp_Expired(deadline)){
+                return USART_TIMEOUT;
+            }
+        }
 
         // Extract the value from the pointer and write to Data Register.
         // pTxBuffer is a pointer to uint8_t, meaning the compiler interprets
@@ -265,9 +370,10 @@ void USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t L
         // Increment the pointer to point to the next "box" (byte) in the memory array.
         pTxBuffer++;
     }
+    return USART_OK;
 }
 
-uint8_t USART_ReceiveData(USART_Handle_t *pUSARTHandle){
+uint8_t USART_ReceiveData(USART_Handle_t *pUSARTHandle, uint8_t *pData, uint32_t TimeoutUs){
 	USART_RegDef_t *USARTx = pUSARTHandle->pUSARTx;
 
 	/*
@@ -279,10 +385,16 @@ uint8_t USART_ReceiveData(USART_Handle_t *pUSARTHandle){
 	 * - Bit 5 (RXNE) = 1: Data has arrived and is ready to be read.
 	 *
 	 * Note: This is a "Blocking" implementation. The CPU will stay in this while-loop
-	 * forever until a byte is physically received.
+	 * until a byte is physically received.
+	 * [Previously] "forever": now for at most TimeoutUs (the PC may never send anything).
 	 * Make sure to check SR (Status Register), not CR1!
 	 */
-	while ( READ_BIT(USARTx->SR, 5) == 0){};
+	uint32_t deadline = Timestamp_Deadline(TimeoutUs);
+	while ( READ_BIT(USARTx->SR, 5) == 0){
+		if (Timestamp_Expired(deadline)){
+			return USART_TIMEOUT;
+		}
+	}
 
 	/*
 	 * ------------------------------
@@ -299,7 +411,370 @@ uint8_t USART_ReceiveData(USART_Handle_t *pUSARTHandle){
 	 * * So, we simply read the DR to get the external command.
 	 * Example: If we read 'F', we trigger the logic to turn the motor (and feed the cat).
 	 */
-	return (uint8_t)(USARTx->DR & 0xFF); // Masking with 0xFF for safety
+	*pData = (uint8_t)(USARTx->DR & 0xFF); // Masking with 0xFF for safety
+	return USART_OK;
+}
+
+/*
+ * ==========================================
+ * 		Non-Blocking Transmit (TX Ring Buffer)
+ * ==========================================
+ * USART_SendData above keeps the CPU stuck on TXE for every single byte:
+ * at 115200 baud one byte takes ~87us, so a 20-char status line blocks main() for ~1.7ms.
+ *
+ * Instead, USART_SendDataIT only copies the bytes into the handle's ring buffer
+ * and turns on the TXE interrupt (TXEIE). The hardware then "asks" for the next byte
+ * by itself, and USART_IRQHandling loads it into DR from inside the ISR.
+ * main() returns immediately and can go back to feeding the dog / handling commands.
+ *
+ * Control register 1:
+ * Bit 7 TXEIE: TXE interrupt enable -> interrupt whenever TXE=1 (DR is empty)
+ * Bit 6 TCIE: Transmission complete interrupt enable -> interrupt whenever TC=1
+ */
+uint32_t USART_GetTxQueued(USART_Handle_t *pUSARTHandle){
+	return SPSC_Count(&pUSARTHandle->TxQueue);
+}
+
+uint32_t USART_GetTxFree(USART_Handle_t *pUSARTHandle){
+	return SPSC_Free(&pUSARTHandle->TxQueue);
+}
+
+uint32_t USART_SendDataIT(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len){
+	/*
+	 * Never block: if the queue cannot take everything, only what fits is queued
+	 * (the rest is counted in TxQueue.Dropped).
+	 * The queue publishes the new bytes only after they are written,
+	 * so the ISR can never send a slot that has not been filled yet.
+	 */
+	Len = SPSC_PushBuffer(&pUSARTHandle->TxQueue, pTxBuffer, Len);
+	if (Len == 0){
+		return 0;
+	}
+
+	uint32_t state = Critical_Enter();
+	pUSARTHandle->TxBusy = SET;
+
+	/*
+	 * Kick the transmitter: TXE is already 1 when idle, so the ISR fires right away.
+	 * If a DMA message is on the wire, the bytes just wait in the ring:
+	 * USART_DMA_TxIRQHandling turns TXEIE on once the DMA is done,
+	 * otherwise the two would interleave bytes in DR.
+	 * Same while a DMA message is pending: it was queued before these bytes, so it goes first.
+	 */
+	if ((pUSARTHandle->TxDMAActive == RESET) && (pUSARTHandle->pTxDMAPending == 0)){
+		SET_BIT(pUSARTHandle->pUSARTx->CR1, 7); // TXEIE
+	}
+	Critical_Exit(state);
+
+	return Len;
+}
+
+uint8_t USART_FlushTx(USART_Handle_t *pUSARTHandle, uint32_t TimeoutUs){
+	/*
+	 * TxBusy is only cleared by the TC interrupt AFTER the ring is empty,
+	 * meaning the last stop bit has physically left the TX pin.
+	 * Useful before a reset, or before changing the baud rate.
+	 * [Previously] Timeout counted loop passes: its length in time depended on the clock
+	 * and the compiler. Now a deadline on the cycle counter.
+	 */
+	uint32_t deadline = Timestamp_Deadline(TimeoutUs);
+
+	while (pUSARTHandle->TxBusy == SET){
+		if (Timestamp_Expired(deadline)){
+			return USART_TIMEOUT;
+		}
+	}
+	return USART_OK;
+}
+
+uint8_t USART_WaitTxFree(USART_Handle_t *pUSARTHandle, uint32_t Len, uint32_t TimeoutUs){
+	// The ISR frees one slot per byte loaded into DR: room for a frame is a few byte times away, not a whole ring
+	uint32_t deadline = Timestamp_Deadline(TimeoutUs);
+
+	while (USART_GetTxFree(pUSARTHandle) < Len){
+		if (Timestamp_Expired(deadline)){
+			return USART_TIMEOUT;
+		}
+	}
+	return USART_OK;
+}
+
+/*
+ * ==========================================
+ * 		Zero-Copy Transmit (DMA)
+ * ==========================================
+ * Control register 3:
+ * Bit 7 DMAT: DMA enable transmitter
+ * 1: every time TXE = 1, the USART raises a DMA request instead of needing the CPU.
+ *
+ * Cost per message for the CPU: a handful of register writes in USART_SendDataDMA
+ * plus one interrupt at the very end, no matter how long the message is.
+ */
+static void USART_DMA_StartTx(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint16_t Len){
+	pUSARTHandle->TxDMAActive = SET;
+	pUSARTHandle->TxBusy = SET;
+
+	// SR Bit 6 TC is cleared by writing 0 to it (RM0390 recommends this before a DMA transmit)
+	CLEAR_BIT(pUSARTHandle->pUSARTx->SR, 6);
+
+	DMA_StartTransfer(pUSARTHandle->pTxDMA, (uint32_t)&pUSARTHandle->pUSARTx->DR, (uint32_t)pTxBuffer, Len);
+}
+
+void USART_DMA_TxInit(USART_Handle_t *pUSARTHandle, DMA_Handle_t *pDMAHandle){
+	pUSARTHandle->pTxDMA = pDMAHandle;
+	pUSARTHandle->TxDMAActive = RESET;
+	pUSARTHandle->pTxDMAPending = 0;
+
+	DMA_PeriClockControl(pDMAHandle->pDMAx, ENABLE);
+	DMA_Init(pDMAHandle);
+
+	SET_BIT(pUSARTHandle->pUSARTx->CR3, 7); // DMAT
+}
+
+uint8_t USART_SendDataDMA(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint16_t Len){
+	uint8_t status = USART_OK;
+
+	if ((pUSARTHandle->pTxDMA == 0) || (Len == 0)){
+		return USART_BUSY;
+	}
+
+	/*
+	 * Short critical section: the DMA / USART ISRs also look at the two slots.
+	 * Without it, the DMA could finish right between "is it active?" and
+	 * "store as pending", and the pending message would never be started.
+	 */
+	uint32_t state = Critical_Enter();
+
+	uint8_t ring_idle = (USART_GetTxQueued(pUSARTHandle) == 0) && !READ_BIT(pUSARTHandle->pUSARTx->CR1, 7);
+
+	if ((pUSARTHandle->TxDMAActive == RESET) && ring_idle){
+		USART_DMA_StartTx(pUSARTHandle, pTxBuffer, Len); // line is free -> go now
+	}
+	else if ((pUSARTHandle->pTxDMAPending == 0) && (USART_GetTxQueued(pUSARTHandle) == 0)){
+		pUSARTHandle->TxDMAPendingLen = Len;             // line is busy -> second slot
+		pUSARTHandle->pTxDMAPending = pTxBuffer;
+		pUSARTHandle->TxBusy = SET;
+
+		/*
+		 * The ring's last byte is still in DR: hand the line over at TC (USART_IRQHandling),
+		 * not at the next TXE, which would send bytes queued after this message first.
+		 */
+		if (READ_BIT(pUSARTHandle->pUSARTx->CR1, 7)){
+			CLEAR_BIT(pUSARTHandle->pUSARTx->CR1, 7); // TXEIE off
+			SET_BIT(pUSARTHandle->pUSARTx->CR1, 6);   // TCIE on
+		}
+	}
+	else{
+		/*
+		 * Both slots taken, or ring bytes queued ahead of it:
+		 * [Previously] accepted anyway, and USART_DMA_TxIRQHandling started it BEFORE those
+		 * bytes, so an earlier USART_SendDataIT message went out after a later DMA one.
+		 */
+		status = USART_BUSY;
+	}
+
+	Critical_Exit(state);
+	return status;
+}
+
+void USART_DMA_TxIRQHandling(USART_Handle_t *pUSARTHandle){
+	DMA_Handle_t *pDMAHandle = pUSARTHandle->pTxDMA;
+	uint8_t flags = DMA_GetFlags(pDMAHandle);
+
+	if ( !(flags & (DMA_FLAG_TC | DMA_FLAG_TE)) ){
+		return;
+	}
+	DMA_ClearFlags(pDMAHandle, DMA_FLAG_ALL);
+
+	pUSARTHandle->TxDMAActive = RESET;
+	USART_ApplicationEventCallback(pUSARTHandle, (flags & DMA_FLAG_TE) ? USART_EVENT_TX_DMA_ERROR : USART_EVENT_TX_DMA_CPLT);
+
+	/*
+	 * Who gets the line next?
+	 * 1. the pending DMA message (back-to-back, no gap)
+	 * 2. bytes that piled up in the TX ring meanwhile
+	 * 3. nobody -> wait for TC so TxBusy only drops once the last bit is out
+	 */
+	if (pUSARTHandle->pTxDMAPending != 0){
+		const uint8_t *pNext = pUSARTHandle->pTxDMAPending;
+		pUSARTHandle->pTxDMAPending = 0;
+		USART_DMA_StartTx(pUSARTHandle, pNext, pUSARTHandle->TxDMAPendingLen);
+	}
+	else if (USART_GetTxQueued(pUSARTHandle) != 0){
+		SET_BIT(pUSARTHandle->pUSARTx->CR1, 7); // TXEIE
+	}
+	else{
+		SET_BIT(pUSARTHandle->pUSARTx->CR1, 6); // TCIE
+	}
+}
+
+/*
+ * ==========================================
+ * 		Circular DMA Receive + IDLE Line
+ * ==========================================
+ * Problem with one interrupt per byte:
+ * the old USART2_IRQHandler copied DR into ONE global variable,
+ * so a burst of several bytes between two loop iterations overwrote itself.
+ *
+ * Here, the DMA copies every byte into a ring in RAM by itself (circular mode never stops),
+ * and the CPU is only interrupted when:
+ * 1. the line goes IDLE (one whole character time with no start bit) -> "the sender paused,
+ *    a complete frame is in the buffer" (USART_SR Bit 4 IDLE, CR1 Bit 4 IDLEIE)
+ * 2. the DMA reaches half / the end of the buffer (long bursts, so main() can catch up early)
+ * 3. an error happens (CR3 Bit 0 EIE -> FE, NF, ORE while DMAR = 1)
+ *
+ * Control register 3:
+ * Bit 6 DMAR: DMA enable receiver
+ */
+void USART_DMA_RxInit(USART_Handle_t *pUSARTHandle, DMA_Handle_t *pDMAHandle, uint8_t *pRxBuffer, uint16_t Size){
+	USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+
+	pUSARTHandle->pRxDMA = pDMAHandle;
+	pUSARTHandle->pRxDMABuffer = pRxBuffer;
+	pUSARTHandle->RxDMASize = Size;
+	pUSARTHandle->RxDMAPos = 0;
+	pUSARTHandle->RxDMACrossed = 0;
+
+	DMA_PeriClockControl(pDMAHandle->pDMAx, ENABLE);
+	DMA_Init(pDMAHandle);
+
+	// Peripheral (DR) -> Memory (DMA ring), NDTR = whole buffer, reloaded automatically (CIRC)
+	DMA_StartTransfer(pDMAHandle, (uint32_t)&pUSARTx->DR, (uint32_t)pRxBuffer, Size);
+
+	SET_BIT(pUSARTx->CR3, 6);   // DMAR
+	SET_BIT(pUSARTx->CR3, 0);   // EIE
+	CLEAR_BIT(pUSARTx->CR1, 5); // RXNEIE off: the DMA takes the bytes, not the CPU
+	SET_BIT(pUSARTx->CR1, 4);   // IDLEIE
+}
+
+/*
+ * Move everything the DMA wrote since last time into RxQueue.
+ * Called from the ISRs only (IDLE line, half / full buffer).
+ *
+ * NDTR counts down from RxDMASize, so the DMA's write position is (RxDMASize - NDTR).
+ * (NDTR reads RxDMASize again right after a wrap, which maps to position 0, as expected.)
+ * At most two copies: up to the end of the DMA buffer, then from its start.
+ *
+ * Lapping: NDTR alone cannot tell "3 new bytes" from "3 + RxDMASize new bytes".
+ * The HT / TC flags can: each says the DMA went past the half / the end of the buffer.
+ * RxDMACrossed remembers which of the two the drained bytes went past,
+ * USART_DMA_RxIRQHandling checks every flag against it.
+ */
+#define USART_RX_CROSSED_HALF  (1U << 0)
+#define USART_RX_CROSSED_END   (1U << 1)
+
+static void USART_DMA_RxPush(USART_Handle_t *pUSARTHandle, const uint8_t *pData, uint32_t Len){
+	uint32_t pushed = SPSC_PushBuffer(&pUSARTHandle->RxQueue, pData, Len);
+	pUSARTHandle->RxDroppedBytes += (Len - pushed);
+}
+
+static void USART_DMA_RxDrain(USART_Handle_t *pUSARTHandle){
+	uint16_t size = pUSARTHandle->RxDMASize;
+	uint16_t write_pos = size - DMA_GetRemaining(pUSARTHandle->pRxDMA);
+	uint16_t read_pos = pUSARTHandle->RxDMAPos;
+
+	if (write_pos == size){
+		write_pos = 0;
+	}
+	if (write_pos == read_pos){
+		return;
+	}
+
+	// (read_pos, write_pos] going forward: which boundaries does it contain?
+	uint16_t len = (uint16_t)((write_pos + size - read_pos) % size);
+	uint16_t to_half = (uint16_t)(((size / 2U) + size - read_pos) % size);
+	uint16_t to_end = (uint16_t)((size - read_pos) % size);
+	if ((to_half != 0) && (to_half <= len)){
+		pUSARTHandle->RxDMACrossed |= USART_RX_CROSSED_HALF;
+	}
+	if ((to_end != 0) && (to_end <= len)){
+		pUSARTHandle->RxDMACrossed |= USART_RX_CROSSED_END;
+	}
+
+	if (write_pos < read_pos){ // the DMA wrapped around
+		USART_DMA_RxPush(pUSARTHandle, &pUSARTHandle->pRxDMABuffer[read_pos], size - read_pos);
+		read_pos = 0;
+	}
+	USART_DMA_RxPush(pUSARTHandle, &pUSARTHandle->pRxDMABuffer[read_pos], write_pos - read_pos);
+
+	pUSARTHandle->RxDMAPos = write_pos;
+}
+
+void USART_DMA_RxIRQHandling(USART_Handle_t *pUSARTHandle){
+	uint8_t flags = DMA_GetFlags(pUSARTHandle->pRxDMA);
+	DMA_ClearFlags(pUSARTHandle->pRxDMA, flags);
+
+	// Half / full buffer: a long burst is still coming in, move it out before the DMA laps it
+	if (flags & (DMA_FLAG_HT | DMA_FLAG_TC)){
+		USART_DMA_RxDrain(pUSARTHandle);
+
+		/*
+		 * A boundary the DMA went past (flag) that no drain went past: the DMA went past it
+		 * once more after the last drain, i.e. around the whole buffer. Those bytes are gone,
+		 * what RxQueue got instead is the newest RxDMASize at most (the exact loss is unknown).
+		 */
+		uint8_t crossed = pUSARTHandle->RxDMACrossed;
+		if (((flags & DMA_FLAG_HT) && !(crossed & USART_RX_CROSSED_HALF)) ||
+			((flags & DMA_FLAG_TC) && !(crossed & USART_RX_CROSSED_END))){
+			pUSARTHandle->RxLappedBytes += pUSARTHandle->RxDMASize;
+		}
+		if (flags & DMA_FLAG_HT){
+			crossed &= ~USART_RX_CROSSED_HALF;
+		}
+		if (flags & DMA_FLAG_TC){
+			crossed &= ~USART_RX_CROSSED_END;
+		}
+		pUSARTHandle->RxDMACrossed = crossed;
+
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_DATA);
+	}
+
+	/*
+	 * Transfer error (RM0390 9.3.15): the hardware has already cleared EN, so circular mode
+	 * does not save us: [Previously] the flag was cleared and reception silently stopped for good.
+	 * Now: keep what was written up to the error, count it, and start over from the buffer start.
+	 */
+	if (flags & DMA_FLAG_TE){
+		USART_DMA_RxDrain(pUSARTHandle);
+		pUSARTHandle->RxDMAErrors++;
+
+		pUSARTHandle->RxDMAPos = 0;
+		pUSARTHandle->RxDMACrossed = 0;
+		(void)DMA_StartTransfer(pUSARTHandle->pRxDMA, (uint32_t)&pUSARTHandle->pUSARTx->DR,
+				(uint32_t)pUSARTHandle->pRxDMABuffer, pUSARTHandle->RxDMASize);
+
+		USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_DMA_ERROR);
+	}
+}
+
+/*
+ * ==========================================
+ * 		Receive Queue (both RX modes)
+ * ==========================================
+ * USART_ReceiveIT: the simple mode without DMA.
+ * One RXNE interrupt per byte, and the ISR pushes each byte into RxQueue
+ * (instead of overwriting a single global variable).
+ */
+void USART_ReceiveIT(USART_Handle_t *pUSARTHandle){
+	SET_BIT(pUSARTHandle->pUSARTx->CR1, 5); // RXNEIE
+}
+
+uint32_t USART_RxAvailable(USART_Handle_t *pUSARTHandle){
+	return SPSC_Count(&pUSARTHandle->RxQueue);
+}
+
+uint32_t USART_ReadRx(USART_Handle_t *pUSARTHandle, uint8_t *pDest, uint32_t MaxLen){
+	return SPSC_PopBuffer(&pUSARTHandle->RxQueue, pDest, MaxLen);
+}
+
+/*
+ * Weak default: does nothing.
+ * The application can define its own USART_ApplicationEventCallback to get notified
+ * (the linker picks the non-weak one automatically).
+ */
+__attribute__((weak)) void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle, uint8_t AppEvent){
+	(void)pUSARTHandle;
+	(void)AppEvent;
 }
 
 /*
@@ -349,3 +824,106 @@ void USART_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnableOrDisable){
 	 */
 	SET_BIT(NVIC_ISER->ISER[register_num], target_bit);
 }
+
+void USART_IRQHandling(USART_Handle_t *pUSARTHandle){
+	USART_RegDef_t *pUSARTx = pUSARTHandle->pUSARTx;
+	uint32_t sr = pUSARTx->SR;
+	uint8_t dr_read = RESET;
+
+	/*
+	 * ==============================
+	 * 	 RX side (no DMA): RXNE -> queue the byte
+	 * ==============================
+	 * Reading DR clears RXNE (and, together with the SR read above, ORE/FE/NF/IDLE too).
+	 */
+	if ( READ_BIT(pUSARTx->CR1, 5) && (sr & (1U << 5)) ){
+		if (SPSC_Push(&pUSARTHandle->RxQueue, (uint8_t)(pUSARTx->DR & 0xFF)) != SET){
+			pUSARTHandle->RxDroppedBytes++;
+		}
+		dr_read = SET;
+	}
+
+	/*
+	 * ==============================
+	 * 	 0. RX side: errors and IDLE line
+	 * ==============================
+	 * SR Bit 1 FE, Bit 2 NF, Bit 3 ORE, Bit 4 IDLE
+	 * All four are cleared by the same sequence: read SR (done above), then read DR.
+	 */
+	if ( sr & ((1U << 1) | (1U << 2) | (1U << 3) | (1U << 4)) ){
+		if (sr & (1U << 3)){
+			pUSARTHandle->RxOverrunErrors++;
+		}
+		if (sr & (1U << 1)){
+			pUSARTHandle->RxFramingErrors++;
+		}
+		if (sr & (1U << 2)){
+			pUSARTHandle->RxNoiseErrors++;
+		}
+
+		/*
+		 * Second half of the clear sequence, unless the RXNE branch above already did it.
+		 * [Previously] always read: a byte that arrived after the first read was thrown away.
+		 */
+		if (!dr_read){
+			(void)pUSARTx->DR;
+		}
+
+		if ( (sr & (1U << 4)) && READ_BIT(pUSARTx->CR1, 4) ){
+			USART_DMA_RxDrain(pUSARTHandle); // the burst is over -> hand all of it to main()
+			pUSARTHandle->RxFrames++;
+			USART_ApplicationEventCallback(pUSARTHandle, USART_EVENT_RX_FRAME);
+		}
+	}
+
+	/*
+	 * ==============================
+	 * 	 1. TXE -> load the next byte
+	 * ==============================
+	 * Only act if TXEIE is enabled, otherwise TXE (which is 1 whenever the line is idle)
+	 * would make us treat every RX interrupt as a TX interrupt too.
+	 */
+	if ( READ_BIT(pUSARTx->CR1, 7) && READ_BIT(pUSARTx->SR, 7) ){
+		uint8_t data;
+
+		if (SPSC_Pop(&pUSARTHandle->TxQueue, &data) == SET){
+			// Writing DR clears TXE (and TC) automatically
+			pUSARTx->DR = data;
+		}
+		else{
+			/*
+			 * Ring is empty: stop asking for bytes (TXE stays 1, so leaving TXEIE on
+			 * would re-enter this ISR forever) and wait for TC instead,
+			 * which tells us the final byte has completely left the shift register.
+			 */
+			CLEAR_BIT(pUSARTx->CR1, 7); // TXEIE off
+			SET_BIT(pUSARTx->CR1, 6);   // TCIE on
+		}
+	}
+
+	/*
+	 * ==============================
+	 * 	 2. TC -> transmission fully done
+	 * ==============================
+	 */
+	if ( READ_BIT(pUSARTx->CR1, 6) && READ_BIT(pUSARTx->SR, 6) ){
+		CLEAR_BIT(pUSARTx->CR1, 6); // TCIE off
+
+		if (pUSARTHandle->TxDMAActive == RESET){
+			if (pUSARTHandle->pTxDMAPending != 0){
+				/*
+				 * A DMA message was waiting for the ring to finish -> its turn now.
+				 * Bytes in the ring at this point were queued after it (USART_SendDataDMA
+				 * only takes it with the ring empty): they follow, from USART_DMA_TxIRQHandling.
+				 */
+				const uint8_t *pNext = pUSARTHandle->pTxDMAPending;
+				pUSARTHandle->pTxDMAPending = 0;
+				USART_DMA_StartTx(pUSARTHandle, pNext, pUSARTHandle->TxDMAPendingLen);
+			}
+			else if (USART_GetTxQueued(pUSARTHandle) == 0){
+				// main() may have queued more bytes in the meantime (TXEIE is on again then): only go idle if truly empty
+				pUSARTHandle->TxBusy = RESET;
+			}
+		}
+	}
+}
@@ -9,6 +9,8 @@
 #define SOURCES_STM32F446XX_UART_DRIVER_H_
 
 #include "stm32f446xx.h"
+#include "stm32f446xx_dma_driver.h"
+#include "spsc_queue.h"
 
 /*
  * ==========================================
@@ -37,6 +39,16 @@ typedef struct{
 	uint32_t USART_Baud; // 9600, 115200, etc.
 } USART_Config_t;
 
+/*
+ * TX / RX Queue Sizes
+ * MUST be powers of two (see spsc_queue.h).
+ * TX: 256 bytes holds a reply plus a few batches of log records (64-byte payload frames).
+ * RX: what can pile up between two passes of the main loop
+ *     (128: a pipelined burst of ~10 command frames from the PC).
+ */
+#define USART_TX_BUFFER_SIZE 256U
+#define USART_RX_BUFFER_SIZE 128U
+
 /*
  * USART Handle Structure
  * This structure acts as the "Object" or "Handle" for a specific Timer instance.
@@ -45,10 +57,53 @@ typedef struct{
  * Concept: "Job Order"
  * - "Where" to do the job: pUSART2 (Base Address of the peripheral)
  * - "How" to do the job:   USART2_Config (User parameters)
+ *
+ * TX Queue (Interrupt-driven transmit):
+ * main() is the producer (USART_SendDataIT), the USART ISR is the consumer.
+ * RX Queue:
+ * the USART ISR is the producer, main() is the consumer (USART_ReadRx).
+ * Both are lock-free SPSC queues, so no interrupt disabling is needed to use them.
  */
 typedef struct{
 	USART_RegDef_t *pUSARTx;
 	USART_Config_t USART_Config;
+
+	uint32_t ActualBaud;      // baud rate really produced by BRR (0: requested rate not reachable)
+	int32_t BaudErrorPpm;     // (ActualBaud - requested) in parts per million
+	uint32_t BaudClock;       // PCLK that BRR was computed for (USART_ClockChanged)
+
+	SPSC_Queue_t TxQueue;
+	uint8_t TxStorage[USART_TX_BUFFER_SIZE];
+	volatile uint8_t TxBusy;  // SET until the last queued byte has fully left the shift register
+
+	SPSC_Queue_t RxQueue;     // RxQueue.HighWater / RxQueue.Dropped -> RX health statistics
+	uint8_t RxStorage[USART_RX_BUFFER_SIZE];
+
+	DMA_Handle_t *pTxDMA;                    // NULL -> DMA transmit not set up
+	volatile uint8_t TxDMAActive;            // SET while a DMA message is in flight
+	const uint8_t * volatile pTxDMAPending;  // queued message (NULL -> slot is free)
+	volatile uint16_t TxDMAPendingLen;
+
+	/*
+	 * DMA Receive (Circular, see USART_DMA_RxInit)
+	 * The DMA writes every incoming byte into pRxDMABuffer and wraps around forever.
+	 * The DMA is the "writer" (its position = RxDMASize - NDTR), and the ISR moves
+	 * everything new (RxDMAPos -> DMA position) into RxQueue in one go.
+	 */
+	DMA_Handle_t *pRxDMA;               // NULL -> DMA receive not set up
+	uint8_t *pRxDMABuffer;
+	uint16_t RxDMASize;
+	uint16_t RxDMAPos;                  // next DMA byte not yet moved into RxQueue (ISR only)
+	uint8_t RxDMACrossed;               // half (Bit 0) / end (Bit 1) of the buffer drained past, not flagged yet
+
+	/* Receive statistics (only ever incremented, by the ISR) */
+	volatile uint32_t RxFrames;         // IDLE line detected after a burst
+	volatile uint32_t RxOverrunErrors;  // ORE: a byte arrived before the previous one was taken
+	volatile uint32_t RxFramingErrors;  // FE: stop bit was not where it should be (baud mismatch / noise)
+	volatile uint32_t RxNoiseErrors;    // NF: noise detected while sampling
+	volatile uint32_t RxLappedBytes;    // DMA wrote over bytes not drained yet: RxDMASize per lap (at least)
+	volatile uint32_t RxDroppedBytes;   // drained, but RxQueue was full
+	volatile uint32_t RxDMAErrors;      // TE: the stream stopped, restarted by USART_DMA_RxIRQHandling
 } USART_Handle_t;
 
 /*
@@ -77,9 +132,39 @@ typedef struct{
 #define USART_StopBits_2    2
 #define USART_StopBits_1_5  3
 
-/* @USART_BaudRate */
+/*
+ * @USART_BaudRate
+ * Any value works (BRR is computed from the real PCLK), these are just the common ones.
+ * Upper limit = PCLK / 8 (OVER8), e.g. 2 Mbaud with PCLK1 = 16 MHz, 5.625 Mbaud with PCLK1 = 45 MHz.
+ * Check USART_Handle_t.ActualBaud / BaudErrorPpm after USART_Init.
+ */
 #define USART_Baud_9600     9600
 #define USART_Baud_115200   115200
+#define USART_Baud_230400   230400
+#define USART_Baud_460800   460800
+#define USART_Baud_921600   921600
+#define USART_Baud_1000000  1000000
+#define USART_Baud_2000000  2000000
+#define USART_Baud_3000000  3000000
+#define USART_Baud_4500000  4500000
+
+/* @USART_Status (return values of the bounded calls) */
+#define USART_OK            0
+#define USART_TIMEOUT       1
+#define USART_BUSY          2
+
+// USART_SendData: longest wait for TXE, one 10-bit character at 9600 baud is 1.04 ms
+#define USART_BYTE_TIMEOUT_US  2000U
+
+/*
+ * @USART_Events
+ * Passed to USART_ApplicationEventCallback (the application may override it)
+ */
+#define USART_EVENT_TX_DMA_CPLT   1 // a DMA message finished, its buffer may be reused
+#define USART_EVENT_TX_DMA_ERROR  2 // DMA transfer error, the message was dropped
+#define USART_EVENT_RX_FRAME      3 // RX line went IDLE: a complete burst is waiting
+#define USART_EVENT_RX_DATA       4 // RX DMA buffer half/fully written (long burst, read it early)
+#define USART_EVENT_RX_DMA_ERROR  5 // RX DMA transfer error: bytes may be lost, reception restarted
 
 /*
  * ==========================================
@@ -87,10 +172,71 @@ typedef struct{
  * ==========================================
  */
 void USART_Init(USART_Handle_t *pUSARTHandle);
-void USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate);
+/*
+ * Returns the baud rate actually achieved, 0 if BaudRate cannot be produced from the current PCLK
+ * (BRR is then left unchanged). Call it again after every clock change.
+ */
+uint32_t USART_SetBaudRate(USART_RegDef_t *pUSARTx, uint32_t BaudRate);
+
+/*
+ * Clock-change hook (RCC_RegisterClockHook, through a wrapper): BRR again for USART_Config.USART_Baud,
+ * only if the USART's PCLK really changed. Make sure the line is quiet first (USART_FlushTx).
+ */
+void USART_ClockChanged(USART_Handle_t *pUSARTHandle);
+
+/*
+ * Blocking (polled) transfer, bounded (returns USART_OK or USART_TIMEOUT)
+ * USART_SendData:    gives up if one byte is not taken within USART_BYTE_TIMEOUT_US
+ * USART_ReceiveData: one byte into *pData, or nothing after TimeoutUs (at most TIMESTAMP_MAX_DEADLINE_US)
+ */
+uint8_t USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t Len);
+uint8_t USART_ReceiveData(USART_Handle_t *pUSARTHandle, uint8_t *pData, uint32_t TimeoutUs);
+
+/*
+ * Non-blocking transmit (TX ring buffer drained by the TXE/TC interrupt)
+ * USART_SendDataIT returns the number of bytes actually queued (less than Len if the ring is full).
+ * USART_FlushTx waits until everything queued has left the TX pin,
+ * giving up after TimeoutUs microseconds (returns USART_OK or USART_TIMEOUT).
+ * USART_WaitTxFree only waits until the ring has room for Len more bytes (same returns).
+ */
+uint32_t USART_SendDataIT(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint32_t Len);
+uint32_t USART_GetTxQueued(USART_Handle_t *pUSARTHandle);
+uint32_t USART_GetTxFree(USART_Handle_t *pUSARTHandle);
+uint8_t USART_FlushTx(USART_Handle_t *pUSARTHandle, uint32_t TimeoutUs);
+uint8_t USART_WaitTxFree(USART_Handle_t *pUSARTHandle, uint32_t Len, uint32_t TimeoutUs);
+
+/*
+ * DMA transmit (USART2_TX -> DMA1 Stream 6, Channel 4)
+ * pTxBuffer is NOT copied: it must stay untouched until USART_EVENT_TX_DMA_CPLT.
+ * (const strings in Flash are perfect for this)
+ * Returns USART_OK if the message was started or queued, USART_BUSY if both slots are taken,
+ * or if bytes of USART_SendDataIT are still waiting in the TX ring (they must go out first).
+ */
+void USART_DMA_TxInit(USART_Handle_t *pUSARTHandle, DMA_Handle_t *pDMAHandle);
+uint8_t USART_SendDataDMA(USART_Handle_t *pUSARTHandle, const uint8_t *pTxBuffer, uint16_t Len);
+void USART_DMA_TxIRQHandling(USART_Handle_t *pUSARTHandle); // call from DMA1_Stream6_IRQHandler
+
+/*
+ * Receive (RX Queue)
+ * Bytes arrive in RxQueue either from the RXNE interrupt (USART_ReceiveIT)
+ * or from the circular DMA (USART_DMA_RxInit), main() reads them the same way.
+ */
+void USART_ReceiveIT(USART_Handle_t *pUSARTHandle);
+uint32_t USART_RxAvailable(USART_Handle_t *pUSARTHandle);
+uint32_t USART_ReadRx(USART_Handle_t *pUSARTHandle, uint8_t *pDest, uint32_t MaxLen);
+
+/*
+ * Circular DMA receive with IDLE-line frame detection (USART2_RX -> DMA1 Stream 5, Channel 4)
+ * pRxBuffer is owned by the DMA from now on.
+ * USART_EVENT_RX_FRAME is raised every time the line goes quiet after a burst.
+ * NOTE: the USART IRQ and the RX DMA IRQ must share the same NVIC priority (the default),
+ * since both push into RxQueue and the queue allows only one producer.
+ */
+void USART_DMA_RxInit(USART_Handle_t *pUSARTHandle, DMA_Handle_t *pDMAHandle, uint8_t *pRxBuffer, uint16_t Size);
+void USART_DMA_RxIRQHandling(USART_Handle_t *pUSARTHandle); // call from DMA1_Stream5_IRQHandler
 
-void USART_SendData(USART_Handle_t *pUSARTHandle, uint8_t *pTxBuffer, uint32_t Len);
-uint8_t USART_ReceiveData(USART_Handle_t *pUSARTHandle);
+void USART_ApplicationEventCallback(USART_Handle_t *pUSARTHandle, uint8_t AppEvent);
 
 void USART_IRQInterruptConfig(uint8_t IRQNumber, uint8_t EnableOrDisable);
+void USART_IRQHandling(USART_Handle_t *pUSARTHandle); // call from USARTx_IRQHandler
 #endif /* SOURCES_STM32F446XX_UART_DRIVER_H_ */
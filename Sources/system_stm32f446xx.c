@@ -0,0 +1,46 @@
+/*
+ * system_stm32f446xx.c
+ *
+ *  Created on: 2026/2/27
+ *      Author: Yuheng
+ *
+ * Description:
+ * SystemInit: the first C function to run, called by Reset_Handler (startup_stm32f446retx.s)
+ * BEFORE .data is copied and .bss is zeroed, so no global variable may be touched here.
+ * The clock tree is left to main() (SystemClock_Config): it needs the timestamps, which live in .bss.
+ *
+ * Floating Point Unit
+ * [Previously] never enabled: the build was soft-float anyway (MFLOAT_ABI empty), so every
+ * float / double went through libgcc routines (__aeabi_fmul ...: tens of cycles per operation).
+ * The Cortex-M4F FPU (single precision, 1 cycle for most instructions) is OFF after reset:
+ * the first VFP instruction would be a UsageFault (NOCP).
+ *
+ * Enabled here in EVERY build, so a hard-float image (CMakeLists.txt, FELINEGUARD_HARD_FLOAT)
+ * can use it from the first line of the C runtime on (the hard-float newlib may, too).
+ *
+ * ISR cost (PM0214 2.3.7 Exception entry and return):
+ * - Thread code has not used the FPU (CONTROL.FPCA = 0): nothing changes, 8-word frame (32 bytes).
+ * - It has: every exception pushes the extended 26-word frame (104 bytes), 72 bytes more stack
+ *   per nesting level. With lazy stacking (LSPEN) that space is only RESERVED: S0-S15 / FPSCR are
+ *   written only if the handler itself runs an FP instruction. The ISRs of this project are
+ *   integer-only, so their entry latency stays at 12 cycles; only the stack grows.
+ * - A handler that does use the FPU pays ~17 more cycles for the lazy save (and restore on return).
+ */
+#include "stm32f446xx.h"
+#include <stdint.h>
+
+void SystemInit(void){
+	/*
+	 * CP10 / CP11 full access (CPACR Bits 23:20 = 1111), then DSB + ISB:
+	 * the next instruction may already be a VFP one (PM0214 4.6.6 Enabling the FPU).
+	 */
+	SCB_CPACR |= (0xFU << 20);
+	SYNC_BARRIER();
+
+	/*
+	 * Automatic + lazy FP context save on exceptions (FPCCR ASPEN / LSPEN).
+	 * Both are 1 after reset already: written anyway, so the ISR cost above does not depend
+	 * on what a bootloader might have left behind.
+	 */
+	FPU_FPCCR |= (1U << 31) | (1U << 30);
+}
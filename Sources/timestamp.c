@@ -0,0 +1,113 @@
+/*
+ * timestamp.c
+ *
+ *  Created on: 2026/2/23
+ *      Author: Yuheng
+ */
+#include "stm32f446xx.h"
+#include "stm32f446xx_rcc_driver.h"
+#include "timestamp.h"
+#include <stdint.h>
+
+static uint32_t CyclesHigh;   // CYCCNT wraps seen so far
+static uint32_t CyclesLast;   // CYCCNT at the last read, to see the next wrap
+
+static uint32_t UsPerCycleQ32; // 1e6 / HCLK in 1/2^32ths
+static uint32_t CyclesPerUs;   // HCLK / 1e6, rounded up (deadlines are never early)
+static uint64_t BaseCycles;    // the conversion counts from here ...
+static uint64_t BaseUs;        // ... where the clock showed this many us
+
+// Inside a critical section: every read is also a wrap check
+static uint64_t Timestamp_Extend(void){
+	uint32_t low = DWT->CYCCNT;
+
+	if (low < CyclesLast){
+		CyclesHigh++;
+	}
+	CyclesLast = low;
+
+	return ((uint64_t)CyclesHigh << 32) | low;
+}
+
+// Inside a critical section: Cycles (>= BaseCycles) -> us
+static uint64_t Timestamp_ToUs(uint64_t Cycles){
+	uint64_t delta = Cycles - BaseCycles;
+
+	// delta x Q32 = (high word x Q32) + (low word x Q32) / 2^32: two UMULLs, no 128-bit product
+	return BaseUs + ((uint64_t)(uint32_t)(delta >> 32) * UsPerCycleQ32)
+			+ (((uint64_t)(uint32_t)delta * UsPerCycleQ32) >> 32);
+}
+
+static uint32_t Timestamp_Scale(uint32_t Hclk){
+	return (uint32_t)((1000000ULL << 32) / Hclk); // once per clock change, HCLK > 1 MHz
+}
+
+void Timestamp_Init(void){
+	/*
+	 * DEMCR Bit 24 TRCENA: Global enable for the DWT and ITM units
+	 * DWT_CTRL Bit 0 CYCCNTENA: enable the cycle counter
+	 */
+	SET_BIT(DEMCR, 24);
+	DWT->CYCCNT = 0;
+	SET_BIT(DWT->CTRL, 0);
+
+	CyclesHigh = 0;
+	CyclesLast = 0;
+	BaseCycles = 0;
+	BaseUs = 0;
+	uint32_t hclk = RCC_GetHCLKValue();
+	UsPerCycleQ32 = Timestamp_Scale(hclk);
+	CyclesPerUs = (hclk + 999999U) / 1000000U;
+}
+
+uint64_t Timestamp_Cycles(void){
+	uint32_t state = Critical_Enter();
+	uint64_t cycles = Timestamp_Extend();
+	Critical_Exit(state);
+
+	return cycles;
+}
+
+uint64_t Timestamp_Us(void){
+	uint32_t state = Critical_Enter();
+	uint64_t us = Timestamp_ToUs(Timestamp_Extend());
+	Critical_Exit(state);
+
+	return us;
+}
+
+uint32_t Timestamp_CyclesToUs(uint32_t Cycles){
+	return (uint32_t)(((uint64_t)Cycles * UsPerCycleQ32) >> 32);
+}
+
+uint32_t Timestamp_Deadline(uint32_t Us){
+	if (Us > TIMESTAMP_MAX_DEADLINE_US){
+		Us = TIMESTAMP_MAX_DEADLINE_US;
+	}
+	return DWT->CYCCNT + (Us * CyclesPerUs);
+}
+
+void Timestamp_Poll(void){
+	uint32_t state = Critical_Enter();
+	(void)Timestamp_Extend();
+	Critical_Exit(state);
+}
+
+void Timestamp_ClockChanged(void){
+	uint32_t hclk = RCC_GetHCLKValue();
+	uint32_t scale = Timestamp_Scale(hclk); // the divisions outside the critical section
+	uint32_t per_us = (hclk + 999999U) / 1000000U;
+	uint32_t state = Critical_Enter();
+
+	/*
+	 * The cycles counted so far were at the OLD clock: fold them into BaseUs first.
+	 * Called right after the switch, so only the few cycles since it are converted at the wrong rate.
+	 */
+	uint64_t now = Timestamp_Extend();
+	BaseUs = Timestamp_ToUs(now);
+	BaseCycles = now;
+	UsPerCycleQ32 = scale;
+	CyclesPerUs = per_us;
+
+	Critical_Exit(state);
+}
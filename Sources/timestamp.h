@@ -0,0 +1,81 @@
+/*
+ * timestamp.h
+ *
+ *  Created on: 2026/2/23
+ *      Author: Yuheng
+ *
+ * Description:
+ * Monotonic timestamps: core clock cycles and microseconds since boot, on 64 bits.
+ *
+ * [Previously] there was no notion of "now" at all: software_delay() counts NOPs,
+ * and nothing could tell how long an ISR, a command or a DMA job took.
+ *
+ * Source: DWT CYCCNT (see stm32f446xx.h), a 32-bit counter of core clock cycles.
+ * - No timer used up (TIM2 / TIM3 both have a job), nothing to configure but 2 bits.
+ * - One load to read it: Timestamp_Cycles32() is the cheapest stopwatch there is.
+ * - It wraps every 2^32 cycles (268 s at 16 MHz, 24 s at 180 MHz): the 64-bit value keeps
+ *   the number of wraps, and needs Timestamp_Poll() at least once per wrap period
+ *   (the SysTick tick calls it every ms).
+ *
+ * Microseconds:
+ * us = cycles x (1e6 / HCLK), with 1e6 / HCLK as a Q32 fraction (UMULL, no division).
+ * Exact for 16 MHz (2^28), within 20 ppb for any other clock.
+ * When HCLK changes, Timestamp_ClockChanged() re-bases the conversion, so the microseconds
+ * keep counting on from where they were (cycles are always the raw count).
+ *
+ * Bounded busy-waits (drivers):
+ * A deadline is a CYCCNT value. It keeps counting with interrupts masked and inside an ISR,
+ * where a millisecond tick (SysTick) stands still, so every driver wait on a hardware flag
+ * can give up, wherever it is called from:
+ *
+ *   uint32_t deadline = Timestamp_Deadline(100U);
+ *   while (!flag){ if (Timestamp_Expired(deadline)){ return XXX_TIMEOUT; } }
+ *
+ * Safe to call from main() AND from any ISR.
+ */
+
+#ifndef SOURCES_TIMESTAMP_H_
+#define SOURCES_TIMESTAMP_H_
+
+#include <stdint.h>
+#include "stm32f446xx.h"
+
+/*
+ * ==========================================
+ * 		Function Prototypes
+ * ==========================================
+ */
+// DEMCR TRCENA + DWT CYCCNTENA, counter from 0, conversion from the current HCLK
+void Timestamp_Init(void);
+
+/*
+ * Raw 32 bits, ~2 cycles: for short intervals (end - start, correct across one wrap).
+ * e.g. uint32_t t0 = Timestamp_Cycles32(); ... ; LOG_INFO("%u us", Timestamp_CyclesToUs(Timestamp_Cycles32() - t0));
+ */
+static inline uint32_t Timestamp_Cycles32(void){
+	return DWT->CYCCNT;
+}
+
+uint64_t Timestamp_Cycles(void); // since Timestamp_Init
+uint64_t Timestamp_Us(void);     // since Timestamp_Init
+uint32_t Timestamp_CyclesToUs(uint32_t Cycles); // a 32-bit interval at the current HCLK
+
+/*
+ * Deadline Us microseconds from now (at most TIMESTAMP_MAX_DEADLINE_US: CYCCNT is compared
+ * with a subtraction, so a deadline must stay within half a wrap)
+ */
+#define TIMESTAMP_MAX_DEADLINE_US  10000000U // 10 s (2^31 cycles = 11.9 s at 180 MHz)
+
+uint32_t Timestamp_Deadline(uint32_t Us);
+
+static inline uint8_t Timestamp_Expired(uint32_t Deadline){
+	return ((int32_t)(DWT->CYCCNT - Deadline) >= 0) ? SET : RESET;
+}
+
+// At least once per CYCCNT wrap (the SysTick tick does it)
+void Timestamp_Poll(void);
+
+// After every change of HCLK (PLL, prescalers)
+void Timestamp_ClockChanged(void);
+
+#endif /* SOURCES_TIMESTAMP_H_ */